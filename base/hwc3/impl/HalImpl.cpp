@@ -619,9 +619,8 @@ int32_t HalImpl::setClientTarget(int64_t display, buffer_handle_t target,
     a2h::translate(dataspace, hwcDataspace);
     a2h::translate(damage, hwcDamage);
     hwc_region_t region = { hwcDamage.size(), hwcDamage.data() };
-    UNUSED(region);
 
-    return mDevice->setClientTarget(halDisplay, target, hwcFence, hwcDataspace);
+    return mDevice->setClientTarget(halDisplay, target, hwcFence, hwcDataspace, region);
 }
 
 int32_t HalImpl::setColorMode(int64_t display, ColorMode mode, RenderIntent intent) {
@@ -966,9 +965,15 @@ int32_t HalImpl::validateDisplay(int64_t display, std::vector<int64_t>* outChang
 }
 
 int HalImpl::setExpectedPresentTime(
-        int64_t __unused display, const std::optional<ClockMonotonicTimestamp> __unused expectedPresentTime) {
+        int64_t display, const std::optional<ClockMonotonicTimestamp> expectedPresentTime) {
+    ExynosDisplay* halDisplay;
+    RET_IF_ERR(getHalDisplay(display, halDisplay));
 
-    return HWC2_ERROR_UNSUPPORTED;
+    if (!expectedPresentTime.has_value()) {
+        return halDisplay->setExpectedPresentTime(0);
+    }
+
+    return halDisplay->setExpectedPresentTime(expectedPresentTime->timestampNanos);
 }
 
 } // namespace aidl::android::hardware::graphics::composer3::impl
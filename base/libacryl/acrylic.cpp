@@ -26,6 +26,7 @@
 Acrylic::Acrylic(const HW2DCapability &capability)
     : mCapability(capability), mHasBackgroundColor(false),
       mMaxTargetLuminance(100), mMinTargetLuminance(0), mTargetDisplayInfo(nullptr),
+      mTargetDisplayDevice(-1),
       mCanvas(this, AcrylicCanvas::CANVAS_TARGET)
 {
     ALOGD_TEST("Created a new Acrylic on %p", this);
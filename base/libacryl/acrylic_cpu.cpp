@@ -0,0 +1,960 @@
+/*
+ * Copyright Samsung Electronics Co.,LTD.
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/dma-buf.h>
+
+#include <system/graphics.h>
+#include <log/log.h>
+
+#include <hardware/hwcomposer2.h>
+
+#include <exynos_format.h> // hardware/smasung_slsi/exynos/include
+
+#include "acrylic_internal.h"
+#include "acrylic_csc.h"
+#include "acrylic_cpu.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define CPU_FENCE_TIMEOUT_MSEC  3000
+#define CPU_DECODE_ROWS         64
+
+/*
+ * 4-component vector of float to process a RGBA pixel at once.
+ * NEON and SSE2 are used if available. Otherwise scalar operations are used.
+ */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+typedef float32x4_t vec4;
+
+static inline vec4 vec4_load_u16(const uint16_t *p) { return vcvtq_f32_u32(vmovl_u16(vld1_u16(p))); }
+static inline vec4 vec4_load(const float *p) { return vld1q_f32(p); }
+static inline void vec4_store(float *p, vec4 v) { vst1q_f32(p, v); }
+static inline vec4 vec4_splat(float f) { return vdupq_n_f32(f); }
+static inline vec4 vec4_set(float r, float g, float b, float a)
+{
+    float f[4] = {r, g, b, a};
+    return vld1q_f32(f);
+}
+static inline vec4 vec4_add(vec4 a, vec4 b) { return vaddq_f32(a, b); }
+static inline vec4 vec4_sub(vec4 a, vec4 b) { return vsubq_f32(a, b); }
+static inline vec4 vec4_mul(vec4 a, vec4 b) { return vmulq_f32(a, b); }
+static inline vec4 vec4_mla(vec4 acc, vec4 a, vec4 b) { return vmlaq_f32(acc, a, b); }
+static inline float vec4_alpha(vec4 v) { return vgetq_lane_f32(v, 3); }
+#elif defined(__SSE2__)
+typedef __m128 vec4;
+
+static inline vec4 vec4_load_u16(const uint16_t *p)
+{
+    __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, _mm_setzero_si128()));
+}
+static inline vec4 vec4_load(const float *p) { return _mm_loadu_ps(p); }
+static inline void vec4_store(float *p, vec4 v) { _mm_storeu_ps(p, v); }
+static inline vec4 vec4_splat(float f) { return _mm_set1_ps(f); }
+static inline vec4 vec4_set(float r, float g, float b, float a) { return _mm_setr_ps(r, g, b, a); }
+static inline vec4 vec4_add(vec4 a, vec4 b) { return _mm_add_ps(a, b); }
+static inline vec4 vec4_sub(vec4 a, vec4 b) { return _mm_sub_ps(a, b); }
+static inline vec4 vec4_mul(vec4 a, vec4 b) { return _mm_mul_ps(a, b); }
+static inline vec4 vec4_mla(vec4 acc, vec4 a, vec4 b) { return _mm_add_ps(acc, _mm_mul_ps(a, b)); }
+static inline float vec4_alpha(vec4 v) { return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))); }
+#else
+struct vec4 {
+    float v[4];
+};
+
+static inline vec4 vec4_load_u16(const uint16_t *p) { return {{p[0] * 1.0f, p[1] * 1.0f, p[2] * 1.0f, p[3] * 1.0f}}; }
+static inline vec4 vec4_load(const float *p) { return {{p[0], p[1], p[2], p[3]}}; }
+static inline void vec4_store(float *p, vec4 v)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = v.v[i];
+}
+static inline vec4 vec4_splat(float f) { return {{f, f, f, f}}; }
+static inline vec4 vec4_set(float r, float g, float b, float a) { return {{r, g, b, a}}; }
+static inline vec4 vec4_add(vec4 a, vec4 b)
+{
+    return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+}
+static inline vec4 vec4_sub(vec4 a, vec4 b)
+{
+    return {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}};
+}
+static inline vec4 vec4_mul(vec4 a, vec4 b)
+{
+    return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}};
+}
+static inline vec4 vec4_mla(vec4 acc, vec4 a, vec4 b) { return vec4_add(acc, vec4_mul(a, b)); }
+static inline float vec4_alpha(vec4 v) { return v.v[3]; }
+#endif
+
+enum cpu_pixel_layout {
+    CPU_FMT_RGBA8888,
+    CPU_FMT_RGBX8888,
+    CPU_FMT_BGRA8888,
+    CPU_FMT_RGB888,
+    CPU_FMT_RGB565,
+    CPU_FMT_RGBA1010102,
+    CPU_FMT_NV12,
+    CPU_FMT_NV21,
+    CPU_FMT_P010,
+};
+
+struct cpu_fmt {
+    uint32_t halfmt;
+    cpu_pixel_layout layout;
+    uint32_t num_bufs;
+    uint32_t bpp;       // bytes per pixel of the first plane
+};
+
+static const cpu_fmt __halfmt_to_cpufmt[] = {
+//  {halfmt,                                      layout,              num_buffers, bpp}
+    {HAL_PIXEL_FORMAT_RGBA_8888,                  CPU_FMT_RGBA8888,    1, 4},
+    {HAL_PIXEL_FORMAT_RGBX_8888,                  CPU_FMT_RGBX8888,    1, 4},
+    {HAL_PIXEL_FORMAT_BGRA_8888,                  CPU_FMT_BGRA8888,    1, 4},
+    {HAL_PIXEL_FORMAT_RGB_888,                    CPU_FMT_RGB888,      1, 3},
+    {HAL_PIXEL_FORMAT_RGB_565,                    CPU_FMT_RGB565,      1, 2},
+    {HAL_PIXEL_FORMAT_RGBA_1010102,               CPU_FMT_RGBA1010102, 1, 4},
+    {HAL_PIXEL_FORMAT_YCrCb_420_SP,               CPU_FMT_NV21,        1, 1},
+    {HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M,      CPU_FMT_NV21,        2, 1},
+    {HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M_FULL, CPU_FMT_NV21,        2, 1},
+    {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP,        CPU_FMT_NV12,        1, 1},
+    {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M,      CPU_FMT_NV12,        2, 1},
+    {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_PRIV, CPU_FMT_NV12,        2, 1},
+    {HAL_PIXEL_FORMAT_YCBCR_P010,                 CPU_FMT_P010,        1, 2},
+    {HAL_PIXEL_FORMAT_EXYNOS_YCbCr_P010_M,        CPU_FMT_P010,        2, 2},
+};
+
+static const cpu_fmt *halfmt_to_cpufmt(uint32_t halfmt)
+{
+    for (size_t i = 0 ; i < ARRSIZE(__halfmt_to_cpufmt); i++) {
+        if (__halfmt_to_cpufmt[i].halfmt == halfmt)
+            return &__halfmt_to_cpufmt[i];
+    }
+
+    ALOGE("Unable to find the proper CPU format for HAL format %#x", halfmt);
+
+    return NULL;
+}
+
+static inline bool cpufmt_is_ycbcr(const cpu_fmt *fmt)
+{
+    return fmt->layout >= CPU_FMT_NV12;
+}
+
+static inline int clamp_int(int v, int max)
+{
+    return (v < 0) ? 0 : ((v > max) ? max : v);
+}
+
+static inline float clamp_unit(float v)
+{
+    return (v < 0.0f) ? 0.0f : ((v > 1.0f) ? 1.0f : v);
+}
+
+static inline uint16_t expand_to_16bit(int v, int depth)
+{
+    return (depth == 8) ? static_cast<uint16_t>(v * 257)
+                        : static_cast<uint16_t>((v << 6) | (v >> 4));
+}
+
+static bool waitFence(int fence)
+{
+    if (fence < 0)
+        return true;
+
+    struct pollfd fds = {fence, POLLIN, 0};
+    int ret;
+    do {
+        ret = poll(&fds, 1, CPU_FENCE_TIMEOUT_MSEC);
+    } while ((ret < 0) && (errno == EINTR || errno == EAGAIN));
+
+    if (ret == 0) {
+        ALOGE("Timed out waiting for fence %d", fence);
+        return false;
+    } else if (ret < 0) {
+        ALOGERR("Failed to wait for fence %d", fence);
+        return false;
+    }
+
+    return true;
+}
+
+bool AcrylicCompositorCPU::CSCParam::configure(const uint16_t table[][CSC_MATRIX_COEF_COUNT],
+                                               int dataspace, int depth)
+{
+    int index = csc_find_matrix_index(dataspace);
+    if (index < 0) {
+        ALOGE("Data space %d is not supported by the CPU compositor", dataspace);
+        return false;
+    }
+
+    for (int i = 0; i < CSC_MATRIX_COEF_COUNT; i++)
+        coef[i] = static_cast<int16_t>(table[index][i]);
+
+    offsetY = ((dataspace & HAL_DATASPACE_RANGE_FULL) != 0) ? 0 : (16 << (depth - 8));
+    offsetC = 128 << (depth - 8);
+    max = (1 << depth) - 1;
+
+    return true;
+}
+
+AcrylicCompositorCPU::AcrylicCompositorCPU(const HW2DCapability &capability)
+    : Acrylic(capability), mJob(NULL), mJobCount(0), mJobThreads(0), mJobNext(0),
+      mJobGeneration(0), mBusyWorkers(0), mExitWorkers(false), mLaptimeUSec(0)
+{
+    unsigned int cores = std::thread::hardware_concurrency();
+
+    mThreadCount = std::max(1U, std::min(cores, static_cast<unsigned int>(LIBACRYL_CPU_MAX_THREADS)));
+    mTiles.resize(mThreadCount);
+
+    for (unsigned int i = 1; i < mThreadCount; i++)
+        mWorkers.emplace_back(&AcrylicCompositorCPU::workerLoop, this, i);
+
+    ALOGD_TEST("Created a new Acrylic for CPU on %p with %u threads", this, mThreadCount);
+}
+
+AcrylicCompositorCPU::~AcrylicCompositorCPU()
+{
+    {
+        std::lock_guard<std::mutex> lock(mPoolMutex);
+        mExitWorkers = true;
+    }
+    mJobCondition.notify_all();
+
+    for (auto &worker : mWorkers)
+        worker.join();
+
+    ALOGD_TEST("Deleting Acrylic for CPU on %p", this);
+}
+
+bool AcrylicCompositorCPU::mapImage(AcrylicCanvas &canvas, MappedImage &image, bool write)
+{
+    image.count = 0;
+
+    if (canvas.isProtected() || canvas.isCompressed() || canvas.isUOrder() || canvas.isOTF()) {
+        ALOGE("Protected, compressed, U-Order or OTF image is not accessible by CPU");
+        return false;
+    }
+
+    image.fmt = halfmt_to_cpufmt(canvas.getFormat());
+    if (!image.fmt)
+        return false;
+
+    if ((canvas.getBufferType() != AcrylicCanvas::MT_DMABUF) &&
+            (canvas.getBufferType() != AcrylicCanvas::MT_USERPTR)) {
+        ALOGE("Unsupported buffer type %d", canvas.getBufferType());
+        return false;
+    }
+
+    if (canvas.getBufferCount() < image.fmt->num_bufs) {
+        ALOGE("HAL Format %#x requires %d buffers but %d buffers are given",
+              canvas.getFormat(), image.fmt->num_bufs, canvas.getBufferCount());
+        return false;
+    }
+
+    hw2d_coord_t xy = canvas.getImageDimension();
+    bool ycbcr = cpufmt_is_ycbcr(image.fmt);
+    unsigned int num_planes = ycbcr ? 2 : 1;
+
+    if (ycbcr && ((xy.hori % 2) != 0)) {
+        ALOGE("Width %d of YCbCr 4:2:0 image should be even", xy.hori);
+        return false;
+    }
+
+    for (unsigned int i = 0; i < num_planes; i++) {
+        image.stride[i] = canvas.getStride(i) ? canvas.getStride(i) : xy.hori * image.fmt->bpp;
+        if (image.stride[i] < xy.hori * image.fmt->bpp) {
+            ALOGE("Too small stride %u of plane %u for width %d", image.stride[i], i, xy.hori);
+            return false;
+        }
+    }
+
+    size_t required[MAX_HW2D_PLANES] = {0, };
+    required[0] = static_cast<size_t>(image.stride[0]) * xy.vert;
+    if (ycbcr) {
+        size_t chroma = static_cast<size_t>(image.stride[1]) * ((xy.vert + 1) / 2);
+        if (image.fmt->num_bufs == 1)
+            required[0] += chroma;
+        else
+            required[1] = chroma;
+    }
+
+    for (unsigned int i = 0; i < image.fmt->num_bufs; i++) {
+        if (canvas.getBufferLength(i) < required[i]) {
+            ALOGE("Buffer %u of HAL format %#x %dx%d is too small (%u < %zu)", i,
+                  canvas.getFormat(), xy.hori, xy.vert, canvas.getBufferLength(i), required[i]);
+            unmapImage(image, write);
+            return false;
+        }
+
+        image.dmabuf[i] = -1;
+        image.mapped[i] = NULL;
+        image.mappedLength[i] = 0;
+
+        if (canvas.getBufferType() == AcrylicCanvas::MT_USERPTR) {
+            image.plane[i] = reinterpret_cast<uint8_t *>(canvas.getUserptr(i));
+        } else {
+            int fd = canvas.getDmabuf(i);
+            size_t len = canvas.getOffset(i) + canvas.getBufferLength(i);
+            void *addr = mmap(NULL, len, write ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                              MAP_SHARED, fd, 0);
+            if (addr == MAP_FAILED) {
+                ALOGERR("Failed to map dmabuf %d of %zu bytes", fd, len);
+                unmapImage(image, write);
+                return false;
+            }
+
+            struct dma_buf_sync sync;
+            sync.flags = DMA_BUF_SYNC_START | (write ? DMA_BUF_SYNC_RW : DMA_BUF_SYNC_READ);
+            if (ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync) < 0)
+                ALOGERR("Failed to start CPU access to dmabuf %d", fd);
+
+            image.dmabuf[i] = fd;
+            image.mapped[i] = addr;
+            image.mappedLength[i] = len;
+            image.plane[i] = reinterpret_cast<uint8_t *>(addr) + canvas.getOffset(i);
+        }
+
+        image.count++;
+    }
+
+    if (ycbcr && (image.fmt->num_bufs == 1))
+        image.plane[1] = image.plane[0] + static_cast<size_t>(image.stride[0]) * xy.vert;
+
+    return true;
+}
+
+void AcrylicCompositorCPU::unmapImage(MappedImage &image, bool write)
+{
+    for (unsigned int i = 0; i < image.count; i++) {
+        if (!image.mapped[i])
+            continue;
+
+        struct dma_buf_sync sync;
+        sync.flags = DMA_BUF_SYNC_END | (write ? DMA_BUF_SYNC_RW : DMA_BUF_SYNC_READ);
+        if (ioctl(image.dmabuf[i], DMA_BUF_IOCTL_SYNC, &sync) < 0)
+            ALOGERR("Failed to end CPU access to dmabuf %d", image.dmabuf[i]);
+
+        munmap(image.mapped[i], image.mappedLength[i]);
+        image.mapped[i] = NULL;
+    }
+
+    image.count = 0;
+}
+
+bool AcrylicCompositorCPU::prepareSource(AcrylicLayer &layer, SourceImage &source,
+                                         hw2d_coord_t target_size, bool bottom)
+{
+    source.layer = &layer;
+    source.image.count = 0;
+    source.crop = layer.getImageRect();
+    source.window = layer.getTargetRect();
+    if (area_is_zero(source.window))
+        source.window.size = target_size;
+
+    source.planeAlpha = layer.getPlaneAlpha() / 255.0f;
+
+    uint32_t mode = layer.getCompositingMode();
+    if ((mode == HWC_BLENDING_PREMULT) || (mode == HWC2_BLEND_MODE_PREMULTIPLIED))
+        source.blend = HWC2_BLEND_MODE_PREMULTIPLIED;
+    else if ((mode == HWC_BLENDING_COVERAGE) || (mode == HWC2_BLEND_MODE_COVERAGE))
+        source.blend = HWC2_BLEND_MODE_COVERAGE;
+    else
+        source.blend = HWC2_BLEND_MODE_NONE;
+
+    /* bottom layer always is opaque as G2D does */
+    if (bottom)
+        source.blend = HWC2_BLEND_MODE_NONE;
+
+    if (layer.isSolidColor()) {
+        uint32_t color = layer.getSolidColor();
+        source.solid[0] = ((color >> 16) & 0xFF) * 257.0f;
+        source.solid[1] = ((color >> 8) & 0xFF) * 257.0f;
+        source.solid[2] = (color & 0xFF) * 257.0f;
+        source.solid[3] = ((color >> 24) & 0xFF) * 257.0f;
+        return true;
+    }
+
+    if (!mapImage(layer, source.image, false))
+        return false;
+
+    if (cpufmt_is_ycbcr(source.image.fmt) &&
+            !source.csc.configure(YCbCr2sRGBCoefficients, layer.getDataspace(),
+                                  (source.image.fmt->layout == CPU_FMT_P010) ? 10 : 8)) {
+        unmapImage(source.image, false);
+        return false;
+    }
+
+    source.pixels.resize(static_cast<size_t>(source.crop.size.hori) * source.crop.size.vert * 4);
+
+    /*
+     * Find the affine mapping from the center of a target pixel (x, y) to
+     * the coordinate in the crop area. The flips are applied to the source
+     * image before the clockwise rotation by 90 degree as HAL defines.
+     * u and v are the normalized coordinates in the crop area:
+     *   u = cu + ux * (x - left + 0.5) / width + uy * (y - top + 0.5) / height
+     */
+    uint32_t transform = layer.getTransform();
+    float cu, ux, uy, cv, vx, vy;
+    if (!!(transform & HAL_TRANSFORM_ROT_90)) {
+        cu = 0.0f; ux = 0.0f; uy = 1.0f;
+        cv = 1.0f; vx = -1.0f; vy = 0.0f;
+    } else {
+        cu = 0.0f; ux = 1.0f; uy = 0.0f;
+        cv = 0.0f; vx = 0.0f; vy = 1.0f;
+    }
+
+    if (!!(transform & HAL_TRANSFORM_FLIP_H)) {
+        cu = 1.0f - cu; ux = -ux; uy = -uy;
+    }
+
+    if (!!(transform & HAL_TRANSFORM_FLIP_V)) {
+        cv = 1.0f - cv; vx = -vx; vy = -vy;
+    }
+
+    float sw = source.crop.size.hori, sh = source.crop.size.vert;
+    float ww = source.window.size.hori, wh = source.window.size.vert;
+    float x0 = 0.5f - source.window.pos.hori, y0 = 0.5f - source.window.pos.vert;
+
+    source.coef[1] = sw * ux / ww;
+    source.coef[2] = sw * uy / wh;
+    source.coef[0] = sw * cu + source.coef[1] * x0 + source.coef[2] * y0 - 0.5f;
+    source.coef[4] = sh * vx / ww;
+    source.coef[5] = sh * vy / wh;
+    source.coef[3] = sh * cv + source.coef[4] * x0 + source.coef[5] * y0 - 0.5f;
+
+    return true;
+}
+
+void AcrylicCompositorCPU::decodeSource(SourceImage &source, int top, int bottom)
+{
+    const MappedImage &image = source.image;
+    int left = source.crop.pos.hori;
+    int width = source.crop.size.hori;
+
+    for (int y = top; y < bottom; y++) {
+        int sy = source.crop.pos.vert + y;
+        const uint8_t *row = image.plane[0] + static_cast<size_t>(image.stride[0]) * sy;
+        uint16_t *out = &source.pixels[static_cast<size_t>(y) * width * 4];
+
+        switch (image.fmt->layout) {
+        case CPU_FMT_RGBA8888:
+        case CPU_FMT_RGBX8888:
+            row += left * 4;
+            for (int x = 0; x < width; x++, row += 4, out += 4) {
+                out[0] = row[0] * 257;
+                out[1] = row[1] * 257;
+                out[2] = row[2] * 257;
+                out[3] = (image.fmt->layout == CPU_FMT_RGBX8888) ? 0xFFFF : row[3] * 257;
+            }
+            break;
+        case CPU_FMT_BGRA8888:
+            row += left * 4;
+            for (int x = 0; x < width; x++, row += 4, out += 4) {
+                out[0] = row[2] * 257;
+                out[1] = row[1] * 257;
+                out[2] = row[0] * 257;
+                out[3] = row[3] * 257;
+            }
+            break;
+        case CPU_FMT_RGB888:
+            row += left * 3;
+            for (int x = 0; x < width; x++, row += 3, out += 4) {
+                out[0] = row[0] * 257;
+                out[1] = row[1] * 257;
+                out[2] = row[2] * 257;
+                out[3] = 0xFFFF;
+            }
+            break;
+        case CPU_FMT_RGB565:
+            row += left * 2;
+            for (int x = 0; x < width; x++, row += 2, out += 4) {
+                uint16_t v = row[0] | (row[1] << 8);
+                out[0] = ((v >> 11) * 0xFFFF + 15) / 31;
+                out[1] = (((v >> 5) & 0x3F) * 0xFFFF + 31) / 63;
+                out[2] = ((v & 0x1F) * 0xFFFF + 15) / 31;
+                out[3] = 0xFFFF;
+            }
+            break;
+        case CPU_FMT_RGBA1010102:
+            row += left * 4;
+            for (int x = 0; x < width; x++, row += 4, out += 4) {
+                uint32_t v = row[0] | (row[1] << 8) | (row[2] << 16) | (row[3] << 24);
+                out[0] = expand_to_16bit(v & 0x3FF, 10);
+                out[1] = expand_to_16bit((v >> 10) & 0x3FF, 10);
+                out[2] = expand_to_16bit((v >> 20) & 0x3FF, 10);
+                out[3] = (v >> 30) * 0x5555;
+            }
+            break;
+        case CPU_FMT_NV12:
+        case CPU_FMT_NV21:
+        case CPU_FMT_P010: {
+            const CSCParam &csc = source.csc;
+            bool p010 = image.fmt->layout == CPU_FMT_P010;
+            int depth = p010 ? 10 : 8;
+            int cb = (image.fmt->layout == CPU_FMT_NV21) ? 1 : 0;
+            const uint8_t *crow = image.plane[1] + static_cast<size_t>(image.stride[1]) * (sy / 2);
+
+            // chroma is sampled from the nearest co-sited sample
+            for (int x = 0; x < width; x++, out += 4) {
+                int sx = left + x;
+                int Y, Cb, Cr;
+                if (p010) {
+                    const uint16_t *yp = reinterpret_cast<const uint16_t *>(row);
+                    const uint16_t *cp = reinterpret_cast<const uint16_t *>(crow);
+                    Y = yp[sx] >> 6;
+                    Cb = cp[(sx & ~1) + cb] >> 6;
+                    Cr = cp[(sx & ~1) + 1 - cb] >> 6;
+                } else {
+                    Y = row[sx];
+                    Cb = crow[(sx & ~1) + cb];
+                    Cr = crow[(sx & ~1) + 1 - cb];
+                }
+
+                Y -= csc.offsetY;
+                Cb -= csc.offsetC;
+                Cr -= csc.offsetC;
+
+                out[0] = expand_to_16bit(clamp_int(csc.product(0, Y, Cb, Cr), csc.max), depth);
+                out[1] = expand_to_16bit(clamp_int(csc.product(1, Y, Cb, Cr), csc.max), depth);
+                out[2] = expand_to_16bit(clamp_int(csc.product(2, Y, Cb, Cr), csc.max), depth);
+                out[3] = 0xFFFF;
+            }
+            break;
+        }
+        }
+    }
+}
+
+/*
+ * Blend a source pixel @s in the scale of 16-bit onto the target pixel @d in
+ * the scale of 1.0 according to the blending mode:
+ * - PREMULTIPLIED: D = S * Pa + D * (1 - Sa * Pa)
+ * - COVERAGE:      D = S * Sa * Pa + D * (1 - Sa * Pa)
+ * - NONE:          D = S * Pa + D * (1 - Pa), Sa = 1
+ */
+template <uint32_t BLEND>
+static inline void blendPixel(float *d, vec4 s, float pa)
+{
+    float scale = pa / 65535.0f;
+    float sa;
+
+    if (BLEND == HWC2_BLEND_MODE_NONE) {
+        sa = pa;
+        s = vec4_mla(vec4_set(0.0f, 0.0f, 0.0f, pa), s, vec4_set(scale, scale, scale, 0.0f));
+    } else if (BLEND == HWC2_BLEND_MODE_COVERAGE) {
+        sa = vec4_alpha(s) * scale;
+        float cs = sa / 65535.0f;
+        s = vec4_mul(s, vec4_set(cs, cs, cs, scale));
+    } else {
+        sa = vec4_alpha(s) * scale;
+        s = vec4_mul(s, vec4_splat(scale));
+    }
+
+    vec4_store(d, vec4_mla(s, vec4_load(d), vec4_splat(1.0f - sa)));
+}
+
+template <uint32_t BLEND>
+void AcrylicCompositorCPU::compositeSource(const SourceImage &source, float *tile, int tile_top,
+                                           int tile_width, int top, int bottom, int left, int right)
+{
+    float pa = source.planeAlpha;
+
+    if (source.layer->isSolidColor()) {
+        vec4 s = vec4_set(source.solid[0], source.solid[1], source.solid[2], source.solid[3]);
+        for (int y = top; y < bottom; y++) {
+            float *d = tile + (static_cast<size_t>(y - tile_top) * tile_width + left) * 4;
+            for (int x = left; x < right; x++, d += 4)
+                blendPixel<BLEND>(d, s, pa);
+        }
+        return;
+    }
+
+    const uint16_t *pixels = source.pixels.data();
+    int sw = source.crop.size.hori, sh = source.crop.size.vert;
+
+    for (int y = top; y < bottom; y++) {
+        float *d = tile + (static_cast<size_t>(y - tile_top) * tile_width + left) * 4;
+        float sx = source.coef[0] + source.coef[1] * left + source.coef[2] * y;
+        float sy = source.coef[3] + source.coef[4] * left + source.coef[5] * y;
+
+        for (int x = left; x < right; x++, d += 4, sx += source.coef[1], sy += source.coef[4]) {
+            // bilinear interpolation with the edge pixels repeated
+            float fx0 = floorf(sx), fy0 = floorf(sy);
+            float fx = sx - fx0, fy = sy - fy0;
+            int x0 = static_cast<int>(fx0), y0 = static_cast<int>(fy0);
+            int x1 = clamp_int(x0 + 1, sw - 1), y1 = clamp_int(y0 + 1, sh - 1);
+            x0 = clamp_int(x0, sw - 1);
+            y0 = clamp_int(y0, sh - 1);
+
+            const uint16_t *r0 = pixels + static_cast<size_t>(y0) * sw * 4;
+            const uint16_t *r1 = pixels + static_cast<size_t>(y1) * sw * 4;
+            vec4 p00 = vec4_load_u16(r0 + x0 * 4);
+            vec4 p01 = vec4_load_u16(r0 + x1 * 4);
+            vec4 p10 = vec4_load_u16(r1 + x0 * 4);
+            vec4 p11 = vec4_load_u16(r1 + x1 * 4);
+
+            vec4 vfx = vec4_splat(fx);
+            vec4 t = vec4_mla(p00, vec4_sub(p01, p00), vfx);
+            vec4 b = vec4_mla(p10, vec4_sub(p11, p10), vfx);
+            vec4 s = vec4_mla(t, vec4_sub(b, t), vec4_splat(fy));
+
+            blendPixel<BLEND>(d, s, pa);
+        }
+    }
+}
+
+void AcrylicCompositorCPU::compositeTile(int top, int bottom, float *tile)
+{
+    hw2d_coord_t xy = getCanvas().getImageDimension();
+    int width = xy.hori;
+    size_t count = static_cast<size_t>(bottom - top) * width;
+
+    float bg[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    if (hasBackgroundColor()) {
+        uint16_t r, g, b, a;
+        getBackgroundColor(&r, &g, &b, &a);
+        // G2D takes the upper 8 bits of the default color
+        bg[0] = (r >> 8) / 255.0f;
+        bg[1] = (g >> 8) / 255.0f;
+        bg[2] = (b >> 8) / 255.0f;
+        bg[3] = (a >> 8) / 255.0f;
+    }
+
+    vec4 vbg = vec4_set(bg[0], bg[1], bg[2], bg[3]);
+    for (size_t i = 0; i < count; i++)
+        vec4_store(tile + i * 4, vbg);
+
+    for (auto &source : mSources) {
+        int l = std::max(0, static_cast<int>(source.window.pos.hori));
+        int r = std::min(width, source.window.pos.hori + source.window.size.hori);
+        int t = std::max(top, static_cast<int>(source.window.pos.vert));
+        int b = std::min(bottom, source.window.pos.vert + source.window.size.vert);
+
+        if ((l >= r) || (t >= b))
+            continue;
+
+        switch (source.blend) {
+        case HWC2_BLEND_MODE_PREMULTIPLIED:
+            compositeSource<HWC2_BLEND_MODE_PREMULTIPLIED>(source, tile, top, width, t, b, l, r);
+            break;
+        case HWC2_BLEND_MODE_COVERAGE:
+            compositeSource<HWC2_BLEND_MODE_COVERAGE>(source, tile, top, width, t, b, l, r);
+            break;
+        default:
+            compositeSource<HWC2_BLEND_MODE_NONE>(source, tile, top, width, t, b, l, r);
+            break;
+        }
+    }
+}
+
+void AcrylicCompositorCPU::encodeTile(int top, int bottom, const float *tile)
+{
+    hw2d_coord_t xy = getCanvas().getImageDimension();
+    int width = xy.hori;
+
+    for (int y = top; y < bottom; y++) {
+        const float *s = tile + static_cast<size_t>(y - top) * width * 4;
+        uint8_t *row = mTarget.plane[0] + static_cast<size_t>(mTarget.stride[0]) * y;
+
+        switch (mTarget.fmt->layout) {
+        case CPU_FMT_RGBA8888:
+        case CPU_FMT_RGBX8888:
+        case CPU_FMT_BGRA8888:
+        case CPU_FMT_RGB888: {
+            bool bgr = mTarget.fmt->layout == CPU_FMT_BGRA8888;
+            unsigned int bpp = mTarget.fmt->bpp;
+            for (int x = 0; x < width; x++, s += 4, row += bpp) {
+                row[bgr ? 2 : 0] = static_cast<uint8_t>(clamp_unit(s[0]) * 255.0f + 0.5f);
+                row[1] = static_cast<uint8_t>(clamp_unit(s[1]) * 255.0f + 0.5f);
+                row[bgr ? 0 : 2] = static_cast<uint8_t>(clamp_unit(s[2]) * 255.0f + 0.5f);
+                if (bpp == 4)
+                    row[3] = (mTarget.fmt->layout == CPU_FMT_RGBX8888) ?
+                             0xFF : static_cast<uint8_t>(clamp_unit(s[3]) * 255.0f + 0.5f);
+            }
+            break;
+        }
+        case CPU_FMT_RGB565:
+            for (int x = 0; x < width; x++, s += 4, row += 2) {
+                uint16_t v = (static_cast<uint16_t>(clamp_unit(s[0]) * 31.0f + 0.5f) << 11) |
+                             (static_cast<uint16_t>(clamp_unit(s[1]) * 63.0f + 0.5f) << 5) |
+                             static_cast<uint16_t>(clamp_unit(s[2]) * 31.0f + 0.5f);
+                row[0] = v & 0xFF;
+                row[1] = v >> 8;
+            }
+            break;
+        case CPU_FMT_RGBA1010102:
+            for (int x = 0; x < width; x++, s += 4, row += 4) {
+                uint32_t v = static_cast<uint32_t>(clamp_unit(s[0]) * 1023.0f + 0.5f) |
+                             (static_cast<uint32_t>(clamp_unit(s[1]) * 1023.0f + 0.5f) << 10) |
+                             (static_cast<uint32_t>(clamp_unit(s[2]) * 1023.0f + 0.5f) << 20) |
+                             (static_cast<uint32_t>(clamp_unit(s[3]) * 3.0f + 0.5f) << 30);
+                row[0] = v & 0xFF;
+                row[1] = (v >> 8) & 0xFF;
+                row[2] = (v >> 16) & 0xFF;
+                row[3] = v >> 24;
+            }
+            break;
+        case CPU_FMT_NV12:
+        case CPU_FMT_NV21:
+        case CPU_FMT_P010: {
+            const CSCParam &csc = mTargetCSC;
+            bool p010 = mTarget.fmt->layout == CPU_FMT_P010;
+            int cb = (mTarget.fmt->layout == CPU_FMT_NV21) ? 1 : 0;
+            bool chroma_row = (y % 2) == 0;
+            const float *s1 = ((y + 1) < bottom) ? s + width * 4 : s;
+            uint8_t *crow = mTarget.plane[1] + static_cast<size_t>(mTarget.stride[1]) * (y / 2);
+
+            for (int x = 0; x < width; x++) {
+                int R = static_cast<int>(clamp_unit(s[x * 4 + 0]) * csc.max + 0.5f);
+                int G = static_cast<int>(clamp_unit(s[x * 4 + 1]) * csc.max + 0.5f);
+                int B = static_cast<int>(clamp_unit(s[x * 4 + 2]) * csc.max + 0.5f);
+                int Y = clamp_int(csc.product(0, R, G, B) + csc.offsetY, csc.max);
+
+                if (p010)
+                    reinterpret_cast<uint16_t *>(row)[x] = static_cast<uint16_t>(Y << 6);
+                else
+                    row[x] = static_cast<uint8_t>(Y);
+
+                if (!chroma_row || (x % 2) != 0)
+                    continue;
+
+                // chroma is the average of 2x2 pixels
+                int x1 = std::min(x + 1, width - 1);
+                float r = 0.0f, g = 0.0f, b = 0.0f;
+                for (const float *p : {&s[x * 4], &s[x1 * 4], &s1[x * 4], &s1[x1 * 4]}) {
+                    r += clamp_unit(p[0]);
+                    g += clamp_unit(p[1]);
+                    b += clamp_unit(p[2]);
+                }
+                R = static_cast<int>(r * csc.max / 4.0f + 0.5f);
+                G = static_cast<int>(g * csc.max / 4.0f + 0.5f);
+                B = static_cast<int>(b * csc.max / 4.0f + 0.5f);
+                int Cb = clamp_int(csc.product(1, R, G, B) + csc.offsetC, csc.max);
+                int Cr = clamp_int(csc.product(2, R, G, B) + csc.offsetC, csc.max);
+
+                if (p010) {
+                    uint16_t *cp = reinterpret_cast<uint16_t *>(crow);
+                    cp[x + cb] = static_cast<uint16_t>(Cb << 6);
+                    cp[x + 1 - cb] = static_cast<uint16_t>(Cr << 6);
+                } else {
+                    crow[x + cb] = static_cast<uint8_t>(Cb);
+                    crow[x + 1 - cb] = static_cast<uint8_t>(Cr);
+                }
+            }
+            break;
+        }
+        }
+    }
+}
+
+void AcrylicCompositorCPU::runJobs(unsigned int thread)
+{
+    unsigned int index;
+    while ((index = mJobNext.fetch_add(1, std::memory_order_relaxed)) < mJobCount)
+        (*mJob)(index, thread);
+}
+
+void AcrylicCompositorCPU::workerLoop(unsigned int thread)
+{
+    unsigned int generation = 0;
+    std::unique_lock<std::mutex> lock(mPoolMutex);
+
+    while (true) {
+        mJobCondition.wait(lock, [&] { return mExitWorkers || (mJobGeneration != generation); });
+        if (mExitWorkers)
+            return;
+
+        generation = mJobGeneration;
+        // The job has fewer items than the threads
+        if (thread >= mJobThreads)
+            continue;
+
+        lock.unlock();
+        runJobs(thread);
+        lock.lock();
+
+        if (--mBusyWorkers == 0)
+            mDoneCondition.notify_one();
+    }
+}
+
+void AcrylicCompositorCPU::parallelFor(unsigned int count,
+                                       const std::function<void(unsigned int, unsigned int)> &func)
+{
+    unsigned int num_threads = std::min(mThreadCount, count);
+    if (num_threads <= 1) {
+        for (unsigned int i = 0; i < count; i++)
+            func(i, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mPoolMutex);
+        mJob = &func;
+        mJobCount = count;
+        mJobThreads = num_threads;
+        mJobNext.store(0, std::memory_order_relaxed);
+        mBusyWorkers = num_threads - 1;
+        mJobGeneration++;
+    }
+    mJobCondition.notify_all();
+
+    runJobs(0);
+
+    std::unique_lock<std::mutex> lock(mPoolMutex);
+    mDoneCondition.wait(lock, [&] { return mBusyWorkers == 0; });
+    mJob = NULL;
+}
+
+bool AcrylicCompositorCPU::executeCPU()
+{
+    if (!validateAllLayers())
+        return false;
+
+    sortLayers();
+
+    auto start = std::chrono::steady_clock::now();
+
+    AcrylicCanvas &canvas = getCanvas();
+    hw2d_coord_t xy = canvas.getImageDimension();
+
+    if (!waitFence(canvas.getFence()))
+        return false;
+
+    for (unsigned int i = 0; i < layerCount(); i++) {
+        if (!waitFence(getLayer(i)->getFence()))
+            return false;
+    }
+
+    if (!mapImage(canvas, mTarget, true)) {
+        ALOGE("Failed to configure the target image");
+        return false;
+    }
+
+    if (cpufmt_is_ycbcr(mTarget.fmt) &&
+            !mTargetCSC.configure(sRGB2YCbCrCoefficients, canvas.getDataspace(),
+                                  (mTarget.fmt->layout == CPU_FMT_P010) ? 10 : 8)) {
+        unmapImage(mTarget, true);
+        return false;
+    }
+
+    mSources.resize(layerCount());
+    for (unsigned int i = 0; i < layerCount(); i++) {
+        if (!prepareSource(*getLayer(i), mSources[i], xy, (i == 0) && !hasBackgroundColor())) {
+            ALOGE("Failed to configure source layer %u", i);
+            for (unsigned int j = 0; j < i; j++)
+                unmapImage(mSources[j].image, false);
+            mSources.clear();
+            unmapImage(mTarget, true);
+            return false;
+        }
+    }
+
+    std::vector<std::tuple<unsigned int, int, int>> jobs;
+    for (unsigned int i = 0; i < mSources.size(); i++) {
+        if (mSources[i].layer->isSolidColor())
+            continue;
+
+        int rows = mSources[i].crop.size.vert;
+        for (int top = 0; top < rows; top += CPU_DECODE_ROWS)
+            jobs.emplace_back(i, top, std::min(rows, top + CPU_DECODE_ROWS));
+    }
+
+    parallelFor(static_cast<unsigned int>(jobs.size()), [&] (unsigned int index, unsigned int) {
+        decodeSource(mSources[std::get<0>(jobs[index])], std::get<1>(jobs[index]), std::get<2>(jobs[index]));
+    });
+
+    for (auto &source : mSources)
+        unmapImage(source.image, false);
+
+    size_t tile_size = static_cast<size_t>(xy.hori) * LIBACRYL_CPU_TILE_HEIGHT * 4;
+    for (auto &tile : mTiles)
+        tile.resize(tile_size);
+
+    unsigned int num_tiles = (xy.vert + LIBACRYL_CPU_TILE_HEIGHT - 1) / LIBACRYL_CPU_TILE_HEIGHT;
+    parallelFor(num_tiles, [&] (unsigned int index, unsigned int thread) {
+        int top = index * LIBACRYL_CPU_TILE_HEIGHT;
+        int bottom = std::min(static_cast<int>(xy.vert), top + LIBACRYL_CPU_TILE_HEIGHT);
+
+        compositeTile(top, bottom, mTiles[thread].data());
+        encodeTile(top, bottom, mTiles[thread].data());
+    });
+
+    unmapImage(mTarget, true);
+
+    // Release the intermediate images not to keep the memory of the largest layer
+    mSources.clear();
+
+    mLaptimeUSec = static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start).count());
+
+    return true;
+}
+
+bool AcrylicCompositorCPU::execute(int fence[], unsigned int num_fences)
+{
+    bool success = executeCPU();
+
+    // The target image is ready on return. No release fence is required.
+    for (unsigned int i = 0; i < num_fences; i++)
+        fence[i] = -1;
+
+    // Clearing all acquire fences because their buffers are expired on failure.
+    getCanvas().setFence(-1);
+    for (unsigned int i = 0; i < layerCount(); i++)
+        getLayer(i)->setFence(-1);
+
+    if (success) {
+        getCanvas().clearSettingModified();
+        for (unsigned int i = 0; i < layerCount(); i++)
+            getLayer(i)->clearSettingModified();
+    }
+
+    return success;
+}
+
+bool AcrylicCompositorCPU::execute(int *handle)
+{
+    if (!execute(NULL, 0))
+        return false;
+
+    if (handle != NULL)
+        *handle = 0; /* the execution is already completed */
+
+    return true;
+}
+
+bool AcrylicCompositorCPU::waitExecution(int __unused handle)
+{
+    ALOGD_TEST("Waiting for execution of CPU compositor completed by handle %d", handle);
+
+    return true;
+}
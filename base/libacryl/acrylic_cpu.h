@@ -0,0 +1,149 @@
+/*
+ * Copyright Samsung Electronics Co.,LTD.
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HARDWARE_EXYNOS_HW2DCOMPOSITOR_CPU_H__
+#define __HARDWARE_EXYNOS_HW2DCOMPOSITOR_CPU_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <hardware/exynos/acryl.h>
+
+#include "acrylic_csc.h"
+
+/*
+ * The maximum number of threads that process the tiles of the target image.
+ * The calling thread is also counted.
+ */
+#ifndef LIBACRYL_CPU_MAX_THREADS
+#define LIBACRYL_CPU_MAX_THREADS 4
+#endif
+
+/*
+ * The number of rows of the target image composited by a worker at once.
+ * It should be even for the target images with vertically subsampled chroma.
+ */
+#ifndef LIBACRYL_CPU_TILE_HEIGHT
+#define LIBACRYL_CPU_TILE_HEIGHT 32
+#endif
+
+/*
+ * AcrylicCompositorCPU - software implementation of Acrylic
+ *
+ * It composites the source images described by AcrylicLayer onto the target
+ * image described by AcrylicCanvas with CPU. It is slow compared to HW 2D but
+ * it produces deterministic results. It can be used as the reference of the
+ * results of HW 2D and as the compositor on the systems without HW 2D.
+ *
+ * The source images are converted into 16-bit RGBA intermediate images first.
+ * Then the target image is divided into horizontal tiles and each tile is
+ * composited by one of the worker threads. The worker threads are created
+ * with the instance and they sleep between the executions.
+ */
+class AcrylicCompositorCPU: public Acrylic {
+public:
+    AcrylicCompositorCPU(const HW2DCapability &capability);
+    virtual ~AcrylicCompositorCPU();
+    virtual bool execute(int fence[], unsigned int num_fences);
+    virtual bool execute(int *handle = NULL);
+    virtual bool waitExecution(int handle);
+    virtual unsigned int getLaptimeUSec() { return mLaptimeUSec; }
+
+private:
+    /*
+     * Color space conversion with the fixed point matrices in acrylic_csc.h
+     * on the components of the given bit depth.
+     */
+    struct CSCParam {
+        int coef[CSC_MATRIX_COEF_COUNT];
+        int offsetY;
+        int offsetC;
+        int max;
+
+        bool configure(const uint16_t table[][CSC_MATRIX_COEF_COUNT], int dataspace, int depth);
+        int product(int row, int c0, int c1, int c2) const {
+            int v = coef[row * 3] * c0 + coef[row * 3 + 1] * c1 + coef[row * 3 + 2] * c2;
+            return (v + (1 << (CSC_MATRIX_COEF_FRACBITS - 1))) >> CSC_MATRIX_COEF_FRACBITS;
+        }
+    };
+
+    struct MappedImage {
+        const struct cpu_fmt *fmt;
+        uint8_t *plane[MAX_HW2D_PLANES];
+        uint32_t stride[MAX_HW2D_PLANES];
+        void *mapped[MAX_HW2D_PLANES];
+        size_t mappedLength[MAX_HW2D_PLANES];
+        int dmabuf[MAX_HW2D_PLANES];
+        unsigned int count;
+    };
+
+    struct SourceImage {
+        AcrylicLayer *layer;
+        MappedImage image;
+        CSCParam csc;
+        std::vector<uint16_t> pixels; // RGBA of the crop area, 16-bit per component
+        hw2d_rect_t crop;
+        hw2d_rect_t window;
+        float coef[6];                // sx = c0 + c1 * x + c2 * y, sy = c3 + c4 * x + c5 * y
+        float solid[4];
+        uint32_t blend;
+        float planeAlpha;
+    };
+
+    bool executeCPU();
+    bool mapImage(AcrylicCanvas &canvas, MappedImage &image, bool write);
+    void unmapImage(MappedImage &image, bool write);
+    bool prepareSource(AcrylicLayer &layer, SourceImage &source, hw2d_coord_t target_size, bool bottom);
+    void decodeSource(SourceImage &source, int top, int bottom);
+    template <uint32_t BLEND>
+    static void compositeSource(const SourceImage &source, float *tile, int tile_top, int tile_width,
+                                int top, int bottom, int left, int right);
+    void compositeTile(int top, int bottom, float *tile);
+    void encodeTile(int top, int bottom, const float *tile);
+    void parallelFor(unsigned int count, const std::function<void(unsigned int, unsigned int)> &func);
+    void runJobs(unsigned int thread);
+    void workerLoop(unsigned int thread);
+
+    /*
+     * Worker threads 1 to mThreadCount - 1. The caller of parallelFor() is thread 0.
+     * A job is published by increasing mJobGeneration under mPoolMutex.
+     */
+    std::vector<std::thread> mWorkers;
+    std::mutex mPoolMutex;
+    std::condition_variable mJobCondition;
+    std::condition_variable mDoneCondition;
+    const std::function<void(unsigned int, unsigned int)> *mJob;
+    unsigned int mJobCount;
+    unsigned int mJobThreads;
+    std::atomic<unsigned int> mJobNext;
+    unsigned int mJobGeneration;
+    unsigned int mBusyWorkers;
+    bool mExitWorkers;
+
+    std::vector<SourceImage> mSources;
+    MappedImage mTarget;
+    CSCParam mTargetCSC;
+    std::vector<std::vector<float>> mTiles; // RGBA premultiplied, one per thread
+    unsigned int mThreadCount;
+    unsigned int mLaptimeUSec;
+};
+
+#endif /* __HARDWARE_EXYNOS_HW2DCOMPOSITOR_CPU_H__ */
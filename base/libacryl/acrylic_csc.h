@@ -0,0 +1,57 @@
+/*
+ * Copyright Samsung Electronics Co.,LTD.
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HARDWARE_EXYNOS_ACRYLIC_CSC_H__
+#define __HARDWARE_EXYNOS_ACRYLIC_CSC_H__
+
+#include <cstdint>
+
+/*
+ * Color space conversion matrices shared by the compositors that need to
+ * convert YCbCr to RGB and vice versa. Each matrix has 9 coefficients in
+ * row-major order, signed 16-bit fixed point with 9 fractional bits.
+ */
+enum {
+    G2D_CSC_STD_UNDEFINED = -1,
+    G2D_CSC_STD_601       = 0,
+    G2D_CSC_STD_709       = 1,
+    G2D_CSC_STD_2020      = 2,
+    G2D_CSC_STD_P3        = 3,
+
+    G2D_CSC_STD_COUNT     = 4,
+};
+
+enum {
+    G2D_CSC_RANGE_LIMITED,
+    G2D_CSC_RANGE_FULL,
+
+    G2D_CSC_RANGE_COUNT,
+};
+
+#define CSC_MATRIX_COEF_COUNT      9
+#define CSC_MATRIX_COEF_FRACBITS   9
+
+extern const uint16_t YCbCr2sRGBCoefficients[G2D_CSC_STD_COUNT * G2D_CSC_RANGE_COUNT][CSC_MATRIX_COEF_COUNT];
+extern const uint16_t sRGB2YCbCrCoefficients[G2D_CSC_STD_COUNT * G2D_CSC_RANGE_COUNT][CSC_MATRIX_COEF_COUNT];
+
+/*
+ * Find the index of the matrix in the above tables for @dataspace.
+ * Returns a negative value if no matrix is defined for the standard of @dataspace.
+ */
+int csc_find_matrix_index(int dataspace);
+
+#endif /* __HARDWARE_EXYNOS_ACRYLIC_CSC_H__ */
@@ -27,6 +27,7 @@
 #include "acrylic_mscl9810.h"
 #include "acrylic_mscl3830.h"
 #include "acrylic_dummy.h"
+#include "acrylic_cpu.h"
 
 static uint32_t all_fimg2d_formats[] = {
     HAL_PIXEL_FORMAT_RGBA_8888,
@@ -297,6 +298,23 @@ static uint32_t blter_formats[] = {
     HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_PRIV,    // NV12M with MFC alignment constraints on multi-buffer
 };
 
+static uint32_t all_cpu_formats[] = {
+    HAL_PIXEL_FORMAT_RGBA_8888,
+    HAL_PIXEL_FORMAT_BGRA_8888,
+    HAL_PIXEL_FORMAT_RGBA_1010102,
+    HAL_PIXEL_FORMAT_RGBX_8888,
+    HAL_PIXEL_FORMAT_RGB_888,
+    HAL_PIXEL_FORMAT_RGB_565,
+    HAL_PIXEL_FORMAT_YCrCb_420_SP,                  // NV21 (YVU420 semi-planar)
+    HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M,         // NV21 on multi-buffer
+    HAL_PIXEL_FORMAT_EXYNOS_YCrCb_420_SP_M_FULL,    // NV21 on multi-buffer
+    HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP,           // NV12 (YUV420 semi-planar)
+    HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M,         // NV12 on multi-buffer
+    HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_PRIV,    // NV12 on multi-buffer
+    HAL_PIXEL_FORMAT_YCBCR_P010,                    // P010 (YUV420 semi-planar 10-bit)
+    HAL_PIXEL_FORMAT_EXYNOS_YCbCr_P010_M,           // P010 on multi-buffer
+};
+
 static uint32_t rgb_formats[] = {
     HAL_PIXEL_FORMAT_RGBA_8888,
     HAL_PIXEL_FORMAT_BGRA_8888,
@@ -656,6 +674,28 @@ const static stHW2DCapability __capability_mscl_sbwc_v2_7 = {
     .base_align = 4,
 };
 
+const static stHW2DCapability __capability_cpu = {
+    .max_upsampling_num = {32767, 32767},
+    .max_downsampling_factor = {4, 4},
+    .max_upsizing_num = {32767, 32767},
+    .max_downsizing_factor = {4, 4},
+    .min_src_dimension = {1, 1},
+    .max_src_dimension = {8192, 8192},
+    .min_dst_dimension = {1, 1},
+    .max_dst_dimension = {8192, 8192},
+    .min_pix_align = {1, 1},
+    .rescaling_count = 0,
+    .compositing_mode = HW2DCapability::BLEND_NONE | HW2DCapability::BLEND_SRC_COPY | HW2DCapability::BLEND_SRC_OVER,
+    .transform_type = HW2DCapability::TRANSFORM_ALL,
+    .auxiliary_feature = HW2DCapability::FEATURE_PLANE_ALPHA | HW2DCapability::FEATURE_SOLIDCOLOR,
+    .num_formats = ARRSIZE(all_cpu_formats),
+    .num_dataspaces = ARRSIZE(all_hwc_dataspaces),
+    .max_layers = 16,
+    .pixformats = all_cpu_formats,
+    .dataspaces = all_hwc_dataspaces,
+    .base_align = 1,
+};
+
 static const HW2DCapability capability_fimg2d_8895(__capability_fimg2d_8895);
 static const HW2DCapability capability_fimg2d_8890(__capability_fimg2d_8890);
 static const HW2DCapability capability_fimg2d_9610(__capability_fimg2d_9610);
@@ -669,6 +709,7 @@ static const HW2DCapability capability_mscl_sbwcl(__capability_mscl_sbwcl);
 static const HW2DCapability capability_mscl_3830(__capability_mscl_3830);
 static const HW2DCapability capability_mscl_votf(__capability_mscl_votf);
 static const HW2DCapability capability_mscl_sbwc_v2_7(__capability_mscl_sbwc_v2_7);
+static const HW2DCapability capability_cpu(__capability_cpu);
 
 Acrylic *Acrylic::createInstance(const char *spec)
 {
@@ -704,6 +745,8 @@ Acrylic *Acrylic::createInstance(const char *spec)
         compositor = new AcrylicCompositorMSCL9810(capability_mscl_votf);
     } else if (strcmp(spec, "mscl_sbwc_v2_7") == 0) {
         compositor = new AcrylicCompositorMSCL9810(capability_mscl_sbwc_v2_7);
+    } else if (strcmp(spec, "cpu") == 0) {
+        compositor = new AcrylicCompositorCPU(capability_cpu);
     } else if (strcmp(spec, "dummy") == 0) {
         compositor = new AcrylicCompositorDummy(capability_fimg2d_8895);
     } else {
@@ -29,60 +29,7 @@
 #include <exynos_format.h> // hardware/smasung_slsi/exynos/include
 
 #include "acrylic_g2d9810.h"
-
-enum {
-    G2D_CSC_STD_UNDEFINED = -1,
-    G2D_CSC_STD_601       = 0,
-    G2D_CSC_STD_709       = 1,
-    G2D_CSC_STD_2020      = 2,
-    G2D_CSC_STD_P3        = 3,
-
-    G2D_CSC_STD_COUNT     = 4,
-};
-
-enum {
-    G2D_CSC_RANGE_LIMITED,
-    G2D_CSC_RANGE_FULL,
-
-    G2D_CSC_RANGE_COUNT,
-};
-
-static char csc_std_to_matrix_index[] = {
-    G2D_CSC_STD_709,                          // HAL_DATASPACE_STANDARD_UNSPECIFIED
-    G2D_CSC_STD_709,                          // HAL_DATASPACE_STANDARD_BT709
-    G2D_CSC_STD_601,                          // HAL_DATASPACE_STANDARD_BT601_625
-    G2D_CSC_STD_601,                          // HAL_DATASPACE_STANDARD_BT601_625_UNADJUSTED
-    G2D_CSC_STD_601,                          // HAL_DATASPACE_STANDARD_BT601_525
-    G2D_CSC_STD_601,                          // HAL_DATASPACE_STANDARD_BT601_525_UNADJUSTED
-    G2D_CSC_STD_2020,                         // HAL_DATASPACE_STANDARD_BT2020
-    G2D_CSC_STD_2020,                         // HAL_DATASPACE_STANDARD_BT2020_CONSTANT_LUMINANCE
-    static_cast<char>(G2D_CSC_STD_UNDEFINED), // HAL_DATASPACE_STANDARD_BT470M
-    G2D_CSC_STD_709,                          // HAL_DATASPACE_STANDARD_FILM
-    G2D_CSC_STD_P3,                           // HAL_DATASPACE_STANDARD_DCI_P3
-    static_cast<char>(G2D_CSC_STD_UNDEFINED), // HAL_DATASPACE_STANDARD_ADOBE_RGB
-};
-
-static uint16_t YCbCr2sRGBCoefficients[G2D_CSC_STD_COUNT * G2D_CSC_RANGE_COUNT][9] = {
-    {0x0254, 0x0000, 0x0331, 0x0254, 0xFF37, 0xFE60, 0x0254, 0x0409, 0x0000}, // 601 limited
-    {0x0200, 0x0000, 0x02BE, 0x0200, 0xFF54, 0xFE9B, 0x0200, 0x0377, 0x0000}, // 601 full
-    {0x0254, 0x0000, 0x0396, 0x0254, 0xFF93, 0xFEEF, 0x0254, 0x043A, 0x0000}, // 709 limited
-    {0x0200, 0x0000, 0x0314, 0x0200, 0xFFA2, 0xFF16, 0x0200, 0x03A1, 0x0000}, // 709 full
-    {0x0254, 0x0000, 0x035B, 0x0254, 0xFFA0, 0xFEB3, 0x0254, 0x0449, 0x0000}, // 2020 limited
-    {0x0200, 0x0000, 0x02E2, 0x0200, 0xFFAE, 0xFEE2, 0x0200, 0x03AE, 0x0000}, // 2020 full
-    {0x0254, 0x0000, 0x03AE, 0x0254, 0xFF96, 0xFEEE, 0x0254, 0x0456, 0x0000}, // DCI-P3 limited
-    {0x0200, 0x0000, 0x0329, 0x0200, 0xFFA5, 0xFF15, 0x0200, 0x03B9, 0x0000}, // DCI-P3 full
-};
-
-static uint16_t sRGB2YCbCrCoefficients[G2D_CSC_STD_COUNT * G2D_CSC_RANGE_COUNT][9] = {
-    {0x0083, 0x0102, 0x0032, 0xFFB4, 0xFF6B, 0x00E1, 0x00E1, 0xFF44, 0xFFDB}, // 601 limited
-    {0x0099, 0x012D, 0x003A, 0xFFA8, 0xFF53, 0x0106, 0x0106, 0xFF25, 0xFFD5}, // 601 full
-    {0x005D, 0x013A, 0x0020, 0xFFCC, 0xFF53, 0x00E1, 0x00E1, 0xFF34, 0xFFEB}, // 709 limited
-    {0x006D, 0x016E, 0x0025, 0xFFC4, 0xFF36, 0x0106, 0x0106, 0xFF12, 0xFFE8}, // 709 full
-    {0x0074, 0x012A, 0x001A, 0xFFC1, 0xFF5A, 0x00E1, 0x00E1, 0xFF31, 0xFFEE}, // 2020 limited
-    {0x0087, 0x015B, 0x001E, 0xFFB7, 0xFF43, 0x0106, 0x0106, 0xFF0F, 0xFFEB}, // 2020 full
-    {0x006B, 0x0171, 0x0023, 0xFFC6, 0xFF3A, 0x0100, 0x0100, 0xFF16, 0xFFEA}, // DCI-P3 limited(full)
-    {0x006B, 0x0171, 0x0023, 0xFFC6, 0xFF3A, 0x0100, 0x0100, 0xFF16, 0xFFEA}, // DCI-P3 full
-};
+#include "acrylic_csc.h"
 
 #define CSC_MATRIX_REGISTER_COUNT 9
 #define CSC_MATRIX_REGISTER_SIZE  (CSC_MATRIX_REGISTER_COUNT * sizeof(uint32_t))
@@ -169,7 +116,7 @@ public:
     }
 
 private:
-    void writeSingle(unsigned int base, g2d_reg regs[], uint16_t matrix[9]) {
+    void writeSingle(unsigned int base, g2d_reg regs[], const uint16_t matrix[9]) {
         for (unsigned int idx = 0; idx < CSC_MATRIX_REGISTER_COUNT; idx++) {
             regs[idx].offset = base;
             regs[idx].value = matrix[idx];
@@ -178,18 +125,12 @@ private:
     }
 
     unsigned int findMatrixIndex(unsigned int dataspace) {
-        unsigned int index, colorspace;
-
-        colorspace = (dataspace & HAL_DATASPACE_STANDARD_MASK) >> HAL_DATASPACE_STANDARD_SHIFT;
-        if (colorspace >= ARRSIZE(csc_std_to_matrix_index)) {
+        int index = csc_find_matrix_index(dataspace);
+        if (index < 0) {
             ALOGE("Data space %d is not supported by G2D", dataspace);
             return CSC_MATRIX_INVALID_INDEX;
         }
 
-        index = csc_std_to_matrix_index[colorspace] * G2D_CSC_RANGE_COUNT;
-        if ((dataspace & HAL_DATASPACE_RANGE_FULL) != 0)
-            index++;
-
         return index;
     }
 
@@ -342,10 +283,12 @@ static g2d_fmt *halfmt_to_g2dfmt(struct g2d_fmt *tbl, size_t tbl_len, uint32_t h
 
 AcrylicCompositorG2D9810::AcrylicCompositorG2D9810(const HW2DCapability &capability, bool newcolormode)
     : Acrylic(capability), mDev((capability.maxLayerCount() > 2) ? "/dev/g2d" : "/dev/fimg2d"),
-      mMaxSourceCount(0), mPriority(-1)
+      mMaxSourceCount(0), mPriority(-1), mNumExtraRegs(0)
 {
     memset(&mTask, 0, sizeof(mTask));
 
+    invalidateCommandCache();
+
     mVersion = 0;
     if (mDev.ioctl(G2D_IOC_VERSION, &mVersion) < 0)
         ALOGERR("Failed to get G2D command version");
@@ -404,42 +347,32 @@ static unsigned int sbwc_lossy_formats[] = {
     HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M_10B_SBWC_L80,
 };
 
-bool AcrylicCompositorG2D9810::prepareImage(AcrylicCanvas &layer, struct g2d_layer &image, uint32_t cmd[], int index)
+/*
+ * Configure the acquire fence and the buffers of @image. This is the only part
+ * of an image that should be updated when the command block of the image is
+ * reused from the previous execution.
+ */
+bool AcrylicCompositorG2D9810::prepareBuffer(AcrylicCanvas &layer, struct g2d_layer &image, unsigned int num_bufs)
 {
-    image.flags = 0;
+    image.flags &= ~G2D_LAYERFLAG_ACQUIRE_FENCE;
 
     if (layer.getFence() >= 0) {
         image.flags |= G2D_LAYERFLAG_ACQUIRE_FENCE;
         image.fence = layer.getFence();
     }
 
-    if (layer.isProtected())
-        image.flags |= G2D_LAYERFLAG_SECURE;
-
-    g2d_fmt *g2dfmt = halfmt_to_g2dfmt(halfmt_to_g2dfmt_tbl, len_halfmt_to_g2dfmt_tbl, layer.getFormat());
-    if (!g2dfmt)
-        return false;
-
-    image.flags &= ~G2D_LAYERFLAG_MFC_STRIDE;
-    for (size_t i = 0; i < ARRSIZE(mfc_stride_formats); i++) {
-        if (layer.getFormat() == mfc_stride_formats[i]) {
-            image.flags |= G2D_LAYERFLAG_MFC_STRIDE;
-            break;
-        }
-    }
-
     if (layer.getBufferType() == AcrylicCanvas::MT_EMPTY) {
         image.buffer_type = G2D_BUFTYPE_EMPTY;
     } else {
-        if (layer.getBufferCount() < g2dfmt->num_bufs) {
+        if (layer.getBufferCount() < num_bufs) {
             ALOGE("HAL Format %#x requires %d buffers but %d buffers are given",
-                    layer.getFormat(), g2dfmt->num_bufs, layer.getBufferCount());
+                    layer.getFormat(), num_bufs, layer.getBufferCount());
             return false;
         }
 
         if (layer.getBufferType() == AcrylicCanvas::MT_DMABUF) {
             image.buffer_type = G2D_BUFTYPE_DMABUF;
-            for (unsigned int i = 0; i < g2dfmt->num_bufs; i++) {
+            for (unsigned int i = 0; i < num_bufs; i++) {
                 image.buffer[i].dmabuf.fd = layer.getDmabuf(i);
                 image.buffer[i].dmabuf.offset = layer.getOffset(i);
                 image.buffer[i].length = layer.getBufferLength(i);
@@ -448,14 +381,38 @@ bool AcrylicCompositorG2D9810::prepareImage(AcrylicCanvas &layer, struct g2d_lay
             LOGASSERT(layer.getBufferType() == AcrylicCanvas::MT_USERPTR,
                       "Unknown buffer type %d", layer.getBufferType());
             image.buffer_type = G2D_BUFTYPE_USERPTR;
-            for (unsigned int i = 0; i < g2dfmt->num_bufs; i++) {
+            for (unsigned int i = 0; i < num_bufs; i++) {
                 image.buffer[i].userptr = layer.getUserptr(i);
                 image.buffer[i].length = layer.getBufferLength(i);
             }
         }
     }
 
-    image.num_buffers = g2dfmt->num_bufs;
+    image.num_buffers = num_bufs;
+
+    return true;
+}
+
+bool AcrylicCompositorG2D9810::prepareImage(AcrylicCanvas &layer, struct g2d_layer &image, uint32_t cmd[], int index)
+{
+    image.flags = 0;
+
+    if (layer.isProtected())
+        image.flags |= G2D_LAYERFLAG_SECURE;
+
+    g2d_fmt *g2dfmt = halfmt_to_g2dfmt(halfmt_to_g2dfmt_tbl, len_halfmt_to_g2dfmt_tbl, layer.getFormat());
+    if (!g2dfmt)
+        return false;
+
+    for (size_t i = 0; i < ARRSIZE(mfc_stride_formats); i++) {
+        if (layer.getFormat() == mfc_stride_formats[i]) {
+            image.flags |= G2D_LAYERFLAG_MFC_STRIDE;
+            break;
+        }
+    }
+
+    if (!prepareBuffer(layer, image, g2dfmt->num_bufs))
+        return false;
 
     hw2d_coord_t xy = layer.getImageDimension();
 
@@ -757,6 +714,8 @@ bool AcrylicCompositorG2D9810::reallocLayer(unsigned int layercount)
 
     mMaxSourceCount = 0;
 
+    invalidateCommandCache();
+
     mTask.source = new g2d_layer[layercount];
     if (!mTask.source) {
         ALOGE("Failed to allocate %u source image descriptors", layercount);
@@ -1010,6 +969,57 @@ unsigned int AcrylicCompositorG2D9810::setHdrLibCommand(g2d_reg regs[])
     return count;
 }
 
+static uint32_t getImageAttr(AcrylicCanvas &canvas)
+{
+    uint32_t attr = 0;
+
+    if (canvas.isProtected())
+        attr |= AcrylicCanvas::ATTR_PROTECTED;
+    if (canvas.isCompressed())
+        attr |= AcrylicCanvas::ATTR_COMPRESSED;
+    if (canvas.isUOrder())
+        attr |= AcrylicCanvas::ATTR_UORDER;
+    if (canvas.isOTF())
+        attr |= AcrylicCanvas::ATTR_OTF;
+    if (canvas.isSolidColor())
+        attr |= AcrylicCanvas::ATTR_SOLIDCOLOR;
+
+    return attr;
+}
+
+static void fillImageKey(G2DImageKey &key, AcrylicCanvas &canvas)
+{
+    // memset() is required because G2DImageKey is compared by memcmp()
+    memset(&key, 0, sizeof(key));
+
+    key.dimension = canvas.getImageDimension();
+    key.format = canvas.getFormat();
+    key.attr = getImageAttr(canvas);
+    key.index = -1;
+}
+
+static void fillImageKey(G2DImageKey &key, AcrylicLayer &layer, hw2d_coord_t target_size, int index)
+{
+    fillImageKey(key, layer);
+
+    key.target_size = target_size;
+    key.crop = layer.getImageRect();
+    key.window = layer.getTargetRect();
+    key.color = layer.isSolidColor() ? layer.getSolidColor() : 0;
+    key.blend = layer.getCompositingMode();
+    key.transform = layer.getTransform();
+    key.index = index;
+    key.alpha = layer.getPlaneAlpha();
+}
+
+void AcrylicCompositorG2D9810::invalidateCommandCache()
+{
+    mTargetCache.valid = false;
+    for (unsigned int i = 0; i < G2D_MAX_IMAGES; i++)
+        mSourceCache[i].valid = false;
+    mExtraValid = false;
+}
+
 bool AcrylicCompositorG2D9810::executeG2D(int fence[], unsigned int num_fences, bool nonblocking)
 {
     if (!validateAllLayers())
@@ -1046,9 +1056,24 @@ bool AcrylicCompositorG2D9810::executeG2D(int fence[], unsigned int num_fences,
 
     mTask.flags = 0;
 
-    if (!prepareImage(getCanvas(), mTask.target, mTask.commands.target, -1)) {
-        ALOGE("Failed to configure the target image");
-        return false;
+    G2DImageKey key;
+
+    fillImageKey(key, getCanvas());
+    if (mTargetCache.valid && (mTargetCache.key == key)) {
+        if (!prepareBuffer(getCanvas(), mTask.target, mTask.target.num_buffers)) {
+            ALOGE("Failed to configure the target image");
+            return false;
+        }
+    } else {
+        mTargetCache.valid = false;
+
+        if (!prepareImage(getCanvas(), mTask.target, mTask.commands.target, -1)) {
+            ALOGE("Failed to configure the target image");
+            return false;
+        }
+
+        mTargetCache.key = key;
+        mTargetCache.valid = true;
     }
 
     if (getCanvas().isOTF())
@@ -1059,6 +1084,7 @@ bool AcrylicCompositorG2D9810::executeG2D(int fence[], unsigned int num_fences,
     if (hasBackground) {
         baseidx++;
         prepareSolidLayer(getCanvas(), mTask.source[0], mTask.commands.source[0]);
+        mSourceCache[0].valid = false;
     }
 
     mTask.commands.target[G2DSFR_DST_YCBCRMODE] = 0;
@@ -1069,47 +1095,66 @@ bool AcrylicCompositorG2D9810::executeG2D(int fence[], unsigned int num_fences,
 
     mTask.commands.target[G2DSFR_DST_YCBCRMODE] |= (G2D_LAYER_YCBCRMODE_OFFX | G2D_LAYER_YCBCRMODE_OFFY);
 
-    unsigned int layer_premult = 0;
+    // Properties that the CSC and HDR extra registers are generated from.
+    // The opaque layer data and target display information are not comparable.
+    // The extra registers are always generated again if any of them is given.
+    // The target display device is compared by its value.
+    bool hasOpaqueData = (getTargetDisplayInfo() != nullptr) && !hasTargetDisplayDevice();
+
+    mNextExtraKey.clear();
+    mNextExtraKey.push_back(baseidx);
+    mNextExtraKey.push_back(mTask.commands.target[G2DSFR_IMG_COLORMODE]);
+    mNextExtraKey.push_back(static_cast<uint32_t>(getCanvas().getDataspace()));
+    mNextExtraKey.push_back(static_cast<uint32_t>(hasTargetDisplayDevice() ? getTargetDisplayDevice() : -1));
+    mNextExtraKey.push_back(getMinTargetDisplayLuminance());
+    mNextExtraKey.push_back(getMaxTargetDisplayLuminance());
+
     for (unsigned int i = baseidx; i < layercount; i++) {
         AcrylicLayer &layer = *getLayer(i - baseidx);
+        G2DCommandCache &cache = mSourceCache[i];
+        uint32_t *cmd = mTask.commands.source[i];
+
+        fillImageKey(key, layer, getCanvas().getImageDimension(), i - baseidx);
+        if (cache.valid && (cache.key == key)) {
+            if (!layer.isSolidColor() && !prepareBuffer(layer, mTask.source[i], mTask.source[i].num_buffers)) {
+                ALOGE("Failed to configure source layer %u", i - baseidx);
+                return false;
+            }
 
-        if (!prepareSource(layer, mTask.source[i],
-                           mTask.commands.source[i], getCanvas().getImageDimension(),
-                           i - baseidx)) {
-            ALOGE("Failed to configure source layer %u", i - baseidx);
-            return false;
+            cmd[G2DSFR_SRC_COMMAND] = cache.command;
+            cmd[G2DSFR_SRC_YCBCRMODE] = 0;
+            cmd[G2DSFR_SRC_HDRMODE] = 0;
+        } else {
+            cache.valid = false;
+
+            if (!prepareSource(layer, mTask.source[i], cmd, getCanvas().getImageDimension(), i - baseidx)) {
+                ALOGE("Failed to configure source layer %u", i - baseidx);
+                return false;
+            }
+
+            cache.key = key;
+            cache.command = cmd[G2DSFR_SRC_COMMAND];
+            cache.valid = true;
         }
 
-        if (!cscMatrixWriter.configure(mTask.commands.source[i][G2DSFR_IMG_COLORMODE],
-                                       layer.getDataspace(),
-                                       &mTask.commands.source[i][G2DSFR_SRC_YCBCRMODE])) {
+        if (!cscMatrixWriter.configure(cmd[G2DSFR_IMG_COLORMODE], layer.getDataspace(),
+                                       &cmd[G2DSFR_SRC_YCBCRMODE])) {
             ALOGE("Failed to configure CSC coefficient of layer %d for dataspace %u",
                   i, layer.getDataspace());
             return false;
         }
 
-        mHdrWriter.setLayerStaticMetadata(i, layer.getDataspace(),
-                                          layer.getMinMasteringLuminance(),
-                                          layer.getMaxMasteringLuminance());
-
-        bool alpha_premult = (layer.getCompositingMode() == HWC_BLENDING_PREMULT)
-                             || (layer.getCompositingMode() == HWC2_BLEND_MODE_PREMULTIPLIED);
-
-        if (alpha_premult)
-            layer_premult |= 1 << i;
-
-        mHdrWriter.setLayerImageInfo(i, layer.getFormat(), alpha_premult);
+        mNextExtraKey.push_back(cmd[G2DSFR_IMG_COLORMODE]);
+        mNextExtraKey.push_back(static_cast<uint32_t>(layer.getDataspace()));
+        mNextExtraKey.push_back(layer.getFormat());
+        mNextExtraKey.push_back(layer.getCompositingMode());
+        mNextExtraKey.push_back(layer.getMinMasteringLuminance());
+        mNextExtraKey.push_back(layer.getMaxMasteringLuminance());
 
         if (layer.getLayerData())
-            mHdrWriter.setLayerOpaqueData(i, layer.getLayerData(), layer.getLayerDataLength());
+            hasOpaqueData = true;
     }
 
-    mHdrWriter.setTargetInfo(getCanvas().getDataspace(), getTargetDisplayInfo());
-    mHdrWriter.setTargetDisplayLuminance(getMinTargetDisplayLuminance(), getMaxTargetDisplayLuminance());
-
-    mHdrWriter.getCommands();
-    mHdrWriter.getLayerHdrMode(mTask);
-
     mTask.num_source = layercount;
 
     if (nonblocking)
@@ -1118,37 +1163,88 @@ bool AcrylicCompositorG2D9810::executeG2D(int fence[], unsigned int num_fences,
     mTask.num_release_fences = num_fences;
     mTask.release_fence = reinterpret_cast<int *>(alloca(sizeof(int) * num_fences));
 
-    mTask.commands.num_extra_regs = cscMatrixWriter.getRegisterCount() + mHdrWriter.getCommandCount();
+    if (mExtraValid && !hasOpaqueData && (mNextExtraKey == mExtraKey)) {
+        for (unsigned int i = baseidx; i < layercount; i++) {
+            mTask.commands.source[i][G2DSFR_SRC_COMMAND] |= mSourceCache[i].hdrCommand;
+            mTask.commands.source[i][G2DSFR_SRC_HDRMODE] = mSourceCache[i].hdrMode;
+        }
+    } else {
+        mExtraValid = false;
 
-    // If mHdrWriter is disabled and command of hdr library exist, we use the library coefficients.
-    // We use max hdr register count because we could not calculate the count here.
-    // num_extra_regs is updated after to set the hdr register unlike mHdrWriter.
-    unsigned int num_hdrlib_coef = 0;
-    if (!mHdrWriter.getCommandCount()) {
-        for (unsigned int i = 0; i < MAX_HDR_SET; i++) {
-            if (mHdrLibCoef[i].hdr_en) {
-                num_hdrlib_coef = NUM_HDR_REGS;
-                break;
+        unsigned int layer_premult = 0;
+        for (unsigned int i = baseidx; i < layercount; i++) {
+            AcrylicLayer &layer = *getLayer(i - baseidx);
+
+            mHdrWriter.setLayerStaticMetadata(i, layer.getDataspace(),
+                                              layer.getMinMasteringLuminance(),
+                                              layer.getMaxMasteringLuminance());
+
+            bool alpha_premult = (layer.getCompositingMode() == HWC_BLENDING_PREMULT)
+                                 || (layer.getCompositingMode() == HWC2_BLEND_MODE_PREMULTIPLIED);
+
+            if (alpha_premult)
+                layer_premult |= 1 << i;
+
+            mHdrWriter.setLayerImageInfo(i, layer.getFormat(), alpha_premult);
+
+            if (layer.getLayerData())
+                mHdrWriter.setLayerOpaqueData(i, layer.getLayerData(), layer.getLayerDataLength());
+        }
+
+        mHdrWriter.setTargetInfo(getCanvas().getDataspace(), getTargetDisplayInfo());
+        mHdrWriter.setTargetDisplayLuminance(getMinTargetDisplayLuminance(), getMaxTargetDisplayLuminance());
+
+        mHdrWriter.getCommands();
+        mHdrWriter.getLayerHdrMode(mTask);
+
+        mNumExtraRegs = cscMatrixWriter.getRegisterCount() + mHdrWriter.getCommandCount();
+
+        // If mHdrWriter is disabled and command of hdr library exist, we use the library coefficients.
+        // We use max hdr register count because we could not calculate the count here.
+        // mNumExtraRegs is updated after to set the hdr register unlike mHdrWriter.
+        unsigned int num_hdrlib_coef = 0;
+        if (!mHdrWriter.getCommandCount()) {
+            for (unsigned int i = 0; i < MAX_HDR_SET; i++) {
+                if (mHdrLibCoef[i].hdr_en) {
+                    num_hdrlib_coef = NUM_HDR_REGS;
+                    break;
+                }
             }
         }
-    }
-    mTask.commands.extra = reinterpret_cast<g2d_reg *>(
-            alloca(sizeof(g2d_reg) * (mTask.commands.num_extra_regs + num_hdrlib_coef)));
 
-    unsigned int count = cscMatrixWriter.write(mTask.commands.extra);
+        if (mExtraRegs.size() < mNumExtraRegs + num_hdrlib_coef)
+            mExtraRegs.resize(mNumExtraRegs + num_hdrlib_coef);
+
+        unsigned int count = cscMatrixWriter.write(mExtraRegs.data());
+
+        if (mHdrWriter.getCommandCount()) {
+            mHdrWriter.write(mExtraRegs.data() + count);
+        } else if (num_hdrlib_coef) {
+            mNumExtraRegs += setHdrLibCommand(mExtraRegs.data() + count);
+            setHdrLayerCommand(mTask, layer_premult);
+        }
 
-    if (mHdrWriter.getCommandCount()) {
-        mHdrWriter.write(mTask.commands.extra + count);
-    } else if (num_hdrlib_coef) {
-        mTask.commands.num_extra_regs += setHdrLibCommand(mTask.commands.extra + count);
-        setHdrLayerCommand(mTask, layer_premult);
+        for (unsigned int i = baseidx; i < layercount; i++) {
+            uint32_t *cmd = mTask.commands.source[i];
+
+            mSourceCache[i].hdrCommand = cmd[G2DSFR_SRC_COMMAND] & ~mSourceCache[i].command;
+            mSourceCache[i].hdrMode = cmd[G2DSFR_SRC_HDRMODE];
+        }
+
+        mExtraKey.swap(mNextExtraKey);
+        mExtraValid = true;
     }
 
+    mTask.commands.extra = mExtraRegs.data();
+    mTask.commands.num_extra_regs = mNumExtraRegs;
+
     debug_show_g2d_task(mTask);
 
     if (ioctlG2D() < 0) {
         ALOGERR("Failed to process a task");
         show_g2d_task(mTask);
+        mHdrWriter.putCommands();
+        invalidateCommandCache();
         return false;
     }
 
@@ -1157,6 +1253,7 @@ bool AcrylicCompositorG2D9810::executeG2D(int fence[], unsigned int num_fences,
     if (!!(mTask.flags & G2D_FLAG_ERROR)) {
         ALOGE("Error occurred during processing a task to G2D");
         show_g2d_task(mTask);
+        invalidateCommandCache();
         return false;
     }
 
@@ -1385,6 +1482,13 @@ void AcrylicCompositorG2D9810::setLibHdrCoefficient(int *layermap, void *hdrcoef
 {
     hdrCoef *coefs = static_cast<hdrCoef *>(hdrcoef);
 
+    // The HDR extra registers are generated again only if the coefficients are changed
+    if ((memcmp(mHdrLibLayerMap, layermap, sizeof(mHdrLibLayerMap)) == 0) &&
+            (memcmp(mHdrLibCoef, coefs, sizeof(mHdrLibCoef)) == 0))
+        return;
+
+    mExtraValid = false;
+
     memcpy(mHdrLibLayerMap, layermap, sizeof(mHdrLibLayerMap));
     for (int i = 0; i < MAX_HDR_SET; i++)
         mHdrLibCoef[i] = coefs[i];
@@ -1392,6 +1496,8 @@ void AcrylicCompositorG2D9810::setLibHdrCoefficient(int *layermap, void *hdrcoef
 
 void AcrylicCompositorG2D9810::clearLibHdrCoefficient()
 {
+    mExtraValid = false;
+
     memset(mHdrLibLayerMap, 0, sizeof(mHdrLibLayerMap));
     memset(mHdrLibCoef, 0, sizeof(mHdrLibCoef));
 }
@@ -18,6 +18,8 @@
 #ifndef __HARDWARE_EXYNOS_HW2DCOMPOSITOR_G2D9810_H__
 #define __HARDWARE_EXYNOS_HW2DCOMPOSITOR_G2D9810_H__
 
+#include <vector>
+
 #include <hardware/exynos/acryl.h>
 
 #include <hardware/exynos/g2d9810_hdr_plugin.h>
@@ -115,6 +117,35 @@ struct g2d_fmt;
 
 #define MAX_HDR_SET 4
 
+/*
+ * The properties of an image that determine the command block generated by
+ * prepareImage() or prepareSource(). Buffers and fences are not included
+ * because they are patched to the cached command block in every execution.
+ */
+struct G2DImageKey {
+    hw2d_coord_t dimension;
+    hw2d_coord_t target_size;
+    hw2d_rect_t crop;
+    hw2d_rect_t window;
+    uint32_t format;
+    uint32_t attr;
+    uint32_t color;
+    uint32_t blend;
+    uint32_t transform;
+    int index;
+    uint8_t alpha;
+
+    bool operator==(const G2DImageKey &key) const { return memcmp(this, &key, sizeof(key)) == 0; }
+};
+
+struct G2DCommandCache {
+    bool valid;
+    G2DImageKey key;
+    uint32_t command;    // G2DSFR_SRC_COMMAND before CSC and HDR are configured
+    uint32_t hdrCommand; // G2DSFR_SRC_COMMAND bits added by HDR configuration
+    uint32_t hdrMode;    // G2DSFR_SRC_HDRMODE
+};
+
 class AcrylicCompositorG2D9810: public Acrylic {
 public:
     AcrylicCompositorG2D9810(const HW2DCapability &capability, bool newcolormode);
@@ -137,6 +168,7 @@ public:
 private:
     int ioctlG2D(void);
     bool executeG2D(int fence[], unsigned int num_fences, bool nonblocking);
+    bool prepareBuffer(AcrylicCanvas &layer, struct g2d_layer &image, unsigned int num_bufs);
     bool prepareImage(AcrylicCanvas &layer, struct g2d_layer &image, uint32_t cmd[], int index);
     bool prepareSource(AcrylicLayer &layer, struct g2d_layer &image, uint32_t cmd[], hw2d_coord_t target_size, int index);
     bool prepareSolidLayer(AcrylicCanvas &canvas, struct g2d_layer &image, uint32_t cmd[]);
@@ -144,6 +176,7 @@ private:
     bool reallocLayer(unsigned int layercount);
     unsigned int setHdrLibCommand(g2d_reg regs[]);
     void setHdrLayerCommand(g2d_task &task, unsigned int layer_premult);
+    void invalidateCommandCache();
 
     AcrylicDevice mDev;
     g2d_task	  mTask;
@@ -157,6 +190,19 @@ private:
 
     int mHdrLibLayerMap[MAX_HDR_SET];
     hdrCoef mHdrLibCoef[MAX_HDR_SET];
+
+    /*
+     * Command blocks of the previous execution. A command block is regenerated
+     * only if the properties of its image are changed. The CSC and HDR extra
+     * registers are reused if the properties in mExtraKey are not changed.
+     */
+    G2DCommandCache mTargetCache;
+    G2DCommandCache mSourceCache[G2D_MAX_IMAGES];
+    std::vector<g2d_reg> mExtraRegs;
+    std::vector<uint64_t> mExtraKey;
+    std::vector<uint64_t> mNextExtraKey;
+    unsigned int mNumExtraRegs;
+    bool mExtraValid;
 };
 
 #endif //__HARDWARE_EXYNOS_HW2DCOMPOSITOR_G2D9810_H__
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <cstring>
+
 #include <log/log.h>
 
 #include <hardware/exynos/acryl.h>
@@ -32,17 +34,16 @@ AcrylicPerformanceRequest::~AcrylicPerformanceRequest()
 
 bool AcrylicPerformanceRequest::reset(int num_frames)
 {
-    if (num_frames == 0) {
-        delete [] mFrames;
-        mFrames = NULL;
-    } else if (num_frames > mNumAllocFrames) {
-        delete [] mFrames;
-        mFrames = new AcrylicPerformanceRequestFrame[num_frames];
-        if (mFrames == NULL) {
+    // The frames and the layers of the frames are kept for the next request
+    if (num_frames > mNumAllocFrames) {
+        AcrylicPerformanceRequestFrame *frames = new AcrylicPerformanceRequestFrame[num_frames];
+        if (frames == NULL) {
             ALOGE("Failed to allocate PerformanceRequestFrame[%d]", num_frames);
             return false;
         }
 
+        delete [] mFrames;
+        mFrames = frames;
         mNumAllocFrames = num_frames;
     }
 
@@ -51,6 +52,51 @@ bool AcrylicPerformanceRequest::reset(int num_frames)
     return true;
 }
 
+// FNV-1a
+static inline void hashValue(uint64_t &hash, uint32_t value)
+{
+    for (unsigned int i = 0; i < sizeof(value); i++) {
+        hash ^= (value >> (i * 8)) & 0xFF;
+        hash *= 0x100000001B3ULL;
+    }
+}
+
+static inline void hashCoord(uint64_t &hash, const hw2d_coord_t &coord)
+{
+    hashValue(hash, (static_cast<uint16_t>(coord.hori) << 16) | static_cast<uint16_t>(coord.vert));
+}
+
+uint64_t AcrylicPerformanceRequest::getHash()
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    hashValue(hash, mNumFrames);
+    for (int i = 0; i < mNumFrames; i++) {
+        AcrylicPerformanceRequestFrame &frame = mFrames[i];
+
+        hashValue(hash, frame.mNumLayers);
+        hashValue(hash, frame.mFrameRate);
+        hashValue(hash, frame.mTargetPixFormat);
+        hashValue(hash, frame.mHasBackgroundLayer);
+        hashCoord(hash, frame.mTargetDimension);
+
+        for (int j = 0; j < frame.mNumLayers; j++) {
+            AcrylicPerformanceRequestLayer &layer = frame.mLayers[j];
+
+            hashCoord(hash, layer.mSourceDimension);
+            hashValue(hash, layer.mPixFormat);
+            hashCoord(hash, layer.mSourceRect.pos);
+            hashCoord(hash, layer.mSourceRect.size);
+            hashCoord(hash, layer.mTargetRect.pos);
+            hashCoord(hash, layer.mTargetRect.size);
+            hashValue(hash, layer.mTransform);
+            hashValue(hash, layer.mAttribute);
+        }
+    }
+
+    return hash;
+}
+
 AcrylicPerformanceRequestFrame::AcrylicPerformanceRequestFrame()
     : mNumLayers(0), mNumAllocLayers(0), mFrameRate(60),
       mHasBackgroundLayer(false), mLayers(NULL)
@@ -65,19 +111,22 @@ AcrylicPerformanceRequestFrame::~AcrylicPerformanceRequestFrame()
 
 bool AcrylicPerformanceRequestFrame::reset(int num_layers)
 {
-    if (num_layers == 0) {
-        delete [] mLayers;
-        mLayers = NULL;
-    } else if (num_layers > mNumAllocLayers) {
-        mLayers = new AcrylicPerformanceRequestLayer[num_layers];
-        if (mLayers == NULL) {
+    if (num_layers > mNumAllocLayers) {
+        AcrylicPerformanceRequestLayer *layers = new AcrylicPerformanceRequestLayer[num_layers];
+        if (layers == NULL) {
             ALOGE("Failed to allocate PerformanceRequestLayer[%d]", num_layers);
             return false;
         }
 
+        delete [] mLayers;
+        mLayers = layers;
         mNumAllocLayers = num_layers;
     }
 
+    // Attributes are only set for some layers. Nothing should be left from the previous request
+    if (num_layers > 0)
+        memset(mLayers, 0, sizeof(*mLayers) * num_layers);
+
     mNumLayers = num_layers;
 
     return true;
@@ -1122,11 +1122,21 @@ public:
     }
     /*
      * Configure information of target display device.
+     * @data is opaque to Acrylic. It should be valid until the next execution.
      */
     inline void setTargetDisplayInfo(void *data)
     {
         mTargetDisplayInfo = data;
     }
+    /*
+     * Configure the target display device. @device is kept in Acrylic and it
+     * is given to the implementation as the information of target display.
+     */
+    inline void setTargetDisplayDevice(int device)
+    {
+        mTargetDisplayDevice = device;
+        mTargetDisplayInfo = &mTargetDisplayDevice;
+    }
     /*
      * Run HW 2D. If @fence is not NULL and num_fences is not zero, execute()
      * fills the release fences to the array of @fence. The number of fences
@@ -1228,6 +1238,8 @@ protected:
     uint16_t getMaxTargetDisplayLuminance() { return mMaxTargetLuminance; }
     uint16_t getMinTargetDisplayLuminance() { return mMinTargetLuminance; }
     void *getTargetDisplayInfo() { return mTargetDisplayInfo; }
+    bool hasTargetDisplayDevice() { return mTargetDisplayInfo == &mTargetDisplayDevice; }
+    int getTargetDisplayDevice() { return mTargetDisplayDevice; }
     void pushPPC(uint32_t halfmt, uint32_t ppc, uint32_t ppcRot) { mTablePPC.push_back({halfmt, ppc, ppcRot}); }
 private:
     std::vector<AcrylicLayer *> mLayers;
@@ -1242,6 +1254,7 @@ private:
     uint16_t mMaxTargetLuminance;
     uint16_t mMinTargetLuminance;
     void *mTargetDisplayInfo;
+    int mTargetDisplayDevice;
     AcrylicCanvas mCanvas;
     std::vector<std::tuple<uint32_t, uint32_t, uint32_t>> mTablePPC;
 };
@@ -1316,6 +1329,11 @@ public:
     ~AcrylicPerformanceRequest();
 
     bool reset(int num_frames = 0);
+    /*
+     * Hash of the frames and the layers of the request. Users can skip
+     * requestPerformanceQoS() if the hash is the same as the last request.
+     */
+    uint64_t getHash();
 
     int getFrameCount() { return mNumFrames; }
     AcrylicPerformanceRequestFrame *getFrame(int idx) { return (idx < mNumFrames) ? &mFrames[idx] : NULL; }
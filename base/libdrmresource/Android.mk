@@ -37,7 +37,9 @@ LOCAL_SRC_FILES := \
 	drmplane.cpp \
 	drmproperty.cpp \
 	drmeventlistener.cpp \
-	vsyncworker.cpp
+	vsyncworker.cpp \
+	vsyncpredictor.cpp \
+	drmbackend.cpp
 
 LOCAL_CFLAGS := -DHLOG_CODE=0
 LOCAL_CFLAGS += -Wno-unused-parameter
@@ -49,3 +51,25 @@ LOCAL_MODULE_TAGS := optional
 include $(TOP)/hardware/samsung_slsi-linaro/graphics/base/BoardConfigCFlags.mk
 include $(BUILD_SHARED_LIBRARY)
 
+
+################################################################################
+# Fake DRM backend, linked only into the unit tests
+
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := libcutils libdrm liblog libutils libdrmresource
+
+LOCAL_PROPRIETARY_MODULE := true
+
+LOCAL_SRC_FILES := \
+	drmfakebackend.cpp
+
+LOCAL_CFLAGS := -DHLOG_CODE=0
+LOCAL_CFLAGS += -Wno-unused-parameter
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)
+
+LOCAL_MODULE := libdrmresource_fake
+LOCAL_MODULE_TAGS := optional
+
+include $(TOP)/hardware/samsung_slsi-linaro/graphics/base/BoardConfigCFlags.mk
+include $(BUILD_STATIC_LIBRARY)
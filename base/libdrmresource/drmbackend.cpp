@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "hwc-drm-backend"
+
+#include "drmbackend.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+
+#include <log/log.h>
+
+namespace android {
+
+DrmAtomicRequest::DrmAtomicRequest() : req_(drmModeAtomicAlloc()) {
+}
+
+DrmAtomicRequest::~DrmAtomicRequest() {
+  if (req_)
+    drmModeAtomicFree(req_);
+}
+
+int DrmAtomicRequest::AddProperty(uint32_t object_id, uint32_t property_id,
+                                  uint64_t value) {
+  int ret = drmModeAtomicAddProperty(req_, object_id, property_id, value);
+  if (ret < 0)
+    return ret;
+  items_.push_back({object_id, property_id, value});
+  return ret;
+}
+
+void DrmAtomicRequest::SetCursor(int cursor) {
+  drmModeAtomicSetCursor(req_, cursor);
+  if (cursor >= 0 && (size_t)cursor < items_.size())
+    items_.resize(cursor);
+}
+
+static DrmBackend libdrm_backend;
+static std::atomic<DrmBackend *> backend_instance(&libdrm_backend);
+
+DrmBackend &DrmBackend::GetInstance() {
+  return *backend_instance.load();
+}
+
+void DrmBackend::SetInstance(DrmBackend *backend) {
+  backend_instance.store(backend ? backend : &libdrm_backend);
+}
+
+int DrmBackend::Open(const char *path) {
+  /* TODO: Use drmOpenControl here instead */
+  return open(path, O_RDWR);
+}
+
+int DrmBackend::GetNodeTypeFromFd(int fd) {
+  return drmGetNodeTypeFromFd(fd);
+}
+
+int DrmBackend::SetClientCap(int fd, uint64_t capability, uint64_t value) {
+  return drmSetClientCap(fd, capability, value);
+}
+
+drmModeResPtr DrmBackend::GetResources(int fd) {
+  return drmModeGetResources(fd);
+}
+
+void DrmBackend::FreeResources(drmModeResPtr res) {
+  drmModeFreeResources(res);
+}
+
+drmModeCrtcPtr DrmBackend::GetCrtc(int fd, uint32_t crtc_id) {
+  return drmModeGetCrtc(fd, crtc_id);
+}
+
+void DrmBackend::FreeCrtc(drmModeCrtcPtr crtc) {
+  drmModeFreeCrtc(crtc);
+}
+
+drmModeEncoderPtr DrmBackend::GetEncoder(int fd, uint32_t encoder_id) {
+  return drmModeGetEncoder(fd, encoder_id);
+}
+
+void DrmBackend::FreeEncoder(drmModeEncoderPtr encoder) {
+  drmModeFreeEncoder(encoder);
+}
+
+drmModeConnectorPtr DrmBackend::GetConnector(int fd, uint32_t connector_id) {
+  return drmModeGetConnector(fd, connector_id);
+}
+
+void DrmBackend::FreeConnector(drmModeConnectorPtr connector) {
+  drmModeFreeConnector(connector);
+}
+
+drmModePlaneResPtr DrmBackend::GetPlaneResources(int fd) {
+  return drmModeGetPlaneResources(fd);
+}
+
+void DrmBackend::FreePlaneResources(drmModePlaneResPtr res) {
+  drmModeFreePlaneResources(res);
+}
+
+drmModePlanePtr DrmBackend::GetPlane(int fd, uint32_t plane_id) {
+  return drmModeGetPlane(fd, plane_id);
+}
+
+void DrmBackend::FreePlane(drmModePlanePtr plane) {
+  drmModeFreePlane(plane);
+}
+
+drmModeObjectPropertiesPtr DrmBackend::ObjectGetProperties(int fd,
+                                                           uint32_t object_id,
+                                                           uint32_t object_type) {
+  return drmModeObjectGetProperties(fd, object_id, object_type);
+}
+
+void DrmBackend::FreeObjectProperties(drmModeObjectPropertiesPtr props) {
+  drmModeFreeObjectProperties(props);
+}
+
+drmModePropertyPtr DrmBackend::GetProperty(int fd, uint32_t property_id) {
+  return drmModeGetProperty(fd, property_id);
+}
+
+void DrmBackend::FreeProperty(drmModePropertyPtr property) {
+  drmModeFreeProperty(property);
+}
+
+drmModePropertyBlobPtr DrmBackend::GetPropertyBlob(int fd, uint32_t blob_id) {
+  return drmModeGetPropertyBlob(fd, blob_id);
+}
+
+void DrmBackend::FreePropertyBlob(drmModePropertyBlobPtr blob) {
+  drmModeFreePropertyBlob(blob);
+}
+
+int DrmBackend::CreatePropertyBlob(int fd, const void *data, size_t length,
+                                   uint32_t *blob_id) {
+  struct drm_mode_create_blob create_blob;
+  memset(&create_blob, 0, sizeof(create_blob));
+  create_blob.length = length;
+  create_blob.data = (__u64)data;
+
+  int ret = drmIoctl(fd, DRM_IOCTL_MODE_CREATEPROPBLOB, &create_blob);
+  if (ret)
+    return ret;
+  *blob_id = create_blob.blob_id;
+  return 0;
+}
+
+int DrmBackend::DestroyPropertyBlob(int fd, uint32_t blob_id) {
+  struct drm_mode_destroy_blob destroy_blob;
+  memset(&destroy_blob, 0, sizeof(destroy_blob));
+  destroy_blob.blob_id = (__u32)blob_id;
+  return drmIoctl(fd, DRM_IOCTL_MODE_DESTROYPROPBLOB, &destroy_blob);
+}
+
+int DrmBackend::ConnectorSetProperty(int fd, uint32_t connector_id,
+                                     uint32_t property_id, uint64_t value) {
+  return drmModeConnectorSetProperty(fd, connector_id, property_id, value);
+}
+
+int DrmBackend::AtomicCommit(int fd, const DrmAtomicRequest &req,
+                             uint32_t flags, void *user_data) {
+  return drmModeAtomicCommit(fd, req.req(), flags, user_data);
+}
+
+int DrmBackend::WaitVBlank(int fd, drmVBlankPtr vbl) {
+  return drmWaitVBlank(fd, vbl);
+}
+
+int DrmBackend::HandleEvent(int fd, drmEventContextPtr context) {
+  return drmHandleEvent(fd, context);
+}
+
+int DrmBackend::OpenUevent() {
+  int fd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT);
+  if (fd < 0) {
+    ALOGE("Failed to open uevent socket: %s", strerror(errno));
+    return -errno;
+  }
+
+  struct sockaddr_nl addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_pid = 0;
+  addr.nl_groups = 0xFFFFFFFF;
+
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+    int ret = -errno;
+    ALOGE("Failed to bind uevent socket: %s", strerror(errno));
+    close(fd);
+    return ret;
+  }
+  return fd;
+}
+
+int DrmBackend::PrimeFDToHandle(int fd, int prime_fd, uint32_t *handle) {
+  return drmPrimeFDToHandle(fd, prime_fd, handle);
+}
+
+int DrmBackend::CloseBufferHandle(int fd, uint32_t handle) {
+  struct drm_gem_close gem_close;
+  memset(&gem_close, 0, sizeof(gem_close));
+  gem_close.handle = handle;
+  return drmIoctl(fd, DRM_IOCTL_GEM_CLOSE, &gem_close);
+}
+
+int DrmBackend::AddFB2WithModifiers(int fd, uint32_t width, uint32_t height,
+                                    uint32_t pixel_format,
+                                    const uint32_t bo_handles[4],
+                                    const uint32_t pitches[4],
+                                    const uint32_t offsets[4],
+                                    const uint64_t modifier[4],
+                                    uint32_t *buf_id, uint32_t flags) {
+  return drmModeAddFB2WithModifiers(fd, width, height, pixel_format, bo_handles,
+                                    pitches, offsets, modifier, buf_id, flags);
+}
+
+int DrmBackend::RmFB(int fd, uint32_t buf_id) {
+  return drmModeRmFB(fd, buf_id);
+}
+}  // namespace android
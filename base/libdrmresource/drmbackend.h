@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_DRM_BACKEND_H_
+#define ANDROID_DRM_BACKEND_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#include <vector>
+
+namespace android {
+
+// Atomic request that keeps a copy of the items added to its
+// drmModeAtomicReq. libdrm doesn't expose the items, a backend other than
+// libdrm and debug dumps read them from here.
+class DrmAtomicRequest {
+ public:
+  struct Item {
+    uint32_t object_id;
+    uint32_t property_id;
+    uint64_t value;
+  };
+
+  DrmAtomicRequest();
+  ~DrmAtomicRequest();
+  DrmAtomicRequest(const DrmAtomicRequest &) = delete;
+  DrmAtomicRequest &operator=(const DrmAtomicRequest &) = delete;
+
+  // Returns the new cursor or a negative error like drmModeAtomicAddProperty()
+  int AddProperty(uint32_t object_id, uint32_t property_id, uint64_t value);
+  int GetCursor() const {
+    return items_.size();
+  }
+  // Drops the items from the cursor
+  void SetCursor(int cursor);
+
+  const std::vector<Item> &items() const {
+    return items_;
+  }
+  drmModeAtomicReqPtr req() const {
+    return req_;
+  }
+
+ private:
+  drmModeAtomicReqPtr req_;
+  std::vector<Item> items_;
+};
+
+// Every libdrm call that touches the kernel goes through a DrmBackend.
+// The default implementation forwards to libdrm. Another backend (e.g.
+// FakeDrmBackend) can be installed with SetInstance() before
+// DrmDevice::Init() so that the DRM paths run without /dev/dri.
+class DrmBackend {
+ public:
+  virtual ~DrmBackend() {
+  }
+
+  static DrmBackend &GetInstance();
+  // nullptr restores the libdrm backend
+  static void SetInstance(DrmBackend *backend);
+
+  virtual int Open(const char *path);
+  virtual int GetNodeTypeFromFd(int fd);
+  virtual int SetClientCap(int fd, uint64_t capability, uint64_t value);
+
+  virtual drmModeResPtr GetResources(int fd);
+  virtual void FreeResources(drmModeResPtr res);
+  virtual drmModeCrtcPtr GetCrtc(int fd, uint32_t crtc_id);
+  virtual void FreeCrtc(drmModeCrtcPtr crtc);
+  virtual drmModeEncoderPtr GetEncoder(int fd, uint32_t encoder_id);
+  virtual void FreeEncoder(drmModeEncoderPtr encoder);
+  virtual drmModeConnectorPtr GetConnector(int fd, uint32_t connector_id);
+  virtual void FreeConnector(drmModeConnectorPtr connector);
+  virtual drmModePlaneResPtr GetPlaneResources(int fd);
+  virtual void FreePlaneResources(drmModePlaneResPtr res);
+  virtual drmModePlanePtr GetPlane(int fd, uint32_t plane_id);
+  virtual void FreePlane(drmModePlanePtr plane);
+
+  virtual drmModeObjectPropertiesPtr ObjectGetProperties(int fd, uint32_t object_id,
+                                                         uint32_t object_type);
+  virtual void FreeObjectProperties(drmModeObjectPropertiesPtr props);
+  virtual drmModePropertyPtr GetProperty(int fd, uint32_t property_id);
+  virtual void FreeProperty(drmModePropertyPtr property);
+  virtual drmModePropertyBlobPtr GetPropertyBlob(int fd, uint32_t blob_id);
+  virtual void FreePropertyBlob(drmModePropertyBlobPtr blob);
+  virtual int CreatePropertyBlob(int fd, const void *data, size_t length,
+                                 uint32_t *blob_id);
+  virtual int DestroyPropertyBlob(int fd, uint32_t blob_id);
+  virtual int ConnectorSetProperty(int fd, uint32_t connector_id,
+                                   uint32_t property_id, uint64_t value);
+
+  virtual int AtomicCommit(int fd, const DrmAtomicRequest &req, uint32_t flags,
+                           void *user_data);
+  virtual int WaitVBlank(int fd, drmVBlankPtr vbl);
+  virtual int HandleEvent(int fd, drmEventContextPtr context);
+  // Socket that receives kernel uevents for hotplug and panel reset
+  virtual int OpenUevent();
+
+  virtual int PrimeFDToHandle(int fd, int prime_fd, uint32_t *handle);
+  virtual int CloseBufferHandle(int fd, uint32_t handle);
+  virtual int AddFB2WithModifiers(int fd, uint32_t width, uint32_t height,
+                                  uint32_t pixel_format,
+                                  const uint32_t bo_handles[4],
+                                  const uint32_t pitches[4],
+                                  const uint32_t offsets[4],
+                                  const uint64_t modifier[4], uint32_t *buf_id,
+                                  uint32_t flags);
+  virtual int RmFB(int fd, uint32_t buf_id);
+};
+}  // namespace android
+
+#endif  // ANDROID_DRM_BACKEND_H_
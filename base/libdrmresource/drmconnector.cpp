@@ -223,7 +223,7 @@ std::string DrmConnector::name() const {
 
 int DrmConnector::UpdateModes() {
   int fd = drm_->fd();
-  drmModeConnectorPtr c = drmModeGetConnector(fd, id_);
+  drmModeConnectorPtr c = drm_->backend().GetConnector(fd, id_);
   if (!c) {
     ALOGE("Failed to get connector %d", id_);
     return -ENODEV;
@@ -232,6 +232,7 @@ int DrmConnector::UpdateModes() {
   state_ = c->connection;
 
   if (state_ == DRM_MODE_DISCONNECTED) {
+    drm_->backend().FreeConnector(c);
     return 0;
   }
 
@@ -262,6 +263,7 @@ int DrmConnector::UpdateModes() {
   if (!preferred_mode_found && modes_.size() != 0) {
     preferred_mode_id_ = modes_[0].id();
   }
+  drm_->backend().FreeConnector(c);
   return 0;
 }
 
@@ -396,21 +398,21 @@ int DrmConnector::UpdateEdid() {
 int DrmConnector::UpdateProperty(DrmProperty *property) {
   int fd = drm_->fd();
   drmModeObjectPropertiesPtr props;
-  props = drmModeObjectGetProperties(fd, id_, DRM_MODE_OBJECT_CONNECTOR);
+  props = drm_->backend().ObjectGetProperties(fd, id_, DRM_MODE_OBJECT_CONNECTOR);
   if (!props) {
     ALOGE("Failed to get properties for connector %s", property->name().c_str());
     return -ENODEV;
   }
   bool found = false;
   for (int i = 0; !found && (size_t)i < props->count_props; ++i) {
-    drmModePropertyPtr p = drmModeGetProperty(fd, props->props[i]);
+    drmModePropertyPtr p = drm_->backend().GetProperty(fd, props->props[i]);
     if (props->props[i] == property->id()) {
       property->UpdateValue(props->prop_values[i]);
       found = true;
     }
-    drmModeFreeProperty(p);
+    drm_->backend().FreeProperty(p);
   }
-  drmModeFreeObjectProperties(props);
+  drm_->backend().FreeObjectProperties(props);
   return found ? 0 : -ENOENT;
 }
 }  // namespace android
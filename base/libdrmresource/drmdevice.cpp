@@ -39,7 +39,8 @@
 
 namespace android {
 
-DrmDevice::DrmDevice() : event_listener_(this) {
+DrmDevice::DrmDevice()
+    : backend_(&DrmBackend::GetInstance()), event_listener_(this) {
 }
 
 DrmDevice::~DrmDevice() {
@@ -47,40 +48,39 @@ DrmDevice::~DrmDevice() {
 }
 
 std::tuple<int, int> DrmDevice::Init(const char *path, int num_displays) {
-  /* TODO: Use drmOpenControl here instead */
-  fd_.Set(open(path, O_RDWR));
+  fd_.Set(backend_->Open(path));
   if (fd() < 0) {
     ALOGE("Failed to open dri %s: %s", path, strerror(errno));
     return std::make_tuple(-ENODEV, 0);
   }
 
-  if (drmGetNodeTypeFromFd(fd()) != DRM_NODE_PRIMARY) {
+  if (backend_->GetNodeTypeFromFd(fd()) != DRM_NODE_PRIMARY) {
     ALOGE("Node Type is not Primary.. retry..");
     fd_.Set(close(fd()));
     return std::make_tuple(-EEXIST, 0);
   }
 
-  int ret = drmSetClientCap(fd(), DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1);
+  int ret = backend_->SetClientCap(fd(), DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1);
   if (ret) {
     ALOGE("Failed to set universal plane cap %d", ret);
     return std::make_tuple(ret, 0);
   }
 
-  ret = drmSetClientCap(fd(), DRM_CLIENT_CAP_ATOMIC, 1);
+  ret = backend_->SetClientCap(fd(), DRM_CLIENT_CAP_ATOMIC, 1);
   if (ret) {
     ALOGE("Failed to set atomic cap %d", ret);
     return std::make_tuple(ret, 0);
   }
 
 #ifdef DRM_CLIENT_CAP_WRITEBACK_CONNECTORS
-  ret = drmSetClientCap(fd(), DRM_CLIENT_CAP_WRITEBACK_CONNECTORS, 1);
+  ret = backend_->SetClientCap(fd(), DRM_CLIENT_CAP_WRITEBACK_CONNECTORS, 1);
   if (ret) {
     ALOGI("Failed to set writeback cap %d", ret);
     ret = 0;
   }
 #endif
 
-  drmModeResPtr res = drmModeGetResources(fd());
+  drmModeResPtr res = backend_->GetResources(fd());
   if (!res) {
     ALOGE("Failed to get DrmDevice resources");
     return std::make_tuple(-ENODEV, 0);
@@ -96,7 +96,7 @@ std::tuple<int, int> DrmDevice::Init(const char *path, int num_displays) {
   bool found_primary = num_displays != 0;
 
   for (int i = 0; !ret && i < res->count_crtcs; ++i) {
-    drmModeCrtcPtr c = drmModeGetCrtc(fd(), res->crtcs[i]);
+    drmModeCrtcPtr c = backend_->GetCrtc(fd(), res->crtcs[i]);
     if (!c) {
       ALOGE("Failed to get crtc %d", res->crtcs[i]);
       ret = -ENODEV;
@@ -104,7 +104,7 @@ std::tuple<int, int> DrmDevice::Init(const char *path, int num_displays) {
     }
 
     std::unique_ptr<DrmCrtc> crtc(new DrmCrtc(this, c, i));
-    drmModeFreeCrtc(c);
+    backend_->FreeCrtc(c);
 
     ret = crtc->Init();
     if (ret) {
@@ -116,7 +116,7 @@ std::tuple<int, int> DrmDevice::Init(const char *path, int num_displays) {
 
   std::vector<int> possible_clones;
   for (int i = 0; !ret && i < res->count_encoders; ++i) {
-    drmModeEncoderPtr e = drmModeGetEncoder(fd(), res->encoders[i]);
+    drmModeEncoderPtr e = backend_->GetEncoder(fd(), res->encoders[i]);
     if (!e) {
       ALOGE("Failed to get encoder %d", res->encoders[i]);
       ret = -ENODEV;
@@ -136,7 +136,7 @@ std::tuple<int, int> DrmDevice::Init(const char *path, int num_displays) {
     std::unique_ptr<DrmEncoder> enc(
         new DrmEncoder(e, current_crtc, possible_crtcs));
     possible_clones.push_back(e->possible_clones);
-    drmModeFreeEncoder(e);
+    backend_->FreeEncoder(e);
 
     encoders_.emplace_back(std::move(enc));
   }
@@ -148,7 +148,7 @@ std::tuple<int, int> DrmDevice::Init(const char *path, int num_displays) {
   }
 
   for (int i = 0; !ret && i < res->count_connectors; ++i) {
-    drmModeConnectorPtr c = drmModeGetConnector(fd(), res->connectors[i]);
+    drmModeConnectorPtr c = backend_->GetConnector(fd(), res->connectors[i]);
     if (!c) {
       ALOGE("Failed to get connector %d", res->connectors[i]);
       ret = -ENODEV;
@@ -169,7 +169,7 @@ std::tuple<int, int> DrmDevice::Init(const char *path, int num_displays) {
     std::unique_ptr<DrmConnector> conn(
         new DrmConnector(this, c, current_encoder, possible_encoders));
 
-    drmModeFreeConnector(c);
+    backend_->FreeConnector(c);
 
     ret = conn->Init();
     if (ret) {
@@ -212,20 +212,20 @@ std::tuple<int, int> DrmDevice::Init(const char *path, int num_displays) {
   }
 
   if (res)
-    drmModeFreeResources(res);
+    backend_->FreeResources(res);
 
   // Catch-all for the above loops
   if (ret)
     return std::make_tuple(ret, 0);
 
-  drmModePlaneResPtr plane_res = drmModeGetPlaneResources(fd());
+  drmModePlaneResPtr plane_res = backend_->GetPlaneResources(fd());
   if (!plane_res) {
     ALOGE("Failed to get plane resources");
     return std::make_tuple(-ENOENT, 0);
   }
 
   for (uint32_t i = 0; i < plane_res->count_planes; ++i) {
-    drmModePlanePtr p = drmModeGetPlane(fd(), plane_res->planes[i]);
+    drmModePlanePtr p = backend_->GetPlane(fd(), plane_res->planes[i]);
     if (!p) {
       ALOGE("Failed to get plane %d", plane_res->planes[i]);
       ret = -ENODEV;
@@ -234,7 +234,7 @@ std::tuple<int, int> DrmDevice::Init(const char *path, int num_displays) {
 
     std::unique_ptr<DrmPlane> plane(new DrmPlane(this, p));
 
-    drmModeFreePlane(p);
+    backend_->FreePlane(p);
 
     ret = plane->Init();
     if (ret) {
@@ -244,7 +244,7 @@ std::tuple<int, int> DrmDevice::Init(const char *path, int num_displays) {
 
     planes_.emplace_back(std::move(plane));
   }
-  drmModeFreePlaneResources(plane_res);
+  backend_->FreePlaneResources(plane_res);
   if (ret)
     return std::make_tuple(ret, 0);
 
@@ -421,17 +421,11 @@ int DrmDevice::AttachWriteback(int display) {
 
 int DrmDevice::CreatePropertyBlob(void *data, size_t length,
                                   uint32_t *blob_id) {
-  struct drm_mode_create_blob create_blob;
-  memset(&create_blob, 0, sizeof(create_blob));
-  create_blob.length = length;
-  create_blob.data = (__u64)data;
-
-  int ret = drmIoctl(fd(), DRM_IOCTL_MODE_CREATEPROPBLOB, &create_blob);
+  int ret = backend_->CreatePropertyBlob(fd(), data, length, blob_id);
   if (ret) {
     ALOGE("Failed to create mode property blob %d", ret);
     return ret;
   }
-  *blob_id = create_blob.blob_id;
   return 0;
 }
 
@@ -439,10 +433,7 @@ int DrmDevice::DestroyPropertyBlob(uint32_t blob_id) {
   if (!blob_id)
     return 0;
 
-  struct drm_mode_destroy_blob destroy_blob;
-  memset(&destroy_blob, 0, sizeof(destroy_blob));
-  destroy_blob.blob_id = (__u32)blob_id;
-  int ret = drmIoctl(fd(), DRM_IOCTL_MODE_DESTROYPROPBLOB, &destroy_blob);
+  int ret = backend_->DestroyPropertyBlob(fd(), blob_id);
   if (ret) {
     ALOGE("Failed to destroy mode property blob %" PRIu32 "/%d", blob_id, ret);
     return ret;
@@ -458,7 +449,7 @@ int DrmDevice::GetProperty(uint32_t obj_id, uint32_t obj_type,
                            const char *prop_name, DrmProperty *property) {
   drmModeObjectPropertiesPtr props;
 
-  props = drmModeObjectGetProperties(fd(), obj_id, obj_type);
+  props = backend_->ObjectGetProperties(fd(), obj_id, obj_type);
   if (!props) {
     ALOGE("Failed to get properties for %d/%x", obj_id, obj_type);
     return -ENODEV;
@@ -466,18 +457,18 @@ int DrmDevice::GetProperty(uint32_t obj_id, uint32_t obj_type,
 
   bool found = false;
   for (int i = 0; !found && (size_t)i < props->count_props; ++i) {
-    drmModePropertyPtr p = drmModeGetProperty(fd(), props->props[i]);
+    drmModePropertyPtr p = backend_->GetProperty(fd(), props->props[i]);
     if (!strcmp(p->name, prop_name)) {
       property->Init(p, props->prop_values[i]);
       found = true;
     }
-    drmModeFreeProperty(p);
+    backend_->FreeProperty(p);
   }
 
   if (!found)
       property->SetName(prop_name);
 
-  drmModeFreeObjectProperties(props);
+  backend_->FreeObjectProperties(props);
   return found ? 0 : -ENOENT;
 }
 
@@ -500,41 +491,41 @@ int DrmDevice::GetConnectorProperty(const DrmConnector &connector,
 
 int DrmDevice::UpdateCrtcProperty(const DrmCrtc &crtc, DrmProperty *property) {
     drmModeObjectPropertiesPtr props;
-    props = drmModeObjectGetProperties(fd(), crtc.id(), DRM_MODE_OBJECT_CRTC);
+    props = backend_->ObjectGetProperties(fd(), crtc.id(), DRM_MODE_OBJECT_CRTC);
     if (!props) {
         ALOGE("Failed to get properties for crtc %s", property->name().c_str());
         return -ENODEV;
     }
     bool found = false;
     for (int i = 0; !found && (size_t)i < props->count_props; ++i) {
-        drmModePropertyPtr p = drmModeGetProperty(fd(), props->props[i]);
+        drmModePropertyPtr p = backend_->GetProperty(fd(), props->props[i]);
         if (props->props[i] == property->id()) {
             property->UpdateValue(props->prop_values[i]);
             found = true;
         }
-        drmModeFreeProperty(p);
+        backend_->FreeProperty(p);
     }
-    drmModeFreeObjectProperties(props);
+    backend_->FreeObjectProperties(props);
     return found ? 0 : -ENOENT;
 }
 
 int DrmDevice::UpdateConnectorProperty(const DrmConnector &connector, DrmProperty *property) {
     drmModeObjectPropertiesPtr props;
-    props = drmModeObjectGetProperties(fd(), connector.id(), DRM_MODE_OBJECT_CONNECTOR);
+    props = backend_->ObjectGetProperties(fd(), connector.id(), DRM_MODE_OBJECT_CONNECTOR);
     if (!props) {
         ALOGE("Failed to get properties for connector %s", property->name().c_str());
         return -ENODEV;
     }
     bool found = false;
     for (int i = 0; !found && (size_t)i < props->count_props; ++i) {
-        drmModePropertyPtr p = drmModeGetProperty(fd(), props->props[i]);
+        drmModePropertyPtr p = backend_->GetProperty(fd(), props->props[i]);
         if (props->props[i] == property->id()) {
             property->UpdateValue(props->prop_values[i]);
             found = true;
         }
-        drmModeFreeProperty(p);
+        backend_->FreeProperty(p);
     }
-    drmModeFreeObjectProperties(props);
+    backend_->FreeObjectProperties(props);
     return found ? 0 : -ENOENT;
 }
 }  // namespace android
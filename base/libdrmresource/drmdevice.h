@@ -17,6 +17,7 @@
 #ifndef ANDROID_DRM_H_
 #define ANDROID_DRM_H_
 
+#include "drmbackend.h"
 #include "drmconnector.h"
 #include "drmcrtc.h"
 #include "drmencoder.h"
@@ -40,6 +41,10 @@ class DrmDevice {
     return fd_.get();
   }
 
+  DrmBackend &backend() const {
+    return *backend_;
+  }
+
   const std::vector<std::unique_ptr<DrmConnector>> &connectors() const {
     return connectors_;
   }
@@ -93,6 +98,7 @@ class DrmDevice {
   int CreateDisplayPipe(DrmConnector *connector);
   int AttachWriteback(int display);
 
+  DrmBackend *backend_;
   UniqueFd fd_;
   uint32_t mode_id_ = 0;
 
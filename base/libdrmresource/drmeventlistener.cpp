@@ -21,8 +21,8 @@
 
 #include <assert.h>
 #include <errno.h>
-#include <linux/netlink.h>
-#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <algorithm>
 
 #include <hardware/hardware.h>
 #include <hardware/hwcomposer.h>
@@ -37,32 +37,36 @@ DrmEventListener::DrmEventListener(DrmDevice *drm)
 }
 
 int DrmEventListener::Init() {
-  uevent_fd_.Set(socket(PF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT));
-  if (uevent_fd_.get() < 0) {
-    ALOGE("Failed to open uevent socket: %s", strerror(errno));
-    return uevent_fd_.get();
-  }
-
-  struct sockaddr_nl addr;
-  memset(&addr, 0, sizeof(addr));
-  addr.nl_family = AF_NETLINK;
-  addr.nl_pid = 0;
-  addr.nl_groups = 0xFFFFFFFF;
-
-  int ret = bind(uevent_fd_.get(), (struct sockaddr *)&addr, sizeof(addr));
-  if (ret) {
-    ALOGE("Failed to bind uevent socket: %s", strerror(errno));
-    return -errno;
+  int fd = drm_->backend().OpenUevent();
+  if (fd < 0)
+    return fd;
+  uevent_fd_.Set(fd);
+
+  exit_fd_.Set(eventfd(0, EFD_CLOEXEC));
+  if (exit_fd_.get() < 0) {
+    int ret = -errno;
+    ALOGE("Failed to create exit eventfd: %s", strerror(errno));
+    return ret;
   }
 
   FD_ZERO(&fds_);
   FD_SET(drm_->fd(), &fds_);
   FD_SET(uevent_fd_.get(), &fds_);
-  max_fd_ = std::max(drm_->fd(), uevent_fd_.get());
+  FD_SET(exit_fd_.get(), &fds_);
+  max_fd_ = std::max({drm_->fd(), uevent_fd_.get(), exit_fd_.get()});
 
   return InitWorker();
 }
 
+void DrmEventListener::Exit() {
+  if (exit_fd_.get() >= 0) {
+    uint64_t signal = 1;
+    if (write(exit_fd_.get(), &signal, sizeof(signal)) < 0)
+      ALOGE("Failed to wake event listener: %s", strerror(errno));
+  }
+  Worker::Exit();
+}
+
 void DrmEventListener::RegisterHotplugHandler(DrmEventHandler *handler) {
   assert(!hotplug_handler_);
   hotplug_handler_.reset(handler);
@@ -112,7 +116,8 @@ void DrmEventListener::UEventHandler() {
     if (ret == 0) {
       return;
     } else if (ret < 0) {
-      ALOGE("Got error reading uevent %d", ret);
+      if (errno != EAGAIN)
+        ALOGE("Got error reading uevent %d", ret);
       return;
     }
 
@@ -146,19 +151,25 @@ void DrmEventListener::UEventHandler() {
 
 void DrmEventListener::Routine() {
   int ret;
+  fd_set fds;
   do {
-    ret = select(max_fd_ + 1, &fds_, NULL, NULL, NULL);
+    // select() overwrites the set with the ready fds
+    fds = fds_;
+    ret = select(max_fd_ + 1, &fds, NULL, NULL, NULL);
   } while (ret == -1 && errno == EINTR);
 
-  if (FD_ISSET(drm_->fd(), &fds_)) {
+  if (FD_ISSET(exit_fd_.get(), &fds))
+    return;
+
+  if (FD_ISSET(drm_->fd(), &fds)) {
     drmEventContext event_context =
         {.version = 2,
          .vblank_handler = NULL,
          .page_flip_handler = DrmEventListener::FlipHandler};
-    drmHandleEvent(drm_->fd(), &event_context);
+    drm_->backend().HandleEvent(drm_->fd(), &event_context);
   }
 
-  if (FD_ISSET(uevent_fd_.get(), &fds_))
+  if (FD_ISSET(uevent_fd_.get(), &fds))
     UEventHandler();
 }
 }  // namespace android
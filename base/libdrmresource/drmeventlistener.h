@@ -42,6 +42,8 @@ class DrmEventListener : public Worker {
   }
 
   int Init();
+  // Wakes the listener from select() before stopping it
+  void Exit();
 
   void RegisterHotplugHandler(DrmEventHandler *handler);
   void UnRegisterHotplugHandler(DrmEventHandler *handler);
@@ -59,6 +61,7 @@ class DrmEventListener : public Worker {
 
   fd_set fds_;
   UniqueFd uevent_fd_;
+  UniqueFd exit_fd_;
   int max_fd_ = -1;
 
   DrmDevice *drm_;
@@ -0,0 +1,905 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "hwc-drm-fake-backend"
+
+#include "drmfakebackend.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+
+#include <drm_fourcc.h>
+#include <log/log.h>
+
+namespace android {
+
+static const int64_t kOneSecondNs = 1LL * 1000 * 1000 * 1000;
+
+static int64_t Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * kOneSecondNs + ts.tv_nsec;
+}
+
+static std::chrono::steady_clock::time_point ToTimePoint(int64_t ns) {
+  return std::chrono::steady_clock::now() +
+         std::chrono::nanoseconds(ns - Now());
+}
+
+template <typename T>
+static T *CopyArray(const std::vector<T> &v) {
+  if (v.empty())
+    return NULL;
+  T *array = (T *)calloc(v.size(), sizeof(T));
+  if (array)
+    memcpy(array, v.data(), v.size() * sizeof(T));
+  return array;
+}
+
+FakeDrmBackend::FakeDrmBackend(const char *path) : path_(path), jitter_rng_(0) {
+}
+
+FakeDrmBackend::~FakeDrmBackend() {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    running_ = false;
+    latched_seqno_ = commit_seqno_;
+    SignalFencesLocked();
+  }
+  cond_.notify_all();
+  if (vblank_thread_.joinable())
+    vblank_thread_.join();
+
+  if (event_fd_ >= 0)
+    close(event_fd_);
+  if (uevent_fd_ >= 0)
+    close(uevent_fd_);
+}
+
+uint32_t FakeDrmBackend::AddObject(uint32_t type) {
+  uint32_t id = next_id_++;
+  Object &obj = objects_[id];
+  obj.type = type;
+  obj.possible_crtcs = 0;
+  obj.encoder_id = 0;
+  obj.connector_type = DRM_MODE_CONNECTOR_Unknown;
+  obj.connection = DRM_MODE_DISCONNECTED;
+  return id;
+}
+
+uint32_t FakeDrmBackend::AddPropertyLocked(uint32_t object_id, const char *name,
+                                           uint32_t flags,
+                                           const std::vector<uint64_t> &values,
+                                           const std::vector<std::string> &enums,
+                                           uint64_t value) {
+  auto obj = objects_.find(object_id);
+  if (obj == objects_.end())
+    return 0;
+
+  auto key = std::make_pair(obj->second.type, std::string(name));
+  uint32_t prop_id;
+  auto it = property_ids_.find(key);
+  if (it != property_ids_.end()) {
+    prop_id = it->second;
+  } else {
+    prop_id = next_id_++;
+    property_ids_[key] = prop_id;
+    properties_[prop_id] = {name, flags, values, enums};
+  }
+
+  if (!obj->second.values.count(prop_id))
+    obj->second.props.push_back(prop_id);
+  obj->second.values[prop_id] = value;
+  return prop_id;
+}
+
+uint32_t FakeDrmBackend::CreateBlobLocked(const void *data, size_t length) {
+  uint32_t id = next_id_++;
+  const uint8_t *bytes = (const uint8_t *)data;
+  blobs_[id] = std::vector<uint8_t>(bytes, bytes + length);
+  return id;
+}
+
+FakeDrmBackend::Object *FakeDrmBackend::FindObjectLocked(uint32_t id,
+                                                         uint32_t type) {
+  auto it = objects_.find(id);
+  if (it == objects_.end())
+    return NULL;
+  if (type != DRM_MODE_OBJECT_ANY && it->second.type != type)
+    return NULL;
+  return &it->second;
+}
+
+uint32_t FakeDrmBackend::AddProperty(uint32_t object_id, const char *name,
+                                     uint64_t value, uint64_t min,
+                                     uint64_t max) {
+  std::lock_guard<std::mutex> lock(lock_);
+  return AddPropertyLocked(object_id, name, DRM_MODE_PROP_RANGE, {min, max}, {},
+                           value);
+}
+
+uint32_t FakeDrmBackend::AddEnumProperty(uint32_t object_id, const char *name,
+                                         const std::vector<std::string> &enums,
+                                         uint64_t value) {
+  std::lock_guard<std::mutex> lock(lock_);
+  // Enum values are their indices
+  std::vector<uint64_t> values;
+  for (size_t i = 0; i < enums.size(); i++)
+    values.push_back(i);
+  return AddPropertyLocked(object_id, name, DRM_MODE_PROP_ENUM, values, enums,
+                           value);
+}
+
+uint32_t FakeDrmBackend::AddBlobProperty(uint32_t object_id, const char *name,
+                                         const void *data, size_t length) {
+  std::lock_guard<std::mutex> lock(lock_);
+  uint32_t blob_id = data ? CreateBlobLocked(data, length) : 0;
+  return AddPropertyLocked(object_id, name, DRM_MODE_PROP_BLOB, {}, {},
+                           blob_id);
+}
+
+uint32_t FakeDrmBackend::AddCrtc() {
+  uint32_t id;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    id = AddObject(DRM_MODE_OBJECT_CRTC);
+    crtcs_.push_back(id);
+  }
+  AddProperty(id, "ACTIVE", 0, 0, 1);
+  AddBlobProperty(id, "MODE_ID", NULL, 0);
+  AddProperty(id, "OUT_FENCE_PTR", 0);
+  return id;
+}
+
+uint32_t FakeDrmBackend::AddEncoder(uint32_t possible_crtcs) {
+  std::lock_guard<std::mutex> lock(lock_);
+  uint32_t id = AddObject(DRM_MODE_OBJECT_ENCODER);
+  objects_[id].possible_crtcs = possible_crtcs;
+  encoders_.push_back(id);
+  return id;
+}
+
+uint32_t FakeDrmBackend::AddConnector(uint32_t encoder_id, uint32_t type,
+                                      const std::vector<drmModeModeInfo> &modes) {
+  uint32_t id;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    id = AddObject(DRM_MODE_OBJECT_CONNECTOR);
+    Object &obj = objects_[id];
+    obj.encoder_id = encoder_id;
+    obj.connector_type = type;
+    obj.connection = DRM_MODE_CONNECTED;
+    obj.modes = modes;
+    connectors_.push_back(id);
+    AddPropertyLocked(id, "CRTC_ID", DRM_MODE_PROP_OBJECT,
+                      {DRM_MODE_OBJECT_CRTC}, {}, 0);
+  }
+  AddEnumProperty(id, "DPMS", {"On", "Standby", "Suspend", "Off"},
+                  DRM_MODE_DPMS_OFF);
+  AddBlobProperty(id, "EDID", NULL, 0);
+  return id;
+}
+
+uint32_t FakeDrmBackend::AddPlane(uint32_t possible_crtcs, uint32_t type,
+                                  const std::vector<uint32_t> &formats) {
+  uint32_t id;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    id = AddObject(DRM_MODE_OBJECT_PLANE);
+    objects_[id].possible_crtcs = possible_crtcs;
+    objects_[id].formats = formats;
+    planes_.push_back(id);
+    AddPropertyLocked(id, "CRTC_ID", DRM_MODE_PROP_OBJECT,
+                      {DRM_MODE_OBJECT_CRTC}, {}, 0);
+    AddPropertyLocked(id, "FB_ID", DRM_MODE_PROP_OBJECT, {DRM_MODE_OBJECT_FB},
+                      {}, 0);
+    AddPropertyLocked(id, "rotation", DRM_MODE_PROP_BITMASK, {0, 1, 2, 3, 4, 5},
+                      {"rotate-0", "rotate-90", "rotate-180", "rotate-270",
+                       "reflect-x", "reflect-y"},
+                      DRM_MODE_ROTATE_0);
+  }
+  AddEnumProperty(id, "type", {"Overlay", "Primary", "Cursor"}, type);
+  AddProperty(id, "CRTC_X", 0, 0, INT32_MAX);
+  AddProperty(id, "CRTC_Y", 0, 0, INT32_MAX);
+  AddProperty(id, "CRTC_W", 0, 0, INT32_MAX);
+  AddProperty(id, "CRTC_H", 0, 0, INT32_MAX);
+  AddProperty(id, "SRC_X", 0, 0, UINT32_MAX);
+  AddProperty(id, "SRC_Y", 0, 0, UINT32_MAX);
+  AddProperty(id, "SRC_W", 0, 0, UINT32_MAX);
+  AddProperty(id, "SRC_H", 0, 0, UINT32_MAX);
+
+  std::vector<uint8_t> in_formats(sizeof(struct drm_format_modifier_blob) +
+                                  formats.size() * sizeof(uint32_t));
+  struct drm_format_modifier_blob *header =
+      (struct drm_format_modifier_blob *)in_formats.data();
+  header->version = FORMAT_BLOB_CURRENT;
+  header->count_formats = formats.size();
+  header->formats_offset = sizeof(*header);
+  if (!formats.empty())
+    memcpy(in_formats.data() + sizeof(*header), formats.data(),
+           formats.size() * sizeof(uint32_t));
+  AddBlobProperty(id, "IN_FORMATS", in_formats.data(), in_formats.size());
+
+  AddProperty(id, "zpos", 0, 0, 255);
+  AddProperty(id, "alpha", 0xffff, 0, 0xffff);
+  AddEnumProperty(id, "pixel blend mode", {"None", "Pre-multiplied", "Coverage"},
+                  1);
+  AddProperty(id, "IN_FENCE_FD", (uint64_t)-1, 0, UINT32_MAX);
+  AddEnumProperty(id, "standard",
+                  {"Unspecified", "BT709", "BT601_625", "BT601_625_UNADJUSTED",
+                   "BT601_525", "BT601_525_UNADJUSTED", "BT2020",
+                   "BT2020_CONSTANT_LUMINANCE", "BT470M", "FILM", "DCI-P3",
+                   "Adobe RGB"});
+  AddEnumProperty(id, "transfer",
+                  {"Unspecified", "Linear", "sRGB", "SMPTE 170M", "Gamma 2.2",
+                   "Gamma 2.6", "Gamma 2.8", "ST2084", "HLG"});
+  AddEnumProperty(id, "range", {"Unspecified", "Full", "Limited", "Extended"});
+  AddProperty(id, "HDR_FD", (uint64_t)-1, 0, UINT32_MAX);
+  return id;
+}
+
+drmModeModeInfo FakeDrmBackend::MakeMode(uint32_t width, uint32_t height,
+                                         uint32_t refresh) {
+  drmModeModeInfo mode;
+  memset(&mode, 0, sizeof(mode));
+  mode.hdisplay = width;
+  mode.hsync_start = width + 16;
+  mode.hsync_end = width + 32;
+  mode.htotal = width + 64;
+  mode.vdisplay = height;
+  mode.vsync_start = height + 4;
+  mode.vsync_end = height + 8;
+  mode.vtotal = height + 16;
+  mode.vrefresh = refresh;
+  mode.clock = (uint32_t)((uint64_t)mode.htotal * mode.vtotal * refresh / 1000);
+  mode.type = DRM_MODE_TYPE_DRIVER | DRM_MODE_TYPE_PREFERRED;
+  snprintf(mode.name, DRM_DISPLAY_MODE_LEN, "%ux%u", width, height);
+  return mode;
+}
+
+uint32_t FakeDrmBackend::AddDisplay(uint32_t width, uint32_t height,
+                                    uint32_t refresh, uint32_t num_planes) {
+  uint32_t pipe;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    pipe = crtcs_.size();
+  }
+  AddCrtc();
+  uint32_t encoder = AddEncoder(1 << pipe);
+  for (uint32_t i = 0; i < num_planes; i++)
+    AddPlane(1 << pipe, i ? DRM_PLANE_TYPE_OVERLAY : DRM_PLANE_TYPE_PRIMARY,
+             {DRM_FORMAT_ARGB8888, DRM_FORMAT_XRGB8888, DRM_FORMAT_RGB565,
+              DRM_FORMAT_NV12});
+  return AddConnector(encoder, DRM_MODE_CONNECTOR_DSI,
+                      {MakeMode(width, height, refresh)});
+}
+
+void FakeDrmBackend::SetCommitLatency(int64_t latency_ns) {
+  std::lock_guard<std::mutex> lock(lock_);
+  commit_latency_ns_ = latency_ns;
+}
+
+void FakeDrmBackend::SetVBlank(int64_t period_ns, int64_t jitter_ns) {
+  std::lock_guard<std::mutex> lock(lock_);
+  vblank_period_ns_ = period_ns;
+  vblank_jitter_ns_ = jitter_ns;
+}
+
+void FakeDrmBackend::FailNextCommits(uint32_t count, int error) {
+  std::lock_guard<std::mutex> lock(lock_);
+  fail_commits_ = count;
+  fail_error_ = error;
+}
+
+int FakeDrmBackend::SendUevent(const char *event, size_t length) {
+  int fd;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    fd = uevent_fd_;
+  }
+  if (fd < 0)
+    return -ENOTCONN;
+  if (send(fd, event, length, 0) < 0)
+    return -errno;
+  return 0;
+}
+
+int FakeDrmBackend::InjectHotplug(uint32_t connector_id, bool connected) {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    Object *obj = FindObjectLocked(connector_id, DRM_MODE_OBJECT_CONNECTOR);
+    if (!obj)
+      return -ENOENT;
+    obj->connection = connected ? DRM_MODE_CONNECTED : DRM_MODE_DISCONNECTED;
+  }
+  static const char event[] = "DEVTYPE=drm_minor\0HOTPLUG=1";
+  return SendUevent(event, sizeof(event));
+}
+
+int FakeDrmBackend::InjectPanelReset() {
+  static const char event[] = "DEVTYPE=drm_minor\0LCM_DIE=1";
+  return SendUevent(event, sizeof(event));
+}
+
+FakeDrmBackend::CommitStats FakeDrmBackend::GetCommitStats() {
+  std::lock_guard<std::mutex> lock(lock_);
+  return stats_;
+}
+
+void FakeDrmBackend::ResetCommitStats() {
+  std::lock_guard<std::mutex> lock(lock_);
+  stats_ = {};
+}
+
+int FakeDrmBackend::GetPropertyValue(uint32_t object_id, const char *name,
+                                     uint64_t *value) {
+  std::lock_guard<std::mutex> lock(lock_);
+  Object *obj = FindObjectLocked(object_id, DRM_MODE_OBJECT_ANY);
+  if (!obj)
+    return -ENOENT;
+  for (auto prop_id : obj->props) {
+    if (properties_[prop_id].name == name) {
+      *value = obj->values[prop_id];
+      return 0;
+    }
+  }
+  return -ENOENT;
+}
+
+uint64_t FakeDrmBackend::GetVBlankCount() {
+  std::lock_guard<std::mutex> lock(lock_);
+  return vblank_count_;
+}
+
+size_t FakeDrmBackend::GetFramebufferCount() {
+  std::lock_guard<std::mutex> lock(lock_);
+  return framebuffers_.size();
+}
+
+int FakeDrmBackend::WaitIdle(int64_t timeout_ns) {
+  std::unique_lock<std::mutex> lock(lock_);
+  if (!cond_.wait_until(lock, ToTimePoint(Now() + timeout_ns),
+                        [this] { return pending_.empty() || !running_; }))
+    return -ETIMEDOUT;
+  return 0;
+}
+
+int FakeDrmBackend::Open(const char *path) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (path_ != path) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  if (event_fd_ < 0) {
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd_ < 0)
+      return -1;
+  }
+  if (!running_) {
+    running_ = true;
+    vblank_ns_ = Now();
+    vblank_thread_ = std::thread(&FakeDrmBackend::VBlankRoutine, this);
+  }
+  return dup(event_fd_);
+}
+
+int FakeDrmBackend::GetNodeTypeFromFd(int /* fd */) {
+  return DRM_NODE_PRIMARY;
+}
+
+int FakeDrmBackend::SetClientCap(int /* fd */, uint64_t /* capability */,
+                                 uint64_t /* value */) {
+  return 0;
+}
+
+drmModeResPtr FakeDrmBackend::GetResources(int /* fd */) {
+  std::lock_guard<std::mutex> lock(lock_);
+  drmModeResPtr res = (drmModeResPtr)calloc(1, sizeof(*res));
+  if (!res)
+    return NULL;
+  res->count_crtcs = crtcs_.size();
+  res->crtcs = CopyArray(crtcs_);
+  res->count_encoders = encoders_.size();
+  res->encoders = CopyArray(encoders_);
+  res->count_connectors = connectors_.size();
+  res->connectors = CopyArray(connectors_);
+  res->min_width = 0;
+  res->max_width = 8192;
+  res->min_height = 0;
+  res->max_height = 8192;
+  return res;
+}
+
+void FakeDrmBackend::FreeResources(drmModeResPtr res) {
+  if (!res)
+    return;
+  free(res->fbs);
+  free(res->crtcs);
+  free(res->encoders);
+  free(res->connectors);
+  free(res);
+}
+
+drmModeCrtcPtr FakeDrmBackend::GetCrtc(int /* fd */, uint32_t crtc_id) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (!FindObjectLocked(crtc_id, DRM_MODE_OBJECT_CRTC))
+    return NULL;
+  drmModeCrtcPtr crtc = (drmModeCrtcPtr)calloc(1, sizeof(*crtc));
+  if (crtc)
+    crtc->crtc_id = crtc_id;
+  return crtc;
+}
+
+void FakeDrmBackend::FreeCrtc(drmModeCrtcPtr crtc) {
+  free(crtc);
+}
+
+drmModeEncoderPtr FakeDrmBackend::GetEncoder(int /* fd */, uint32_t encoder_id) {
+  std::lock_guard<std::mutex> lock(lock_);
+  Object *obj = FindObjectLocked(encoder_id, DRM_MODE_OBJECT_ENCODER);
+  if (!obj)
+    return NULL;
+  drmModeEncoderPtr encoder = (drmModeEncoderPtr)calloc(1, sizeof(*encoder));
+  if (!encoder)
+    return NULL;
+  encoder->encoder_id = encoder_id;
+  encoder->encoder_type = DRM_MODE_ENCODER_DSI;
+  encoder->possible_crtcs = obj->possible_crtcs;
+  return encoder;
+}
+
+void FakeDrmBackend::FreeEncoder(drmModeEncoderPtr encoder) {
+  free(encoder);
+}
+
+drmModeConnectorPtr FakeDrmBackend::GetConnector(int /* fd */,
+                                                 uint32_t connector_id) {
+  std::lock_guard<std::mutex> lock(lock_);
+  Object *obj = FindObjectLocked(connector_id, DRM_MODE_OBJECT_CONNECTOR);
+  if (!obj)
+    return NULL;
+  drmModeConnectorPtr c = (drmModeConnectorPtr)calloc(1, sizeof(*c));
+  if (!c)
+    return NULL;
+  c->connector_id = connector_id;
+  c->connector_type = obj->connector_type;
+  c->connector_type_id = 1;
+  c->connection = obj->connection;
+  c->subpixel = DRM_MODE_SUBPIXEL_UNKNOWN;
+  if (obj->connection == DRM_MODE_CONNECTED) {
+    c->count_modes = obj->modes.size();
+    c->modes = CopyArray(obj->modes);
+  }
+  std::vector<uint64_t> values;
+  for (auto prop_id : obj->props)
+    values.push_back(obj->values[prop_id]);
+  c->count_props = obj->props.size();
+  c->props = CopyArray(obj->props);
+  c->prop_values = CopyArray(values);
+  if (obj->encoder_id) {
+    c->count_encoders = 1;
+    c->encoders = CopyArray(std::vector<uint32_t>{obj->encoder_id});
+  }
+  return c;
+}
+
+void FakeDrmBackend::FreeConnector(drmModeConnectorPtr connector) {
+  if (!connector)
+    return;
+  free(connector->modes);
+  free(connector->props);
+  free(connector->prop_values);
+  free(connector->encoders);
+  free(connector);
+}
+
+drmModePlaneResPtr FakeDrmBackend::GetPlaneResources(int /* fd */) {
+  std::lock_guard<std::mutex> lock(lock_);
+  drmModePlaneResPtr res = (drmModePlaneResPtr)calloc(1, sizeof(*res));
+  if (!res)
+    return NULL;
+  res->count_planes = planes_.size();
+  res->planes = CopyArray(planes_);
+  return res;
+}
+
+void FakeDrmBackend::FreePlaneResources(drmModePlaneResPtr res) {
+  if (!res)
+    return;
+  free(res->planes);
+  free(res);
+}
+
+drmModePlanePtr FakeDrmBackend::GetPlane(int /* fd */, uint32_t plane_id) {
+  std::lock_guard<std::mutex> lock(lock_);
+  Object *obj = FindObjectLocked(plane_id, DRM_MODE_OBJECT_PLANE);
+  if (!obj)
+    return NULL;
+  drmModePlanePtr plane = (drmModePlanePtr)calloc(1, sizeof(*plane));
+  if (!plane)
+    return NULL;
+  plane->plane_id = plane_id;
+  plane->possible_crtcs = obj->possible_crtcs;
+  plane->count_formats = obj->formats.size();
+  plane->formats = CopyArray(obj->formats);
+  return plane;
+}
+
+void FakeDrmBackend::FreePlane(drmModePlanePtr plane) {
+  if (!plane)
+    return;
+  free(plane->formats);
+  free(plane);
+}
+
+drmModeObjectPropertiesPtr FakeDrmBackend::ObjectGetProperties(
+    int /* fd */, uint32_t object_id, uint32_t object_type) {
+  std::lock_guard<std::mutex> lock(lock_);
+  Object *obj = FindObjectLocked(object_id, object_type);
+  if (!obj)
+    return NULL;
+  drmModeObjectPropertiesPtr props =
+      (drmModeObjectPropertiesPtr)calloc(1, sizeof(*props));
+  if (!props)
+    return NULL;
+  std::vector<uint64_t> values;
+  for (auto prop_id : obj->props)
+    values.push_back(obj->values[prop_id]);
+  props->count_props = obj->props.size();
+  props->props = CopyArray(obj->props);
+  props->prop_values = CopyArray(values);
+  return props;
+}
+
+void FakeDrmBackend::FreeObjectProperties(drmModeObjectPropertiesPtr props) {
+  if (!props)
+    return;
+  free(props->props);
+  free(props->prop_values);
+  free(props);
+}
+
+drmModePropertyPtr FakeDrmBackend::GetProperty(int /* fd */,
+                                               uint32_t property_id) {
+  std::lock_guard<std::mutex> lock(lock_);
+  auto it = properties_.find(property_id);
+  if (it == properties_.end())
+    return NULL;
+  const Property &prop = it->second;
+  drmModePropertyPtr p = (drmModePropertyPtr)calloc(1, sizeof(*p));
+  if (!p)
+    return NULL;
+  p->prop_id = property_id;
+  p->flags = prop.flags;
+  strncpy(p->name, prop.name.c_str(), DRM_PROP_NAME_LEN - 1);
+  p->count_values = prop.values.size();
+  p->values = CopyArray(prop.values);
+  if (!prop.enums.empty()) {
+    p->count_enums = prop.enums.size();
+    p->enums = (struct drm_mode_property_enum *)calloc(prop.enums.size(),
+                                                       sizeof(*p->enums));
+    for (size_t i = 0; p->enums && i < prop.enums.size(); i++) {
+      p->enums[i].value = prop.values[i];
+      strncpy(p->enums[i].name, prop.enums[i].c_str(), DRM_PROP_NAME_LEN - 1);
+    }
+  }
+  return p;
+}
+
+void FakeDrmBackend::FreeProperty(drmModePropertyPtr property) {
+  if (!property)
+    return;
+  free(property->values);
+  free(property->enums);
+  free(property->blob_ids);
+  free(property);
+}
+
+drmModePropertyBlobPtr FakeDrmBackend::GetPropertyBlob(int /* fd */,
+                                                       uint32_t blob_id) {
+  std::lock_guard<std::mutex> lock(lock_);
+  auto it = blobs_.find(blob_id);
+  if (it == blobs_.end())
+    return NULL;
+  drmModePropertyBlobPtr blob = (drmModePropertyBlobPtr)calloc(1, sizeof(*blob));
+  if (!blob)
+    return NULL;
+  blob->id = blob_id;
+  blob->length = it->second.size();
+  blob->data = CopyArray(it->second);
+  return blob;
+}
+
+void FakeDrmBackend::FreePropertyBlob(drmModePropertyBlobPtr blob) {
+  if (!blob)
+    return;
+  free(blob->data);
+  free(blob);
+}
+
+int FakeDrmBackend::CreatePropertyBlob(int /* fd */, const void *data,
+                                       size_t length, uint32_t *blob_id) {
+  if (!data || !length)
+    return -EINVAL;
+  std::lock_guard<std::mutex> lock(lock_);
+  *blob_id = CreateBlobLocked(data, length);
+  return 0;
+}
+
+int FakeDrmBackend::DestroyPropertyBlob(int /* fd */, uint32_t blob_id) {
+  std::lock_guard<std::mutex> lock(lock_);
+  return blobs_.erase(blob_id) ? 0 : -ENOENT;
+}
+
+int FakeDrmBackend::ConnectorSetProperty(int /* fd */, uint32_t connector_id,
+                                         uint32_t property_id, uint64_t value) {
+  std::lock_guard<std::mutex> lock(lock_);
+  Object *obj = FindObjectLocked(connector_id, DRM_MODE_OBJECT_CONNECTOR);
+  if (!obj || !obj->values.count(property_id))
+    return -EINVAL;
+  obj->values[property_id] = value;
+  return 0;
+}
+
+int FakeDrmBackend::CreateFenceLocked(uint64_t seqno) {
+  int fd = eventfd(0, EFD_CLOEXEC);
+  if (fd < 0)
+    return -1;
+  int out = dup(fd);
+  if (out < 0) {
+    close(fd);
+    return -1;
+  }
+  fences_.push_back(std::make_pair(seqno, fd));
+  return out;
+}
+
+void FakeDrmBackend::SignalFencesLocked() {
+  for (auto it = fences_.begin(); it != fences_.end();) {
+    if (it->first > latched_seqno_) {
+      ++it;
+      continue;
+    }
+    uint64_t signal = 1;
+    if (write(it->second, &signal, sizeof(signal)) < 0)
+      ALOGE("Failed to signal fence %d", errno);
+    close(it->second);
+    it = fences_.erase(it);
+  }
+}
+
+int FakeDrmBackend::AtomicCommit(int /* fd */, const DrmAtomicRequest &req,
+                                 uint32_t flags, void *user_data) {
+  std::unique_lock<std::mutex> lock(lock_);
+  if (fail_commits_) {
+    fail_commits_--;
+    stats_.failed_commits++;
+    return fail_error_;
+  }
+
+  const std::vector<DrmAtomicRequest::Item> &items = req.items();
+  bool modeset = false;
+  for (const DrmAtomicRequest::Item &item : items) {
+    Object *obj = FindObjectLocked(item.object_id, DRM_MODE_OBJECT_ANY);
+    if (!obj) {
+      stats_.failed_commits++;
+      return -ENOENT;
+    }
+    auto value = obj->values.find(item.property_id);
+    if (value == obj->values.end() ||
+        (properties_[item.property_id].flags & DRM_MODE_PROP_IMMUTABLE)) {
+      stats_.failed_commits++;
+      return -EINVAL;
+    }
+
+    const Property &prop = properties_[item.property_id];
+    if ((prop.flags & DRM_MODE_PROP_BLOB) && item.value &&
+        !blobs_.count(item.value)) {
+      stats_.failed_commits++;
+      return -EINVAL;
+    }
+    if (prop.name == "FB_ID" && item.value && !framebuffers_.count(item.value)) {
+      stats_.failed_commits++;
+      return -ENOENT;
+    }
+    if ((prop.name == "ACTIVE" || prop.name == "MODE_ID" ||
+         (obj->type == DRM_MODE_OBJECT_CONNECTOR && prop.name == "CRTC_ID")) &&
+        value->second != item.value)
+      modeset = true;
+  }
+
+  if (modeset && !(flags & DRM_MODE_ATOMIC_ALLOW_MODESET)) {
+    stats_.failed_commits++;
+    return -EINVAL;
+  }
+
+  if (flags & DRM_MODE_ATOMIC_TEST_ONLY) {
+    stats_.test_commits++;
+    return 0;
+  }
+
+  if ((flags & DRM_MODE_ATOMIC_NONBLOCK) && !pending_.empty())
+    return -EBUSY;
+
+  uint32_t count = items.size();
+  stats_.commits++;
+  stats_.properties += count;
+  stats_.last_properties = count;
+  if (count > stats_.max_properties)
+    stats_.max_properties = count;
+
+  uint64_t seqno = ++commit_seqno_;
+  for (const DrmAtomicRequest::Item &item : items) {
+    const Property &prop = properties_[item.property_id];
+    size_t len = prop.name.size();
+    if (len >= strlen("OUT_FENCE_PTR") &&
+        prop.name.compare(len - strlen("OUT_FENCE_PTR"), std::string::npos,
+                          "OUT_FENCE_PTR") == 0 &&
+        item.value) {
+      // The kernel writes an s32 fd to the user pointer
+      *(int32_t *)(uintptr_t)item.value = CreateFenceLocked(seqno);
+    }
+    objects_[item.object_id].values[item.property_id] = item.value;
+  }
+
+  pending_.push_back({Now() + commit_latency_ns_, seqno,
+                      (flags & DRM_MODE_PAGE_FLIP_EVENT) != 0, user_data});
+
+  if (!(flags & DRM_MODE_ATOMIC_NONBLOCK))
+    cond_.wait(lock, [&] { return latched_seqno_ >= seqno || !running_; });
+  return 0;
+}
+
+void FakeDrmBackend::OnVBlankLocked(int64_t timestamp_ns) {
+  vblank_count_++;
+  vblank_ns_ = timestamp_ns;
+
+  bool queued = false;
+  while (!pending_.empty() && pending_.front().ready_ns <= timestamp_ns) {
+    const PendingCommit &commit = pending_.front();
+    latched_seqno_ = commit.seqno;
+    if (commit.event) {
+      events_.push_back({vblank_count_, timestamp_ns, commit.user_data});
+      queued = true;
+    }
+    pending_.pop_front();
+  }
+  SignalFencesLocked();
+
+  if (queued) {
+    uint64_t signal = 1;
+    if (write(event_fd_, &signal, sizeof(signal)) < 0)
+      ALOGE("Failed to queue page flip event %d", errno);
+  }
+  cond_.notify_all();
+}
+
+void FakeDrmBackend::VBlankRoutine() {
+  std::unique_lock<std::mutex> lock(lock_);
+  // Vblanks are on the ideal grid moved by jitter, so jitter doesn't drift
+  int64_t ideal_ns = vblank_ns_;
+  while (running_) {
+    ideal_ns += vblank_period_ns_;
+    int64_t next_ns = ideal_ns;
+    if (vblank_jitter_ns_ > 0) {
+      std::uniform_int_distribution<int64_t> jitter(-vblank_jitter_ns_,
+                                                    vblank_jitter_ns_);
+      next_ns += jitter(jitter_rng_);
+    }
+    next_ns = std::max(next_ns, vblank_ns_ + 1);
+
+    cond_.wait_until(lock, ToTimePoint(next_ns), [&] {
+      return !running_ || Now() >= next_ns;
+    });
+    if (!running_)
+      break;
+    OnVBlankLocked(Now());
+  }
+}
+
+int FakeDrmBackend::WaitVBlank(int /* fd */, drmVBlankPtr vbl) {
+  std::unique_lock<std::mutex> lock(lock_);
+  if (!running_)
+    return -EINVAL;
+
+  uint64_t target = vbl->request.sequence;
+  if (vbl->request.type & DRM_VBLANK_RELATIVE)
+    target += vblank_count_;
+  cond_.wait(lock, [&] { return vblank_count_ >= target || !running_; });
+  if (!running_)
+    return -EINTR;
+
+  vbl->reply.sequence = vblank_count_;
+  vbl->reply.tval_sec = vblank_ns_ / kOneSecondNs;
+  vbl->reply.tval_usec = (vblank_ns_ % kOneSecondNs) / 1000;
+  return 0;
+}
+
+int FakeDrmBackend::HandleEvent(int /* fd */, drmEventContextPtr context) {
+  std::deque<FlipEvent> events;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    uint64_t count;
+    if (read(event_fd_, &count, sizeof(count)) < 0 && errno != EAGAIN)
+      return -errno;
+    events.swap(events_);
+  }
+
+  for (auto &e : events) {
+    if (context->page_flip_handler)
+      context->page_flip_handler(event_fd_, e.sequence,
+                                 e.timestamp_ns / kOneSecondNs,
+                                 (e.timestamp_ns % kOneSecondNs) / 1000,
+                                 e.user_data);
+  }
+  return 0;
+}
+
+int FakeDrmBackend::OpenUevent() {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds))
+    return -errno;
+
+  std::lock_guard<std::mutex> lock(lock_);
+  if (uevent_fd_ >= 0)
+    close(uevent_fd_);
+  uevent_fd_ = fds[1];
+  return fds[0];
+}
+
+int FakeDrmBackend::PrimeFDToHandle(int /* fd */, int prime_fd,
+                                    uint32_t *handle) {
+  if (prime_fd < 0)
+    return -EINVAL;
+  std::lock_guard<std::mutex> lock(lock_);
+  *handle = next_handle_++;
+  return 0;
+}
+
+int FakeDrmBackend::CloseBufferHandle(int /* fd */, uint32_t /* handle */) {
+  return 0;
+}
+
+int FakeDrmBackend::AddFB2WithModifiers(
+    int /* fd */, uint32_t width, uint32_t height, uint32_t /* pixel_format */,
+    const uint32_t bo_handles[4], const uint32_t /* pitches */[4],
+    const uint32_t /* offsets */[4], const uint64_t /* modifier */[4],
+    uint32_t *buf_id, uint32_t /* flags */) {
+  if (!width || !height || !bo_handles[0])
+    return -EINVAL;
+  std::lock_guard<std::mutex> lock(lock_);
+  *buf_id = AddObject(DRM_MODE_OBJECT_FB);
+  framebuffers_[*buf_id] = bo_handles[0];
+  return 0;
+}
+
+int FakeDrmBackend::RmFB(int /* fd */, uint32_t buf_id) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (!framebuffers_.erase(buf_id))
+    return -ENOENT;
+  objects_.erase(buf_id);
+  return 0;
+}
+}  // namespace android
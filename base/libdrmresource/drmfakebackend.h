@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_DRM_FAKE_BACKEND_H_
+#define ANDROID_DRM_FAKE_BACKEND_H_
+
+#include "drmbackend.h"
+
+#include <errno.h>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace android {
+
+// In-process DRM/KMS device for running libdrmresource and the DRM display
+// interface without a kernel driver. Objects are scripted with the Add*()
+// calls before DrmDevice::Init(). Atomic commits are latched on the next
+// vblank after the commit latency, then the page flip event is queued and the
+// out-fences, which are eventfds, are signaled like a sw_sync timeline.
+class FakeDrmBackend : public DrmBackend {
+ public:
+  struct CommitStats {
+    uint64_t commits;
+    uint64_t failed_commits;
+    uint64_t test_commits;
+    uint64_t properties;
+    uint32_t last_properties;
+    uint32_t max_properties;
+  };
+
+  explicit FakeDrmBackend(const char *path = "/dev/dri/card0");
+  ~FakeDrmBackend() override;
+
+  // Scripting, returns the id of the new object
+  uint32_t AddCrtc();
+  uint32_t AddEncoder(uint32_t possible_crtcs);
+  uint32_t AddConnector(uint32_t encoder_id, uint32_t type,
+                        const std::vector<drmModeModeInfo> &modes);
+  uint32_t AddPlane(uint32_t possible_crtcs, uint32_t type,
+                    const std::vector<uint32_t> &formats);
+  // Range property
+  uint32_t AddProperty(uint32_t object_id, const char *name, uint64_t value,
+                       uint64_t min = 0, uint64_t max = UINT64_MAX);
+  uint32_t AddEnumProperty(uint32_t object_id, const char *name,
+                           const std::vector<std::string> &enums,
+                           uint64_t value = 0);
+  uint32_t AddBlobProperty(uint32_t object_id, const char *name,
+                           const void *data, size_t length);
+  // A crtc, an encoder and a DSI connector with one mode and num_planes planes.
+  // Returns the connector id.
+  uint32_t AddDisplay(uint32_t width, uint32_t height, uint32_t refresh,
+                      uint32_t num_planes);
+  static drmModeModeInfo MakeMode(uint32_t width, uint32_t height,
+                                  uint32_t refresh);
+
+  // Injection
+  void SetCommitLatency(int64_t latency_ns);
+  void SetVBlank(int64_t period_ns, int64_t jitter_ns);
+  void FailNextCommits(uint32_t count, int error);
+  int InjectHotplug(uint32_t connector_id, bool connected);
+  int InjectPanelReset();
+
+  // Observation
+  CommitStats GetCommitStats();
+  void ResetCommitStats();
+  int GetPropertyValue(uint32_t object_id, const char *name, uint64_t *value);
+  uint64_t GetVBlankCount();
+  size_t GetFramebufferCount();
+  // Waits until every queued commit is latched
+  int WaitIdle(int64_t timeout_ns);
+
+  int Open(const char *path) override;
+  int GetNodeTypeFromFd(int fd) override;
+  int SetClientCap(int fd, uint64_t capability, uint64_t value) override;
+
+  drmModeResPtr GetResources(int fd) override;
+  void FreeResources(drmModeResPtr res) override;
+  drmModeCrtcPtr GetCrtc(int fd, uint32_t crtc_id) override;
+  void FreeCrtc(drmModeCrtcPtr crtc) override;
+  drmModeEncoderPtr GetEncoder(int fd, uint32_t encoder_id) override;
+  void FreeEncoder(drmModeEncoderPtr encoder) override;
+  drmModeConnectorPtr GetConnector(int fd, uint32_t connector_id) override;
+  void FreeConnector(drmModeConnectorPtr connector) override;
+  drmModePlaneResPtr GetPlaneResources(int fd) override;
+  void FreePlaneResources(drmModePlaneResPtr res) override;
+  drmModePlanePtr GetPlane(int fd, uint32_t plane_id) override;
+  void FreePlane(drmModePlanePtr plane) override;
+
+  drmModeObjectPropertiesPtr ObjectGetProperties(int fd, uint32_t object_id,
+                                                 uint32_t object_type) override;
+  void FreeObjectProperties(drmModeObjectPropertiesPtr props) override;
+  drmModePropertyPtr GetProperty(int fd, uint32_t property_id) override;
+  void FreeProperty(drmModePropertyPtr property) override;
+  drmModePropertyBlobPtr GetPropertyBlob(int fd, uint32_t blob_id) override;
+  void FreePropertyBlob(drmModePropertyBlobPtr blob) override;
+  int CreatePropertyBlob(int fd, const void *data, size_t length,
+                         uint32_t *blob_id) override;
+  int DestroyPropertyBlob(int fd, uint32_t blob_id) override;
+  int ConnectorSetProperty(int fd, uint32_t connector_id, uint32_t property_id,
+                           uint64_t value) override;
+
+  int AtomicCommit(int fd, const DrmAtomicRequest &req, uint32_t flags,
+                   void *user_data) override;
+  int WaitVBlank(int fd, drmVBlankPtr vbl) override;
+  int HandleEvent(int fd, drmEventContextPtr context) override;
+  int OpenUevent() override;
+
+  int PrimeFDToHandle(int fd, int prime_fd, uint32_t *handle) override;
+  int CloseBufferHandle(int fd, uint32_t handle) override;
+  int AddFB2WithModifiers(int fd, uint32_t width, uint32_t height,
+                          uint32_t pixel_format, const uint32_t bo_handles[4],
+                          const uint32_t pitches[4], const uint32_t offsets[4],
+                          const uint64_t modifier[4], uint32_t *buf_id,
+                          uint32_t flags) override;
+  int RmFB(int fd, uint32_t buf_id) override;
+
+ private:
+  struct Property {
+    std::string name;
+    uint32_t flags;
+    std::vector<uint64_t> values;
+    std::vector<std::string> enums;
+  };
+
+  struct Object {
+    uint32_t type;
+    // Property ids in the order they were added
+    std::vector<uint32_t> props;
+    std::map<uint32_t, uint64_t> values;
+
+    // Encoder and plane
+    uint32_t possible_crtcs;
+    // Connector
+    uint32_t encoder_id;
+    uint32_t connector_type;
+    drmModeConnection connection;
+    std::vector<drmModeModeInfo> modes;
+    // Plane
+    std::vector<uint32_t> formats;
+  };
+
+  struct PendingCommit {
+    int64_t ready_ns;
+    uint64_t seqno;
+    bool event;
+    void *user_data;
+  };
+
+  struct FlipEvent {
+    uint64_t sequence;
+    int64_t timestamp_ns;
+    void *user_data;
+  };
+
+  uint32_t AddObject(uint32_t type);
+  uint32_t AddPropertyLocked(uint32_t object_id, const char *name,
+                             uint32_t flags, const std::vector<uint64_t> &values,
+                             const std::vector<std::string> &enums,
+                             uint64_t value);
+  uint32_t CreateBlobLocked(const void *data, size_t length);
+  Object *FindObjectLocked(uint32_t id, uint32_t type);
+  int CreateFenceLocked(uint64_t seqno);
+  void SignalFencesLocked();
+  void OnVBlankLocked(int64_t timestamp_ns);
+  void VBlankRoutine();
+  int SendUevent(const char *event, size_t length);
+
+  std::string path_;
+  std::mutex lock_;
+  std::condition_variable cond_;
+  std::thread vblank_thread_;
+  bool running_ = false;
+
+  uint32_t next_id_ = 1;
+  std::map<uint32_t, Object> objects_;
+  // Objects of the same type share a property with the same name
+  std::map<std::pair<uint32_t, std::string>, uint32_t> property_ids_;
+  std::map<uint32_t, Property> properties_;
+  std::map<uint32_t, std::vector<uint8_t>> blobs_;
+  std::vector<uint32_t> crtcs_;
+  std::vector<uint32_t> encoders_;
+  std::vector<uint32_t> connectors_;
+  std::vector<uint32_t> planes_;
+  std::map<uint32_t, uint32_t> framebuffers_;
+  uint32_t next_handle_ = 1;
+
+  // The drm fd is a dup of event_fd_, it is readable when events_ is not empty
+  int event_fd_ = -1;
+  std::deque<FlipEvent> events_;
+  int uevent_fd_ = -1;
+
+  int64_t commit_latency_ns_ = 0;
+  int64_t vblank_period_ns_ = 16666667;
+  int64_t vblank_jitter_ns_ = 0;
+  std::mt19937 jitter_rng_;
+  uint64_t vblank_count_ = 0;
+  int64_t vblank_ns_ = 0;
+
+  uint32_t fail_commits_ = 0;
+  int fail_error_ = -EINVAL;
+  CommitStats stats_ = {};
+
+  std::deque<PendingCommit> pending_;
+  uint64_t commit_seqno_ = 0;
+  // Timeline value, commits up to this seqno are on the screen
+  uint64_t latched_seqno_ = 0;
+  std::vector<std::pair<uint64_t, int>> fences_;
+};
+}  // namespace android
+
+#endif  // ANDROID_DRM_FAKE_BACKEND_H_
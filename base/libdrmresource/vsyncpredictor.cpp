@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "hwc-vsync-predictor"
+
+#include "vsyncpredictor.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#include <log/log.h>
+
+namespace android {
+
+// Number of timestamps the model is fitted to
+static const size_t kHistorySize = 20;
+static const size_t kMinSamples = 6;
+// A timestamp farther than this from the timeline is an outlier
+static const int64_t kOutlierPercent = 25;
+// The model restarts after this many outliers in a row
+static const uint32_t kMaxConsecutiveOutliers = 3;
+// Fitted period must be this close to the nominal period
+static const int64_t kMaxPeriodDeviationPercent = 20;
+// The phase of the model is not trusted after this many periods without a
+// timestamp, e.g. while vsync is disabled
+static const int64_t kMaxStalePeriods = 10;
+
+void VSyncPredictor::SetPeriod(int64_t period_ns) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (period_ns == nominal_period_)
+    return;
+  nominal_period_ = period_ns;
+  ResetLocked();
+}
+
+void VSyncPredictor::Reset() {
+  std::lock_guard<std::mutex> lock(lock_);
+  ResetLocked();
+}
+
+void VSyncPredictor::ResetLocked() {
+  if (!timestamps_.empty())
+    resets_++;
+  timestamps_.clear();
+  consecutive_outliers_ = 0;
+  valid_ = false;
+}
+
+bool VSyncPredictor::IsStaleLocked(int64_t time_ns) const {
+  return !timestamps_.empty() &&
+         time_ns - timestamps_.back() > kMaxStalePeriods * nominal_period_;
+}
+
+bool VSyncPredictor::GetTimelineLocked(int64_t *base, double *period) const {
+  if (valid_) {
+    *base = phase_;
+    *period = period_;
+    return true;
+  }
+  if (nominal_period_ <= 0)
+    return false;
+  *base = timestamps_.empty() ? 0 : timestamps_.back();
+  *period = nominal_period_;
+  return !timestamps_.empty();
+}
+
+bool VSyncPredictor::AddTimestamp(int64_t timestamp_ns) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (nominal_period_ <= 0)
+    return false;
+  if (IsStaleLocked(timestamp_ns))
+    ResetLocked();
+
+  int64_t base;
+  double period;
+  if (GetTimelineLocked(&base, &period)) {
+    double ordinal = round((timestamp_ns - base) / period);
+    int64_t error = timestamp_ns - base - (int64_t)llround(ordinal * period);
+    bool outlier = llabs(error) > (int64_t)(period * kOutlierPercent / 100) ||
+                   timestamp_ns <= timestamps_.back();
+    if (outlier) {
+      outliers_++;
+      if (++consecutive_outliers_ < kMaxConsecutiveOutliers)
+        return false;
+      ALOGI("Vsync timeline moved, restart the model");
+      ResetLocked();
+    } else if (valid_) {
+      samples_++;
+      error_sum_ += llabs(error);
+      max_error_ = std::max(max_error_, (int64_t)llabs(error));
+    }
+  }
+
+  consecutive_outliers_ = 0;
+  timestamps_.push_back(timestamp_ns);
+  if (timestamps_.size() > kHistorySize)
+    timestamps_.pop_front();
+  FitLocked();
+  return true;
+}
+
+void VSyncPredictor::FitLocked() {
+  if (timestamps_.size() < kMinSamples) {
+    valid_ = false;
+    return;
+  }
+
+  // Least squares of timestamp = phase + ordinal * period, relative to the
+  // oldest timestamp to keep the precision
+  int64_t origin = timestamps_.front();
+  double ref_period = valid_ ? period_ : nominal_period_;
+  double mean_x = 0, mean_y = 0;
+  std::vector<double> x, y;
+  for (int64_t ts : timestamps_) {
+    x.push_back(round((ts - origin) / ref_period));
+    y.push_back(ts - origin);
+    mean_x += x.back();
+    mean_y += y.back();
+  }
+  mean_x /= x.size();
+  mean_y /= y.size();
+
+  double sxx = 0, sxy = 0;
+  for (size_t i = 0; i < x.size(); i++) {
+    sxx += (x[i] - mean_x) * (x[i] - mean_x);
+    sxy += (x[i] - mean_x) * (y[i] - mean_y);
+  }
+  if (sxx == 0) {
+    valid_ = false;
+    return;
+  }
+
+  double period = sxy / sxx;
+  if (fabs(period - nominal_period_) >
+      nominal_period_ * kMaxPeriodDeviationPercent / 100.0) {
+    valid_ = false;
+    return;
+  }
+
+  valid_ = true;
+  period_ = period;
+  phase_ = origin + llround(mean_y - period * mean_x);
+}
+
+int64_t VSyncPredictor::PredictNextVSync(int64_t time_ns) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  int64_t base;
+  double period;
+  if (IsStaleLocked(time_ns) || !GetTimelineLocked(&base, &period))
+    return nominal_period_ > 0 ? time_ns + nominal_period_ : 0;
+
+  double ordinal = floor((time_ns - base) / period) + 1;
+  return base + llround(ordinal * period);
+}
+
+int64_t VSyncPredictor::period() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return valid_ ? llround(period_) : nominal_period_;
+}
+
+bool VSyncPredictor::HasModel() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return valid_;
+}
+
+VSyncPredictor::Stats VSyncPredictor::GetStats() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  Stats stats;
+  stats.samples = samples_;
+  stats.outliers = outliers_;
+  stats.resets = resets_;
+  stats.mean_error_ns = samples_ ? (int64_t)(error_sum_ / samples_) : 0;
+  stats.max_error_ns = max_error_;
+  return stats;
+}
+
+std::string VSyncPredictor::Dump() const {
+  Stats stats = GetStats();
+  std::lock_guard<std::mutex> lock(lock_);
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "Vsync model: %s, period(%.3f ms), nominal(%.3f ms), "
+           "phase(%" PRId64 "), history(%zu)\n"
+           "\terror mean(%" PRId64 " us), max(%" PRId64 " us), "
+           "samples(%" PRIu64 "), outliers(%" PRIu64 "), resets(%" PRIu64 ")\n",
+           valid_ ? "fitted" : "nominal", (valid_ ? period_ : nominal_period_) / 1e6,
+           nominal_period_ / 1e6, phase_, timestamps_.size(),
+           stats.mean_error_ns / 1000, stats.max_error_ns / 1000, stats.samples,
+           stats.outliers, stats.resets);
+  return buf;
+}
+}  // namespace android
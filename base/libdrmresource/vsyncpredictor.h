@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_VSYNC_PREDICTOR_H_
+#define ANDROID_VSYNC_PREDICTOR_H_
+
+#include <stdint.h>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace android {
+
+// Fits period and phase of the vsync timeline to the last vblank timestamps
+// with a linear regression. Timestamps that are far from the fitted timeline
+// are rejected, and the model restarts when they keep coming (mode switch or
+// a phase change of the panel), when the nominal period is changed or when the
+// last timestamp is too old.
+class VSyncPredictor {
+ public:
+  struct Stats {
+    uint64_t samples;
+    uint64_t outliers;
+    uint64_t resets;
+    // Absolute error of the prediction of accepted timestamps
+    int64_t mean_error_ns;
+    int64_t max_error_ns;
+  };
+
+  // Nominal period of the active mode, the model is reset if it changes
+  void SetPeriod(int64_t period_ns);
+  void Reset();
+  // Returns false if the timestamp is rejected as an outlier
+  bool AddTimestamp(int64_t timestamp_ns);
+
+  // First vsync after time, or 0 if no period is known. It is one nominal
+  // period after time if the last timestamp is too old.
+  int64_t PredictNextVSync(int64_t time_ns) const;
+  // Fitted period, or the nominal period until there are enough samples
+  int64_t period() const;
+  bool HasModel() const;
+  Stats GetStats() const;
+  std::string Dump() const;
+
+ private:
+  void ResetLocked();
+  void FitLocked();
+  bool IsStaleLocked(int64_t time_ns) const;
+  bool GetTimelineLocked(int64_t *base, double *period) const;
+
+  mutable std::mutex lock_;
+  int64_t nominal_period_ = 0;
+  std::deque<int64_t> timestamps_;
+  uint32_t consecutive_outliers_ = 0;
+
+  bool valid_ = false;
+  double period_ = 0;
+  int64_t phase_ = 0;
+
+  uint64_t samples_ = 0;
+  uint64_t outliers_ = 0;
+  uint64_t resets_ = 0;
+  uint64_t error_sum_ = 0;
+  int64_t max_error_ = 0;
+};
+}  // namespace android
+
+#endif  // ANDROID_VSYNC_PREDICTOR_H_
@@ -64,6 +64,14 @@ void VSyncWorker::VSyncControl(bool enabled) {
   Signal();
 }
 
+void VSyncWorker::SetVSyncPeriod(int64_t period_ns) {
+  predictor_.SetPeriod(period_ns);
+}
+
+int64_t VSyncWorker::PredictNextVSync(int64_t time_ns) const {
+  return predictor_.PredictNextVSync(time_ns);
+}
+
 /*
  * Returns the timestamp of the next vsync in phase with last_timestamp_.
  * For example:
@@ -144,7 +152,7 @@ void VSyncWorker::Routine() {
   vblank.request.sequence = 1;
 
   int64_t timestamp;
-  ret = drmWaitVBlank(drm_->fd(), &vblank);
+  ret = drm_->backend().WaitVBlank(drm_->fd(), &vblank);
   if (ret == -EINTR) {
     return;
   } else if (ret) {
@@ -154,6 +162,7 @@ void VSyncWorker::Routine() {
   } else {
     timestamp = (int64_t)vblank.reply.tval_sec * kOneSecondNs +
                 (int64_t)vblank.reply.tval_usec * 1000;
+    predictor_.AddTimestamp(timestamp);
   }
 
   /*
@@ -18,6 +18,7 @@
 #define ANDROID_EVENT_WORKER_H_
 
 #include "drmdevice.h"
+#include "vsyncpredictor.h"
 #include "worker.h"
 
 #include <stdint.h>
@@ -45,6 +46,13 @@ class VSyncWorker : public Worker {
 
   void VSyncControl(bool enabled);
 
+  // Vsync timeline fitted to the kernel vblank timestamps
+  void SetVSyncPeriod(int64_t period_ns);
+  int64_t PredictNextVSync(int64_t time_ns) const;
+  const VSyncPredictor &predictor() const {
+    return predictor_;
+  }
+
  protected:
   void Routine() override;
 
@@ -59,6 +67,7 @@ class VSyncWorker : public Worker {
   int display_;
   std::atomic_bool enabled_;
   int64_t last_timestamp_;
+  VSyncPredictor predictor_;
 };
 }  // namespace android
 
@@ -89,11 +89,18 @@ LOCAL_SRC_FILES := \
 	virtualdisplay/ExynosVirtualDisplay.cpp \
 	virtualdisplay/ExynosVirtualDisplayFbInterface.cpp \
 	resources/ExynosMPP.cpp \
+	resources/ExynosMPPBufferPool.cpp \
+	utils/ExynosDamageRegion.cpp \
+	utils/ExynosFenceReactor.cpp \
 	utils/ExynosFenceTracer.cpp \
 	utils/ExynosHWCDebug.cpp \
 	utils/ExynosHWCFormat.cpp \
 	utils/ExynosHWCHelper.cpp \
-	utils/OneShotTimer.cpp
+	utils/ExynosPresentScheduler.cpp \
+	utils/ExynosRecompPolicy.cpp \
+	utils/LatencyHistogram.cpp \
+	utils/OneShotTimer.cpp \
+	utils/WorkerPool.cpp
 
 LOCAL_EXPORT_SHARED_LIBRARY_HEADERS += libacryl libdrm
 LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_C_INCLUDES)
@@ -307,9 +314,81 @@ LOCAL_SRC_FILES := \
 	unittests/main.cpp \
     unittests/HwcUnitTest.cpp
 
+# HWC3 frontend is linked to test the calls that it forwards to the HAL
+LOCAL_SRC_FILES += ../hwc3/impl/HalImpl.cpp
+LOCAL_C_INCLUDES += \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/hwc3 \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/hwc3/impl
+LOCAL_SHARED_LIBRARIES += android.hardware.graphics.composer3-V1-ndk libbase libbinder_ndk
+LOCAL_STATIC_LIBRARIES += libaidlcommonsupport libdrmresource_fake
+LOCAL_HEADER_LIBRARIES += android.hardware.graphics.composer3-command-buffer
+
 LOCAL_CFLAGS += -Wno-unused-parameter
 LOCAL_CFLAGS += -Wno-unused-variable
 LOCAL_MODULE := hwcomposer_unittest
 
 include $(TOP)/hardware/samsung_slsi-linaro/graphics/base/BoardConfigCFlags.mk
 include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_PROPRIETARY_MODULE := true
+
+LOCAL_SHARED_LIBRARIES := liblog libcutils libutils libexynosdisplay libacryl \
+                          libui libion libdrmresource
+
+LOCAL_HEADER_LIBRARIES := libhardware_legacy_headers libbinder_headers libexynos_headers
+
+LOCAL_CFLAGS := -DHLOG_CODE=0
+LOCAL_CFLAGS += -DLOG_TAG=\"hwcomposer_simulator\"
+
+LOCAL_C_INCLUDES += \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libhwc2.1/simulator \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libhwc2.1/device \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libhwc2.1/utils \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libhwc2.1/display \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libhwc2.1/resources \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libhwc2.1/primarydisplay \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libhwc2.1/externaldisplay \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libhwc2.1/virtualdisplay \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libhwc2.1/driver_header \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/$(TARGET_SOC_BASE)/libhwc2.1 \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/$(TARGET_SOC_BASE)/libhwc2.1/device \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/$(TARGET_SOC_BASE)/libhwc2.1/utils \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/$(TARGET_SOC_BASE)/libhwc2.1/display \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/$(TARGET_SOC_BASE)/libhwc2.1/resources \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/$(TARGET_SOC_BASE)/libhwc2.1/primarydisplay \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/$(TARGET_SOC_BASE)/libhwc2.1/externaldisplay \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/$(TARGET_SOC_BASE)/libhwc2.1/virtualdisplay \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libhwc2.1/libhwcService \
+	$(TOP)/hardware/samsung_slsi-linaro/graphics/base/libdrmresource
+
+LOCAL_HEADER_LIBRARIES += libhdrinterface_header libhdr10p_meta_interface_header
+ifdef BOARD_LIBHDR_PLUGIN
+    LOCAL_SHARED_LIBRARIES += $(BOARD_LIBHDR_PLUGIN)
+endif
+ifdef BOARD_LIBHDR10P_META_PLUGIN
+    LOCAL_SHARED_LIBRARIES += $(BOARD_LIBHDR10P_META_PLUGIN)
+endif
+
+ifeq ($(BOARD_USES_DQE_INTERFACE), true)
+LOCAL_SHARED_LIBRARIES += libdqeInterface
+LOCAL_HEADER_LIBRARIES += libdqeInterface_headers
+endif
+
+ifeq ($(BOARD_USES_DISPLAY_COLOR_INTERFACE), true)
+LOCAL_SHARED_LIBRARIES += libdisplaycolor_default
+LOCAL_HEADER_LIBRARIES += libdisplaycolor_interface
+endif
+
+LOCAL_SRC_FILES := \
+	simulator/HwcSimulator.cpp
+
+LOCAL_CFLAGS += -Wno-unused-parameter
+LOCAL_MODULE := hwcomposer_simulator
+LOCAL_MODULE_TAGS := optional
+
+include $(TOP)/hardware/samsung_slsi-linaro/graphics/base/BoardConfigCFlags.mk
+include $(BUILD_EXECUTABLE)
@@ -28,6 +28,7 @@
 #include "ExynosVirtualDisplayModule.h"
 #include "ExynosHWCDebug.h"
 #include "ExynosFenceTracer.h"
+#include "ExynosFenceReactor.h"
 #include "ExynosDeviceFbInterface.h"
 #include "ExynosDeviceDrmInterface.h"
 #include <sync/sync.h>
@@ -97,6 +98,9 @@ ExynosDevice::ExynosDevice()
     exynosHWCControl.fenceTracer = 0;
     exynosHWCControl.sysFenceLogging = false;
     exynosHWCControl.usePerfFile = false;
+    exynosHWCControl.compositionPlanner = 0;
+    exynosHWCControl.parallelValidate = false;
+    exynosHWCControl.presentScheduler = true;
 
     /* Initialize pre defined format */
     PredefinedFormat::init();
@@ -246,6 +250,8 @@ ExynosDevice::ExynosDevice()
             mResourceManager->getM2mMPP(i)->registerBufDestoryedCallback(
                 [=](const uint64_t &bufferId) { ExynosDisplayInterface::removeBuffer(bufferId); });
         }
+        mResourceManager->getDstBufPool().registerBufDestoryedCallback(
+            [=](const uint64_t &bufferId) { ExynosDisplayInterface::removeBuffer(bufferId); });
     }
 
     mResourceManager->initDisplaysTDMInfo();
@@ -419,6 +425,7 @@ void ExynosDevice::initDeviceInterface(uint32_t interfaceType) {
         mDisplays[i]->initDisplayInterface(interfaceType,
                                            deviceData, deviceDataSize);
         mDisplays[i]->mDisplayInterface->setDeviceToDisplayInterface(initData);
+        mDisplays[i]->mDisplayInterface->setLatencyRecorder(&mDisplays[i]->mLatencyRecorder);
     }
 
     free(deviceData);
@@ -629,6 +636,7 @@ void ExynosDevice::registerRestrictions() {
 
     /* It's implmented in each module */
     mResourceManager->setVirtualOtfMPPsRestrictions();
+    mResourceManager->updateCapabilityTables();
     for (size_t i = 0; i < mDisplays.size(); i++)
         mResourceManager->checkAttrMPP(mDisplays[i]);
     /* Checking whether WCG is supported or not
@@ -680,6 +688,22 @@ void ExynosDevice::dump(uint32_t *outSize, char *outBuffer) {
             display->dump(result);
     }
 
+    result.append("\n");
+    mResourceManager->dumpAssignResultCache(result);
+    mResourceManager->dumpCompositionPlanner(result);
+    mResourceManager->dumpStaticLayerFlattening(result);
+    mResourceManager->dumpDstBufPool(result);
+    mResourceManager->dumpPerformanceRequests(result);
+    ExynosFenceReactor::getInstance().dump(result);
+    result.appendFormat("Parallel validate: enabled(%d), frames(%" PRIu64 "), reassigned(%" PRIu64 ")\n",
+                        exynosHWCControl.parallelValidate, mParallelValidateCount,
+                        mParallelReassignCount);
+    if (mDeviceInterface != nullptr)
+        mDeviceInterface->dump(result);
+
+    result.append("\n");
+    dumpLatencyHistogram(-1, false, result);
+
     if (outBuffer == NULL) {
         *outSize = (uint32_t)result.length();
     } else {
@@ -950,6 +974,23 @@ void ExynosDevice::setHWCControl(uint32_t display, uint32_t ctrl, int32_t val) {
         ALOGI("%s::HWC_CTL_USE_PERF_FILE on/off=%d", __func__, val);
         exynosHWCControl.usePerfFile = (unsigned int)val;
         break;
+    case HWC_CTL_COMPOSITION_PLANNER:
+        ALOGI("%s::HWC_CTL_COMPOSITION_PLANNER budget=%d", __func__, val);
+        exynosHWCControl.compositionPlanner = (val > 0) ? (unsigned int)val : 0;
+        mResourceManager->invalidateAssignResultCache();
+        setGeometryChanged(GEOMETRY_DEVICE_CONFIG_CHANGED);
+        invalidate();
+        break;
+    case HWC_CTL_PARALLEL_VALIDATE:
+        ALOGI("%s::HWC_CTL_PARALLEL_VALIDATE on/off=%d", __func__, val);
+        exynosHWCControl.parallelValidate = (unsigned int)val;
+        setGeometryChanged(GEOMETRY_DEVICE_CONFIG_CHANGED);
+        invalidate();
+        break;
+    case HWC_CTL_PRESENT_SCHEDULER:
+        ALOGI("%s::HWC_CTL_PRESENT_SCHEDULER on/off=%d", __func__, val);
+        exynosHWCControl.presentScheduler = (unsigned int)val;
+        break;
     default:
         ALOGE("%s: unsupported HWC_CTL (%d)", __func__, ctrl);
         break;
@@ -1206,6 +1247,7 @@ int32_t ExynosDevice::validateDisplay(
     ExynosDisplay *display,
     uint32_t *outNumTypes, uint32_t *outNumRequests) {
     Mutex::Autolock lock(mMutex);
+    ScopedLatency latency(&display->mLatencyRecorder, LATENCY_STAGE_VALIDATE);
 
     gettimeofday(&updateTimeInfo.lastValidateTime, NULL);
     if (outNumTypes == nullptr || outNumRequests == nullptr)
@@ -1302,6 +1344,37 @@ int32_t ExynosDevice::getDevicePresentInfo(DevicePresentInfo &info) {
     return NO_ERROR;
 }
 
+void ExynosDevice::assignResourceInParallel(android::Vector<ExynosDisplay *> &displays,
+                                            std::map<uint32_t, int32_t> &assignRets) {
+    ATRACE_CALL();
+    android::Vector<ExynosDisplay *> parallelDisplays;
+    mResourceManager->partitionMPPs(displays, parallelDisplays);
+    if (parallelDisplays.size() == 0)
+        return;
+
+    if (mValidateWorkerPool == nullptr)
+        mValidateWorkerPool = std::make_unique<WorkerPool>(PARALLEL_VALIDATE_THREAD_NUM);
+
+    std::vector<int32_t> rets(parallelDisplays.size(), NO_ERROR);
+    std::vector<WorkerPool::Task> tasks;
+    for (size_t i = 0; i < parallelDisplays.size(); i++) {
+        ExynosDisplay *display = parallelDisplays[i];
+        int32_t *ret = &rets[i];
+        tasks.push_back([this, display, ret] {
+            *ret = mResourceManager->assignResource(display);
+        });
+    }
+    mValidateWorkerPool->run(tasks);
+    mResourceManager->clearMPPPartition();
+
+    for (size_t i = 0; i < parallelDisplays.size(); i++) {
+        HDEBUGLOGD(eDebugResourceManager, "%s:: %s is assigned in parallel, ret(%d)",
+                   __func__, parallelDisplays[i]->mDisplayName.string(), rets[i]);
+        assignRets[parallelDisplays[i]->mDisplayId] = rets[i];
+    }
+    mParallelValidateCount++;
+}
+
 int32_t ExynosDevice::validateAllDisplays(ExynosDisplay *firstDisplay,
                                           uint32_t *outNumTypes, uint32_t *outNumRequests) {
     int32_t ret = HWC2_ERROR_NONE;
@@ -1403,6 +1476,16 @@ int32_t ExynosDevice::validateAllDisplays(ExynosDisplay *firstDisplay,
         }
     }
 
+    std::map<uint32_t, int32_t> parallelAssignRets;
+    if (mGeometryChanged && exynosHWCControl.parallelValidate) {
+        android::Vector<ExynosDisplay *> assignDisplays;
+        for (int32_t i = (mDisplays.size() - 1); i >= 0; i--) {
+            if (!skip_display(mDisplays[i]) && !(mDisplays[i]->mIsSkipFrame))
+                assignDisplays.add(mDisplays[i]);
+        }
+        assignResourceInParallel(assignDisplays, parallelAssignRets);
+    }
+
     for (int32_t i = (mDisplays.size() - 1); i >= 0; i--) {
         ExynosDisplay *display = mDisplays[i];
         if (skip_display(display))
@@ -1414,7 +1497,26 @@ int32_t ExynosDevice::validateAllDisplays(ExynosDisplay *firstDisplay,
                   __func__, display->mDisplayName.string());
 
         if (mGeometryChanged && !(display->mIsSkipFrame)) {
-            if ((displayRet = mResourceManager->assignResource(display)) != NO_ERROR) {
+            auto parallelRet = parallelAssignRets.find(display->mDisplayId);
+            if (parallelRet != parallelAssignRets.end()) {
+                /*
+                 * MPPs that were not reserved for the display could not be used in parallel.
+                 * Assign it again in validation order if it needs them.
+                 */
+                mResourceManager->updateUncheckedMPPFlag(display);
+                if ((parallelRet->second == NO_ERROR) &&
+                    !mResourceManager->needSharedMPPs(display))
+                    displayRet = parallelRet->second;
+                else {
+                    mParallelReassignCount++;
+                    mResourceManager->resetAssignedResources(display, true);
+                    displayRet = mResourceManager->assignResource(display);
+                }
+            } else {
+                displayRet = mResourceManager->assignResource(display);
+            }
+
+            if (displayRet != NO_ERROR) {
                 HWC_LOGE(display->mDisplayInfo.displayIdentifier, "%s:: assignResource() fail, error(%d)",
                          __func__, displayRet);
             } else {
@@ -1487,13 +1589,27 @@ int32_t ExynosDevice::validateAllDisplays(ExynosDisplay *firstDisplay,
 int32_t ExynosDevice::presentDisplay(ExynosDisplay *display,
                                      int32_t *outPresentFence) {
     ATRACE_CALL();
-    Mutex::Autolock lock(mMutex);
-
     if (display == NULL || display == nullptr) {
         ALOGE("%s: There is no display", __func__);
         return HWC2_ERROR_BAD_DISPLAY;
     }
 
+    /*
+     * Power mode and config of the display are read under the locks,
+     * the frame is held after mMutex is released.
+     * The hold blocks the thread that presents this display,
+     * so only other displays can be validated and presented while it waits.
+     */
+    nsecs_t targetVsync;
+    {
+        Mutex::Autolock lock(mMutex);
+        targetVsync = display->getPresentHoldTarget();
+    }
+    display->holdPresent(targetVsync);
+
+    Mutex::Autolock lock(mMutex);
+    ScopedLatency latency(&display->mLatencyRecorder, LATENCY_STAGE_PRESENT);
+
     funcReturnCallback retCallback([&]() {
         display->mHWCRenderingState = RENDERING_STATE_PRESENTED;
     });
@@ -1790,6 +1906,22 @@ void ExynosDevice::performanceAssuranceInternal() {
     return;
 }
 
+int32_t ExynosDevice::dumpLatencyHistogram(int32_t display, bool reset, String8 &result) {
+    /* Histograms are lock-free, so validate and present are not blocked */
+    int32_t ret = -EINVAL;
+    for (uint32_t i = 0; i < mDisplays.size(); i++) {
+        ExynosDisplay *_display = mDisplays[i];
+        if ((display >= 0) && (_display->mDisplayId != (uint32_t)display))
+            continue;
+        result.appendFormat("%s latency\n", _display->mDisplayName.string());
+        _display->mLatencyRecorder.dump(result);
+        if (reset)
+            _display->mLatencyRecorder.reset();
+        ret = NO_ERROR;
+    }
+    return ret;
+}
+
 bool ExynosDevice::getCPUPerfInfo(int display, int config, int32_t *cpuIDs, int32_t *minClock) {
     Mutex::Autolock lock(mMutex);
 
@@ -2101,8 +2233,10 @@ int32_t ExynosDevice::setColorTransform(ExynosDisplay *display,
 }
 
 int32_t ExynosDevice::setClientTarget(ExynosDisplay *display,
-                                      buffer_handle_t target, int32_t acquireFence, int32_t dataspace) {
+                                      buffer_handle_t target, int32_t acquireFence, int32_t dataspace,
+                                      hwc_region_t damage) {
     Mutex::Autolock lock(mMutex);
+    display->setClientTargetDamage(damage);
     return display->setClientTarget(target, acquireFence, dataspace,
                                     mGeometryChanged);
 }
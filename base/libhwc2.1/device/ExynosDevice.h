@@ -30,6 +30,8 @@
 #include <sys/stat.h>
 #include <sys/resource.h>
 #include <cutils/atomic.h>
+#include <map>
+#include <memory>
 #include <unordered_map>
 
 #include <thread>
@@ -46,6 +48,7 @@
 #include "ExynosHWCTypes.h"
 #include "ExynosFenceTracer.h"
 #include "OneShotTimer.h"
+#include "WorkerPool.h"
 
 #define MAX_DEV_NAME 128
 #define ERROR_LOG_PATH0 "/data/vendor/log/hwc"
@@ -65,6 +68,11 @@
 #define MAX_SUPPORTED_FPS 120
 #endif
 
+/* Threads that assign resources with the validating thread */
+#ifndef PARALLEL_VALIDATE_THREAD_NUM
+#define PARALLEL_VALIDATE_THREAD_NUM 2
+#endif
+
 #ifdef USE_DQE_INTERFACE
 #include <hardware/exynos/dqeInterface.h>
 #ifndef DEFAULT_DQE_INTERFACE_XML
@@ -240,6 +248,8 @@ class ExynosDevice : public ExynosHotplugHandler, ExynosPanelResetHandler, Exyno
     bool wasRenderingStateFlagsCleared();
 
     virtual bool getCPUPerfInfo(int display, int config, int32_t *cpuIDs, int32_t *minClock);
+    /* All of displays are dumped if display is -1 */
+    int32_t dumpLatencyHistogram(int32_t display, bool reset, String8 &result);
 
     /* Add EPIC APIs */
     void *mEPICHandle = NULL;
@@ -322,7 +332,8 @@ class ExynosDevice : public ExynosHotplugHandler, ExynosPanelResetHandler, Exyno
     int32_t setColorTransform(ExynosDisplay *display, const float *matrix,
                               int32_t /*android_color_transform_t*/ hint);
     int32_t setClientTarget(ExynosDisplay *display, buffer_handle_t target,
-                            int32_t acquireFence, int32_t dataspace);
+                            int32_t acquireFence, int32_t dataspace,
+                            hwc_region_t damage);
     int32_t setActiveConfig(ExynosDisplay *display, hwc2_config_t config);
     int32_t setActiveConfigWithConstraints(ExynosDisplay *display, hwc2_config_t config,
                                            hwc_vsync_period_change_constraints_t *vsyncPeriodChangeConstraints,
@@ -347,6 +358,9 @@ class ExynosDevice : public ExynosHotplugHandler, ExynosPanelResetHandler, Exyno
 
   protected:
     void updateNonPrimaryDisplayList(ExynosDisplay *display);
+    /* Results are returned by assignRets for the displays that were assigned */
+    void assignResourceInParallel(android::Vector<ExynosDisplay *> &displays,
+                                  std::map<uint32_t, int32_t> &assignRets);
 
   protected:
     uint32_t mInterfaceType;
@@ -359,5 +373,9 @@ class ExynosDevice : public ExynosHotplugHandler, ExynosPanelResetHandler, Exyno
     Condition mCaptureCondition;
     std::atomic<bool> mIsWaitingReadbackReqDone = false;
     ExynosFenceTracer &mFenceTracer = ExynosFenceTracer::getInstance();
+
+    std::unique_ptr<WorkerPool> mValidateWorkerPool;
+    uint64_t mParallelValidateCount = 0;
+    uint64_t mParallelReassignCount = 0;
 };
 #endif  //_EXYNOSDEVICE_H
@@ -62,7 +62,7 @@ int32_t ExynosDeviceDrmInterface::getRestrictions(struct dpp_restrictions_info_v
             if (ret)
                 break;
             struct drm_dpp_ch_restriction *res;
-            drmModePropertyBlobPtr blob = drmModeGetPropertyBlob(mDrmDevice->fd(), blobId);
+            drmModePropertyBlobPtr blob = mDrmDevice->backend().GetPropertyBlob(mDrmDevice->fd(), blobId);
             if (!blob) {
                 ALOGE("Fail to get blob for hw_restrictions(%" PRId64 ")", blobId);
                 ret = HWC2_ERROR_UNSUPPORTED;
@@ -70,7 +70,7 @@ int32_t ExynosDeviceDrmInterface::getRestrictions(struct dpp_restrictions_info_v
             }
             res = (struct drm_dpp_ch_restriction *)blob->data;
             setDppChannelRestriction(mDPUInfo.dpuInfo.dpp_ch[channelId], *res);
-            drmModeFreePropertyBlob(blob);
+            mDrmDevice->backend().FreePropertyBlob(blob);
         } else {
             ALOGI("plane[%d] There is no hw restriction information", channelId);
             ret = HWC2_ERROR_UNSUPPORTED;
@@ -83,7 +83,7 @@ int32_t ExynosDeviceDrmInterface::getRestrictions(struct dpp_restrictions_info_v
             if (ret)
                 break;
             struct drm_format_modifier_blob *res;
-            drmModePropertyBlobPtr blob = drmModeGetPropertyBlob(mDrmDevice->fd(), blobId);
+            drmModePropertyBlobPtr blob = mDrmDevice->backend().GetPropertyBlob(mDrmDevice->fd(), blobId);
             if (!blob) {
                 ALOGE("Fail to get blob for format_property(%" PRId64 ")", blobId);
                 ret = HWC2_ERROR_UNSUPPORTED;
@@ -141,7 +141,7 @@ int32_t ExynosDeviceDrmInterface::getRestrictions(struct dpp_restrictions_info_v
                 }
             }
 
-            drmModeFreePropertyBlob(blob);
+            mDrmDevice->backend().FreePropertyBlob(blob);
         }
 
         if (hwcCheckDebugMessages(eDebugAttrSetting))
@@ -34,6 +34,7 @@ class ExynosDeviceDrmInterface : public ExynosDeviceInterface,
     void setDppChannelRestriction(struct dpp_ch_restriction &common_restriction,
                                 struct drm_dpp_ch_restriction &drm_restriction);
     void HandlePanelEvent(uint64_t timestamp_us) override;
+    virtual void dump(String8 &result) override { mFBManager.dump(result); };
   protected:
     ResourceManager mDrmResourceManager;
     DrmDevice *mDrmDevice;
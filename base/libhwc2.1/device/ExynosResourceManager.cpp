@@ -20,6 +20,8 @@
 
 #define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
 #include <cutils/properties.h>
+#include <algorithm>
+#include <cfloat>
 #include <unordered_set>
 #include "ExynosResourceManager.h"
 #include "ExynosMPPModule.h"
@@ -74,6 +76,11 @@ std::vector<EnableMPPRequest> ExynosResourceManager::mEnableMPPRequests;
 
 extern struct exynos_hwc_control exynosHWCControl;
 
+/* MPP is given to another display or blocked by partitionMPPs() */
+static inline bool isPartitionedAway(ExynosMPP *mpp, ExynosDisplay *display) {
+    return mpp->isPartitionedAway(display->mDisplayId);
+}
+
 ExynosMPPVector::ExynosMPPVector() {
 }
 
@@ -139,6 +146,7 @@ ExynosResourceManager::ExynosResourceManager() {
         ExynosMPP *exynosMPP = new ExynosMPPModule(exynos_mpp.physicalType,
                                                    exynos_mpp.logicalType, exynos_mpp.name, exynos_mpp.physical_index,
                                                    exynos_mpp.logical_index, exynos_mpp.pre_assign_info, MPP_TYPE_M2M);
+        exynosMPP->mDstBufPool = &mDstBufPool;
         mM2mMPPs.add(exynosMPP);
     }
 
@@ -236,9 +244,46 @@ int32_t ExynosResourceManager::doPreProcessing() {
     if (display == NULL)
         return -EINVAL;
     ret = (doAllocDstBufs(display->mXres, display->mYres)) | (doAllocLutParcels(display));
+    prewarmDstBufs(display);
     return ret;
 }
 
+void ExynosResourceManager::prewarmDstBufs(ExynosDisplay *display) {
+    uint32_t oldXres, oldYres;
+    bool releaseOldSize;
+    {
+        /* Pre-warmed sizes of all displays are updated and read under the lock */
+        Mutex::Autolock lock(mAssignContextMutex);
+        AssignContext &context = mAssignContexts[display->mDisplayId];
+        oldXres = context.prewarmedXres;
+        oldYres = context.prewarmedYres;
+        if ((oldXres == display->mXres) && (oldYres == display->mYres))
+            return;
+        context.prewarmedXres = display->mXres;
+        context.prewarmedYres = display->mYres;
+
+        /* Buffers of the previous size are kept only if other display still uses the size */
+        releaseOldSize = (oldXres != 0) && (oldYres != 0);
+        for (auto &it : mAssignContexts) {
+            if ((it.second.prewarmedXres == oldXres) && (it.second.prewarmedYres == oldYres))
+                releaseOldSize = false;
+        }
+    }
+
+    HDEBUGLOGD(eDebugBuf, "%s:: display(%d), %dx%d -> %dx%d", __func__,
+               display->mDisplayId, oldXres, oldYres, display->mXres, display->mYres);
+
+    for (uint32_t i = 0; i < mM2mMPPs.size(); i++) {
+        /* MPPs of other displays are used by their validate in parallel */
+        if (isPartitionedAway(mM2mMPPs[i], display))
+            continue;
+        if (releaseOldSize)
+            mM2mMPPs[i]->prewarmDstBufs(oldXres, oldYres, 0);
+        mM2mMPPs[i]->prewarmDstBufs(display->mXres, display->mYres,
+                                    MPP_BUFFER_POOL_PREWARM_COUNT);
+    }
+}
+
 int32_t ExynosResourceManager::doAllocDstBufs(uint32_t Xres, uint32_t Yres) {
     ATRACE_CALL();
     int32_t ret = NO_ERROR;
@@ -246,22 +291,14 @@ int32_t ExynosResourceManager::doAllocDstBufs(uint32_t Xres, uint32_t Yres) {
 
     for (uint32_t i = 0; i < mM2mMPPs.size(); i++) {
         if (mM2mMPPs[i]->needPreAllocation(mDeviceInfo.displayMode)) {
-            uint32_t width = Xres;
-            uint32_t height = Yres;
+            uint32_t width = 0;
+            uint32_t height = 0;
             mM2mMPPs[i]->mFreeOutBufFlag = false;
+            mM2mMPPs[i]->getDefaultOutBufSize(Xres, Yres, width, height);
             for (uint32_t index = 0; index < NUM_MPP_DST_BUFS(mM2mMPPs[i]->mLogicalType); index++) {
                 HDEBUGLOGD(eDebugBuf, "%s allocate dst buffer[%d]%p, x: %d, y: %d",
                            __func__, index, mM2mMPPs[i]->mDstImgs[index].bufferHandle, Xres, Yres);
-                uint32_t bufAlign = mM2mMPPs[i]->getOutBufAlign();
-                // For using the compressed output in G2D composition,
-                // allocated buffer size should be larger than FHD.
-                if ((mM2mMPPs[i]->mMaxSrcLayerNum > 1) && (mM2mMPPs[i]->mPhysicalType == MPP_G2D) &&
-                    (Xres * Yres < 1920 * 1080)) {
-                    width = 1080;
-                    height = 1920;
-                }
-                ret = mM2mMPPs[i]->allocOutBuf(ALIGN_UP(width, bufAlign),
-                                               ALIGN_UP(height, bufAlign),
+                ret = mM2mMPPs[i]->allocOutBuf(width, height,
                                                DEFAULT_MPP_DST_FORMAT, 0x0, index);
                 if (ret < 0) {
                     HWC_LOGE_NODISP("%s:: fail to allocate dst buffer[%d]",
@@ -281,6 +318,7 @@ int32_t ExynosResourceManager::doAllocDstBufs(uint32_t Xres, uint32_t Yres) {
  */
 int32_t ExynosResourceManager::assignResource(ExynosDisplay *display) {
     ATRACE_CALL();
+    ScopedLatency latency(&display->mLatencyRecorder, LATENCY_STAGE_ASSIGN_RESOURCE);
     int ret = 0;
 
     HDEBUGLOGD(eDebugResourceManager | eDebugSkipResourceAssign,
@@ -303,6 +341,8 @@ int32_t ExynosResourceManager::assignResource(ExynosDisplay *display) {
     }
 
     for (size_t i = 0; i < mM2mMPPs.size(); i++) {
+        if (isPartitionedAway(mM2mMPPs[i], display))
+            continue;
         if (mM2mMPPs[i]->mReservedDisplayInfo.displayIdentifier.id == display->mDisplayId)
             mM2mMPPs[i]->mPreAssignedCapacity = 0.0f;
     }
@@ -313,11 +353,45 @@ int32_t ExynosResourceManager::assignResource(ExynosDisplay *display) {
         return ret;
     }
 
-    if ((ret = assignResourceInternal(display)) != NO_ERROR) {
+    AssignContext &context = getAssignContext(display);
+
+    /* Hotplug or resolution change */
+    prewarmDstBufs(display);
+
+    AssignSignature &signature = context.signature;
+    getAssignSignature(display, signature);
+    context.hasReplayResult = false;
+    {
+        Mutex::Autolock lock(mAssignResultCacheMutex);
+        for (auto it = mAssignResultCache.begin(); it != mAssignResultCache.end(); it++) {
+            if ((it->displayId == display->mDisplayId) && (it->signature == signature) &&
+                (it->layerResults.size() == display->mLayers.size())) {
+                mAssignResultCache.splice(mAssignResultCache.begin(), mAssignResultCache, it);
+                context.replayResult = mAssignResultCache.front();
+                context.hasReplayResult = true;
+                break;
+            }
+        }
+    }
+    if (context.hasReplayResult)
+        context.cacheHitCount++;
+    else
+        context.cacheMissCount++;
+    HDEBUGLOGD(eDebugResourceManager, "%s:: assign result cache %s (signature: 0x%" PRIx64 ")",
+               __func__, context.hasReplayResult ? "hit" : "miss", signature.hash);
+
+    context.layerResults.assign(display->mLayers.size(), AssignLayerResult());
+    ret = assignResourceInternal(display);
+    context.hasReplayResult = false;
+    context.cacheActive = false;
+    if (ret != NO_ERROR) {
         HWC_LOGE(display->mDisplayInfo.displayIdentifier, "%s:: assignResourceInternal() error (%d)",
                  __func__, ret);
         return ret;
     }
+    /* Planner frames don't have results of assignLayer() */
+    if (!context.planned)
+        storeAssignResult(display, signature);
 
     if ((ret = assignWindow(display)) != NO_ERROR) {
         HWC_LOGE(display->mDisplayInfo.displayIdentifier, "%s:: assignWindow() error (%d)",
@@ -462,7 +536,39 @@ int32_t ExynosResourceManager::setResourcePriority(ExynosDisplay *display) {
 
 int32_t ExynosResourceManager::assignResourceInternal(ExynosDisplay *display) {
     int ret = NO_ERROR;
+
+    AssignContext &context = getAssignContext(display);
+    context.planned = false;
+    if ((exynosHWCControl.compositionPlanner != 0) && display->mUseDpu)
+        context.planned = (planAssignResources(display) == NO_ERROR);
+
+    if ((!context.planned) && ((ret = assignResourceByPriority(display)) != NO_ERROR))
+        return ret;
+
+    if ((ret = updateExynosComposition(display)) != NO_ERROR)
+        return ret;
+    if ((ret = updateClientComposition(display)) != NO_ERROR)
+        return ret;
+    if ((ret = flattenStaticClientLayers(display)) != NO_ERROR)
+        return ret;
+
+    if (hwcCheckDebugMessages(eDebugCapacity)) {
+        for (uint32_t i = 0; i < mM2mMPPs.size(); i++) {
+            if (mM2mMPPs[i]->mPhysicalType == MPP_G2D) {
+                String8 dumpMPP;
+                mM2mMPPs[i]->dump(dumpMPP);
+                HDEBUGLOGD(eDebugCapacity, "%s", dumpMPP.string());
+            }
+        }
+    }
+
+    return ret;
+}
+
+int32_t ExynosResourceManager::assignResourceByPriority(ExynosDisplay *display) {
+    int ret = NO_ERROR;
     int retry_count = 0;
+    AssignContext &context = getAssignContext(display);
 
     /*
      * First add layers that SF requested HWC2_COMPOSITION_CLIENT type
@@ -481,10 +587,14 @@ int32_t ExynosResourceManager::assignResourceInternal(ExynosDisplay *display) {
         }
     }
 
+    context.cacheActive = true;
     do {
         HDEBUGLOGD(eDebugResourceAssigning, "%s:: retry_count(%d)", __func__, retry_count);
         if ((ret = resetAssignedResources(display)) != NO_ERROR)
             return ret;
+        /* Only results of the last try are kept in the cache */
+        for (auto &result : context.layerResults)
+            result.valid = false;
         if ((ret = assignCompositionTarget(display, COMPOSITION_CLIENT)) != NO_ERROR) {
             HWC_LOGE(display->mDisplayInfo.displayIdentifier, "%s:: Fail to assign resource for compositionTarget",
                      __func__);
@@ -553,26 +663,11 @@ int32_t ExynosResourceManager::assignResourceInternal(ExynosDisplay *display) {
         }
         retry_count++;
     } while ((ret == EXYNOS_ERROR_CHANGED) && (retry_count < ASSIGN_RESOURCE_TRY_COUNT));
+    context.cacheActive = false;
 
     if (retry_count == ASSIGN_RESOURCE_TRY_COUNT) {
         HWC_LOGE(display->mDisplayInfo.displayIdentifier, "%s:: assign resources fail", __func__);
         ret = eUnknown;
-        return ret;
-    } else {
-        if ((ret = updateExynosComposition(display)) != NO_ERROR)
-            return ret;
-        if ((ret = updateClientComposition(display)) != NO_ERROR)
-            return ret;
-    }
-
-    if (hwcCheckDebugMessages(eDebugCapacity)) {
-        for (uint32_t i = 0; i < mM2mMPPs.size(); i++) {
-            if (mM2mMPPs[i]->mPhysicalType == MPP_G2D) {
-                String8 dumpMPP;
-                mM2mMPPs[i]->dump(dumpMPP);
-                HDEBUGLOGD(eDebugCapacity, "%s", dumpMPP.string());
-            }
-        }
     }
 
     return ret;
@@ -833,14 +928,135 @@ int32_t ExynosResourceManager::updateClientComposition(ExynosDisplay *display) {
     return ret;
 }
 
+/*
+ * Move the longest static run at the bottom or the top of client composition
+ * to exynos composition. M2M MPP reuses its dst buffer while sources of the run
+ * are not changed, so GPU composes only the dynamic layers.
+ * Client composition is kept as it is if the run can't be assigned.
+ */
+int32_t ExynosResourceManager::flattenStaticClientLayers(ExynosDisplay *display) {
+    int32_t ret = NO_ERROR;
+    ExynosCompositionInfo &clientInfo = display->mClientCompositionInfo;
+    ExynosCompositionInfo &exynosInfo = display->mExynosCompositionInfo;
+    ExynosMPP *m2mMPP = exynosInfo.mM2mMPP;
+
+    if ((!display->mUseDpu) || (exynosHWCControl.forceGpu == 1) ||
+        (display->mDisplayControl.skipStaticLayers == 0) ||
+        (display->mDynamicRecompMode == DEVICE_TO_CLIENT) ||
+        (clientInfo.mHasCompositionLayer == false) ||
+        (exynosInfo.mHasCompositionLayer == true) || (m2mMPP == NULL))
+        return NO_ERROR;
+
+    std::vector<StaticLayerRun> runs;
+    display->getStaticLayerRuns(clientInfo.mFirstIndex, clientInfo.mLastIndex, runs);
+    /* Client composition that has no dynamic layer is handled by skipStaticLayers() */
+    if (runs.size() < 2)
+        return NO_ERROR;
+
+    StaticLayerRun run = runs.front();
+    if ((!run.isStatic) ||
+        (runs.back().isStatic &&
+         ((runs.back().lastIndex - runs.back().firstIndex) > (run.lastIndex - run.firstIndex))))
+        run = runs.back();
+    if ((!run.isStatic) ||
+        ((run.lastIndex - run.firstIndex + 1) < STATIC_LAYER_FLATTEN_MIN_LAYERS))
+        return NO_ERROR;
+
+    for (int32_t i = run.firstIndex; i <= run.lastIndex; i++) {
+        ExynosLayer *layer = display->mLayers[i];
+        if ((layer->mCompositionType == HWC2_COMPOSITION_CLIENT) ||
+            (layer->mValidateCompositionType != HWC2_COMPOSITION_CLIENT) ||
+            (layer->mOverlayPriority >= ePriorityHigh) ||
+            ((layer->mSupportedMPPFlag & m2mMPP->mLogicalType) == 0))
+            return NO_ERROR;
+    }
+
+    HDEBUGLOGD(eDebugResourceAssigning, "%s:: static layers [%d] - [%d] of client composition [%d] - [%d]",
+               __func__, run.firstIndex, run.lastIndex, clientInfo.mFirstIndex, clientInfo.mLastIndex);
+
+    AssignContext &context = getAssignContext(display);
+    int32_t clientFirstIndex = clientInfo.mFirstIndex;
+    int32_t clientLastIndex = clientInfo.mLastIndex;
+    int32_t assignedLastIndex = run.firstIndex - 1;
+    bool flattened = false;
+
+    funcReturnCallback retCallback([&]() {
+        if (flattened) {
+            context.flattenCount++;
+            return;
+        }
+        for (int32_t i = run.firstIndex; i <= assignedLastIndex; i++) {
+            ExynosLayer *layer = display->mLayers[i];
+            layer->resetAssignedResource();
+            layer->mOverlayInfo &= ~eFlattenedStaticLayer;
+            layer->mValidateCompositionType = HWC2_COMPOSITION_CLIENT;
+        }
+        if (exynosInfo.mOtfMPP != NULL) {
+            exynosInfo.mOtfMPP->resetAssignedState();
+            display->mWindowNumUsed--;
+        }
+        exynosInfo.initializeInfos();
+        clientInfo.mFirstIndex = clientFirstIndex;
+        clientInfo.mLastIndex = clientLastIndex;
+        context.flattenFailCount++;
+    });
+
+    for (int32_t i = run.firstIndex; i <= run.lastIndex; i++) {
+        ExynosLayer *layer = display->mLayers[i];
+        exynos_image src_img;
+        exynos_image dst_img;
+        layer->setSrcExynosImage(&src_img);
+        layer->setDstExynosImage(&dst_img);
+        layer->setExynosImage(src_img, dst_img);
+        if (!isAssignable(m2mMPP, display, src_img, dst_img, layer)) {
+            HDEBUGLOGD(eDebugResourceAssigning, "	[%d] layer is not assignable to %s",
+                       i, m2mMPP->mName.string());
+            return NO_ERROR;
+        }
+        if ((ret = m2mMPP->assignMPP(display->mDisplayInfo, layer)) != NO_ERROR) {
+            ALOGE("%s:: %s MPP assignMPP() error (%d)",
+                  __func__, m2mMPP->mName.string(), ret);
+            return ret;
+        }
+        layer->setExynosMidImage(dst_img);
+        layer->mOverlayInfo |= eFlattenedStaticLayer;
+        layer->mValidateCompositionType = HWC2_COMPOSITION_EXYNOS;
+        assignedLastIndex = i;
+    }
+
+    exynosInfo.mHasCompositionLayer = true;
+    exynosInfo.mFirstIndex = run.firstIndex;
+    exynosInfo.mLastIndex = run.lastIndex;
+    if (run.firstIndex == clientInfo.mFirstIndex)
+        clientInfo.mFirstIndex = run.lastIndex + 1;
+    else
+        clientInfo.mLastIndex = run.firstIndex - 1;
+
+    if ((ret = assignCompositionTarget(display, COMPOSITION_EXYNOS)) != NO_ERROR) {
+        HDEBUGLOGD(eDebugResourceAssigning, "	no window for flattened layers (%d)", ret);
+        return NO_ERROR;
+    }
+    if (m2mMPP->prioritize(2) != NO_ERROR) {
+        HDEBUGLOGD(eDebugResourceAssigning, "	%s has pending work", m2mMPP->mName.string());
+        return NO_ERROR;
+    }
+
+    flattened = true;
+    return NO_ERROR;
+}
+
 int32_t ExynosResourceManager::resetAssignedResources(ExynosDisplay *display, bool forceReset) {
     for (uint32_t i = 0; i < mOtfMPPs.size(); i++) {
+        if (display && isPartitionedAway(mOtfMPPs[i], display))
+            continue;
         if (display && (mOtfMPPs[i]->mAssignedDisplayInfo.displayIdentifier.id != display->mDisplayId))
             continue;
 
         mOtfMPPs[i]->resetAssignedState();
     }
     for (uint32_t i = 0; i < mM2mMPPs.size(); i++) {
+        if (display && isPartitionedAway(mM2mMPPs[i], display))
+            continue;
         if (display && (mM2mMPPs[i]->mAssignedDisplayInfo.displayIdentifier.id != display->mDisplayId))
             continue;
         if ((forceReset == false) &&
@@ -908,6 +1124,8 @@ int32_t ExynosResourceManager::assignCompositionTarget(ExynosDisplay *display, u
     otfMppReordering(display, mOtfMPPs, src_img, dst_img);
 
     for (uint32_t i = 0; i < mOtfMPPs.size(); i++) {
+        if (isPartitionedAway(mOtfMPPs[i], display))
+            continue;
 #ifdef USE_DEDICATED_TOP_WINDOW
         if ((mOtfMPPs[i]->mPhysicalType == DEDICATED_CHANNEL_TYPE) &&
             (mOtfMPPs[i]->mPhysicalIndex == DEDICATED_CHANNEL_INDEX) &&
@@ -1239,6 +1457,38 @@ int32_t ExynosResourceManager::assignLayer(ExynosDisplay *display, ExynosLayer *
         layer->printLayer();
     }
 
+    /* Layers are re-checked by updateClientComposition(), it is not recorded */
+    AssignContext &context = getAssignContext(display);
+    if (!context.cacheActive)
+        return findLayerAssignment(display, layer, layer_index, validateFlag, src_img, dst_img,
+                                   m2m_out_img, m2mMPP, otfMPP, overlayInfo);
+
+    ret = replayAssignResult(display, layer, layer_index, validateFlag, src_img, dst_img,
+                             m2m_out_img, m2mMPP, otfMPP, overlayInfo);
+    if (ret == HWC2_COMPOSITION_INVALID)
+        ret = findLayerAssignment(display, layer, layer_index, validateFlag, src_img, dst_img,
+                                  m2m_out_img, m2mMPP, otfMPP, overlayInfo);
+
+    if ((ret > HWC2_COMPOSITION_INVALID) && (layer_index < context.layerResults.size())) {
+        AssignLayerResult &result = context.layerResults[layer_index];
+        result.valid = true;
+        result.compositionType = ret;
+        result.validateFlag = validateFlag;
+        result.overlayInfo = overlayInfo;
+        result.otfMPP = *otfMPP;
+        result.m2mMPP = *m2mMPP;
+        result.m2mOutImg = m2m_out_img;
+    }
+
+    return ret;
+}
+
+int32_t ExynosResourceManager::findLayerAssignment(ExynosDisplay *display, ExynosLayer *layer, uint32_t layer_index,
+                                                   uint32_t validateFlag, exynos_image &src_img, exynos_image &dst_img,
+                                                   exynos_image &m2m_out_img, ExynosMPP **m2mMPP, ExynosMPP **otfMPP,
+                                                   uint32_t &overlayInfo) {
+    int32_t ret = NO_ERROR;
+
     if ((validateFlag == NO_ERROR) || (validateFlag & eInsufficientWindow) ||
         (validateFlag & eDimLayer)) {
         bool isAssignableFlag = false;
@@ -1249,6 +1499,8 @@ int32_t ExynosResourceManager::assignLayer(ExynosDisplay *display, ExynosLayer *
             otfMppReordering(display, mOtfMPPs, src_img, dst_img);
 
             for (uint32_t j = 0; j < mOtfMPPs.size(); j++) {
+                if (isPartitionedAway(mOtfMPPs[j], display))
+                    continue;
 #ifdef USE_DEDICATED_TOP_WINDOW
                 if ((mOtfMPPs[j]->mPhysicalType == DEDICATED_CHANNEL_TYPE) &&
                     (mOtfMPPs[j]->mPhysicalIndex == DEDICATED_CHANNEL_INDEX) &&
@@ -1275,6 +1527,8 @@ int32_t ExynosResourceManager::assignLayer(ExynosDisplay *display, ExynosLayer *
 
         /* 2. Find available m2mMPP */
         for (uint32_t j = 0; j < mM2mMPPs.size(); j++) {
+            if (isPartitionedAway(mM2mMPPs[j], display))
+                continue;
             if ((display->mUseDpu == true) &&
                 ((mM2mMPPs[j]->mLogicalType == MPP_LOGICAL_G2D_COMBO) ||
                  (mM2mMPPs[j]->mLogicalType == MPP_LOGICAL_MSC_COMBO)))
@@ -1298,8 +1552,8 @@ int32_t ExynosResourceManager::assignLayer(ExynosDisplay *display, ExynosLayer *
                        mM2mMPPs[j]->mName.string(),
                        (layer->mSupportedMPPFlag & mM2mMPPs[j]->mLogicalType), isAssignableState);
 
-            float totalUsedCapa = ExynosResourceManager::getResourceUsedCapa(*mM2mMPPs[j]);
             if (isAssignableState) {
+                float totalUsedCapa = ExynosResourceManager::getResourceUsedCapa(*mM2mMPPs[j]);
                 if (!(mM2mMPPs[j]->mMaxSrcLayerNum > 1)) {
                     exynos_image otf_dst_img = dst_img;
 
@@ -1336,6 +1590,8 @@ int32_t ExynosResourceManager::assignLayer(ExynosDisplay *display, ExynosLayer *
 
                         /* 3. Find available OtfMPP for output of m2mMPP */
                         for (uint32_t k = 0; k < mOtfMPPs.size(); k++) {
+                            if (isPartitionedAway(mOtfMPPs[k], display))
+                                continue;
 #ifdef USE_DEDICATED_TOP_WINDOW
                             if ((mOtfMPPs[k]->mPhysicalType == DEDICATED_CHANNEL_TYPE) &&
                                 (mOtfMPPs[k]->mPhysicalIndex == DEDICATED_CHANNEL_INDEX) &&
@@ -1399,6 +1655,797 @@ int32_t ExynosResourceManager::assignLayer(ExynosDisplay *display, ExynosLayer *
     return HWC2_COMPOSITION_CLIENT;
 }
 
+int32_t ExynosResourceManager::replayAssignResult(ExynosDisplay *display, ExynosLayer *layer, uint32_t layer_index,
+                                                  uint32_t validateFlag, exynos_image &src_img, exynos_image &dst_img,
+                                                  exynos_image &m2m_out_img, ExynosMPP **m2mMPP, ExynosMPP **otfMPP,
+                                                  uint32_t &overlayInfo) {
+    AssignContext &context = getAssignContext(display);
+    if ((!context.hasReplayResult) ||
+        (layer_index >= context.replayResult.layerResults.size()))
+        return HWC2_COMPOSITION_INVALID;
+
+    const AssignLayerResult &cached = context.replayResult.layerResults[layer_index];
+    /* HDR10+ layer can be changed to HDR10 layer while it is assigned */
+    if ((cached.valid == false) || (cached.validateFlag != validateFlag) ||
+        hasHdr10Plus(src_img))
+        return HWC2_COMPOSITION_INVALID;
+
+    /*
+     * isSupported() was already checked when the result was recorded.
+     * Only state of MPPs that can be changed in this frame is checked again.
+     */
+    bool replayable = false;
+    if (cached.compositionType == HWC2_COMPOSITION_DEVICE) {
+        if (cached.m2mMPP == nullptr) {
+            replayable = (cached.otfMPP != nullptr) &&
+                         isAssignable(cached.otfMPP, display, src_img, dst_img, layer);
+        } else if (cached.otfMPP != nullptr) {
+            exynos_image m2m_src_img = src_img;
+            exynos_image otf_src_img = cached.m2mOutImg;
+            exynos_image otf_dst_img = dst_img;
+            otf_src_img.metaParcel = src_img.metaParcel;
+            otf_dst_img.exynosFormat = ExynosMPP::defaultMppDstFormat;
+            otf_dst_img.transform = 0;
+            if (otf_src_img.needColorTransform)
+                m2m_src_img.needColorTransform = false;
+
+            if (cached.m2mMPP->isAssignableState(display->mDisplayInfo, src_img, dst_img) &&
+                cached.m2mMPP->hasEnoughCapa(display->mDisplayInfo, m2m_src_img, otf_src_img,
+                                             getResourceUsedCapa(*cached.m2mMPP))) {
+                ExynosCompositionInfo dpuSrcInfo;
+                dpuSrcInfo.mSrcImg = otf_src_img;
+                dpuSrcInfo.mDstImg = otf_dst_img;
+                calculateHWResourceAmount(display, &dpuSrcInfo);
+                replayable = isAssignable(cached.otfMPP, display, otf_src_img, otf_dst_img, &dpuSrcInfo);
+            }
+            if (replayable)
+                m2m_out_img = otf_src_img;
+        }
+    } else if (cached.compositionType == HWC2_COMPOSITION_EXYNOS) {
+        replayable = (cached.m2mMPP != nullptr) &&
+                     (layer->mSupportedMPPFlag & cached.m2mMPP->mLogicalType) &&
+                     cached.m2mMPP->isAssignableState(display->mDisplayInfo, src_img, dst_img) &&
+                     cached.m2mMPP->hasEnoughCapa(display->mDisplayInfo, src_img, dst_img,
+                                                  getResourceUsedCapa(*cached.m2mMPP));
+    } else if (cached.compositionType == HWC2_COMPOSITION_CLIENT) {
+        replayable = true;
+        overlayInfo = cached.overlayInfo;
+    }
+
+    if (!replayable) {
+        /*
+         * State of MPPs is different from the recorded one,
+         * remaining layers are also assigned without the cache
+         */
+        HDEBUGLOGD(eDebugResourceAssigning, "\t[%d] layer: cached result can't be replayed", layer_index);
+        context.hasReplayResult = false;
+        context.cacheReplayFailCount++;
+        return HWC2_COMPOSITION_INVALID;
+    }
+
+    *otfMPP = cached.otfMPP;
+    *m2mMPP = cached.m2mMPP;
+    HDEBUGLOGD(eDebugResourceAssigning, "\t[%d] layer: cached result is replayed, type(%d), otf(%s), m2m(%s)",
+               layer_index, cached.compositionType,
+               (cached.otfMPP != nullptr) ? cached.otfMPP->mName.string() : "none",
+               (cached.m2mMPP != nullptr) ? cached.m2mMPP->mName.string() : "none");
+
+    return cached.compositionType;
+}
+
+static inline void addAssignSignature(AssignSignature &signature, uint64_t value) {
+    signature.key.push_back(value);
+    /* FNV-1a */
+    for (uint32_t i = 0; i < sizeof(value); i++) {
+        signature.hash ^= (value >> (i * 8)) & 0xff;
+        signature.hash *= 0x100000001b3ULL;
+    }
+}
+
+static inline void addAssignSignature(AssignSignature &signature, float value) {
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    addAssignSignature(signature, (uint64_t)bits);
+}
+
+static void addAssignSignature(AssignSignature &signature, const exynos_image &img) {
+    addAssignSignature(signature, ((uint64_t)img.fullWidth << 32) | img.fullHeight);
+    addAssignSignature(signature, ((uint64_t)img.x << 32) | img.y);
+    addAssignSignature(signature, ((uint64_t)img.w << 32) | img.h);
+    addAssignSignature(signature, ((uint64_t)img.color.r << 24) | ((uint64_t)img.color.g << 16) |
+                                      ((uint64_t)img.color.b << 8) | img.color.a);
+    addAssignSignature(signature, ((uint64_t)img.exynosFormat.halFormat() << 32) | img.compressionInfo.type);
+    addAssignSignature(signature, img.usageFlags);
+    addAssignSignature(signature, ((uint64_t)img.layerFlags << 32) | img.dataSpace);
+    addAssignSignature(signature, ((uint64_t)img.blending << 32) | img.transform);
+    addAssignSignature(signature, img.planeAlpha);
+    addAssignSignature(signature, ((uint64_t)img.metaType << 32) | img.needColorTransform);
+}
+
+void ExynosResourceManager::getAssignSignature(ExynosDisplay *display, AssignSignature &signature) {
+    signature.reset();
+
+    addAssignSignature(signature, ((uint64_t)display->mDisplayId << 32) | display->mLayers.size());
+    addAssignSignature(signature, ((uint64_t)display->mXres << 32) | display->mYres);
+    addAssignSignature(signature, ((uint64_t)display->mColorTransformHint << 32) | display->mDynamicRecompMode);
+    addAssignSignature(signature, ((uint64_t)mDeviceInfo.displayMode << 32) | display->mMaxWindowNum);
+
+    for (uint32_t i = 0; i < display->mLayers.size(); i++) {
+        ExynosLayer *layer = display->mLayers[i];
+        exynos_image src_img;
+        exynos_image dst_img;
+        layer->setSrcExynosImage(&src_img);
+        layer->setDstExynosImage(&dst_img);
+        addAssignSignature(signature, src_img);
+        addAssignSignature(signature, dst_img);
+        addAssignSignature(signature, ((uint64_t)layer->mCompositionType << 32) | layer->mOverlayPriority);
+        addAssignSignature(signature, ((uint64_t)layer->mSupportedMPPFlag << 32) | layer->mLayerFlag);
+    }
+
+    /* Resources that are already used by other displays */
+    auto addMPPSignature = [&](ExynosMPPVector &mpps) {
+        for (auto mpp : mpps) {
+            /* State of MPPs partitioned away can be changed by other displays at the same time */
+            addAssignSignature(signature, mpp->mPartitionDisplayId);
+            if (isPartitionedAway(mpp, display))
+                continue;
+            addAssignSignature(signature, ((uint64_t)mpp->mAssignedState << 32) | mpp->mDisableByUserScenario);
+            addAssignSignature(signature, ((uint64_t)mpp->mAssignedDisplayInfo.displayIdentifier.id << 32) |
+                                              mpp->mReservedDisplayInfo.displayIdentifier.id);
+            /* Running HW can be assigned only to the display that used it */
+            bool busyForOthers = (mpp->mHWState != MPP_HW_STATE_IDLE) &&
+                                 (mpp->mPrevAssignedDisplayType >= 0) &&
+                                 ((uint32_t)mpp->mPrevAssignedDisplayType != display->mType);
+            addAssignSignature(signature, (uint64_t)busyForOthers);
+            addAssignSignature(signature, ((uint64_t)mpp->mEnableByDebug << 32) | mpp->mAssignedSources.size());
+            addAssignSignature(signature, mpp->mUsedCapacity);
+            addAssignSignature(signature, mpp->mPreAssignedCapacity);
+        }
+    };
+    addMPPSignature(mOtfMPPs);
+    addMPPSignature(mM2mMPPs);
+}
+
+void ExynosResourceManager::storeAssignResult(ExynosDisplay *display, const AssignSignature &signature) {
+    Mutex::Autolock lock(mAssignResultCacheMutex);
+    auto it = mAssignResultCache.begin();
+    for (; it != mAssignResultCache.end(); it++) {
+        if ((it->displayId == display->mDisplayId) && (it->signature == signature))
+            break;
+    }
+
+    if (it != mAssignResultCache.end()) {
+        mAssignResultCache.splice(mAssignResultCache.begin(), mAssignResultCache, it);
+    } else if (mAssignResultCache.size() >= ASSIGN_RESULT_CACHE_SIZE) {
+        /* The least recently used entry is overwritten, its vectors are reused */
+        mAssignResultCache.splice(mAssignResultCache.begin(), mAssignResultCache,
+                                  std::prev(mAssignResultCache.end()));
+    } else {
+        mAssignResultCache.emplace_front();
+    }
+
+    AssignResultCacheEntry &entry = mAssignResultCache.front();
+    entry.displayId = display->mDisplayId;
+    entry.signature = signature;
+    entry.layerResults = getAssignContext(display).layerResults;
+}
+
+void ExynosResourceManager::invalidateAssignResultCache() {
+    Mutex::Autolock lock(mAssignResultCacheMutex);
+    mAssignResultCache.clear();
+}
+
+void ExynosResourceManager::partitionMPPs(android::Vector<ExynosDisplay *> &displays,
+                                          android::Vector<ExynosDisplay *> &parallelDisplays) {
+    parallelDisplays.clear();
+    mSharedMPPLogicalTypes = 0;
+
+    auto getOwner = [&](ExynosMPP *mpp) -> uint32_t {
+        if ((mpp->mAssignedState & MPP_ASSIGN_STATE_RESERVED) == 0)
+            return MPP_PARTITION_SHARED;
+        for (size_t i = 0; i < displays.size(); i++) {
+            if (displays[i]->mDisplayId == mpp->mReservedDisplayInfo.displayIdentifier.id)
+                return displays[i]->mDisplayId;
+        }
+        return MPP_PARTITION_SHARED;
+    };
+
+    /*
+     * Capacity of MPP is shared by the logical MPPs of the same HW,
+     * so the HW is given to a display only if all of them are reserved for it.
+     */
+    auto getOwners = [&](ExynosMPPVector &mpps) -> std::vector<uint32_t> {
+        std::vector<uint32_t> reservedOwners(mpps.size());
+        for (size_t i = 0; i < mpps.size(); i++)
+            reservedOwners[i] = getOwner(mpps[i]);
+        std::vector<uint32_t> owners = reservedOwners;
+        for (size_t i = 0; i < mpps.size(); i++) {
+            for (size_t j = 0; j < mpps.size(); j++) {
+                if ((mpps[i]->mPhysicalType == mpps[j]->mPhysicalType) &&
+                    (mpps[i]->mPhysicalIndex == mpps[j]->mPhysicalIndex) &&
+                    (reservedOwners[i] != reservedOwners[j])) {
+                    owners[i] = MPP_PARTITION_SHARED;
+                    break;
+                }
+            }
+        }
+        return owners;
+    };
+    std::vector<uint32_t> otfOwners = getOwners(mOtfMPPs);
+    std::vector<uint32_t> m2mOwners = getOwners(mM2mMPPs);
+
+    for (size_t i = 0; i < displays.size(); i++) {
+        ExynosDisplay *display = displays[i];
+        if (display->mUseDpu == false)
+            continue;
+        for (size_t j = 0; j < otfOwners.size(); j++) {
+            if (otfOwners[j] == display->mDisplayId) {
+                parallelDisplays.add(display);
+                break;
+            }
+        }
+    }
+
+    if (parallelDisplays.size() < 2) {
+        HDEBUGLOGD(eDebugResourceManager, "%s:: %zu displays own otfMPP, skip partition",
+                   __func__, parallelDisplays.size());
+        parallelDisplays.clear();
+        return;
+    }
+
+    auto setPartition = [&](ExynosMPP *mpp, uint32_t owner) {
+        mpp->mPartitionDisplayId = owner;
+        if (owner == MPP_PARTITION_SHARED)
+            mSharedMPPLogicalTypes |= mpp->mLogicalType;
+        HDEBUGLOGD(eDebugResourceManager, "\t%s partition: %d", mpp->mName.string(), owner);
+    };
+    for (size_t i = 0; i < mOtfMPPs.size(); i++)
+        setPartition(mOtfMPPs[i], otfOwners[i]);
+    for (size_t i = 0; i < mM2mMPPs.size(); i++)
+        setPartition(mM2mMPPs[i], m2mOwners[i]);
+}
+
+void ExynosResourceManager::clearMPPPartition() {
+    for (size_t i = 0; i < mOtfMPPs.size(); i++)
+        mOtfMPPs[i]->mPartitionDisplayId = MPP_PARTITION_NONE;
+    for (size_t i = 0; i < mM2mMPPs.size(); i++)
+        mM2mMPPs[i]->mPartitionDisplayId = MPP_PARTITION_NONE;
+}
+
+bool ExynosResourceManager::needSharedMPPs(ExynosDisplay *display) {
+    if (mSharedMPPLogicalTypes == 0)
+        return false;
+
+    for (size_t i = 0; i < display->mLayers.size(); i++) {
+        ExynosLayer *layer = display->mLayers[i];
+        if ((layer->mValidateCompositionType == HWC2_COMPOSITION_CLIENT) &&
+            (layer->mCompositionType != HWC2_COMPOSITION_CLIENT) &&
+            (layer->mSupportedMPPFlag & mSharedMPPLogicalTypes))
+            return true;
+    }
+    return false;
+}
+
+AssignContext &ExynosResourceManager::getAssignContext(ExynosDisplay *display) {
+    Mutex::Autolock lock(mAssignContextMutex);
+    return mAssignContexts[display->mDisplayId];
+}
+
+void ExynosResourceManager::dumpAssignResultCache(String8 &result) {
+    Mutex::Autolock lock(mAssignResultCacheMutex);
+    result.appendFormat("Assign result cache: entries(%zu/%d)\n",
+                        mAssignResultCache.size(), ASSIGN_RESULT_CACHE_SIZE);
+    Mutex::Autolock contextLock(mAssignContextMutex);
+    for (auto &it : mAssignContexts) {
+        result.appendFormat("\tdisplay(%d): hit(%" PRIu64 "), miss(%" PRIu64 "), replay fail(%" PRIu64 ")\n",
+                            it.first, it.second.cacheHitCount, it.second.cacheMissCount,
+                            it.second.cacheReplayFailCount);
+    }
+}
+
+void ExynosResourceManager::dumpCompositionPlanner(String8 &result) {
+    result.appendFormat("Composition planner: budget(%d us)\n", exynosHWCControl.compositionPlanner);
+    Mutex::Autolock lock(mAssignContextMutex);
+    for (auto &it : mAssignContexts) {
+        AssignContext &context = it.second;
+        result.appendFormat("\tdisplay(%d): planned(%" PRIu64 "), skip(%" PRIu64 "), timeout(%" PRIu64 "), fail(%" PRIu64 "), max search(%" PRId64 " us)\n",
+                            it.first, context.plannedCount, context.plannerSkipCount,
+                            context.plannerTimeoutCount, context.plannerFailCount,
+                            ns2us(context.plannerMaxSearchTime));
+    }
+}
+
+void ExynosResourceManager::dumpStaticLayerFlattening(String8 &result) {
+    result.appendFormat("Static layer flattening: min frames(%d), min layers(%d)\n",
+                        STATIC_LAYER_FLATTEN_FRAMES, STATIC_LAYER_FLATTEN_MIN_LAYERS);
+    Mutex::Autolock lock(mAssignContextMutex);
+    for (auto &it : mAssignContexts) {
+        result.appendFormat("\tdisplay(%d): flattened(%" PRIu64 "), fail(%" PRIu64 ")\n",
+                            it.first, it.second.flattenCount, it.second.flattenFailCount);
+    }
+}
+
+void ExynosResourceManager::dumpPerformanceRequests(String8 &result) {
+    Mutex::Autolock lock(mPerformanceRequestMutex);
+    result.appendFormat("M2M performance requests\n");
+    for (uint32_t i = MPP_DPP_NUM; i < MPP_P_TYPE_MAX; i++) {
+        PerformanceRequestInfo &requestInfo = mPerformanceRequests[i];
+        if ((requestInfo.deliveredCount == 0) && (requestInfo.skippedCount == 0))
+            continue;
+        result.appendFormat("\ttype(%d): frames(%d), delivered(%" PRIu64 "), skipped(%" PRIu64 ")\n",
+                            i, requestInfo.request.getFrameCount(),
+                            requestInfo.deliveredCount, requestInfo.skippedCount);
+    }
+}
+
+/*
+ * Assign resources of all layers at once with the lowest cost.
+ * Cost is bytes that are read by DPU, and bytes that are composed
+ * by M2M MPP or GPU are weighted by PLANNER_M2M_COST_WEIGHT, PLANNER_GPU_COST_WEIGHT.
+ * It returns error if the plan can't be found or applied within the time budget,
+ * then resources should be assigned by assignResourceByPriority().
+ */
+int32_t ExynosResourceManager::planAssignResources(ExynosDisplay *display) {
+    ATRACE_CALL();
+    int32_t ret = NO_ERROR;
+    AssignContext &context = getAssignContext(display);
+    CompositionPlan &plan = context.plan;
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    uint32_t budget = exynosHWCControl.compositionPlanner;
+    if (budget == 1)
+        budget = PLANNER_DEFAULT_TIME_BUDGET_US;
+
+    /* Make display state same as the beginning of assignResource() */
+    auto resetPlan = [&]() {
+        resetAssignedResources(display, true);
+        for (uint32_t i = 0; i < display->mLayers.size(); i++) {
+            display->mLayers[i]->resetValidateData();
+            calculateHWResourceAmount(display, display->mLayers[i]);
+        }
+        display->initializeValidateInfos();
+    };
+
+    /* Blending MPP is also planned so that it is reset */
+    resetAssignedResources(display, true);
+    if (buildCompositionPlan(display, plan) != NO_ERROR) {
+        context.plannerSkipCount++;
+        return -EINVAL;
+    }
+
+    plan.deadline = start + us2ns(budget);
+    PlanSearchState state;
+    searchCompositionPlan(plan, 0, state);
+
+    nsecs_t searchTime = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    context.plannerMaxSearchTime = max(context.plannerMaxSearchTime, searchTime);
+    HDEBUGLOGD(eDebugResourceAssigning, "%s:: visited(%d), cost(%f), timeout(%d), %" PRId64 " us",
+               __func__, plan.visitedNodes, plan.bestCost, plan.timeout, ns2us(searchTime));
+
+    if (plan.timeout) {
+        context.plannerTimeoutCount++;
+        resetPlan();
+        return -ETIME;
+    }
+    if (plan.bestChoice.empty()) {
+        context.plannerFailCount++;
+        resetPlan();
+        return -EINVAL;
+    }
+
+    if ((ret = applyCompositionPlan(display, plan)) != NO_ERROR) {
+        HDEBUGLOGD(eDebugResourceAssigning, "%s:: fail to apply plan (%d)", __func__, ret);
+        context.plannerFailCount++;
+        resetPlan();
+        return (ret > 0) ? -EINVAL : ret;
+    }
+
+    context.plannedCount++;
+    return NO_ERROR;
+}
+
+int32_t ExynosResourceManager::buildCompositionPlan(ExynosDisplay *display, CompositionPlan &plan) {
+    uint32_t layerNum = display->mLayers.size();
+
+    /* MPPs are indexed by bits of PlanSearchState */
+    if ((layerNum == 0) || (layerNum > PLANNER_MAX_LAYER_NUM) ||
+        (mOtfMPPs.size() > 64) || (mM2mMPPs.size() > 64))
+        return -EINVAL;
+
+    /* MPPs of other partitions are not visible to the plan */
+    plan.otfMPPs.clear();
+    for (uint32_t i = 0; i < mOtfMPPs.size(); i++) {
+        if (!isPartitionedAway(mOtfMPPs[i], display))
+            plan.otfMPPs.push_back(mOtfMPPs[i]);
+    }
+    plan.m2mMPPs.clear();
+    for (uint32_t i = 0; i < mM2mMPPs.size(); i++) {
+        if (!isPartitionedAway(mM2mMPPs[i], display))
+            plan.m2mMPPs.push_back(mM2mMPPs[i]);
+    }
+    plan.blendingMPP = display->mExynosCompositionInfo.mM2mMPP;
+    plan.maxWindowNum = display->mMaxWindowNum;
+    plan.options.resize(layerNum);
+    plan.validateFlags.resize(layerNum);
+    plan.remainingMinCost.assign(layerNum + 1, 0);
+    plan.choice.assign(layerNum, -1);
+    plan.bestChoice.clear();
+    plan.bestCost = FLT_MAX;
+    plan.timeout = false;
+    plan.visitedNodes = 0;
+
+    plan.blendingCycleBudget = 0;
+    if (plan.blendingMPP != nullptr) {
+        ExynosMPP *blendingMPP = plan.blendingMPP;
+        if (blendingMPP->mCapacity == -1) {
+            plan.blendingCycleBudget = FLT_MAX;
+        } else {
+            /* Same as hasEnoughCapa() */
+            float usedCapa = getResourceUsedCapa(*blendingMPP) - blendingMPP->mUsedCapacity;
+            if ((blendingMPP->mReservedDisplayInfo.displayIdentifier.id == display->mDisplayId) &&
+                (blendingMPP->mPreAssignedCapacity > (float)0.0))
+                usedCapa -= blendingMPP->mPreAssignedCapacity;
+            plan.blendingCycleBudget = (blendingMPP->mCapacity - usedCapa) * blendingMPP->getMPPClock() -
+                                       blendingMPP->getColorFillCycles(display->mDisplayInfo);
+        }
+    }
+
+    auto getTargetOtfMask = [&](uint32_t targetType) -> uint64_t {
+        ExynosCompositionInfo &compositionInfo = (targetType == COMPOSITION_CLIENT)
+                                                     ? display->mClientCompositionInfo
+                                                     : display->mExynosCompositionInfo;
+        exynos_image src_img;
+        exynos_image dst_img;
+        uint64_t mask = 0;
+
+        display->setCompositionTargetExynosImage(targetType, &src_img, &dst_img);
+        compositionInfo.setExynosImage(src_img, dst_img);
+        compositionInfo.setExynosMidImage(dst_img);
+        calculateHWResourceAmount(display, &compositionInfo);
+        for (uint32_t i = 0; i < plan.otfMPPs.size(); i++) {
+#ifdef USE_DEDICATED_TOP_WINDOW
+            if ((plan.otfMPPs[i]->mPhysicalType == DEDICATED_CHANNEL_TYPE) &&
+                (plan.otfMPPs[i]->mPhysicalIndex == DEDICATED_CHANNEL_INDEX))
+                continue;
+#endif
+            if ((plan.otfMPPs[i]->isSupported(display->mDisplayInfo, src_img, dst_img) == NO_ERROR) &&
+                isAssignable(plan.otfMPPs[i], display, src_img, dst_img, &compositionInfo))
+                mask |= (1ULL << i);
+        }
+        return mask;
+    };
+    float targetBytes = (float)display->mXres * display->mYres * 4;
+    plan.clientTargetOtfMask = getTargetOtfMask(COMPOSITION_CLIENT);
+    plan.clientTargetCost = targetBytes * (1 + PLANNER_GPU_COST_WEIGHT);
+    plan.exynosTargetOtfMask = (plan.blendingMPP != nullptr) ? getTargetOtfMask(COMPOSITION_EXYNOS) : 0;
+    plan.exynosTargetCost = targetBytes * (1 + PLANNER_M2M_COST_WEIGHT);
+
+    for (uint32_t i = 0; i < layerNum; i++) {
+        ExynosLayer *layer = display->mLayers[i];
+        std::vector<PlanLayerOption> &options = plan.options[i];
+        exynos_image src_img;
+        exynos_image dst_img;
+        layer->setSrcExynosImage(&src_img);
+        layer->setDstExynosImage(&dst_img);
+        layer->setExynosImage(src_img, dst_img);
+        layer->setExynosMidImage(dst_img);
+
+        /* HDR10+ layer can be changed to HDR10 layer while it is assigned */
+        if (hasHdr10Plus(src_img))
+            return -EINVAL;
+
+        uint32_t validateFlag = validateLayer(i, display, layer);
+        float srcBytes = (float)src_img.w * src_img.h * src_img.exynosFormat.bpp() / 8;
+        plan.validateFlags[i] = validateFlag;
+        options.clear();
+
+        if ((validateFlag == NO_ERROR) || (validateFlag & eDimLayer)) {
+            addPlanDeviceOptions(display, layer, i, plan, options);
+
+            ExynosMPP *blendingMPP = plan.blendingMPP;
+            /* High priority layer is not composed with other layers */
+            if ((blendingMPP != nullptr) && (layer->mOverlayPriority < ePriorityHigh) &&
+                (layer->mSupportedMPPFlag & blendingMPP->mLogicalType) &&
+                blendingMPP->isAssignableState(display->mDisplayInfo, src_img, dst_img)) {
+                PlanLayerOption option;
+                option.compositionType = HWC2_COMPOSITION_EXYNOS;
+                option.cost = srcBytes * PLANNER_M2M_COST_WEIGHT;
+                blendingMPP->getSrcBaseCycles(src_img, dst_img, option.cycles);
+                option.rotated = ((src_img.transform & HAL_TRANSFORM_ROT_90) != 0);
+                options.push_back(option);
+            }
+        }
+
+        /* High priority layer is composed by GPU only if there is no other way */
+        if (options.empty() || (layer->mOverlayPriority < ePriorityHigh)) {
+            PlanLayerOption option;
+            option.compositionType = HWC2_COMPOSITION_CLIENT;
+            option.cost = srcBytes * PLANNER_GPU_COST_WEIGHT;
+            options.push_back(option);
+        }
+
+        /* Options with the same cost keep the order of MPPs */
+        std::stable_sort(options.begin(), options.end(),
+                         [](const PlanLayerOption &lhs, const PlanLayerOption &rhs) {
+                             return lhs.cost < rhs.cost;
+                         });
+    }
+
+    for (int32_t i = (int32_t)layerNum - 1; i >= 0; i--)
+        plan.remainingMinCost[i] = plan.remainingMinCost[i + 1] + plan.options[i][0].cost;
+
+    return NO_ERROR;
+}
+
+/* Options are checked in the same way as findLayerAssignment() */
+void ExynosResourceManager::addPlanDeviceOptions(ExynosDisplay *display, ExynosLayer *layer, uint32_t layer_index,
+                                                 CompositionPlan &plan, std::vector<PlanLayerOption> &options) {
+    exynos_image src_img;
+    exynos_image dst_img;
+    layer->setSrcExynosImage(&src_img);
+    layer->setDstExynosImage(&dst_img);
+    float srcBytes = (float)src_img.w * src_img.h * src_img.exynosFormat.bpp() / 8;
+
+    /* 1. otfMPP reads the source */
+    for (uint32_t j = 0; j < plan.otfMPPs.size(); j++) {
+        ExynosMPP *otfMPP = plan.otfMPPs[j];
+#ifdef USE_DEDICATED_TOP_WINDOW
+        if ((otfMPP->mPhysicalType == DEDICATED_CHANNEL_TYPE) &&
+            (otfMPP->mPhysicalIndex == DEDICATED_CHANNEL_INDEX) &&
+            (uint32_t)layer_index != (display->mLayers.size() - 1))
+            continue;
+#endif
+        if (((layer->mSupportedMPPFlag & otfMPP->mLogicalType) == 0) ||
+            (!isAssignable(otfMPP, display, src_img, dst_img, layer)) ||
+            (otfMPP->isSupported(display->mDisplayInfo, src_img, dst_img) != NO_ERROR))
+            continue;
+
+        PlanLayerOption option;
+        option.compositionType = HWC2_COMPOSITION_DEVICE;
+        option.otfIndex = j;
+        option.cost = srcBytes;
+        options.push_back(option);
+    }
+
+    /* 2. otfMPP reads the output of m2mMPP */
+    std::vector<exynos_image> image_lists;
+    bool hasImageLists = false;
+    for (uint32_t j = 0; j < plan.m2mMPPs.size(); j++) {
+        ExynosMPP *m2mMPP = plan.m2mMPPs[j];
+        if ((m2mMPP->mLogicalType == MPP_LOGICAL_G2D_COMBO) ||
+            (m2mMPP->mLogicalType == MPP_LOGICAL_MSC_COMBO) ||
+            (m2mMPP->mMaxSrcLayerNum > 1))
+            continue;
+        if (!m2mMPP->isAssignableState(display->mDisplayInfo, src_img, dst_img))
+            continue;
+
+        if (!hasImageLists) {
+            if (getCandidateM2mMPPOutImages(display, layer, image_lists) < 0)
+                return;
+            hasImageLists = true;
+        }
+
+        float totalUsedCapa = ExynosResourceManager::getResourceUsedCapa(*m2mMPP);
+        exynos_image otf_dst_img = dst_img;
+        otf_dst_img.exynosFormat = ExynosMPP::defaultMppDstFormat;
+        /* transform is already handled by m2mMPP */
+        otf_dst_img.transform = 0;
+
+        for (auto &candidate : image_lists) {
+            exynos_image otf_src_img = candidate;
+            exynos_image m2m_src_img = src_img;
+            otf_src_img.transform = 0;
+            if (otf_src_img.needColorTransform)
+                m2m_src_img.needColorTransform = false;
+
+            if ((m2mMPP->isSupported(display->mDisplayInfo, m2m_src_img, otf_src_img) != NO_ERROR) ||
+                (!m2mMPP->hasEnoughCapa(display->mDisplayInfo, m2m_src_img, otf_src_img, totalUsedCapa)))
+                continue;
+
+            float outBytes = (float)otf_src_img.w * otf_src_img.h * otf_src_img.exynosFormat.bpp() / 8;
+            bool found = false;
+            for (uint32_t k = 0; k < plan.otfMPPs.size(); k++) {
+                ExynosMPP *otfMPP = plan.otfMPPs[k];
+#ifdef USE_DEDICATED_TOP_WINDOW
+                if ((otfMPP->mPhysicalType == DEDICATED_CHANNEL_TYPE) &&
+                    (otfMPP->mPhysicalIndex == DEDICATED_CHANNEL_INDEX) &&
+                    (uint32_t)layer_index != (display->mLayers.size() - 1))
+                    continue;
+#endif
+                if (otfMPP->isSupported(display->mDisplayInfo, otf_src_img, otf_dst_img) != NO_ERROR)
+                    continue;
+
+                /* to prevent HW resource execeeded */
+                ExynosCompositionInfo dpuSrcInfo;
+                dpuSrcInfo.mSrcImg = otf_src_img;
+                dpuSrcInfo.mDstImg = otf_dst_img;
+                calculateHWResourceAmount(display, &dpuSrcInfo);
+                if (!isAssignable(otfMPP, display, otf_src_img, otf_dst_img, &dpuSrcInfo))
+                    continue;
+
+                PlanLayerOption option;
+                option.compositionType = HWC2_COMPOSITION_DEVICE;
+                option.otfIndex = k;
+                option.m2mIndex = j;
+                option.m2mOutImg = otf_src_img;
+                option.cost = (srcBytes + outBytes) * PLANNER_M2M_COST_WEIGHT + outBytes;
+                options.push_back(option);
+                found = true;
+            }
+            /* Candidate images are in order of preference */
+            if (found)
+                break;
+        }
+    }
+}
+
+void ExynosResourceManager::searchCompositionPlan(CompositionPlan &plan, uint32_t index,
+                                                  const PlanSearchState &state) {
+    if (plan.timeout)
+        return;
+    /* Time is checked every 64 nodes */
+    if (((++plan.visitedNodes & 0x3f) == 0) &&
+        (systemTime(SYSTEM_TIME_MONOTONIC) > plan.deadline)) {
+        plan.timeout = true;
+        return;
+    }
+    if ((state.cost + plan.remainingMinCost[index]) >= plan.bestCost)
+        return;
+
+    if (index == plan.options.size()) {
+        if (hasPlanTargetWindows(plan, state)) {
+            plan.bestCost = state.cost;
+            plan.bestChoice = plan.choice;
+        }
+        return;
+    }
+
+    const std::vector<PlanLayerOption> &options = plan.options[index];
+    for (uint32_t i = 0; i < options.size(); i++) {
+        const PlanLayerOption &option = options[i];
+        PlanSearchState next = state;
+        next.cost += option.cost;
+
+        /* Composition range is closed by a layer of other composition */
+        if ((option.compositionType != HWC2_COMPOSITION_CLIENT) &&
+            (next.clientRange == PLAN_RANGE_OPEN))
+            next.clientRange = PLAN_RANGE_CLOSED;
+        if ((option.compositionType != HWC2_COMPOSITION_EXYNOS) &&
+            (next.exynosRange == PLAN_RANGE_OPEN))
+            next.exynosRange = PLAN_RANGE_CLOSED;
+
+        if (option.compositionType == HWC2_COMPOSITION_DEVICE) {
+            uint64_t otfBit = 1ULL << option.otfIndex;
+            if (next.usedOtfMask & otfBit)
+                continue;
+            next.usedOtfMask |= otfBit;
+            if (option.m2mIndex >= 0) {
+                uint64_t m2mBit = 1ULL << option.m2mIndex;
+                if (next.usedM2mMask & m2mBit)
+                    continue;
+                next.usedM2mMask |= m2mBit;
+            }
+            next.windowNum++;
+        } else if (option.compositionType == HWC2_COMPOSITION_CLIENT) {
+            if (next.clientRange == PLAN_RANGE_CLOSED)
+                continue;
+            if (next.clientRange == PLAN_RANGE_NONE) {
+                next.clientRange = PLAN_RANGE_OPEN;
+                next.cost += plan.clientTargetCost;
+                next.windowNum++;
+            }
+        } else {
+            if (next.exynosRange == PLAN_RANGE_CLOSED)
+                continue;
+            if (next.exynosRange == PLAN_RANGE_NONE) {
+                next.exynosRange = PLAN_RANGE_OPEN;
+                next.cost += plan.exynosTargetCost;
+                next.windowNum++;
+            }
+            next.blendingSrcNum++;
+            next.blendingCycles[PPC_ROT_NO] += option.cycles[PPC_ROT_NO];
+            next.blendingCycles[PPC_ROT] += option.cycles[PPC_ROT];
+            next.blendingRotated |= option.rotated;
+            float cycles = next.blendingCycles[next.blendingRotated ? PPC_ROT : PPC_ROT_NO];
+            if ((next.blendingSrcNum > plan.blendingMPP->mMaxSrcLayerNum) ||
+                (cycles > plan.blendingCycleBudget))
+                continue;
+        }
+
+        if (next.windowNum > plan.maxWindowNum)
+            continue;
+
+        plan.choice[index] = i;
+        searchCompositionPlan(plan, index + 1, next);
+    }
+}
+
+/* Each composition target needs its own otfMPP */
+bool ExynosResourceManager::hasPlanTargetWindows(const CompositionPlan &plan,
+                                                 const PlanSearchState &state) {
+    bool needClient = (state.clientRange != PLAN_RANGE_NONE);
+    bool needExynos = (state.exynosRange != PLAN_RANGE_NONE);
+    uint64_t clientMask = plan.clientTargetOtfMask & ~state.usedOtfMask;
+    uint64_t exynosMask = plan.exynosTargetOtfMask & ~state.usedOtfMask;
+
+    if ((needClient && (clientMask == 0)) || (needExynos && (exynosMask == 0)))
+        return false;
+    if (needClient && needExynos)
+        return (__builtin_popcountll(clientMask | exynosMask) >= 2);
+    return true;
+}
+
+int32_t ExynosResourceManager::applyCompositionPlan(ExynosDisplay *display, CompositionPlan &plan) {
+    int32_t ret = NO_ERROR;
+    ExynosCompositionInfo &clientInfo = display->mClientCompositionInfo;
+    ExynosCompositionInfo &exynosInfo = display->mExynosCompositionInfo;
+
+    for (uint32_t i = 0; i < display->mLayers.size(); i++) {
+        ExynosLayer *layer = display->mLayers[i];
+        const std::vector<PlanLayerOption> &options = plan.options[i];
+        const PlanLayerOption &option = options[plan.bestChoice[i]];
+        exynos_image src_img;
+        exynos_image dst_img;
+        layer->setSrcExynosImage(&src_img);
+        layer->setDstExynosImage(&dst_img);
+        layer->setExynosImage(src_img, dst_img);
+        layer->setExynosMidImage(dst_img);
+
+        if (option.compositionType == HWC2_COMPOSITION_DEVICE) {
+            ExynosMPP *otfMPP = plan.otfMPPs[option.otfIndex];
+            if ((ret = otfMPP->assignMPP(display->mDisplayInfo, layer)) != NO_ERROR)
+                return ret;
+            if (option.m2mIndex >= 0) {
+                ExynosMPP *m2mMPP = plan.m2mMPPs[option.m2mIndex];
+                exynos_image m2m_src_img = src_img;
+                exynos_image m2m_out_img = option.m2mOutImg;
+                if (m2m_out_img.needColorTransform)
+                    m2m_src_img.needColorTransform = false;
+                /* M2M MPPs sharing HW were checked one by one */
+                if (!m2mMPP->hasEnoughCapa(display->mDisplayInfo, m2m_src_img, m2m_out_img,
+                                           getResourceUsedCapa(*m2mMPP)))
+                    return eInsufficientMPP;
+                if ((ret = m2mMPP->assignMPP(display->mDisplayInfo, layer)) != NO_ERROR)
+                    return ret;
+                layer->setExynosMidImage(m2m_out_img);
+            }
+            display->mWindowNumUsed++;
+        } else if (option.compositionType == HWC2_COMPOSITION_EXYNOS) {
+            if (!plan.blendingMPP->hasEnoughCapa(display->mDisplayInfo, src_img, dst_img,
+                                                 getResourceUsedCapa(*plan.blendingMPP)))
+                return eInsufficientMPP;
+            if ((ret = plan.blendingMPP->assignMPP(display->mDisplayInfo, layer)) != NO_ERROR)
+                return ret;
+            if (!exynosInfo.mHasCompositionLayer) {
+                exynosInfo.mHasCompositionLayer = true;
+                exynosInfo.mFirstIndex = i;
+            }
+            exynosInfo.mLastIndex = i;
+        } else {
+            if (plan.validateFlags[i] != NO_ERROR)
+                layer->mOverlayInfo |= plan.validateFlags[i];
+            else if (options.size() > 1)
+                layer->mOverlayInfo |= ePlannedClientComposition;
+            else
+                layer->mOverlayInfo |= eMPPUnsupported;
+            if (!clientInfo.mHasCompositionLayer) {
+                clientInfo.mHasCompositionLayer = true;
+                clientInfo.mFirstIndex = i;
+            }
+            clientInfo.mLastIndex = i;
+        }
+        layer->mValidateCompositionType = option.compositionType;
+        HDEBUGLOGD(eDebugResourceAssigning, "\t\t[%d] layer: planned type(%d), cost(%f)",
+                   i, option.compositionType, option.cost);
+    }
+
+    if ((ret = assignCompositionTarget(display, COMPOSITION_CLIENT)) != NO_ERROR)
+        return ret;
+    if ((ret = assignCompositionTarget(display, COMPOSITION_EXYNOS)) != NO_ERROR)
+        return ret;
+
+    return setResourcePriority(display);
+}
+
 int32_t ExynosResourceManager::assignLayers(ExynosDisplay *display, uint32_t priority) {
     HDEBUGLOGD(eDebugResourceAssigning, "%s:: display(%d), priority(%d) +++++",
                __func__, display->mType, priority);
@@ -1578,12 +2625,46 @@ int32_t ExynosResourceManager::assignWindow(ExynosDisplay *display) {
     return ret;
 }
 
+void ExynosResourceManager::checkSupportedMPP(ExynosDisplay *display, ExynosLayer *layer, ExynosMPP *mpp,
+                                              exynos_image &src_img, exynos_image &dst_img,
+                                              exynos_image &dst_img_yuv) {
+    int64_t ret = 0;
+    if ((ret = mpp->isSupported(display->mDisplayInfo, src_img, dst_img)) == NO_ERROR) {
+        layer->mSupportedMPPFlag |= mpp->mLogicalType;
+        HDEBUGLOGD(eDebugResourceAssigning, "\t%s: supported", mpp->mName.string());
+    } else {
+        if (((-ret) == eMPPUnsupportedFormat) &&
+            ((ret = mpp->isSupported(display->mDisplayInfo, src_img, dst_img_yuv)) == NO_ERROR)) {
+            layer->mSupportedMPPFlag |= mpp->mLogicalType;
+            HDEBUGLOGD(eDebugResourceAssigning, "\t%s: supported with yuv dst", mpp->mName.string());
+        }
+    }
+    if (ret < 0) {
+        HDEBUGLOGD(eDebugResourceAssigning, "\t%s: unsupported flag(0x%" PRIx64 ")", mpp->mName.string(), -ret);
+        uint64_t checkFlag = 0x0;
+        if (layer->mCheckMPPFlag.find(mpp->mLogicalType) !=
+            layer->mCheckMPPFlag.end()) {
+            checkFlag = layer->mCheckMPPFlag.at(mpp->mLogicalType);
+        }
+        checkFlag |= (-ret);
+        layer->mCheckMPPFlag[mpp->mLogicalType] = checkFlag;
+    }
+}
+
+void ExynosResourceManager::setSupportedMPPImages(ExynosLayer *layer, exynos_image &src_img,
+                                                  exynos_image &dst_img, exynos_image &dst_img_yuv) {
+    layer->setSrcExynosImage(&src_img);
+    layer->setDstExynosImage(&dst_img);
+    layer->setDstExynosImage(&dst_img_yuv);
+    dst_img.exynosFormat = ExynosMPP::defaultMppDstFormat;
+    dst_img_yuv.exynosFormat = ExynosMPP::defaultMppDstYuvFormat;
+}
+
 /**
  * @param * display
  * @return int
  */
 int32_t ExynosResourceManager::updateSupportedMPPFlag(ExynosDisplay *display) {
-    int64_t ret = 0;
     HDEBUGLOGD(eDebugResourceAssigning, "%s++++++++++", __func__);
     for (uint32_t i = 0; i < display->mLayers.size(); i++) {
         ExynosLayer *layer = display->mLayers[i];
@@ -1595,11 +2676,7 @@ int32_t ExynosResourceManager::updateSupportedMPPFlag(ExynosDisplay *display) {
         exynos_image src_img;
         exynos_image dst_img;
         exynos_image dst_img_yuv;
-        layer->setSrcExynosImage(&src_img);
-        layer->setDstExynosImage(&dst_img);
-        layer->setDstExynosImage(&dst_img_yuv);
-        dst_img.exynosFormat = ExynosMPP::defaultMppDstFormat;
-        dst_img_yuv.exynosFormat = ExynosMPP::defaultMppDstYuvFormat;
+        setSupportedMPPImages(layer, src_img, dst_img, dst_img_yuv);
         HDEBUGLOGD(eDebugResourceAssigning, "\tsrc_img");
         dumpExynosImage(eDebugResourceAssigning, src_img);
         HDEBUGLOGD(eDebugResourceAssigning, "\tdst_img");
@@ -1607,62 +2684,63 @@ int32_t ExynosResourceManager::updateSupportedMPPFlag(ExynosDisplay *display) {
 
         /* Initialize flags */
         layer->mSupportedMPPFlag = 0;
+        layer->mUncheckedMPPFlag = 0;
         layer->mCheckMPPFlag.clear();
 
+        /*
+         * MPPs of other partitions are checked by updateUncheckedMPPFlag()
+         * after displays are assigned in parallel.
+         */
         /* Check OtfMPPs */
         for (uint32_t j = 0; j < mOtfMPPs.size(); j++) {
-            if ((ret = mOtfMPPs[j]->isSupported(display->mDisplayInfo, src_img, dst_img)) == NO_ERROR) {
-                layer->mSupportedMPPFlag |= mOtfMPPs[j]->mLogicalType;
-                HDEBUGLOGD(eDebugResourceAssigning, "\t%s: supported", mOtfMPPs[j]->mName.string());
-            } else {
-                if (((-ret) == eMPPUnsupportedFormat) &&
-                    ((ret = mOtfMPPs[j]->isSupported(display->mDisplayInfo, src_img, dst_img_yuv)) == NO_ERROR)) {
-                    layer->mSupportedMPPFlag |= mOtfMPPs[j]->mLogicalType;
-                    HDEBUGLOGD(eDebugResourceAssigning, "\t%s: supported with yuv dst", mOtfMPPs[j]->mName.string());
-                }
-            }
-            if (ret < 0) {
-                HDEBUGLOGD(eDebugResourceAssigning, "\t%s: unsupported flag(0x%" PRIx64 ")", mOtfMPPs[j]->mName.string(), -ret);
-                uint64_t checkFlag = 0x0;
-                if (layer->mCheckMPPFlag.find(mOtfMPPs[j]->mLogicalType) !=
-                    layer->mCheckMPPFlag.end()) {
-                    checkFlag = layer->mCheckMPPFlag.at(mOtfMPPs[j]->mLogicalType);
-                }
-                checkFlag |= (-ret);
-                layer->mCheckMPPFlag[mOtfMPPs[j]->mLogicalType] = checkFlag;
+            if (isPartitionedAway(mOtfMPPs[j], display)) {
+                layer->mUncheckedMPPFlag |= mOtfMPPs[j]->mLogicalType;
+                continue;
             }
+            checkSupportedMPP(display, layer, mOtfMPPs[j], src_img, dst_img, dst_img_yuv);
         }
 
         /* Check M2mMPPs */
         for (uint32_t j = 0; j < mM2mMPPs.size(); j++) {
-            if ((ret = mM2mMPPs[j]->isSupported(display->mDisplayInfo, src_img, dst_img)) == NO_ERROR) {
-                layer->mSupportedMPPFlag |= mM2mMPPs[j]->mLogicalType;
-                HDEBUGLOGD(eDebugResourceAssigning, "\t%s: supported", mM2mMPPs[j]->mName.string());
-            } else {
-                if (((-ret) == eMPPUnsupportedFormat) &&
-                    ((ret = mM2mMPPs[j]->isSupported(display->mDisplayInfo, src_img, dst_img_yuv)) == NO_ERROR)) {
-                    layer->mSupportedMPPFlag |= mM2mMPPs[j]->mLogicalType;
-                    HDEBUGLOGD(eDebugResourceAssigning, "\t%s: supported with yuv dst", mM2mMPPs[j]->mName.string());
-                }
-            }
-            if (ret < 0) {
-                HDEBUGLOGD(eDebugResourceAssigning, "\t%s: unsupported flag(0x%" PRIx64 ")", mM2mMPPs[j]->mName.string(), -ret);
-                uint64_t checkFlag = 0x0;
-                if (layer->mCheckMPPFlag.find(mM2mMPPs[j]->mLogicalType) !=
-                    layer->mCheckMPPFlag.end()) {
-                    checkFlag = layer->mCheckMPPFlag.at(mM2mMPPs[j]->mLogicalType);
-                }
-                checkFlag |= (-ret);
-                layer->mCheckMPPFlag[mM2mMPPs[j]->mLogicalType] = checkFlag;
+            if (isPartitionedAway(mM2mMPPs[j], display)) {
+                layer->mUncheckedMPPFlag |= mM2mMPPs[j]->mLogicalType;
+                continue;
             }
+            checkSupportedMPP(display, layer, mM2mMPPs[j], src_img, dst_img, dst_img_yuv);
         }
-        HDEBUGLOGD(eDebugResourceAssigning, "[%d] layer mSupportedMPPFlag(0x%8x)", i, layer->mSupportedMPPFlag);
+        HDEBUGLOGD(eDebugResourceAssigning, "[%d] layer mSupportedMPPFlag(0x%8x), mUncheckedMPPFlag(0x%8x)",
+                   i, layer->mSupportedMPPFlag, layer->mUncheckedMPPFlag);
     }
     HDEBUGLOGD(eDebugResourceAssigning, "%s-------------", __func__);
 
     return NO_ERROR;
 }
 
+void ExynosResourceManager::updateUncheckedMPPFlag(ExynosDisplay *display) {
+    for (uint32_t i = 0; i < display->mLayers.size(); i++) {
+        ExynosLayer *layer = display->mLayers[i];
+        if (layer->mUncheckedMPPFlag == 0)
+            continue;
+
+        exynos_image src_img;
+        exynos_image dst_img;
+        exynos_image dst_img_yuv;
+        setSupportedMPPImages(layer, src_img, dst_img, dst_img_yuv);
+
+        for (uint32_t j = 0; j < mOtfMPPs.size(); j++) {
+            if (layer->mUncheckedMPPFlag & mOtfMPPs[j]->mLogicalType)
+                checkSupportedMPP(display, layer, mOtfMPPs[j], src_img, dst_img, dst_img_yuv);
+        }
+        for (uint32_t j = 0; j < mM2mMPPs.size(); j++) {
+            if (layer->mUncheckedMPPFlag & mM2mMPPs[j]->mLogicalType)
+                checkSupportedMPP(display, layer, mM2mMPPs[j], src_img, dst_img, dst_img_yuv);
+        }
+        layer->mUncheckedMPPFlag = 0;
+        HDEBUGLOGD(eDebugResourceAssigning, "%s:: [%d] layer mSupportedMPPFlag(0x%8x)",
+                   __func__, i, layer->mSupportedMPPFlag);
+    }
+}
+
 int32_t ExynosResourceManager::resetResources() {
     HDEBUGLOGD(eDebugResourceManager, "%s+++++++++", __func__);
 
@@ -1839,14 +2917,36 @@ void ExynosResourceManager::setFrameRateForPerformance(ExynosMPP &mpp,
     frame->setFrameRate(M2MFps);
 }
 
+bool ExynosResourceManager::deliverPerformanceRequest(PerformanceRequestInfo &requestInfo,
+                                                      Acrylic *handle) {
+    uint64_t hash = requestInfo.request.getHash();
+    if ((requestInfo.deliveredHandle == handle) && (requestInfo.deliveredHash == hash)) {
+        requestInfo.skippedCount++;
+        return false;
+    }
+
+    requestInfo.deliveredCount++;
+    if (!handle->requestPerformanceQoS(&requestInfo.request)) {
+        /* Deliver it again in the next frame */
+        requestInfo.deliveredHandle = nullptr;
+        return false;
+    }
+    requestInfo.deliveredHandle = handle;
+    requestInfo.deliveredHash = hash;
+    return true;
+}
+
 int32_t ExynosResourceManager::deliverPerformanceInfo(ExynosDisplay *display) {
     int ret = NO_ERROR;
 
     if (display == nullptr)
         return -EINVAL;
 
+    ScopedLatency latency(&display->mLatencyRecorder, LATENCY_STAGE_DELIVER_PERFORMANCE);
+    Mutex::Autolock lock(mPerformanceRequestMutex);
     for (uint32_t mpp_physical_type = MPP_DPP_NUM; mpp_physical_type < MPP_P_TYPE_MAX; mpp_physical_type++) {
-        AcrylicPerformanceRequest request;
+        PerformanceRequestInfo &requestInfo = mPerformanceRequests[mpp_physical_type];
+        AcrylicPerformanceRequest &request = requestInfo.request;
         uint32_t assignedInstanceNum = 0;
         uint32_t assignedInstanceIndex = 0;
         ExynosMPP *mpp = NULL;
@@ -1980,7 +3080,9 @@ int32_t ExynosResourceManager::deliverPerformanceInfo(ExynosDisplay *display) {
                 (mpp->mAssignedSources.size() > 0) &&
                 (mpp->mAssignedDisplayInfo.displayIdentifier.id == display->mDisplayId) &&
                 (mpp->canSkipProcessing() == false)) {
-                mpp->mAcrylicHandle->requestPerformanceQoS(&request);
+                if (!deliverPerformanceRequest(requestInfo, mpp->mAcrylicHandle))
+                    HDEBUGLOGD(eDebugResourceManager, "M2M(%d) performance request is not delivered",
+                               mpp_physical_type);
                 break;
             }
         }
@@ -2105,6 +3207,8 @@ void ExynosResourceManager::makeM2MRestrictions() {
             }
         }
     }
+
+    updateCapabilityTables();
 }
 
 void ExynosResourceManager::makeAcrylRestrictions(mpp_phycal_type_t type) {
@@ -2237,6 +3341,9 @@ ExynosMPP *ExynosResourceManager::getOtfMPPWithChannel(int ch) {
 }
 
 void ExynosResourceManager::updateRestrictions() {
+    /* Cached assignment results were checked with previous restrictions */
+    invalidateAssignResultCache();
+
     uint32_t formatRestrictionCnt = sizeof(restriction_format_table) / sizeof(restriction_key);
     for (uint32_t i = 0; i < formatRestrictionCnt; i++)
         addFormatRestrictions(restriction_format_table[i]);
@@ -2275,6 +3382,15 @@ void ExynosResourceManager::updateRestrictions() {
             }
         }
     }
+
+    updateCapabilityTables();
+}
+
+void ExynosResourceManager::updateCapabilityTables() {
+    for (auto mpp : mOtfMPPs)
+        mpp->updateCapabilityTable();
+    for (auto mpp : mM2mMPPs)
+        mpp->updateCapabilityTable();
 }
 
 uint32_t ExynosResourceManager::getFeatureTableSize() const {
@@ -2538,6 +3654,8 @@ void ExynosResourceManager::updateSupportWCG() {
 
 void ExynosResourceManager::makeDPURestrictions(
     struct dpp_restrictions_info_v2 *dpuInfo, bool checkOverlap) {
+    invalidateAssignResultCache();
+
     bool overlap[16] = {
         false,
     };
@@ -2633,6 +3751,8 @@ void ExynosResourceManager::makeDPURestrictions(
             setDPUFeature(mpp, dpuInfo->dpp_ch[i].attr);
         }
     }
+
+    updateCapabilityTables();
 }
 
 void ExynosResourceManager::updateMPPFeature(bool updateOtfMPP) {
@@ -2659,6 +3779,8 @@ void ExynosResourceManager::updateMPPFeature(bool updateOtfMPP) {
             }
         }
     }
+
+    updateCapabilityTables();
 }
 
 void ExynosResourceManager::updateFeatureTable(struct dpp_restrictions_info_v2 *dpuInfo) {
@@ -2768,6 +3890,9 @@ bool ExynosResourceManager::isAssignable(ExynosMPP *candidateMPP, ExynosDisplay
                                          struct exynos_image &src, struct exynos_image &dst, ExynosMPPSource *mppSrc) {
     bool ret = true;
 
+    if (isPartitionedAway(candidateMPP, display))
+        return false;
+
     float totalUsedCapacity = getResourceUsedCapa(*candidateMPP);
     ret = candidateMPP->isAssignable(display->mDisplayInfo, src, dst, totalUsedCapacity);
 
@@ -21,6 +21,7 @@
 #ifndef _EXYNOSRESOURCEMANAGER_H
 #define _EXYNOSRESOURCEMANAGER_H
 
+#include <list>
 #include <vector>
 #include "ExynosDisplay.h"
 #include "ExynosHWCHelper.h"
@@ -34,8 +35,33 @@ class ExynosMPP;
 
 #define ASSIGN_RESOURCE_TRY_COUNT 100
 
+/* Number of layer stacks whose assignment result is kept for reuse */
+#ifndef ASSIGN_RESULT_CACHE_SIZE
+#define ASSIGN_RESULT_CACHE_SIZE 8
+#endif
+
 #define MAX_OVERLAY_LAYER_NUM 30
 
+/*
+ * Composition planner searches the assignment of all layers of a display
+ * at once instead of assigning layers one by one by priority.
+ * It is enabled by exynosHWCControl.compositionPlanner.
+ */
+#ifndef PLANNER_MAX_LAYER_NUM
+#define PLANNER_MAX_LAYER_NUM 16
+#endif
+/* Time budget of a search, greedy assignment is used if it is exceeded */
+#ifndef PLANNER_DEFAULT_TIME_BUDGET_US
+#define PLANNER_DEFAULT_TIME_BUDGET_US 500
+#endif
+/* Cost of a byte composed by GPU or M2M MPP, a byte read by DPU costs 1 */
+#ifndef PLANNER_GPU_COST_WEIGHT
+#define PLANNER_GPU_COST_WEIGHT 4
+#endif
+#ifndef PLANNER_M2M_COST_WEIGHT
+#define PLANNER_M2M_COST_WEIGHT 2
+#endif
+
 struct EnableMPPRequest {
     EnableMPPRequest(uint32_t _physicalType, uint32_t _physicalIndex,
                      uint32_t _logicalIndex, uint32_t _enable) : physicalType(_physicalType), physicalIndex(_physicalIndex),
@@ -46,6 +72,134 @@ struct EnableMPPRequest {
     uint32_t enable;
 };
 
+/* Result of assignLayer() for one layer */
+struct AssignLayerResult {
+    bool valid = false;
+    int32_t compositionType = HWC2_COMPOSITION_INVALID;
+    uint32_t validateFlag = 0;
+    uint32_t overlayInfo = 0;
+    ExynosMPP *otfMPP = nullptr;
+    ExynosMPP *m2mMPP = nullptr;
+    exynos_image m2mOutImg;
+};
+
+/*
+ * Layer geometry and state of MPPs when assignment was started.
+ * hash is FNV-1a of key, key is compared only when hash is same.
+ */
+struct AssignSignature {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    std::vector<uint64_t> key;
+
+    bool operator==(const AssignSignature &other) const {
+        return (hash == other.hash) && (key == other.key);
+    };
+    /* Capacity of key is kept */
+    void reset() {
+        hash = AssignSignature().hash;
+        key.clear();
+    };
+};
+
+/* Assignment result of a display, keyed by the signature */
+struct AssignResultCacheEntry {
+    uint32_t displayId = UINT32_MAX;
+    AssignSignature signature;
+    std::vector<AssignLayerResult> layerResults;
+};
+
+/* Composition that can be selected for a layer by the composition planner */
+struct PlanLayerOption {
+    int32_t compositionType = HWC2_COMPOSITION_INVALID;
+    /* Index of CompositionPlan::otfMPPs, -1 if it is not used */
+    int32_t otfIndex = -1;
+    /* Index of CompositionPlan::m2mMPPs, -1 if it is not used */
+    int32_t m2mIndex = -1;
+    exynos_image m2mOutImg;
+    float cost = 0;
+    /* Base cycles of blending MPP for each rot_index_t */
+    float cycles[PPC_ROT_MAX] = {0, 0};
+    bool rotated = false;
+};
+
+struct CompositionPlan {
+    std::vector<ExynosMPP *> otfMPPs;
+    std::vector<ExynosMPP *> m2mMPPs;
+    ExynosMPP *blendingMPP = nullptr;
+    /* Options of each layer sorted by cost */
+    std::vector<std::vector<PlanLayerOption>> options;
+    std::vector<uint32_t> validateFlags;
+    /* Sum of minimum cost of layers from the index to the top layer */
+    std::vector<float> remainingMinCost;
+    uint64_t clientTargetOtfMask = 0;
+    uint64_t exynosTargetOtfMask = 0;
+    float clientTargetCost = 0;
+    float exynosTargetCost = 0;
+    float blendingCycleBudget = 0;
+    uint32_t maxWindowNum = 0;
+    nsecs_t deadline = 0;
+    bool timeout = false;
+    uint32_t visitedNodes = 0;
+    std::vector<int32_t> choice;
+    std::vector<int32_t> bestChoice;
+    float bestCost = 0;
+};
+
+/* State of a composition range while the planner searches */
+enum {
+    PLAN_RANGE_NONE = 0,
+    PLAN_RANGE_OPEN,
+    PLAN_RANGE_CLOSED,
+};
+
+struct PlanSearchState {
+    uint64_t usedOtfMask = 0;
+    uint64_t usedM2mMask = 0;
+    uint32_t windowNum = 0;
+    uint32_t clientRange = PLAN_RANGE_NONE;
+    uint32_t exynosRange = PLAN_RANGE_NONE;
+    uint32_t blendingSrcNum = 0;
+    float blendingCycles[PPC_ROT_MAX] = {0, 0};
+    bool blendingRotated = false;
+    float cost = 0;
+};
+
+/*
+ * State of assignResource() for a display.
+ * It is kept for each display because displays can be assigned
+ * at the same time by parallel validation.
+ */
+struct AssignContext {
+    /* Copy of the cache entry that is replayed by assignLayer() */
+    AssignResultCacheEntry replayResult;
+    bool hasReplayResult = false;
+    /* Results of assignLayer() of current assignResource() */
+    std::vector<AssignLayerResult> layerResults;
+    /* Results are replayed and recorded only in the retry loop of assignResourceByPriority() */
+    bool cacheActive = false;
+    /* Assignment of current assignResource() was done by the planner */
+    bool planned = false;
+    /* Reused by planAssignResources() to avoid allocation on every frame */
+    CompositionPlan plan;
+    /* Reused by assignResource() to avoid allocation on every frame */
+    AssignSignature signature;
+
+    uint64_t cacheHitCount = 0;
+    uint64_t cacheMissCount = 0;
+    uint64_t cacheReplayFailCount = 0;
+    uint64_t plannedCount = 0;
+    uint64_t plannerSkipCount = 0;
+    uint64_t plannerTimeoutCount = 0;
+    uint64_t plannerFailCount = 0;
+    nsecs_t plannerMaxSearchTime = 0;
+    uint64_t flattenCount = 0;
+    uint64_t flattenFailCount = 0;
+
+    /* Display size that the dst buffer pool is pre-warmed for */
+    uint32_t prewarmedXres = 0;
+    uint32_t prewarmedYres = 0;
+};
+
 /* List of logic that used to fill table */
 enum {
     UNDEFINED = 0,
@@ -119,6 +273,9 @@ class ExynosResourceManager {
     int32_t doPreProcessing();
     int32_t doAllocLutParcels(ExynosDisplay *display);
     int32_t doAllocDstBufs(uint32_t mXres, uint32_t mYres);
+    void prewarmDstBufs(ExynosDisplay *display);
+    ExynosMPPBufferPool &getDstBufPool() { return mDstBufPool; };
+    void dumpDstBufPool(String8 &result) { mDstBufPool.dump(result); };
     int32_t assignResource(ExynosDisplay *display);
     int32_t assignResourceInternal(ExynosDisplay *display);
     static ExynosMPP *getExynosMPP(uint32_t physicalType, uint32_t physicalIndex);
@@ -126,6 +283,8 @@ class ExynosResourceManager {
     static void enableMPP(uint32_t physicalType, uint32_t physicalIndex, uint32_t logicalIndex, uint32_t enable);
     static bool applyEnableMPPRequests();
     int32_t updateSupportedMPPFlag(ExynosDisplay *display);
+    /* Check the MPPs that were partitioned away when updateSupportedMPPFlag() was called */
+    void updateUncheckedMPPFlag(ExynosDisplay *display);
     int32_t resetResources();
     virtual int32_t preAssignResources();
     /* This function should be implemented by module */
@@ -149,6 +308,7 @@ class ExynosResourceManager {
     static float getResourceUsedCapa(ExynosMPP &mpp);
     int32_t updateExynosComposition(ExynosDisplay *display);
     int32_t updateClientComposition(ExynosDisplay *display);
+    int32_t flattenStaticClientLayers(ExynosDisplay *display);
     int32_t getCandidateM2mMPPOutImages(ExynosDisplay *display,
                                         ExynosLayer *layer, std::vector<exynos_image> &image_lists);
     int32_t setResourcePriority(ExynosDisplay *display);
@@ -176,6 +336,8 @@ class ExynosResourceManager {
     void setDPUFeature(ExynosMPP *mpp, uint64_t dpuAttr);
 
     void updateRestrictions();
+    /* Compile restrictions of all MPPs into their capability tables */
+    void updateCapabilityTables();
     virtual void setVirtualOtfMPPsRestrictions() { return; };
 
     mpp_phycal_type_t getPhysicalType(int ch) const;
@@ -218,6 +380,23 @@ class ExynosResourceManager {
                       struct exynos_image &src, struct exynos_image &dst, ExynosMPPSource *mppSrc);
     int32_t printMppsAttr();
 
+    /*
+     * Give MPPs reserved for the displays to them and block the other MPPs
+     * so that the displays can be assigned at the same time.
+     * Displays that own any otfMPP are returned by parallelDisplays.
+     */
+    void partitionMPPs(android::Vector<ExynosDisplay *> &displays,
+                       android::Vector<ExynosDisplay *> &parallelDisplays);
+    void clearMPPPartition();
+    /* Display fell back to client composition for a layer that the blocked MPPs support */
+    bool needSharedMPPs(ExynosDisplay *display);
+
+    void invalidateAssignResultCache();
+    void dumpAssignResultCache(String8 &result);
+    void dumpCompositionPlanner(String8 &result);
+    void dumpStaticLayerFlattening(String8 &result);
+    void dumpPerformanceRequests(String8 &result);
+
     void checkAttrMPP(ExynosDisplay *display);
 
     /* return 1 if it's needed */
@@ -227,20 +406,75 @@ class ExynosResourceManager {
     bool needHdrProcessingInternal(ExynosDisplay *display, exynos_image &srcImg, exynos_image &dstImg);
 
   private:
+    void checkSupportedMPP(ExynosDisplay *display, ExynosLayer *layer, ExynosMPP *mpp,
+                           exynos_image &src_img, exynos_image &dst_img, exynos_image &dst_img_yuv);
+    void setSupportedMPPImages(ExynosLayer *layer, exynos_image &src_img,
+                               exynos_image &dst_img, exynos_image &dst_img_yuv);
     int32_t changeLayerFromClientToDevice(ExynosDisplay *display, ExynosLayer *layer,
                                           uint32_t layer_index, exynos_image &m2m_out_img, ExynosMPP *m2mMPP, ExynosMPP *otfMPP);
     int setClientTargetBufferToExynosCompositor(ExynosDisplay *display);
+    int32_t findLayerAssignment(ExynosDisplay *display, ExynosLayer *layer, uint32_t layer_index,
+                                uint32_t validateFlag, exynos_image &src_img, exynos_image &dst_img,
+                                exynos_image &m2m_out_img, ExynosMPP **m2mMPP, ExynosMPP **otfMPP,
+                                uint32_t &overlayInfo);
+    void storeAssignResult(ExynosDisplay *display, const AssignSignature &signature);
+    int32_t replayAssignResult(ExynosDisplay *display, ExynosLayer *layer, uint32_t layer_index,
+                               uint32_t validateFlag, exynos_image &src_img, exynos_image &dst_img,
+                               exynos_image &m2m_out_img, ExynosMPP **m2mMPP, ExynosMPP **otfMPP,
+                               uint32_t &overlayInfo);
+    AssignContext &getAssignContext(ExynosDisplay *display);
+    int32_t assignResourceByPriority(ExynosDisplay *display);
+    int32_t planAssignResources(ExynosDisplay *display);
+    int32_t buildCompositionPlan(ExynosDisplay *display, CompositionPlan &plan);
+    void addPlanDeviceOptions(ExynosDisplay *display, ExynosLayer *layer, uint32_t layer_index,
+                              CompositionPlan &plan, std::vector<PlanLayerOption> &options);
+    int32_t applyCompositionPlan(ExynosDisplay *display, CompositionPlan &plan);
 
   protected:
     virtual void setFrameRateForPerformance(ExynosMPP &mpp, AcrylicPerformanceRequestFrame *frame);
+    void getAssignSignature(ExynosDisplay *display, AssignSignature &signature);
+    void searchCompositionPlan(CompositionPlan &plan, uint32_t index, const PlanSearchState &state);
+    bool hasPlanTargetWindows(const CompositionPlan &plan, const PlanSearchState &state);
+    /*
+     * QoS request of each M2M physical type. Frames and layers of the request
+     * are reused, and the request is not delivered again if its hash is the
+     * same as the last one that is delivered through the same handle.
+     */
+    struct PerformanceRequestInfo {
+        AcrylicPerformanceRequest request;
+        Acrylic *deliveredHandle = nullptr;
+        uint64_t deliveredHash = 0;
+        uint64_t deliveredCount = 0;
+        uint64_t skippedCount = 0;
+    };
+    PerformanceRequestInfo mPerformanceRequests[MPP_P_TYPE_MAX];
+    Mutex mPerformanceRequestMutex;
+
+    /*
+     * Delivers the request through handle, returns false if it is skipped or fails.
+     * It is called with mPerformanceRequestMutex.
+     */
+    bool deliverPerformanceRequest(PerformanceRequestInfo &requestInfo, Acrylic *handle);
+
     static ExynosMPPVector mOtfMPPs;
     static ExynosMPPVector mM2mMPPs;
     static std::vector<EnableMPPRequest> mEnableMPPRequests;
+    /* Shared by mM2mMPPs, it should be destroyed after them */
+    ExynosMPPBufferPool mDstBufPool;
     android::Vector<ExynosDisplay *> mDisplays;
     std::map<uint32_t, ExynosDisplay *> mDisplayMap;
     DeviceResourceInfo mDeviceInfo;
     bool mDeviceSupportWCG = false;
 
+    /* Most recently used entry is in front */
+    std::list<AssignResultCacheEntry> mAssignResultCache;
+    Mutex mAssignResultCacheMutex;
+    /* Elements are never removed, so references are valid after the lock is released */
+    std::map<uint32_t, AssignContext> mAssignContexts;
+    Mutex mAssignContextMutex;
+    /* Logical types of MPPs blocked by partitionMPPs() */
+    uint32_t mSharedMPPLogicalTypes = 0;
+
   public:
     virtual bool isHWResourceAvailable(ExynosDisplay __unused *display, ExynosMPP __unused *currentMPP, ExynosMPPSource __unused *mppSrc) { return true; };
     virtual uint32_t setDisplaysTDMInfo() { return 0; };
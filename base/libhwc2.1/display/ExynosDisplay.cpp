@@ -57,7 +57,15 @@ int ExynosSortedLayer::compare(ExynosLayer *const *lhs, ExynosLayer *const *rhs)
     return left->mZOrder > right->mZOrder;
 }
 
+ssize_t ExynosSortedLayer::add(ExynosLayer *item) {
+    mHandles.insert(item);
+    return Vector<ExynosLayer *>::add(item);
+}
+
 ssize_t ExynosSortedLayer::remove(const ExynosLayer *item) {
+    if (mHandles.erase(item) == 0)
+        return -1;
+
     for (size_t i = 0; i < size(); i++) {
         if (array()[i] == item) {
             removeAt(i);
@@ -67,6 +75,11 @@ ssize_t ExynosSortedLayer::remove(const ExynosLayer *item) {
     return -1;
 }
 
+void ExynosSortedLayer::clear() {
+    mHandles.clear();
+    Vector<ExynosLayer *>::clear();
+}
+
 status_t ExynosSortedLayer::vector_sort() {
     return sort(compare);
 }
@@ -123,8 +136,6 @@ ExynosCompositionInfo::ExynosCompositionInfo(uint32_t type)
     else
         mCompressionInfo.type = COMP_TYPE_AFBC;
 
-    mSkipSrcInfo.reset();
-
     if (type == COMPOSITION_CLIENT) {
         mEnableSkipStatic = true;
 #ifdef USES_SAJC_FEATURE
@@ -146,6 +157,8 @@ void ExynosCompositionInfo::initializeInfos() {
     mFirstIndex = -1;
     mLastIndex = -1;
     mTargetBuffer = NULL;
+    mDamageNum = 0;
+    mDamageRects.clear();
     if (mType == COMPOSITION_EXYNOS)
         mDataSpace = HAL_DATASPACE_UNKNOWN;
 
@@ -174,6 +187,15 @@ void ExynosCompositionInfo::initializeInfos() {
     }
 }
 
+void ExynosCompositionInfo::setDamage(hwc_region_t damage) {
+    mDamageNum = damage.numRects;
+    mDamageRects.clear();
+
+    for (size_t i = 0; i < mDamageNum; i++) {
+        mDamageRects.push_back(damage.rects[i]);
+    }
+}
+
 bool ExynosCompositionInfo::setTargetBuffer(
     buffer_handle_t handle, int32_t acquireFence,
     android_dataspace dataspace) {
@@ -431,7 +453,7 @@ void ExynosDisplay::initCompositionInfo(ExynosCompositionInfo &compositionInfo)
 
     compositionInfo.mSkipStaticInitFlag = false;
     compositionInfo.mSkipFlag = false;
-    compositionInfo.mSkipSrcInfo.reset();
+    compositionInfo.mSkipLayers.clear();
 }
 
 /**
@@ -474,10 +496,8 @@ void ExynosDisplay::destroyLayers() {
 
 ExynosLayer *ExynosDisplay::checkLayer(hwc2_layer_t addr, bool printError) {
     ExynosLayer *temp = (ExynosLayer *)addr;
-    for (auto layer : mLayers) {
-        if (layer == temp)
-            return layer;
-    }
+    if (mLayers.contains(temp))
+        return temp;
 
     if (printError)
         DISPLAY_LOGE("HWC2 : %s wrong layer request, layer num(%zu)!", __func__, mLayers.size());
@@ -489,6 +509,7 @@ ExynosLayer *ExynosDisplay::checkLayer(hwc2_layer_t addr, bool printError) {
  */
 void ExynosDisplay::doPreProcessing(DeviceValidateInfo &validateInfo,
                                     uint64_t &geometryChanged) {
+    ScopedLatency latency(&mLatencyRecorder, LATENCY_STAGE_PRE_PROCESSING);
     /* Low persistence setting */
     int ret = 0;
     uint32_t selfRefresh = 0;
@@ -542,6 +563,7 @@ void ExynosDisplay::doPreProcessing(DeviceValidateInfo &validateInfo,
         mLayers[i]->setSrcExynosImage(&srcImg);
         mLayers[i]->setDstExynosImage(&dstImg);
         mLayers[i]->setExynosImage(srcImg, dstImg);
+        mLayers[i]->updateFingerprint();
     }
 
     // Re-align layer priority for max overlay resources
@@ -700,64 +722,51 @@ int ExynosDisplay::handleStaticLayers(ExynosCompositionInfo &compositionInfo) {
 }
 
 bool ExynosDisplay::skipStaticLayerChanged(ExynosCompositionInfo &compositionInfo) {
-    if ((int)compositionInfo.mSkipSrcInfo.srcNum !=
+    if ((int)compositionInfo.mSkipLayers.size() !=
         (compositionInfo.mLastIndex - compositionInfo.mFirstIndex + 1)) {
-        DISPLAY_LOGD(eDebugSkipStaicLayer, "Client composition number is changed (%d -> %d)",
-                     compositionInfo.mSkipSrcInfo.srcNum,
+        DISPLAY_LOGD(eDebugSkipStaicLayer, "Client composition number is changed (%zu -> %d)",
+                     compositionInfo.mSkipLayers.size(),
                      compositionInfo.mLastIndex - compositionInfo.mFirstIndex + 1);
         return true;
     }
 
-    bool isChanged = false;
     for (size_t i = (size_t)compositionInfo.mFirstIndex; i <= (size_t)compositionInfo.mLastIndex; i++) {
         ExynosLayer *layer = mLayers[i];
-        size_t index = i - compositionInfo.mFirstIndex;
+        ExynosCompositionInfo::SkipLayerInfo &skipLayer =
+            compositionInfo.mSkipLayers[i - compositionInfo.mFirstIndex];
+        /*
+         * Acquire fence of a client layer is closed in every present,
+         * so a valid one means that a buffer is latched after the last frame
+         * even if the handle is same.
+         */
         if ((layer->mLayerBuffer == NULL) ||
-            (compositionInfo.mSkipSrcInfo.srcInfo[index].bufferHandle != layer->mLayerBuffer)) {
-            isChanged = true;
-            DISPLAY_LOGD(eDebugSkipStaicLayer, "layer[%zu] handle is changed"
-                                               " handle(%p -> %p), layerFlag(0x%8x)",
-                         i, compositionInfo.mSkipSrcInfo.srcInfo[index].bufferHandle,
-                         layer->mLayerBuffer, layer->mLayerFlag);
-            break;
-        } else if ((compositionInfo.mSkipSrcInfo.srcInfo[index].x != layer->mSrcImg.x) ||
-                   (compositionInfo.mSkipSrcInfo.srcInfo[index].y != layer->mSrcImg.y) ||
-                   (compositionInfo.mSkipSrcInfo.srcInfo[index].w != layer->mSrcImg.w) ||
-                   (compositionInfo.mSkipSrcInfo.srcInfo[index].h != layer->mSrcImg.h) ||
-                   (compositionInfo.mSkipSrcInfo.srcInfo[index].dataSpace != layer->mSrcImg.dataSpace) ||
-                   (compositionInfo.mSkipSrcInfo.srcInfo[index].blending != layer->mSrcImg.blending) ||
-                   (compositionInfo.mSkipSrcInfo.srcInfo[index].transform != layer->mSrcImg.transform) ||
-                   (compositionInfo.mSkipSrcInfo.srcInfo[index].planeAlpha != layer->mSrcImg.planeAlpha)) {
-            isChanged = true;
-            DISPLAY_LOGD(eDebugSkipStaicLayer, "layer[%zu] source info is changed, "
-                                               "x(%d->%d), y(%d->%d), w(%d->%d), h(%d->%d), dataSpace(%d->%d), "
-                                               "blending(%d->%d), transform(%d->%d), planeAlpha(%3.1f->%3.1f)",
-                         i,
-                         compositionInfo.mSkipSrcInfo.srcInfo[index].x, layer->mSrcImg.x,
-                         compositionInfo.mSkipSrcInfo.srcInfo[index].y, layer->mSrcImg.y,
-                         compositionInfo.mSkipSrcInfo.srcInfo[index].w, layer->mSrcImg.w,
-                         compositionInfo.mSkipSrcInfo.srcInfo[index].h, layer->mSrcImg.h,
-                         compositionInfo.mSkipSrcInfo.srcInfo[index].dataSpace, layer->mSrcImg.dataSpace,
-                         compositionInfo.mSkipSrcInfo.srcInfo[index].blending, layer->mSrcImg.blending,
-                         compositionInfo.mSkipSrcInfo.srcInfo[index].transform, layer->mSrcImg.transform,
-                         compositionInfo.mSkipSrcInfo.srcInfo[index].planeAlpha, layer->mSrcImg.planeAlpha);
-            break;
-        } else if ((compositionInfo.mSkipSrcInfo.dstInfo[index].x != layer->mDstImg.x) ||
-                   (compositionInfo.mSkipSrcInfo.dstInfo[index].y != layer->mDstImg.y) ||
-                   (compositionInfo.mSkipSrcInfo.dstInfo[index].w != layer->mDstImg.w) ||
-                   (compositionInfo.mSkipSrcInfo.dstInfo[index].h != layer->mDstImg.h)) {
-            isChanged = true;
-            DISPLAY_LOGD(eDebugSkipStaicLayer, "layer[%zu] dst info is changed, "
-                                               "x(%d->%d), y(%d->%d), w(%d->%d), h(%d->%d)",
-                         i,
-                         compositionInfo.mSkipSrcInfo.dstInfo[index].x, layer->mDstImg.x,
-                         compositionInfo.mSkipSrcInfo.dstInfo[index].y, layer->mDstImg.y,
-                         compositionInfo.mSkipSrcInfo.dstInfo[index].w, layer->mDstImg.w,
-                         compositionInfo.mSkipSrcInfo.dstInfo[index].h, layer->mDstImg.h);
-            break;
+            (skipLayer.bufferHandle != layer->mLayerBuffer) ||
+            (layer->mAcquireFence >= 0) ||
+            (skipLayer.fingerprint != layer->mFingerprint)) {
+            DISPLAY_LOGD(eDebugSkipStaicLayer, "layer[%zu] is changed, handle(%p -> %p), "
+                                               "acquireFence(%d), fingerprint(0x%" PRIx64 " -> 0x%" PRIx64 "), "
+                                               "layerFlag(0x%8x)",
+                         i, skipLayer.bufferHandle, layer->mLayerBuffer, layer->mAcquireFence,
+                         skipLayer.fingerprint, layer->mFingerprint, layer->mLayerFlag);
+            return true;
         }
     }
-    return isChanged;
+    return false;
+}
+
+void ExynosDisplay::getStaticLayerRuns(int32_t firstIndex, int32_t lastIndex,
+                                       std::vector<StaticLayerRun> &outRuns) {
+    outRuns.clear();
+    if ((firstIndex < 0) || (lastIndex >= (int32_t)mLayers.size()))
+        return;
+
+    for (int32_t i = firstIndex; i <= lastIndex; i++) {
+        bool isStatic = mLayers[i]->isStatic(STATIC_LAYER_FLATTEN_FRAMES);
+        if (outRuns.empty() || (outRuns.back().isStatic != isStatic))
+            outRuns.push_back({i, i, isStatic});
+        else
+            outRuns.back().lastIndex = i;
+    }
 }
 
 /**
@@ -780,8 +789,7 @@ int ExynosDisplay::skipStaticLayers(ExynosCompositionInfo &compositionInfo) {
 
     if ((compositionInfo.mHasCompositionLayer == false) ||
         (compositionInfo.mFirstIndex < 0) ||
-        (compositionInfo.mLastIndex < 0) ||
-        ((compositionInfo.mLastIndex - compositionInfo.mFirstIndex + 1) > NUM_SKIP_STATIC_LAYER)) {
+        (compositionInfo.mLastIndex < 0)) {
         DISPLAY_LOGD(eDebugSkipStaicLayer, "mHasCompositionLayer(%d), mFirstIndex(%d), mLastIndex(%d)",
                      compositionInfo.mHasCompositionLayer,
                      compositionInfo.mFirstIndex, compositionInfo.mLastIndex);
@@ -827,17 +835,14 @@ int ExynosDisplay::skipStaticLayers(ExynosCompositionInfo &compositionInfo) {
     }
 
     compositionInfo.mSkipStaticInitFlag = true;
-    compositionInfo.mSkipSrcInfo.reset();
+    compositionInfo.mSkipLayers.clear();
 
     for (size_t i = (size_t)compositionInfo.mFirstIndex; i <= (size_t)compositionInfo.mLastIndex; i++) {
         ExynosLayer *layer = mLayers[i];
-        size_t index = i - compositionInfo.mFirstIndex;
-        compositionInfo.mSkipSrcInfo.srcInfo[index] = layer->mSrcImg;
-        compositionInfo.mSkipSrcInfo.dstInfo[index] = layer->mDstImg;
-        DISPLAY_LOGD(eDebugSkipStaicLayer, "mSkipSrcInfo.srcInfo[%zu] is initialized, %p",
-                     index, layer->mSrcImg.bufferHandle);
+        compositionInfo.mSkipLayers.push_back({layer->mLayerBuffer, layer->mFingerprint});
+        DISPLAY_LOGD(eDebugSkipStaicLayer, "mSkipLayers[%zu] is initialized, %p",
+                     i - compositionInfo.mFirstIndex, layer->mLayerBuffer);
     }
-    compositionInfo.mSkipSrcInfo.srcNum = (compositionInfo.mLastIndex - compositionInfo.mFirstIndex + 1);
     return NO_ERROR;
 }
 
@@ -845,10 +850,27 @@ int ExynosDisplay::skipStaticLayers(ExynosCompositionInfo &compositionInfo) {
  * @return int
  */
 int ExynosDisplay::doPostProcessing() {
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    bool updated = false;
+
     for (size_t i = 0; i < mLayers.size(); i++) {
+        if (mLayers[i]->mLayerBuffer != mLayers[i]->mLastLayerBuffer) {
+            mLayers[i]->mUpdateRate.update(now);
+            updated = true;
+        }
+        mLayers[i]->mFps = mLayers[i]->mUpdateRate.getRate(now);
         /* Layer handle back-up */
         mLayers[i]->mLastLayerBuffer = mLayers[i]->mLayerBuffer;
+        mLayers[i]->updateStaticFrameCount();
+    }
+    if (updated) {
+        Mutex::Autolock lock(mDRMutex);
+        mUpdateRate.update(now);
     }
+    /* Idle time is counted after the update is recorded */
+    if (mUseDynamicRecomp && mDynamicRecompTimer &&
+        (mDynamicRecompMode != DEVICE_TO_CLIENT))
+        mDynamicRecompTimer->reset();
     clearGeometryChanged();
 
     return 0;
@@ -922,6 +944,7 @@ int ExynosDisplay::doExynosComposition() {
             dumpExynosImage(eDebugMPP, srcImg);
             mLayers[i]->setDstExynosImage(&dstImg);
             mLayers[i]->setExynosImage(srcImg, dstImg);
+            setExynosCompositionDamage(mLayers[i]);
         }
 
         /* For debugging */
@@ -938,6 +961,7 @@ int ExynosDisplay::doExynosComposition() {
         }
 
         mExynosCompositionInfo.mM2mMPP->mCurrentTargetCompressionInfoType = mExynosCompositionInfo.mCompressionInfo.type;
+        mExynosCompositionInfo.mM2mMPP->requestPartialComposition();
         if ((ret = mExynosCompositionInfo.mM2mMPP->doPostProcessing(mExynosCompositionInfo.mSrcImg,
                                                                     mExynosCompositionInfo.mDstImg)) != NO_ERROR) {
             DISPLAY_LOGE("exynosComposition doPostProcessing fail ret(%d)", ret);
@@ -951,7 +975,53 @@ int ExynosDisplay::doExynosComposition() {
             /* This should be closed by resource lib (libmpp or libacryl) */
             mLayers[i]->mAcquireFence = -1;
         }
+    }
+
+    return ret;
+}
 
+/**
+ * Surface damage of the layer in display coordinates.
+ * The damage is used for partial composition of the M2M MPP.
+ */
+void ExynosDisplay::setExynosCompositionDamage(ExynosLayer *layer) {
+    hwc_rect_t damage;
+    layer->mDamageBaseBuffer = layer->mLastLayerBuffer;
+    layer->mDamageValid = true;
+
+    /* Damage is mapped without scaling and transform */
+    if ((layer->mTransform != 0) ||
+        (WIDTH(layer->mSourceCrop) != WIDTH(layer->mDisplayFrame)) ||
+        (HEIGHT(layer->mSourceCrop) != HEIGHT(layer->mDisplayFrame))) {
+        layer->mDamage = layer->mDisplayFrame;
+        return;
+    }
+
+    switch (getLayerRegion(layer, damage, eDamageRegionByDamage)) {
+    case eDamageRegionPartial:
+        layer->mDamage = damage;
+        break;
+    case eDamageRegionSkip:
+        layer->mDamage = {0, 0, 0, 0};
+        break;
+    default:
+        layer->mDamage = layer->mDisplayFrame;
+        break;
+    }
+}
+
+/**
+ * Set the output of ExynosComposition as the composition target.
+ * It should be called after the job that is requested by
+ * doExynosComposition() is submitted.
+ * @return int
+ */
+int ExynosDisplay::setExynosCompositionTarget() {
+    int ret = NO_ERROR;
+    exynos_image src_img;
+    exynos_image dst_img;
+
+    if (mExynosCompositionInfo.mHasCompositionLayer) {
         exynos_image outImage;
         if ((ret = mExynosCompositionInfo.mM2mMPP->getDstImageInfo(&outImage)) != NO_ERROR) {
             DISPLAY_LOGE("exynosComposition getDstImageInfo fail ret(%d)", ret);
@@ -1803,6 +1873,7 @@ int ExynosDisplay::setWindowUpdate(const hwc_rect &merge_rect) {
  */
 int ExynosDisplay::deliverWinConfigData(DevicePresentInfo &presentInfo) {
     ATRACE_CALL();
+    ScopedLatency latency(&mLatencyRecorder, LATENCY_STAGE_DELIVER_WIN_CONFIG);
     int ret = NO_ERROR;
 
     ret = validateWinConfigData();
@@ -1873,12 +1944,14 @@ int ExynosDisplay::deliverWinConfigData(DevicePresentInfo &presentInfo) {
                                       FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_DPP, FENCE_TO);
         }
 
+        mPresentScheduler.onCommit(systemTime(SYSTEM_TIME_MONOTONIC));
         if ((ret = mDisplayInterface->deliverWinConfigData(mDpuData)) < 0) {
             DISPLAY_LOGE("%s::interface's deliverWinConfigData() failed: %s, ret(%d)",
                          __func__, strerror(errno), ret);
             return ret;
         } else {
             mLastDpuData = mDpuData;
+            mPresentScheduler.onCommitDone(systemTime(SYSTEM_TIME_MONOTONIC));
 
             /* For inform */
             if ((mHiberState.hiberExitFd != NULL) && (!mHiberState.exitRequested))
@@ -1913,6 +1986,7 @@ int ExynosDisplay::deliverWinConfigData(DevicePresentInfo &presentInfo) {
  * @return int
  */
 int ExynosDisplay::setReleaseFences() {
+    ScopedLatency latency(&mLatencyRecorder, LATENCY_STAGE_SET_RELEASE_FENCES);
     int release_fd = -1;
 
     /*
@@ -2700,10 +2774,6 @@ int32_t ExynosDisplay::presentDisplay(DevicePresentInfo &presentInfo,
         }
     }
 
-    if (mUseDynamicRecomp && mDynamicRecompTimer &&
-        (mDynamicRecompMode != DEVICE_TO_CLIENT))
-        mDynamicRecompTimer->reset();
-
     // loop for all layer
     for (size_t i = 0; i < mLayers.size(); i++) {
         /* mAcquireFence is updated, Update image info */
@@ -2892,6 +2962,11 @@ int32_t ExynosDisplay::setActiveConfig(hwc2_config_t config) {
     return setActiveConfigInternal(config);
 }
 
+int32_t ExynosDisplay::setClientTargetDamage(hwc_region_t damage) {
+    mClientCompositionInfo.setDamage(damage);
+    return HWC2_ERROR_NONE;
+}
+
 int32_t ExynosDisplay::setClientTarget(buffer_handle_t target,
                                        int32_t acquireFence, int32_t dataspace, uint64_t &geometryFlag) {
     buffer_handle_t handle = NULL;
@@ -3239,18 +3314,64 @@ int32_t ExynosDisplay::getConfigAppliedTime(const uint64_t desiredTime,
                                             const uint64_t actualChangeTime,
                                             int64_t &appliedTime, int64_t &refreshTime) {
     uint32_t transientDuration = mDisplayInterface->getConfigChangeDuration();
+    /* Fitted period of the vsync model follows the panel better than the nominal one */
+    int64_t vsyncPeriod = mDisplayInterface->getPredictedVsyncPeriod();
+    if (vsyncPeriod <= 0)
+        vsyncPeriod = mVsyncPeriod;
+
     appliedTime = actualChangeTime;
     while (desiredTime > appliedTime) {
         DISPLAY_LOGD(eDebugDisplayConfig, "desired time(%" PRId64 ") > applied time(%" PRId64 ")", desiredTime, appliedTime);
         ;
-        appliedTime += mVsyncPeriod;
+        appliedTime += vsyncPeriod;
     }
 
-    refreshTime = appliedTime - (transientDuration * mVsyncPeriod);
+    refreshTime = appliedTime - (transientDuration * vsyncPeriod);
 
     return NO_ERROR;
 }
 
+nsecs_t ExynosDisplay::predictNextVsync(nsecs_t time) {
+    nsecs_t nextVsync = mDisplayInterface->predictNextVsync(time);
+    if (nextVsync)
+        return nextVsync;
+
+    /* Phase of the last vsync with the nominal period */
+    nsecs_t lastVsync = (nsecs_t)mVsyncCallback.getVsyncTimeStamp();
+    if ((lastVsync == 0) || (mVsyncPeriod == 0))
+        return time + mVsyncPeriod;
+    if (time < lastVsync)
+        return lastVsync;
+    return lastVsync + ((time - lastVsync) / mVsyncPeriod + 1) * mVsyncPeriod;
+}
+
+int32_t ExynosDisplay::setExpectedPresentTime(nsecs_t expectedPresentTime) {
+    mPresentScheduler.setExpectedPresentTime(expectedPresentTime);
+    return HWC2_ERROR_NONE;
+}
+
+nsecs_t ExynosDisplay::getPresentHoldTarget() {
+    Mutex::Autolock lock(mDisplayMutex);
+    nsecs_t expectedPresentTime = mPresentScheduler.takeExpectedPresentTime();
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    if ((expectedPresentTime <= now) || !exynosHWCControl.presentScheduler ||
+        (mType == HWC_DISPLAY_VIRTUAL) || (mPowerModeState != HWC2_POWER_MODE_ON) ||
+        (mConfigRequestState != hwc_request_state_t::SET_CONFIG_STATE_NONE))
+        return 0;
+
+    /* Expected present time is put on the closest vsync */
+    nsecs_t targetVsync = predictNextVsync(expectedPresentTime - mVsyncPeriod / 2);
+    DISPLAY_LOGD(eDebugWinConfig, "%s:: expected(%" PRId64 "), target vsync(%" PRId64 "), deadline(%" PRId64 ")",
+                 __func__, expectedPresentTime, targetVsync, mPresentScheduler.getDeadline(targetVsync));
+    return targetVsync;
+}
+
+void ExynosDisplay::holdPresent(nsecs_t targetVsync) {
+    ATRACE_CALL();
+    mPresentScheduler.hold(targetVsync, systemTime(SYSTEM_TIME_MONOTONIC));
+}
+
 int32_t ExynosDisplay::checkValidationConfigConstraints(hwc2_config_t config,
                                                         hwc_vsync_period_change_constraints_t *vsyncPeriodChangeConstraints,
                                                         hwc_vsync_period_change_timeline_t *outTimeline) {
@@ -3645,6 +3766,7 @@ int32_t ExynosDisplay::setPowerMode(int32_t /*hwc2_power_mode_t*/ mode,
     }
 
     if (mode == HWC_POWER_MODE_OFF) {
+        mPresentScheduler.cancel();
         clearDisplay();
         ALOGV("HWC2: Clear display (power off)");
     }
@@ -3665,6 +3787,7 @@ int32_t ExynosDisplay::setPowerMode(int32_t /*hwc2_power_mode_t*/ mode,
             closeFencesForSkipFrame(RENDERING_STATE_VALIDATED);
         mRenderingState = RENDERING_STATE_NONE;
     } else {
+        mPresentScheduler.resume();
         setGeometryChanged(GEOMETRY_DISPLAY_POWER_ON, geometryFlag);
     }
 
@@ -3832,6 +3955,10 @@ int32_t ExynosDisplay::startPostProcessing() {
         return -EINVAL;
     };
 
+    /* Damage is valid only in the frame that set it */
+    for (size_t i = 0; i < mLayers.size(); i++)
+        mLayers[i]->resetDamage();
+
     if ((ret = doExynosComposition()) != NO_ERROR) {
         errString.appendFormat("exynosComposition fail (%d)\n", ret);
         return handle_err();
@@ -3871,6 +3998,37 @@ int32_t ExynosDisplay::startPostProcessing() {
             }
         }
     }
+
+    /*
+     * Jobs of all M2M MPPs are submitted by the shared post-processing worker
+     * while the next jobs are prepared. Only the submission is waited for here
+     * because the dst acquire fences are committed in this present,
+     * the HW completion is signaled by the fences.
+     */
+    for (size_t i = 0; i < mLayers.size(); i++) {
+        if ((mLayers[i]->mValidateCompositionType == HWC2_COMPOSITION_DEVICE) &&
+            (mLayers[i]->mM2mMPP != NULL)) {
+            if ((ret = mLayers[i]->mM2mMPP->waitPostProcessing()) != NO_ERROR) {
+                DISPLAY_LOGE("%s:: postProcessing failed, layer(%zu), ret(%d)",
+                             __func__, i, ret);
+                errString.appendFormat("%s:: postProcessing failed, layer(%zu), ret(%d)\n",
+                                       __func__, i, ret);
+                return handle_err();
+            }
+        }
+    }
+
+    if (mExynosCompositionInfo.mHasCompositionLayer) {
+        if ((ret = mExynosCompositionInfo.mM2mMPP->waitPostProcessing()) != NO_ERROR) {
+            DISPLAY_LOGE("exynosComposition postProcessing fail ret(%d)", ret);
+            errString.appendFormat("exynosComposition postProcessing fail (%d)\n", ret);
+            return handle_err();
+        }
+        if ((ret = setExynosCompositionTarget()) != NO_ERROR) {
+            errString.appendFormat("exynosComposition target fail (%d)\n", ret);
+            return handle_err();
+        }
+    }
     return ret;
 }
 
@@ -3909,6 +4067,16 @@ void ExynosDisplay::dump(String8 &result) {
                         mXres, mYres, mVsyncState, mColorMode, mColorTransformHint);
     mClientCompositionInfo.dump(result);
     mExynosCompositionInfo.dump(result);
+    result.appendFormat("Window update: full(%" PRIu64 "), single(%" PRIu64 "), split(%" PRIu64 ")\n",
+                        mWindowUpdateCount[ExynosDamageRegion::UPDATE_FULL],
+                        mWindowUpdateCount[ExynosDamageRegion::UPDATE_SINGLE],
+                        mWindowUpdateCount[ExynosDamageRegion::UPDATE_SPLIT]);
+    mDisplayInterface->dumpVsyncModel(result);
+    mPresentScheduler.dump(result);
+    if (mUseDynamicRecomp) {
+        Mutex::Autolock lock(mDRMutex);
+        mRecompPolicy.dump(result);
+    }
 
     for (uint32_t i = 0; i < mLayers.size(); i++) {
         ExynosLayer *layer = mLayers[i];
@@ -4468,12 +4636,17 @@ bool ExynosDisplay::windowUpdateExceptions() {
         DISPLAY_LOGD(eDebugWindowUpdate, "has exynos composition");
         return true;
     }
-    if (mClientCompositionInfo.mHasCompositionLayer) {
-        DISPLAY_LOGD(eDebugWindowUpdate, "has client composition");
+    /* Damage of the client target is used for client composition */
+    if (mClientCompositionInfo.mHasCompositionLayer &&
+        (mClientCompositionInfo.mTargetBuffer == NULL) &&
+        (mClientCompositionInfo.mSkipFlag == false)) {
+        DISPLAY_LOGD(eDebugWindowUpdate, "client target is not set");
         return true;
     }
 
     for (size_t i = 0; i < mLayers.size(); i++) {
+        if (mLayers[i]->mExynosCompositionType == HWC2_COMPOSITION_CLIENT)
+            continue;
         if (mLayers[i]->mM2mMPP != NULL)
             return true;
         if (mLayers[i]->mLayerBuffer == NULL)
@@ -4514,27 +4687,64 @@ int ExynosDisplay::handleWindowUpdate() {
     mDpuData.win_update_region.w = mXres;
     mDpuData.win_update_region.y = 0;
     mDpuData.win_update_region.h = mYres;
+    mDpuData.win_update_region_num = 1;
 
     if (windowUpdateExceptions())
         return 0;
 
-    hwc_rect mergedRect = {(int)mXres, (int)mYres, 0, 0};
-    hwc_rect damageRect = {(int)mXres, (int)mYres, 0, 0};
-    if (mergeDamageRect(mergedRect, damageRect) != NO_ERROR) {
+    PartialUpdateRestriction restriction;
+    mDisplayInterface->getPartialUpdateRestriction(restriction);
+    if (restriction.maxRegionNum == 0) {
+        DISPLAY_LOGD(eDebugWindowUpdate, "Partial update is not supported");
+        return 0;
+    }
+
+    mDamageRegion.clear();
+    if ((mergeDamageRect(mDamageRegion) != NO_ERROR) || mDamageRegion.isEmpty()) {
         DISPLAY_LOGD(eDebugWindowUpdate, "Window update is canceled");
         return 0;
     }
 
+    uint32_t type = mDamageRegion.plan(restriction, mXres, mYres, mWindowUpdateRects);
+    hwc_rect mergedRect = {0, 0, (int)mXres, (int)mYres};
+    if (type != ExynosDamageRegion::UPDATE_FULL) {
+        mergedRect = {(int)mXres, (int)mYres, 0, 0};
+        for (auto &rect : mWindowUpdateRects)
+            mergedRect = expand(mergedRect, rect);
+    }
+    DISPLAY_LOGD(eDebugWindowUpdate, "%s update, damage rects(%zu)",
+                 ExynosDamageRegion::getUpdateTypeStr(type), mDamageRegion.getRects().size());
+
     if (setWindowUpdate(mergedRect) != NO_ERROR) {
         DISPLAY_LOGD(eDebugWindowUpdate, "Window update is canceled");
         return 0;
     }
+    mWindowUpdateCount[type]++;
+
+    if (type == ExynosDamageRegion::UPDATE_SPLIT) {
+        mDpuData.win_update_region_num = mWindowUpdateRects.size();
+        for (size_t i = 0; i < mWindowUpdateRects.size(); i++) {
+            hwc_rect &rect = mWindowUpdateRects[i];
+            DISPLAY_LOGD(eDebugWindowUpdate, "Partial[%zu] : %d, %d, %d, %d",
+                         i, rect.left, rect.top, rect.right, rect.bottom);
+            mDpuData.win_update_regions[i].x = rect.left;
+            mDpuData.win_update_regions[i].y = rect.top;
+            mDpuData.win_update_regions[i].w = WIDTH(rect);
+            mDpuData.win_update_regions[i].h = HEIGHT(rect);
+        }
+    }
 
     return 0;
 }
 
-int ExynosDisplay::mergeDamageRect(hwc_rect &merge_rect, hwc_rect &damage_rect) {
+int ExynosDisplay::mergeDamageRect(ExynosDamageRegion &region) {
+    hwc_rect damage_rect;
+
     for (size_t i = 0; i < mLayers.size(); i++) {
+        /* Damage of client composition layers is the damage of the client target */
+        if (mLayers[i]->mExynosCompositionType == HWC2_COMPOSITION_CLIENT)
+            continue;
+
         int32_t windowIndex = mLayers[i]->mWindowIndex;
         if ((windowIndex < 0) ||
             (windowIndex >= mDpuData.configs.size())) {
@@ -4554,22 +4764,21 @@ int ExynosDisplay::mergeDamageRect(hwc_rect &merge_rect, hwc_rect &damage_rect)
             damage_rect.bottom = mLayers[i]->mDisplayFrame.bottom;
             DISPLAY_LOGD(eDebugWindowUpdate, "Skip layer (origin) : %d, %d, %d, %d",
                          damage_rect.left, damage_rect.top, damage_rect.right, damage_rect.bottom);
-            merge_rect = expand(merge_rect, damage_rect);
+            region.add(damage_rect);
             hwc_rect prevDst = {mLastDpuData.configs[windowIndex].dst.x, mLastDpuData.configs[windowIndex].dst.y,
                                 mLastDpuData.configs[windowIndex].dst.x + (int)mLastDpuData.configs[windowIndex].dst.w,
                                 mLastDpuData.configs[windowIndex].dst.y + (int)mLastDpuData.configs[windowIndex].dst.h};
             DISPLAY_LOGD(eDebugWindowUpdate, "prev rect(%d, %d, %d, %d)",
                          prevDst.left, prevDst.top, prevDst.right, prevDst.bottom);
 
-            merge_rect = expand(merge_rect, prevDst);
+            region.add(prevDst);
             continue;
         }
 
-        unsigned int excp = getLayerRegion(mLayers[i], damage_rect, eDamageRegionByDamage);
+        unsigned int excp = getLayerRegion(mLayers[i], damage_rect, eDamageRegionByDamage, &region);
         if (excp == eDamageRegionPartial) {
             DISPLAY_LOGD(eDebugWindowUpdate, "layer(%zu) partial : %d, %d, %d, %d", i,
                          damage_rect.left, damage_rect.top, damage_rect.right, damage_rect.bottom);
-            merge_rect = expand(merge_rect, damage_rect);
         } else if (excp == eDamageRegionSkip) {
             DISPLAY_LOGD(eDebugWindowUpdate, "layer(%zu) skip", i);
             continue;
@@ -4583,17 +4792,86 @@ int ExynosDisplay::mergeDamageRect(hwc_rect &merge_rect, hwc_rect &damage_rect)
                          mLayers[i]->mDisplayFrame.top,
                          mLayers[i]->mDisplayFrame.right,
                          mLayers[i]->mDisplayFrame.bottom);
-            merge_rect = expand(merge_rect, damage_rect);
+            region.add(damage_rect);
         } else {
             DISPLAY_LOGD(eDebugWindowUpdate, "Window update is canceled, Skip reason (layer %zu) : %d", i, excp);
             return -1;
         }
     }
 
+    if (mClientCompositionInfo.mHasCompositionLayer)
+        return mergeClientTargetDamage(region);
+
+    return NO_ERROR;
+}
+
+int ExynosDisplay::mergeClientTargetDamage(ExynosDamageRegion &region) {
+    ExynosCompositionInfo &clientInfo = mClientCompositionInfo;
+    int32_t windowIndex = clientInfo.mWindowIndex;
+    if ((windowIndex < 0) ||
+        (windowIndex >= mDpuData.configs.size())) {
+        DISPLAY_LOGE("%s:: client target has invalid window index(%d)\n",
+                     __func__, windowIndex);
+        return -1;
+    }
+
+    exynos_win_config_data &config = mDpuData.configs[windowIndex];
+    hwc_rect dst = {config.dst.x, config.dst.y,
+                    config.dst.x + (int)config.dst.w, config.dst.y + (int)config.dst.h};
+
+    int ret = 0;
+    if ((ret = canApplyWindowUpdate(mLastDpuData, mDpuData, windowIndex)) < 0) {
+        DISPLAY_LOGD(eDebugWindowUpdate, "Client target config is changed, cannot apply window update");
+        return -1;
+    } else if (ret > 0) {
+        exynos_win_config_data &lastConfig = mLastDpuData.configs[windowIndex];
+        hwc_rect prevDst = {lastConfig.dst.x, lastConfig.dst.y,
+                            lastConfig.dst.x + (int)lastConfig.dst.w, lastConfig.dst.y + (int)lastConfig.dst.h};
+        region.add(dst);
+        region.add(prevDst);
+        return NO_ERROR;
+    }
+
+    /* Client target is not updated */
+    if (clientInfo.mSkipFlag) {
+        DISPLAY_LOGD(eDebugWindowUpdate, "client target skip");
+        return NO_ERROR;
+    }
+
+    if ((clientInfo.mDamageNum == 0) || (clientInfo.mDamageRects.size() == 0)) {
+        DISPLAY_LOGD(eDebugWindowUpdate, "client target full : %d, %d, %d, %d",
+                     dst.left, dst.top, dst.right, dst.bottom);
+        region.add(dst);
+        return NO_ERROR;
+    }
+
+    /* Damage is in the coordinates of the target buffer, src of the window is cropped from it */
+    for (size_t i = 0; i < clientInfo.mDamageRects.size(); i++) {
+        const hwc_rect_t &damage = clientInfo.mDamageRects[i];
+        if ((damage.left >= damage.right) || (damage.top >= damage.bottom)) {
+            if ((clientInfo.mDamageRects.size() == 1) && (damage.left == 0) && (damage.top == 0) &&
+                (damage.right == 0) && (damage.bottom == 0))
+                return NO_ERROR;
+            region.add(dst);
+            return NO_ERROR;
+        }
+
+        hwc_rect rect = {dst.left + damage.left - config.src.x, dst.top + damage.top - config.src.y,
+                         dst.left + damage.right - config.src.x, dst.top + damage.bottom - config.src.y};
+        rect.left = std::max(rect.left, dst.left);
+        rect.top = std::max(rect.top, dst.top);
+        rect.right = std::min(rect.right, dst.right);
+        rect.bottom = std::min(rect.bottom, dst.bottom);
+        DISPLAY_LOGD(eDebugWindowUpdate, "client target partial : %d, %d, %d, %d",
+                     rect.left, rect.top, rect.right, rect.bottom);
+        region.add(rect);
+    }
+
     return NO_ERROR;
 }
 
-unsigned int ExynosDisplay::getLayerRegion(ExynosLayer *layer, hwc_rect &rect_area, uint32_t regionType) {
+unsigned int ExynosDisplay::getLayerRegion(ExynosLayer *layer, hwc_rect &rect_area, uint32_t regionType,
+                                           ExynosDamageRegion *region) {
     android::Vector<hwc_rect_t> hwcRects;
     size_t numRects = 0;
 
@@ -4638,6 +4916,8 @@ unsigned int ExynosDisplay::getLayerRegion(ExynosLayer *layer, hwc_rect &rect_ar
             adjustRect(rect, INT_MAX, INT_MAX);
             /* Get sums of rects */
             rect_area = expand(rect_area, rect);
+            if (region != nullptr)
+                region->add(rect);
         }
         return eDamageRegionPartial;
         break;
@@ -5318,21 +5598,68 @@ int32_t ExynosDisplay::updateColorConversionInfo() {
     return ret;
 }
 
+ExynosRecompPolicy::CostInfo ExynosDisplay::getRecompCostInfo() {
+    ExynosRecompPolicy::CostInfo info;
+
+    for (uint32_t i = 0; i < mLayers.size(); i++) {
+        if (mLayers[i]->mLayerBuffer == NULL)
+            continue;
+        exynos_image src;
+        mLayers[i]->setSrcExynosImage(&src);
+        info.layerBytes += (uint64_t)src.w * src.h * src.exynosFormat.bpp() / 8;
+    }
+    /* Client target is RGBA8888 */
+    info.targetBytes = (uint64_t)mXres * mYres * 4;
+    if (mVsyncPeriod)
+        info.refreshRate = (uint32_t)(s2ns(1) / mVsyncPeriod);
+
+    return info;
+}
+
 void ExynosDisplay::checkLayersForRevertingDR(uint64_t &geometryChanged) {
-    Mutex::Autolock lock(mDRMutex);
+    nsecs_t prevIdleTimeout = 0;
+    nsecs_t idleTimeout = 0;
 
-    if (mDynamicRecompMode != DEVICE_TO_CLIENT)
-        return;
+    {
+        Mutex::Autolock lock(mDRMutex);
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        prevIdleTimeout = mRecompPolicy.getIdleTimeout();
+
+        if (mDynamicRecompMode != DEVICE_TO_CLIENT) {
+            /* Mode could be reset without reverting, e.g. power off */
+            mRecompPolicy.setMode(ExynosRecompPolicy::MODE_DEVICE,
+                                  ExynosRecompPolicy::REASON_GEOMETRY, now);
+        } else {
+            uint32_t reason = ExynosRecompPolicy::REASON_NONE;
+            if (geometryChanged) {
+                reason = ExynosRecompPolicy::REASON_GEOMETRY;
+            } else {
+                /* Update of this frame is not counted by mUpdateRate yet */
+                uint32_t updateRate = mUpdateRate.getRate(now);
+                for (uint32_t i = 0; i < mLayers.size(); i++) {
+                    if (mLayers[i]->mLastLayerBuffer != mLayers[i]->mLayerBuffer) {
+                        updateRate++;
+                        break;
+                    }
+                }
+                reason = mRecompPolicy.getRevertReason(updateRate, getRecompCostInfo());
+            }
 
-    for (uint32_t i = 0; i < mLayers.size(); i++) {
-        if ((mLayers[i]->mLastLayerBuffer != mLayers[i]->mLayerBuffer) || geometryChanged) {
-            mDynamicRecompMode = CLIENT_TO_DEVICE;
-            DISPLAY_LOGD(eDebugDynamicRecomp, "[DYNAMIC_RECOMP] CLIENT TO DEVICE");
+            if (reason != ExynosRecompPolicy::REASON_NONE) {
+                mDynamicRecompMode = CLIENT_TO_DEVICE;
+                mRecompPolicy.setMode(ExynosRecompPolicy::MODE_DEVICE, reason, now);
+                DISPLAY_LOGD(eDebugDynamicRecomp, "[DYNAMIC_RECOMP] CLIENT TO DEVICE, reason(%d)", reason);
+            }
             setGeometryChanged(GEOMETRY_DISPLAY_DYNAMIC_RECOMPOSITION, geometryChanged);
-            return;
         }
+        idleTimeout = mRecompPolicy.getIdleTimeout();
+    }
+
+    /* The timer thread is joined, so it is not done while mDRMutex is locked */
+    if (idleTimeout != prevIdleTimeout) {
+        DISPLAY_LOGD(eDebugDynamicRecomp, "[DYNAMIC_RECOMP] idle timeout(%" PRId64 " ms)", ns2ms(idleTimeout));
+        mDynamicRecompTimer->setInterval(std::chrono::milliseconds(ns2ms(idleTimeout)));
     }
-    setGeometryChanged(GEOMETRY_DISPLAY_DYNAMIC_RECOMPOSITION, geometryChanged);
 }
 
 #ifdef USE_DQE_INTERFACE
@@ -18,6 +18,7 @@
 #define _EXYNOSDISPLAY_H
 
 #include <fstream>
+#include <unordered_set>
 
 #include <utils/Vector.h>
 #include <utils/KeyedVector.h>
@@ -31,6 +32,8 @@
 #include "ExynosDisplayInterface.h"
 #include "ExynosHWCDebug.h"
 #include "OneShotTimer.h"
+#include "ExynosRecompPolicy.h"
+#include "ExynosPresentScheduler.h"
 
 //#include <hardware/exynos/hdrInterface.h>
 //#include <hardware/exynos/hdr10pMetaInterface.h>
@@ -102,23 +105,21 @@ enum {
     LAYER_DUMP_DONE
 };
 
-#define NUM_SKIP_STATIC_LAYER 5
-struct ExynosFrameInfo {
-    uint32_t srcNum;
-    exynos_image srcInfo[NUM_SKIP_STATIC_LAYER];
-    exynos_image dstInfo[NUM_SKIP_STATIC_LAYER];
-
-    void reset() {
-        srcNum = 0;
-        memset(srcInfo, 0x0, NUM_SKIP_STATIC_LAYER * sizeof(exynos_image));
-        memset(dstInfo, 0x0, NUM_SKIP_STATIC_LAYER * sizeof(exynos_image));
-        for (int i = 0; i < NUM_SKIP_STATIC_LAYER; i++) {
-            srcInfo[i].acquireFenceFd = -1;
-            srcInfo[i].releaseFenceFd = -1;
-            dstInfo[i].acquireFenceFd = -1;
-            dstInfo[i].releaseFenceFd = -1;
-        }
-    }
+/* Layers that are not changed for this number of frames can be flattened by M2M MPP */
+#ifndef STATIC_LAYER_FLATTEN_FRAMES
+#define STATIC_LAYER_FLATTEN_FRAMES 5
+#endif
+
+/* Static run that is shorter than this is left to client composition */
+#ifndef STATIC_LAYER_FLATTEN_MIN_LAYERS
+#define STATIC_LAYER_FLATTEN_MIN_LAYERS 2
+#endif
+
+/* Contiguous layers in a composition range that are all static or all dynamic */
+struct StaticLayerRun {
+    int32_t firstIndex;
+    int32_t lastIndex;
+    bool isStatic;
 };
 
 struct redering_state_flags_info {
@@ -152,9 +153,16 @@ struct layerDumpFrameInfo {
 
 class ExynosSortedLayer : public Vector<ExynosLayer *> {
   public:
+    ssize_t add(ExynosLayer *item);
     ssize_t remove(const ExynosLayer *item);
+    void clear();
     status_t vector_sort();
+    /* Sorting doesn't change the set of layers, so it is checked without scanning */
+    bool contains(const ExynosLayer *item) const { return mHandles.count(item) != 0; };
     static int compare(ExynosLayer *const *lhs, ExynosLayer *const *rhs);
+
+  private:
+    std::unordered_set<const ExynosLayer *> mHandles;
 };
 
 class displayTDMInfo {
@@ -209,7 +217,15 @@ class ExynosCompositionInfo : public ExynosMPPSource {
     bool mEnableSkipStatic;
     bool mSkipStaticInitFlag;
     bool mSkipFlag;
-    ExynosFrameInfo mSkipSrcInfo;
+    /*
+     * Layers when mSkipStaticInitFlag was set. The handle is compared exactly
+     * because the fingerprint is a hash.
+     */
+    struct SkipLayerInfo {
+        buffer_handle_t bufferHandle;
+        uint64_t fingerprint;
+    };
+    std::vector<SkipLayerInfo> mSkipLayers;
     exynos_win_config_data mLastWinConfigData;
 
     int32_t mWindowIndex;
@@ -218,6 +234,11 @@ class ExynosCompositionInfo : public ExynosMPPSource {
     ExynosMPP *mBlendingMPP = nullptr;
     DisplayIdentifier mDisplayIdentifier;
 
+    /* Damage of the target buffer, it is set with the target buffer */
+    size_t mDamageNum = 0;
+    android::Vector<hwc_rect_t> mDamageRects;
+    void setDamage(hwc_region_t damage);
+
     ExynosFormat mFormat;
     void init(DisplayIdentifier display, ExynosMPP *blendingMPP) {
         mDisplayIdentifier = display;
@@ -427,6 +448,11 @@ class ExynosDisplay : public ExynosVsyncHandler {
          */
     exynos_dpu_data mLastDpuData;
 
+    /* Damage of the frame and the regions chosen for window update */
+    ExynosDamageRegion mDamageRegion;
+    std::vector<hwc_rect> mWindowUpdateRects;
+    uint64_t mWindowUpdateCount[ExynosDamageRegion::UPDATE_TYPE_MAX] = {};
+
     /**
          * Restore release fence from DECON.
          */
@@ -537,6 +563,11 @@ class ExynosDisplay : public ExynosVsyncHandler {
     dynamic_recomp_mode mDynamicRecompMode = NO_MODE_SWITCH;
     std::optional<OneShotTimer> mDynamicRecompTimer;
     Mutex mDRMutex;
+    /* Protected by mDRMutex, its idle timeout is the interval of mDynamicRecompTimer */
+    ExynosRecompPolicy mRecompPolicy{ms2ns(DYNAMIC_RECOMP_TIMER_MS)};
+    /* Timestamps of frames that any layer buffer is updated, protected by mDRMutex */
+    ExynosUpdateRate mUpdateRate;
+    ExynosRecompPolicy::CostInfo getRecompCostInfo();
 
     void initOneShotTimer() {
         mDynamicRecompTimer.emplace(
@@ -588,10 +619,15 @@ class ExynosDisplay : public ExynosVsyncHandler {
          */
     int skipStaticLayers(ExynosCompositionInfo &compositionInfo);
     int handleStaticLayers(ExynosCompositionInfo &compositionInfo);
+    /* Split layers [firstIndex, lastIndex] to static and dynamic runs */
+    void getStaticLayerRuns(int32_t firstIndex, int32_t lastIndex,
+                            std::vector<StaticLayerRun> &outRuns);
 
     int doPostProcessing();
 
     int doExynosComposition();
+    void setExynosCompositionDamage(ExynosLayer *layer);
+    int setExynosCompositionTarget();
 
     int32_t configureOverlay(ExynosLayer *layer,
                              exynos_win_config_data &cfg, bool hdrException = false);
@@ -755,6 +791,8 @@ class ExynosDisplay : public ExynosVsyncHandler {
         buffer_handle_t target,
         int32_t acquireFence, int32_t /*android_dataspace_t*/ dataspace,
         uint64_t &geometryFlag);
+    /* Damage of the client target, it is called with setClientTarget() */
+    int32_t setClientTargetDamage(hwc_region_t damage);
 
     /* setColorTransform(..., matrix, hint)
          * Descriptor: HWC2_FUNCTION_SET_COLOR_TRANSFORM
@@ -1128,6 +1166,19 @@ class ExynosDisplay : public ExynosVsyncHandler {
     int32_t getConfigAppliedTime(const uint64_t desiredTime,
                                  const uint64_t actualChangeTime,
                                  int64_t &appliedTime, int64_t &refreshTime);
+    /* First vsync after time on the vsync model, or on the nominal period without it */
+    nsecs_t predictNextVsync(nsecs_t time);
+
+    /* Expected present time of the next frame, it is taken by getPresentHoldTarget() */
+    int32_t setExpectedPresentTime(nsecs_t expectedPresentTime);
+    /* Vsync that the frame is held for, 0 if it is not held. Takes mDisplayMutex */
+    nsecs_t getPresentHoldTarget();
+    /*
+     * Holds the frame until the commit deadline of targetVsync, called without locks.
+     * It blocks the calling thread, so the next frame of this display waits behind it.
+     */
+    void holdPresent(nsecs_t targetVsync);
+    ExynosPresentScheduler mPresentScheduler;
 
     /* TODO : TBD */
     int32_t setCursorPositionAsync(uint32_t x_pos, uint32_t y_pos);
@@ -1147,11 +1198,13 @@ class ExynosDisplay : public ExynosVsyncHandler {
     void printConfig(exynos_win_config_data &c);
 
     unsigned int getLayerRegion(ExynosLayer *layer,
-                                hwc_rect &rect_area, uint32_t regionType);
+                                hwc_rect &rect_area, uint32_t regionType,
+                                ExynosDamageRegion *region = nullptr);
     int canApplyWindowUpdate(const exynos_dpu_data &lastConfigsData,
                              const exynos_dpu_data &newConfigsData,
                              uint32_t index);
-    int mergeDamageRect(hwc_rect &merge_rect, hwc_rect &damage_rect);
+    int mergeDamageRect(ExynosDamageRegion &region);
+    int mergeClientTargetDamage(ExynosDamageRegion &region);
     int setWindowUpdate(const hwc_rect &merge_rect);
     bool windowUpdateExceptions();
     int handleWindowUpdate();
@@ -1252,6 +1305,7 @@ class ExynosDisplay : public ExynosVsyncHandler {
 
   public:
     std::map<uint32_t, displayTDMInfo> mDisplayTDMInfo;
+    LatencyRecorder mLatencyRecorder;
 };
 
 class LayerDumpManager {
@@ -35,20 +35,6 @@ constexpr float CONSTANT_FOR_DP_MIN_LUMINANCE = 255.0f * 255.0f / 100.0f;
 constexpr auto nsecsPerSec = std::chrono::nanoseconds(1s).count();
 constexpr bool kUseBufferCaching = true;
 
-typedef struct _drmModeAtomicReqItem drmModeAtomicReqItem, *drmModeAtomicReqItemPtr;
-
-struct _drmModeAtomicReqItem {
-    uint32_t object_id;
-    uint32_t property_id;
-    uint64_t value;
-};
-
-struct _drmModeAtomicReq {
-    uint32_t cursor;
-    uint32_t size_items;
-    drmModeAtomicReqItemPtr items;
-};
-
 extern struct exynos_hwc_control exynosHWCControl;
 static const int32_t kUmPerInch = 25400;
 
@@ -314,7 +300,7 @@ int32_t ExynosDisplayDrmInterface::getLowPowerDrmModeModeInfo() {
     if (ret) {
         ALOGE("Fail to get blob id for lp mode");
     }
-    drmModePropertyBlobPtr blob = drmModeGetPropertyBlob(mDrmDevice->fd(), blobId);
+    drmModePropertyBlobPtr blob = mDrmDevice->backend().GetPropertyBlob(mDrmDevice->fd(), blobId);
     if (!blob) {
         ALOGE("Fail to get blob for lp mode(%" PRId64 ")", blobId);
         return -EINVAL;
@@ -334,7 +320,7 @@ int32_t ExynosDisplayDrmInterface::getLowPowerDrmModeModeInfo() {
               mDozeDrmModes[dozeModeId].v_display(), mDozeDrmModes[dozeModeId].v_refresh());
     }
 
-    drmModeFreePropertyBlob(blob);
+    mDrmDevice->backend().FreePropertyBlob(blob);
 
     return NO_ERROR;
 }
@@ -386,9 +372,11 @@ int32_t ExynosDisplayDrmInterface::setPowerMode(int32_t mode) {
 
     if (mDrmConnector == nullptr)
         return ret;
+    /* Planes can be used by other displays while this display is off */
+    mPlaneShadow.invalidate();
     const DrmProperty &prop = mDrmConnector->dpms_property();
-    if ((ret = drmModeConnectorSetProperty(mDrmDevice->fd(), mDrmConnector->id(), prop.id(),
-                                           dpms_value)) != NO_ERROR) {
+    if ((ret = mDrmDevice->backend().ConnectorSetProperty(mDrmDevice->fd(), mDrmConnector->id(),
+                                                          prop.id(), dpms_value)) != NO_ERROR) {
         HWC_LOGE(mDisplayIdentifier, "setPower mode ret (%d)", ret);
     }
 
@@ -536,8 +524,17 @@ int32_t ExynosDisplayDrmInterface::getVsyncAppliedTime(hwc2_config_t configId,
                                                        displayConfigs &config, int64_t *actualChangeTime) {
     if (mDrmCrtc->adjusted_vblank_property().id() == 0) {
         uint64_t currentTime = systemTime(SYSTEM_TIME_MONOTONIC);
-        *actualChangeTime = currentTime +
-                            (config.vsyncPeriod) * getConfigChangeDuration();
+        int64_t nextVsync = predictNextVsync(currentTime);
+        /*
+         * Mode is committed on the next vsync of the current timeline,
+         * the transient frames after it run with the period of the new config
+         */
+        if (nextVsync)
+            *actualChangeTime = nextVsync +
+                                (config.vsyncPeriod) * getConfigChangeDuration();
+        else
+            *actualChangeTime = currentTime +
+                                (config.vsyncPeriod) * getConfigChangeDuration();
         return HWC2_ERROR_NONE;
     }
 
@@ -559,6 +556,23 @@ int32_t ExynosDisplayDrmInterface::getVsyncAppliedTime(hwc2_config_t configId,
     return HWC2_ERROR_NONE;
 }
 
+int64_t ExynosDisplayDrmInterface::predictNextVsync(int64_t time) {
+    return mDrmVSyncWorker.PredictNextVSync(time);
+}
+
+int64_t ExynosDisplayDrmInterface::getPredictedVsyncPeriod() {
+    return mDrmVSyncWorker.predictor().period();
+}
+
+void ExynosDisplayDrmInterface::dumpVsyncModel(String8 &result) {
+    result.append(mDrmVSyncWorker.predictor().Dump().c_str());
+}
+
+void ExynosDisplayDrmInterface::setVsyncModelPeriod(const DrmMode &mode) {
+    if (mode.v_refresh() > 0)
+        mDrmVSyncWorker.SetVSyncPeriod(nsecsPerSec / mode.v_refresh());
+}
+
 int32_t ExynosDisplayDrmInterface::getColorModes(
     uint32_t *outNumModes,
     int32_t *outModes) {
@@ -712,6 +726,7 @@ int32_t ExynosDisplayDrmInterface::setActiveDrmMode(DrmMode const &mode) {
     }
 
     DrmModeAtomicReq drmReq(this);
+    mPlaneShadow.invalidate();
 
     if ((ret = setDisplayMode(drmReq, modeBlob)) != NO_ERROR) {
         drmReq.addOldBlob(modeBlob);
@@ -741,6 +756,7 @@ int32_t ExynosDisplayDrmInterface::setActiveDrmMode(DrmMode const &mode) {
     mDrmConnector->set_active_mode(mode);
     mActiveModeState.setMode(mode, modeBlob, drmReq);
     mActiveModeState.needs_modeset = false;
+    setVsyncModelPeriod(mode);
 
     return HWC2_ERROR_NONE;
 }
@@ -939,6 +955,7 @@ int32_t ExynosDisplayDrmInterface::updateHdrCapabilities(std::vector<int32_t> &o
 int32_t ExynosDisplayDrmInterface::getBufferId(
     const exynos_win_config_data &config, uint32_t &fbId, const bool useCache) {
     int ret = NO_ERROR;
+    ScopedLatency latency(mLatencyRecorder, LATENCY_STAGE_GET_FB_BUFFER);
     if ((ret = mFBManager.getBuffer(mDisplayIdentifier.type, config, fbId, useCache)) < 0) {
         HWC_LOGE(mDisplayIdentifier,
                  "%s:: Failed to get FB, fbId(%d), ret(%d)",
@@ -966,29 +983,30 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
         return ret;
     }
 
+    /* crtc and fb are always added to make the plane a part of the commit */
     if (((ret = drmReq.atomicAddProperty(plane->id(), plane->crtc_property(),
                                          mDrmCrtc->id())) < 0) ||
         ((ret = drmReq.atomicAddProperty(plane->id(), plane->fb_property(),
                                          fbId)) < 0) ||
-        ((ret = drmReq.atomicAddProperty(plane->id(),
-                                         plane->crtc_x_property(), config.dst.x)) < 0) ||
-        ((ret = drmReq.atomicAddProperty(plane->id(),
-                                         plane->crtc_y_property(), config.dst.y)) < 0) ||
-        ((ret = drmReq.atomicAddProperty(plane->id(),
-                                         plane->crtc_w_property(), config.dst.w)) < 0) ||
-        ((ret = drmReq.atomicAddProperty(plane->id(),
-                                         plane->crtc_h_property(), config.dst.h)) < 0) ||
-        ((ret = drmReq.atomicAddProperty(plane->id(), plane->src_x_property(),
-                                         (int)(config.src.x) << 16)) < 0) ||
-        ((ret = drmReq.atomicAddProperty(plane->id(), plane->src_y_property(),
-                                         (int)(config.src.y) << 16)) < 0) ||
-        ((ret = drmReq.atomicAddProperty(plane->id(), plane->src_w_property(),
-                                         (int)(config.src.w) << 16)) < 0) ||
-        ((ret = drmReq.atomicAddProperty(plane->id(), plane->src_h_property(),
-                                         (int)(config.src.h) << 16)) < 0) ||
-        ((ret = drmReq.atomicAddProperty(plane->id(),
-                                         plane->rotation_property(),
-                                         halTransformToDrmRot(config.transform), true)) < 0)) {
+        ((ret = addPlaneProperty(drmReq, plane,
+                                 plane->crtc_x_property(), config.dst.x)) < 0) ||
+        ((ret = addPlaneProperty(drmReq, plane,
+                                 plane->crtc_y_property(), config.dst.y)) < 0) ||
+        ((ret = addPlaneProperty(drmReq, plane,
+                                 plane->crtc_w_property(), config.dst.w)) < 0) ||
+        ((ret = addPlaneProperty(drmReq, plane,
+                                 plane->crtc_h_property(), config.dst.h)) < 0) ||
+        ((ret = addPlaneProperty(drmReq, plane, plane->src_x_property(),
+                                 (int)(config.src.x) << 16)) < 0) ||
+        ((ret = addPlaneProperty(drmReq, plane, plane->src_y_property(),
+                                 (int)(config.src.y) << 16)) < 0) ||
+        ((ret = addPlaneProperty(drmReq, plane, plane->src_w_property(),
+                                 (int)(config.src.w) << 16)) < 0) ||
+        ((ret = addPlaneProperty(drmReq, plane, plane->src_h_property(),
+                                 (int)(config.src.h) << 16)) < 0) ||
+        ((ret = addPlaneProperty(drmReq, plane,
+                                 plane->rotation_property(),
+                                 halTransformToDrmRot(config.transform), true)) < 0)) {
         HWC_LOGE(mDisplayIdentifier, "Fail to set properties");
         return ret;
     }
@@ -999,8 +1017,8 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
         int32_t retVal = NO_ERROR;
         uint64_t drmEnum = 0;
         std::tie(drmEnum, retVal) = halToDrmEnum(halData, drmEnums);
-        if ((retVal < 0) || ((retVal = drmReq.atomicAddProperty(plane->id(),
-                                                                property, drmEnum, true)) < 0)) {
+        if ((retVal < 0) || ((retVal = addPlaneProperty(drmReq, plane,
+                                                        property, drmEnum, true)) < 0)) {
             HWC_LOGE(mDisplayIdentifier, "Fail to set %s (%d)",
                      property.name().c_str(), halData);
             return retVal;
@@ -1019,8 +1037,8 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
         // Ignore ret and use min_zpos as 0 by default
         std::tie(std::ignore, min_zpos) = plane->zpos_property().range_min();
 
-        if ((ret = drmReq.atomicAddProperty(plane->id(),
-                                            plane->zpos_property(), configIndex + min_zpos)) < 0)
+        if ((ret = addPlaneProperty(drmReq, plane,
+                                    plane->zpos_property(), configIndex + min_zpos)) < 0)
             return ret;
     }
 
@@ -1036,9 +1054,9 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
             ALOGW("[%s] Invalid plane alpha (%f)", mDisplayIdentifier.name.string(), config.plane_alpha);
         }
 
-        if ((ret = drmReq.atomicAddProperty(plane->id(),
-                                            plane->alpha_property(),
-                                            planeAlpha, true)) < 0)
+        if ((ret = addPlaneProperty(drmReq, plane,
+                                    plane->alpha_property(),
+                                    planeAlpha, true)) < 0)
             return ret;
     }
 
@@ -1049,8 +1067,8 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
 
     if (config.state == config.WIN_STATE_COLOR) {
         if (plane->colormap_property().id()) {
-            if ((ret = drmReq.atomicAddProperty(plane->id(),
-                                                plane->colormap_property(), config.color)) < 0)
+            if ((ret = addPlaneProperty(drmReq, plane,
+                                        plane->colormap_property(), config.color)) < 0)
                 return ret;
         } else {
             HWC_LOGE(mDisplayIdentifier, "colormap property is not supported");
@@ -1077,14 +1095,32 @@ int32_t ExynosDisplayDrmInterface::setupCommitFromDisplayConfig(
     }
 
     if (plane->virtual8k_split_property().id()) {
-        if ((ret = drmReq.atomicAddProperty(plane->id(),
-                                            plane->virtual8k_split_property(), config.split, true)) < 0)
+        if ((ret = addPlaneProperty(drmReq, plane,
+                                    plane->virtual8k_split_property(), config.split, true)) < 0)
             return ret;
     }
 
     return NO_ERROR;
 }
 
+int32_t ExynosDisplayDrmInterface::addPlaneProperty(
+    DrmModeAtomicReq &drmReq,
+    const std::unique_ptr<DrmPlane> &plane,
+    const DrmProperty &property,
+    uint64_t value, bool optional) {
+    if (property.id() &&
+        mPlaneShadow.isCommitted(plane->id(), property.id(), value)) {
+        mPlaneShadow.skipped++;
+        return NO_ERROR;
+    }
+
+    int32_t ret = drmReq.atomicAddProperty(plane->id(), property, value, optional);
+    if ((ret == NO_ERROR) && property.id())
+        mPlaneShadow.stage(plane->id(), property.id(), value);
+
+    return ret;
+}
+
 int32_t ExynosDisplayDrmInterface::setFrameStaticMeta(DrmModeAtomicReq &drmReq,
                                                       const exynos_win_config_data &config) {
     if (!mDrmConnector->hdr_output_meta().id())
@@ -1135,6 +1171,18 @@ int32_t ExynosDisplayDrmInterface::setFrameStaticMeta(DrmModeAtomicReq &drmReq,
     return ret;
 }
 
+void ExynosDisplayDrmInterface::getPartialUpdateRestriction(PartialUpdateRestriction &restriction) {
+    if (!mDrmCrtc->partial_region_property().id()) {
+        restriction.maxRegionNum = 0;
+        return;
+    }
+
+    restriction.maxRegionNum = std::min(DRM_PARTIAL_REGION_MAX_NUM, MAX_PARTIAL_UPDATE_REGIONS);
+    restriction.xAlign = restriction.wAlign = DRM_PARTIAL_REGION_X_ALIGN;
+    restriction.yAlign = restriction.hAlign = DRM_PARTIAL_REGION_Y_ALIGN;
+    restriction.fullWidth = DRM_PARTIAL_REGION_FULL_WIDTH;
+}
+
 int32_t ExynosDisplayDrmInterface::setupPartialRegion(
     exynos_dpu_data &dpuData, DrmModeAtomicReq &drmReq) {
     if (!mDrmCrtc->partial_region_property().id())
@@ -1142,18 +1190,29 @@ int32_t ExynosDisplayDrmInterface::setupPartialRegion(
 
     int ret = NO_ERROR;
 
-    struct decon_frame &update_region = dpuData.win_update_region;
-    struct drm_clip_rect partial_rect = {
-        static_cast<unsigned short>(update_region.x),
-        static_cast<unsigned short>(update_region.y),
-        static_cast<unsigned short>(update_region.x + update_region.w),
-        static_cast<unsigned short>(update_region.y + update_region.h),
+    struct drm_clip_rect partial_rect[MAX_PARTIAL_UPDATE_REGIONS];
+    uint32_t rect_num = 1;
+    auto toClipRect = [](const struct decon_frame &region) {
+        return drm_clip_rect{
+            static_cast<unsigned short>(region.x),
+            static_cast<unsigned short>(region.y),
+            static_cast<unsigned short>(region.x + region.w),
+            static_cast<unsigned short>(region.y + region.h),
+        };
     };
+    if (dpuData.enable_win_update && (dpuData.win_update_region_num > 1)) {
+        rect_num = std::min(dpuData.win_update_region_num, (uint32_t)MAX_PARTIAL_UPDATE_REGIONS);
+        for (uint32_t i = 0; i < rect_num; i++)
+            partial_rect[i] = toClipRect(dpuData.win_update_regions[i]);
+    } else {
+        partial_rect[0] = toClipRect(dpuData.win_update_region);
+    }
+
     if ((mPartialRegionState.blob_id == 0) ||
-        mPartialRegionState.isUpdated(partial_rect)) {
+        mPartialRegionState.isUpdated(partial_rect, rect_num)) {
         uint32_t blob_id = 0;
-        ret = mDrmDevice->CreatePropertyBlob(&partial_rect,
-                                             sizeof(partial_rect), &blob_id);
+        ret = mDrmDevice->CreatePropertyBlob(partial_rect,
+                                             sizeof(partial_rect[0]) * rect_num, &blob_id);
         if (ret || (blob_id == 0)) {
             HWC_LOGE(mDisplayIdentifier, "Failed to create partial region "
                                          "blob id=%d, ret=%d",
@@ -1161,19 +1220,18 @@ int32_t ExynosDisplayDrmInterface::setupPartialRegion(
             return ret;
         }
 
-        HDEBUGLOGD(eDebugWindowUpdate,
-                   "%s: partial region updated [%d, %d, %d, %d] -> [%d, %d, %d, %d] blob(%d)",
-                   mDisplayIdentifier.name.string(),
-                   mPartialRegionState.partial_rect.x1,
-                   mPartialRegionState.partial_rect.y1,
-                   mPartialRegionState.partial_rect.x2,
-                   mPartialRegionState.partial_rect.y2,
-                   partial_rect.x1,
-                   partial_rect.y1,
-                   partial_rect.x2,
-                   partial_rect.y2,
-                   blob_id);
-        mPartialRegionState.partial_rect = partial_rect;
+        for (uint32_t i = 0; i < rect_num; i++) {
+            HDEBUGLOGD(eDebugWindowUpdate,
+                       "%s: partial region[%d] updated [%d, %d, %d, %d] blob(%d)",
+                       mDisplayIdentifier.name.string(), i,
+                       partial_rect[i].x1,
+                       partial_rect[i].y1,
+                       partial_rect[i].x2,
+                       partial_rect[i].y2,
+                       blob_id);
+            mPartialRegionState.partial_rect[i] = partial_rect[i];
+        }
+        mPartialRegionState.rect_num = rect_num;
 
         if (mPartialRegionState.blob_id)
             drmReq.addOldBlob(mPartialRegionState.blob_id);
@@ -1202,6 +1260,10 @@ void ExynosDisplayDrmInterface::disablePlanes(DrmModeAtomicReq &drmReq,
     for (auto &plane : mDrmDevice->planes()) {
         uint32_t curChId = chId++;
         ExynosMPP *exynosMPP = mExynosMPPsForPlane[plane->id()];
+        /* Plane that is not used by this display can be changed by other displays */
+        if ((planeEnableInfo == nullptr) || (planeEnableInfo[curChId] == 0))
+            mPlaneShadow.invalidate(plane->id());
+
         if (((exynosMPP != nullptr) && (mDisplayIdentifier.id != UINT32_MAX) &&
              (exynosMPP->mAssignedState & MPP_ASSIGN_STATE_RESERVED) &&
              (exynosMPP->mReservedDisplayInfo.displayIdentifier.id !=
@@ -1244,10 +1306,17 @@ int32_t ExynosDisplayDrmInterface::deliverWinConfigData(exynos_dpu_data &dpuData
 
     funcReturnCallback retCallback(
         [&]() {
-            flipFBs((ret == NO_ERROR) && !mDrmReq.getError());
+            bool committed = (ret == NO_ERROR) && !mDrmReq.getError();
+            if (committed)
+                mPlaneShadow.apply();
+            else
+                mPlaneShadow.invalidate();
+            flipFBs(committed);
             mDrmReq.reset(); });
 
     if (mDesiredModeState.needs_modeset) {
+        mPlaneShadow.invalidate();
+
         /* Use different instance with mDrmReq */
         DrmModeAtomicReq drmReqForModeSet(this);
 
@@ -1360,6 +1429,8 @@ int32_t ExynosDisplayDrmInterface::deliverWinConfigData(exynos_dpu_data &dpuData
                  __func__, ret);
         return ret;
     }
+    HDEBUGLOGD(eDebugDisplayInterfaceConfig, "%s:: %d properties are committed, %d unchanged plane properties are skipped",
+               __func__, mDrmReq.pset().GetCursor(), mPlaneShadow.skipped);
 
     if (dpuData.enable_standalone_writeback) {
         dpuData.present_fence = dpuData.standalone_writeback_info.acq_fence;
@@ -1395,6 +1466,7 @@ int32_t ExynosDisplayDrmInterface::deliverWinConfigData(exynos_dpu_data &dpuData
         HDEBUGLOGD(eDebugDisplayConfig, "%s:: mActiveModeState is updated to mDesiredModeState(%d -> %d)",
                    __func__, mActiveModeState.mode.id(), mDesiredModeState.mode.id());
         mDesiredModeState.apply(mActiveModeState, mDrmReq);
+        setVsyncModelPeriod(mActiveModeState.mode);
     }
 
     return NO_ERROR;
@@ -1563,13 +1635,11 @@ ExynosDisplayDrmInterface::DrmModeAtomicReq::DrmModeAtomicReq(ExynosDisplayDrmIn
 
 void ExynosDisplayDrmInterface::DrmModeAtomicReq::init(ExynosDisplayDrmInterface *displayInterface) {
     mDrmDisplayInterface = displayInterface;
-    mPset = drmModeAtomicAlloc();
+    mPset = std::make_unique<DrmAtomicRequest>();
 }
 
 ExynosDisplayDrmInterface::DrmModeAtomicReq::~DrmModeAtomicReq() {
     reset();
-    if (mPset)
-        drmModeAtomicFree(mPset);
 }
 
 void ExynosDisplayDrmInterface::DrmModeAtomicReq::reset() {
@@ -1584,7 +1654,8 @@ void ExynosDisplayDrmInterface::DrmModeAtomicReq::reset() {
     if (destroyOldBlobs() != NO_ERROR)
         HWC_LOGE(mDrmDisplayInterface->mDisplayIdentifier, "destroy blob error");
 
-    drmModeAtomicSetCursor(mPset, 0);
+    if (mPset)
+        mPset->SetCursor(0);
 }
 
 int32_t ExynosDisplayDrmInterface::DrmModeAtomicReq::atomicAddProperty(
@@ -1598,8 +1669,7 @@ int32_t ExynosDisplayDrmInterface::DrmModeAtomicReq::atomicAddProperty(
     }
 
     if (property.id()) {
-        int ret = drmModeAtomicAddProperty(mPset, id,
-                                           property.id(), value);
+        int ret = mPset->AddProperty(id, property.id(), value);
         if (ret < 0) {
             HWC_LOGE(mDrmDisplayInterface->mDisplayIdentifier, "%s:: Failed to add property %d(%s) for id(%d), ret(%d)",
                      __func__, property.id(), property.name().c_str(), id, ret);
@@ -1617,13 +1687,14 @@ String8 &ExynosDisplayDrmInterface::DrmModeAtomicReq::dumpAtomicCommitInfo(
         (hwcCheckDebugMessages(eDebugDisplayInterfaceConfig) == false))
         return result;
 
-    for (int i = 0; i < drmModeAtomicGetCursor(mPset); i++) {
+    const std::vector<DrmAtomicRequest::Item> &items = mPset->items();
+    for (int i = 0; i < (int)items.size(); i++) {
         const DrmProperty *property = NULL;
         String8 objectName;
         /* Check crtc properties */
-        if (mPset->items[i].object_id == mDrmDisplayInterface->mDrmCrtc->id()) {
+        if (items[i].object_id == mDrmDisplayInterface->mDrmCrtc->id()) {
             for (auto property_ptr : mDrmDisplayInterface->mDrmCrtc->properties()) {
-                if (mPset->items[i].property_id == property_ptr->id()) {
+                if (items[i].property_id == property_ptr->id()) {
                     property = property_ptr;
                     objectName.appendFormat("Crtc");
                     break;
@@ -1634,9 +1705,9 @@ String8 &ExynosDisplayDrmInterface::DrmModeAtomicReq::dumpAtomicCommitInfo(
                          "%s:: object id is crtc but there is no matched property",
                          __func__);
             }
-        } else if (mPset->items[i].object_id == mDrmDisplayInterface->mDrmConnector->id()) {
+        } else if (items[i].object_id == mDrmDisplayInterface->mDrmConnector->id()) {
             for (auto property_ptr : mDrmDisplayInterface->mDrmConnector->properties()) {
-                if (mPset->items[i].property_id == property_ptr->id()) {
+                if (items[i].property_id == property_ptr->id()) {
                     property = property_ptr;
                     objectName.appendFormat("Connector");
                     break;
@@ -1650,9 +1721,9 @@ String8 &ExynosDisplayDrmInterface::DrmModeAtomicReq::dumpAtomicCommitInfo(
         } else {
             uint32_t channelId = 0;
             for (auto &plane : mDrmDisplayInterface->mDrmDevice->planes()) {
-                if (mPset->items[i].object_id == plane->id()) {
+                if (items[i].object_id == plane->id()) {
                     for (auto property_ptr : plane->properties()) {
-                        if (mPset->items[i].property_id == property_ptr->id()) {
+                        if (items[i].property_id == property_ptr->id()) {
                             property = property_ptr;
                             objectName.appendFormat("Plane[%d]", channelId);
                             break;
@@ -1670,25 +1741,25 @@ String8 &ExynosDisplayDrmInterface::DrmModeAtomicReq::dumpAtomicCommitInfo(
         if (property == NULL) {
             HWC_LOGE(mDrmDisplayInterface->mDisplayIdentifier,
                      "%s:: Fail to get property[%d] (object_id: %d, property_id: %d, value: %" PRId64 ")",
-                     __func__, i, mPset->items[i].object_id, mPset->items[i].property_id,
-                     mPset->items[i].value);
+                     __func__, i, items[i].object_id, items[i].property_id,
+                     items[i].value);
             continue;
         }
 
         if (debugPrint)
             ALOGD("property[%d] %s object_id: %d, property_id: %d, name: %s,  value: %" PRId64 ")\n",
-                  i, objectName.string(), mPset->items[i].object_id, mPset->items[i].property_id, property->name().c_str(), mPset->items[i].value);
+                  i, objectName.string(), items[i].object_id, items[i].property_id, property->name().c_str(), items[i].value);
         else
             result.appendFormat("property[%d] %s object_id: %d, property_id: %d, name: %s,  value: %" PRId64 ")\n",
-                                i, objectName.string(), mPset->items[i].object_id, mPset->items[i].property_id, property->name().c_str(), mPset->items[i].value);
+                                i, objectName.string(), items[i].object_id, items[i].property_id, property->name().c_str(), items[i].value);
     }
     return result;
 }
 
 int ExynosDisplayDrmInterface::DrmModeAtomicReq::commit(uint32_t flags, bool loggingForDebug) {
     android::String8 result;
-    int ret = drmModeAtomicCommit(mDrmDisplayInterface->mDrmDevice->fd(),
-                                  mPset, flags, mDrmDisplayInterface->mDrmDevice);
+    DrmDevice *drmDevice = mDrmDisplayInterface->mDrmDevice;
+    int ret = drmDevice->backend().AtomicCommit(drmDevice->fd(), *mPset, flags, drmDevice);
     if (loggingForDebug)
         dumpAtomicCommitInfo(result, true);
     if (ret < 0) {
@@ -1904,7 +1975,7 @@ void ExynosDisplayDrmInterface::DrmWritebackInfo::init(DrmDevice *drmDevice, uin
             ALOGE("Fail to get blob id for writeback_pixel_formats");
             return;
         }
-        drmModePropertyBlobPtr blob = drmModeGetPropertyBlob(mDrmDevice->fd(), blobId);
+        drmModePropertyBlobPtr blob = mDrmDevice->backend().GetPropertyBlob(mDrmDevice->fd(), blobId);
         if (!blob) {
             ALOGE("Fail to get blob for writeback_pixel_formats(%" PRId64 ")", blobId);
             return;
@@ -1917,7 +1988,7 @@ void ExynosDisplayDrmInterface::DrmWritebackInfo::init(DrmDevice *drmDevice, uin
             if (halFormat != HAL_PIXEL_FORMAT_EXYNOS_UNDEFINED)
                 mSupportedFormats.push_back(halFormat);
         }
-        drmModeFreePropertyBlob(blob);
+        mDrmDevice->backend().FreePropertyBlob(blob);
     }
 }
 
@@ -1964,7 +2035,7 @@ int32_t ExynosDisplayDrmInterface::getDisplayIdentificationData(
         return HWC2_ERROR_UNSUPPORTED;
     }
 
-    blob = drmModeGetPropertyBlob(mDrmDevice->fd(), blobId);
+    blob = mDrmDevice->backend().GetPropertyBlob(mDrmDevice->fd(), blobId);
     if (blob == nullptr) {
         ALOGD("%s: Failed to get blob",
               mDisplayIdentifier.name.string());
@@ -1978,7 +2049,7 @@ int32_t ExynosDisplayDrmInterface::getDisplayIdentificationData(
         *outDataSize = blob->length;
     }
     *outPort = mDrmConnector->id();
-    drmModeFreePropertyBlob(blob);
+    mDrmDevice->backend().FreePropertyBlob(blob);
 
     return HWC2_ERROR_NONE;
 }
@@ -28,10 +28,28 @@
 #include "ExynosMPP.h"
 #include "ExynosHWCTypes.h"
 #include "ExynosDrmFramebufferManager.h"
+#include "drmbackend.h"
 #include "drmconnector.h"
 #include "drmcrtc.h"
 #include "vsyncworker.h"
 
+/*
+ * The partial region blob is an array of drm_clip_rect.
+ * Kernel that takes more than one region can raise DRM_PARTIAL_REGION_MAX_NUM.
+ */
+#ifndef DRM_PARTIAL_REGION_MAX_NUM
+#define DRM_PARTIAL_REGION_MAX_NUM 1
+#endif
+#ifndef DRM_PARTIAL_REGION_X_ALIGN
+#define DRM_PARTIAL_REGION_X_ALIGN 1
+#endif
+#ifndef DRM_PARTIAL_REGION_Y_ALIGN
+#define DRM_PARTIAL_REGION_Y_ALIGN 1
+#endif
+#ifndef DRM_PARTIAL_REGION_FULL_WIDTH
+#define DRM_PARTIAL_REGION_FULL_WIDTH false
+#endif
+
 #ifndef HWC_FORCE_PANIC_PATH
 #define HWC_FORCE_PANIC_PATH "/d/dri/1/crtc-0/panic"
 #endif
@@ -60,7 +78,7 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
         DrmModeAtomicReq &operator=(const DrmModeAtomicReq &) = delete;
 
         void init(ExynosDisplayDrmInterface *displayInterface);
-        drmModeAtomicReqPtr pset() { return mPset; };
+        const DrmAtomicRequest &pset() { return *mPset; };
         void reset();
         void setError(int err) { mError = err; };
         int getError() { return mError; };
@@ -86,13 +104,52 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
         };
 
       private:
-        drmModeAtomicReqPtr mPset = nullptr;
+        std::unique_ptr<DrmAtomicRequest> mPset;
         int mError = 0;
         ExynosDisplayDrmInterface *mDrmDisplayInterface = NULL;
         /* Destroy old blobs after commit */
         std::vector<uint32_t> mOldBlobs;
         int drmFd() const { return mDrmDisplayInterface->mDrmDevice->fd(); }
     };
+    /*
+     * Plane property values of the last successful commit.
+     * Kernel keeps plane state between commits so property that has
+     * the same value is not added to the next request.
+     */
+    struct PlaneShadow {
+        /* Key is plane id */
+        std::unordered_map<uint32_t, DrmPropertyMap> committed;
+        std::unordered_map<uint32_t, DrmPropertyMap> staged;
+        /* Number of skipped properties in the current request */
+        uint32_t skipped = 0;
+        bool isCommitted(uint32_t planeId, uint32_t propertyId, uint64_t value) const {
+            auto plane = committed.find(planeId);
+            if (plane == committed.end())
+                return false;
+            auto prop = plane->second.find(propertyId);
+            return (prop != plane->second.end()) && (prop->second == value);
+        };
+        void stage(uint32_t planeId, uint32_t propertyId, uint64_t value) {
+            staged[planeId][propertyId] = value;
+        };
+        void apply() {
+            for (auto &plane : staged) {
+                for (auto &prop : plane.second)
+                    committed[plane.first][prop.first] = prop.second;
+            }
+            staged.clear();
+            skipped = 0;
+        };
+        void invalidate(uint32_t planeId) {
+            committed.erase(planeId);
+            staged.erase(planeId);
+        };
+        void invalidate() {
+            committed.clear();
+            staged.clear();
+            skipped = 0;
+        };
+    };
     void Callback(int display, int64_t timestamp) override;
 
     ExynosDisplayDrmInterface();
@@ -139,6 +196,9 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
     virtual int32_t getConfigChangeDuration();
     virtual int32_t getVsyncAppliedTime(hwc2_config_t configId, displayConfigs &config,
                                         int64_t *actualChangeTime);
+    virtual int64_t predictNextVsync(int64_t time);
+    virtual int64_t getPredictedVsyncPeriod();
+    virtual void dumpVsyncModel(String8 &result);
     virtual int32_t setActiveConfigWithConstraints(
         hwc2_config_t config, displayConfigs_t &displayConfig, bool test = false);
     virtual void getDisplayHWInfo(uint32_t __unused &xres, uint32_t __unused &yres, int &psrMode,
@@ -176,6 +236,7 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
             return 1000000000 / mWorkingVsyncPeriod;
         return 0;
     };
+    virtual void getPartialUpdateRestriction(PartialUpdateRestriction &restriction) override;
     virtual void resetConfigRequestState() override {
         mDesiredModeState.needs_modeset = false;
     };
@@ -259,6 +320,11 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
                                          const uint32_t configIndex,
                                          const std::unique_ptr<DrmPlane> &plane,
                                          uint32_t &fbId);
+    /* It skips the property if it has the same value in mPlaneShadow */
+    int32_t addPlaneProperty(DrmModeAtomicReq &drmReq,
+                             const std::unique_ptr<DrmPlane> &plane,
+                             const DrmProperty &property,
+                             uint64_t value, bool optional = false);
 
     int32_t setFrameStaticMeta(DrmModeAtomicReq &drmReq,
                                const exynos_win_config_data &config);
@@ -291,19 +357,27 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
   private:
     int32_t getLowPowerDrmModeModeInfo();
     int32_t setActiveDrmMode(DrmMode const &mode);
+    void setVsyncModelPeriod(const DrmMode &mode);
     int32_t getBufferId(const exynos_win_config_data &config, uint32_t &fbId,
                         const bool useCache);
     int32_t clearActiveDrmMode();
 
   protected:
     struct PartialRegionState {
-        struct drm_clip_rect partial_rect = {0, 0, 0, 0};
+        struct drm_clip_rect partial_rect[MAX_PARTIAL_UPDATE_REGIONS] = {};
+        uint32_t rect_num = 0;
         uint32_t blob_id = 0;
-        bool isUpdated(drm_clip_rect rect) {
-            return ((partial_rect.x1 != rect.x1) ||
-                    (partial_rect.y1 != rect.y1) ||
-                    (partial_rect.x2 != rect.x2) ||
-                    (partial_rect.y2 != rect.y2));
+        bool isUpdated(const drm_clip_rect *rect, uint32_t num) {
+            if (rect_num != num)
+                return true;
+            for (uint32_t i = 0; i < num; i++) {
+                if ((partial_rect[i].x1 != rect[i].x1) ||
+                    (partial_rect[i].y1 != rect[i].y1) ||
+                    (partial_rect[i].x2 != rect[i].x2) ||
+                    (partial_rect[i].y2 != rect[i].y2))
+                    return true;
+            }
+            return false;
         };
     };
 
@@ -346,6 +420,7 @@ class ExynosDisplayDrmInterface : public ExynosDisplayInterface,
 
     DrmModeAtomicReq mDrmReq;
     ColorRequest mColorRequest;
+    PlaneShadow mPlaneShadow;
 
   private:
     std::unordered_map</*mode id*/ uint32_t, DrmMode> mDozeDrmModes;
@@ -27,6 +27,7 @@
 #include "ExynosHWCTypes.h"
 #include "ExynosHWCDebug.h"
 #include "ExynosDpuData.h"
+#include "LatencyHistogram.h"
 
 using namespace android;
 
@@ -87,6 +88,10 @@ class ExynosDisplayInterface {
     virtual int32_t getVsyncAppliedTime(hwc2_config_t __unused configId,
                                         displayConfigs __unused &config, int64_t *__unused actualChangeTime) { return NO_ERROR; }
     virtual int32_t getConfigChangeDuration() { return 2; };
+    /* Next vsync after time from the vsync model, 0 if it is unknown */
+    virtual int64_t predictNextVsync(int64_t __unused time) { return 0; };
+    virtual int64_t getPredictedVsyncPeriod() { return 0; };
+    virtual void dumpVsyncModel(String8 __unused &result){};
     virtual int32_t setActiveConfigWithConstraints(hwc2_config_t __unused config,
                                                    displayConfigs_t __unused &displayConfig, bool __unused test = false) { return NO_ERROR; };
     virtual void getDisplayHWInfo(uint32_t __unused &xres, uint32_t __unused &yres,
@@ -95,6 +100,7 @@ class ExynosDisplayInterface {
     virtual void registerVsyncHandler(ExynosVsyncHandler *handle) { mVsyncHandler = handle; };
     virtual int getVsyncFd() const { return -1; };
     virtual void setDeviceToDisplayInterface(const struct DeviceToDisplayInterface __unused &initData){};
+    void setLatencyRecorder(LatencyRecorder *recorder) { mLatencyRecorder = recorder; };
     virtual bool readHotplugStatus() { return true; };
     virtual void updateUeventNodeName(String8 __unused node){};
     virtual bool updateHdrSinkInfo() { return false; };
@@ -108,6 +114,7 @@ class ExynosDisplayInterface {
     virtual uint64_t getWorkingVsyncPeriod() { return 0; };
     virtual hwc2_config_t getPreferredModeId() { return 0; };
     virtual void resetConfigRequestState(){};
+    virtual void getPartialUpdateRestriction(PartialUpdateRestriction __unused &restriction){};
 
   public:
     uint32_t mType = INTERFACE_TYPE_NONE;
@@ -115,6 +122,8 @@ class ExynosDisplayInterface {
     DisplayIdentifier mDisplayIdentifier;
     DisplayInfo mDisplayInfo;
     bool mIsHdrSink = false;
+    /* Owned by ExynosDisplay */
+    LatencyRecorder *mLatencyRecorder = nullptr;
 };
 
 #endif
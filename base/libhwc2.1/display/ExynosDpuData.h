@@ -19,6 +19,7 @@
 #include "ExynosMPP.h"
 #include "ExynosHWCDebug.h"
 #include "ExynosHWCTypes.h"
+#include "ExynosDamageRegion.h"
 
 constexpr uint32_t kIdmaFdNum = 3;
 
@@ -78,6 +79,9 @@ struct exynos_dpu_data {
     std::atomic<bool> enable_readback = false;
     bool enable_standalone_writeback = false;
     struct decon_frame win_update_region = {0, 0, 0, 0, 0, 0};
+    /* Regions of the window update, win_update_region is the bounds of them */
+    uint32_t win_update_region_num = 1;
+    struct decon_frame win_update_regions[MAX_PARTIAL_UPDATE_REGIONS] = {};
     struct exynos_writeback_info readback_info;
     struct exynos_writeback_info standalone_writeback_info;
 #ifdef USE_DQE_INTERFACE
@@ -61,10 +61,7 @@ uint64_t getSBWCModifierBits(const format_description &format_desc) {
 }
 
 void freeBufHandle(int drmFd, uint32_t handle) {
-    struct drm_gem_close gem_close {
-        .handle = handle
-    };
-    int ret = drmIoctl(drmFd, DRM_IOCTL_GEM_CLOSE, &gem_close);
+    int ret = android::DrmBackend::GetInstance().CloseBufferHandle(drmFd, handle);
     if (ret) {
         ALOGE("Failed to close gem handle with error %d\n", ret);
     }
@@ -72,7 +69,7 @@ void freeBufHandle(int drmFd, uint32_t handle) {
 
 void removeFbs(int drmFd, std::list<uint32_t> &fbs) {
     for (auto &fb : fbs) {
-        drmModeRmFB(drmFd, fb);
+        android::DrmBackend::GetInstance().RmFB(drmFd, fb);
     }
 }
 
@@ -100,7 +97,7 @@ void FramebufferManager::init(int drmFd) {
 uint32_t FramebufferManager::getBufHandleFromFd(int fd) {
     uint32_t gem_handle = 0;
 
-    int ret = drmPrimeFDToHandle(mDrmFd, fd, &gem_handle);
+    int ret = android::DrmBackend::GetInstance().PrimeFDToHandle(mDrmFd, fd, &gem_handle);
     if (ret) {
         HWC_LOGE_NODISP("drmPrimeFDToHandle failed with error %d", ret);
     }
@@ -111,41 +108,55 @@ int FramebufferManager::addFB2WithModifiers(uint32_t width, uint32_t height, uin
                                             const BufHandles handles, const uint32_t pitches[4],
                                             const uint32_t offsets[4], const uint64_t modifier[4],
                                             uint32_t *buf_id, uint32_t flags) {
-    int ret = drmModeAddFB2WithModifiers(mDrmFd, width, height, pixel_format, handles.data(),
-                                         pitches, offsets, modifier, buf_id, flags);
+    int ret = android::DrmBackend::GetInstance().AddFB2WithModifiers(
+        mDrmFd, width, height, pixel_format, handles.data(), pitches, offsets,
+        modifier, buf_id, flags);
     if (ret)
         HWC_LOGE_NODISP("Failed to add fb error %d\n", ret);
 
     return ret;
 }
 
-bool FramebufferManager::canRemoveBuffer(const std::unique_ptr<Framebuffer> &frameBuf) {
-    for (uint32_t i = 0; i < HWC_NUM_DISPLAY_TYPES; i++) {
-        /* Can't remove framebuffer in active commit */
-        if (mLastActiveCommitTime[i] &&
-            mLastActiveCommitTime[i] == frameBuf->lastActiveTime[i]) {
-            return false;
+bool FramebufferManager::canRemoveBuffer(Partition &partition,
+                                         const std::unique_ptr<Framebuffer> &frameBuf) {
+    /* Can't remove framebuffer in active commit */
+    if (partition.lastActiveCommitTime &&
+        partition.lastActiveCommitTime == frameBuf->lastActiveTime)
+        return false;
+    return true;
+}
+
+void FramebufferManager::evictBuffer(Partition &partition, FBList::iterator it) {
+    auto range = partition.cacheIndex.equal_range(getKey(*it));
+    for (auto indexIt = range.first; indexIt != range.second; indexIt++) {
+        if (indexIt->second == it) {
+            partition.cacheIndex.erase(indexIt);
+            break;
         }
     }
-    return true;
+    partition.cleanupBuffers.splice(partition.cleanupBuffers.end(), partition.cachedBuffers, it);
+    partition.evictionCount++;
 }
 
-void FramebufferManager::fillCleanupBuffer() {
-    auto it = mCachedBuffers.end();
+void FramebufferManager::fillCleanupBuffer(Partition &partition) {
+    if (partition.cachedBuffers.size() <= MAX_CACHED_BUFFERS)
+        return;
+
+    auto it = partition.cachedBuffers.end();
     it--;
-    while (mCachedBuffers.size() > MAX_CACHED_BUFFERS) {
+    while (partition.cachedBuffers.size() > MAX_CACHED_BUFFERS) {
         bool stop = false;
         /*
          * MAX_CACHED_BUFFERS is more than 2,
          * it-- whouldn't be out of range
          */
         auto const cit = it;
-        if (it == mCachedBuffers.begin())
+        if (it == partition.cachedBuffers.begin())
             stop = true;
         else
             it--;
-        if (canRemoveBuffer(*cit))
-            mCleanupBuffers.splice(mCleanupBuffers.end(), mCachedBuffers, cit);
+        if (canRemoveBuffer(partition, *cit))
+            evictBuffer(partition, cit);
 
         if (stop)
             break;
@@ -161,9 +172,11 @@ void FramebufferManager::removeFBsThreadRoutine() {
                 break;
             }
             mCondition.wait(mMutex);
-            fillCleanupBuffer();
-            cleanupBuffers.splice(cleanupBuffers.end(), mCleanupBuffers,
-                                  mCleanupBuffers.begin(), mCleanupBuffers.end());
+        }
+        for (auto &partition : mPartitions) {
+            Mutex::Autolock lock(partition.mutex);
+            fillCleanupBuffer(partition);
+            cleanupBuffers.splice(cleanupBuffers.end(), partition.cleanupBuffers);
         }
         ATRACE_BEGIN("cleanup framebuffers");
         cleanupBuffers.clear();
@@ -184,6 +197,12 @@ int32_t FramebufferManager::getBuffer(const uint32_t displayType,
     BufHandles handles = {0};
     uint32_t bufWidth, bufHeight = 0;
 
+    if (displayType >= HWC_NUM_DISPLAY_TYPES) {
+        HWC_LOGE_NODISP("%s:: invalid display type(%d)", __func__, displayType);
+        return -EINVAL;
+    }
+    Partition &partition = mPartitions[displayType];
+
     funcReturnCallback retCallback([&]() {
         if (config.state != config.WIN_STATE_COLOR) {
             for (uint32_t i = 0; i < bufferNum; i++) {
@@ -289,19 +308,19 @@ int32_t FramebufferManager::getBuffer(const uint32_t displayType,
     }
 
     if (caching) {
-        Mutex::Autolock lock(mMutex);
-        auto it =
-            std::find_if(mCachedBuffers.begin(), mCachedBuffers.end(),
-                         [&config, &drmFormat, &bufWidth, &bufHeight, &modifiers](auto &buffer) { return (buffer->bufferId == config.buffer_id) &&
-                                                                                                         (buffer->format == drmFormat) &&
-                                                                                                         (buffer->width == bufWidth) &&
-                                                                                                         (buffer->height == bufHeight) &&
-                                                                                                         (buffer->modifier == modifiers[0]); });
-        if (it != mCachedBuffers.end()) {
+        Mutex::Autolock lock(partition.mutex);
+        FBKey key = {config.buffer_id, (uint32_t)drmFormat, bufWidth, bufHeight, modifiers[0]};
+        auto indexIt = partition.cacheIndex.find(key);
+        if (indexIt != partition.cacheIndex.end()) {
+            auto it = indexIt->second;
+            partition.cacheIndex.erase(indexIt);
             fbId = (*it)->fbId;
-            mStagingBuffers.splice(mStagingBuffers.end(), mCachedBuffers, it);
+            partition.stagingBuffers.splice(partition.stagingBuffers.end(),
+                                            partition.cachedBuffers, it);
+            partition.hitCount++;
             return NO_ERROR;
         }
+        partition.missCount++;
     }
 
     /* Get handles only if buffer is not in cache */
@@ -336,8 +355,8 @@ int32_t FramebufferManager::getBuffer(const uint32_t displayType,
     }
 
     if (caching) {
-        Mutex::Autolock lock(mMutex);
-        mStagingBuffers.emplace_back(new Framebuffer(mDrmFd, config.buffer_id,
+        Mutex::Autolock lock(partition.mutex);
+        partition.stagingBuffers.emplace_back(new Framebuffer(mDrmFd, config.buffer_id,
                                                      displayType, config.owner,
                                                      drmFormat, bufWidth, bufHeight,
                                                      modifiers[0], fbId));
@@ -347,27 +366,39 @@ int32_t FramebufferManager::getBuffer(const uint32_t displayType,
 }
 
 void FramebufferManager::flip(uint32_t displayType, bool isActiveCommit) {
+    if (displayType >= HWC_NUM_DISPLAY_TYPES)
+        return;
+
     {
-        Mutex::Autolock lock(mMutex);
+        Partition &partition = mPartitions[displayType];
+        Mutex::Autolock lock(partition.mutex);
         nsecs_t time = systemTime(SYSTEM_TIME_MONOTONIC);
         if (isActiveCommit)
-            updateLastActiveCommitTime(displayType, time);
-        for (auto &it : mStagingBuffers) {
+            partition.lastActiveCommitTime = time;
+        for (auto it = partition.stagingBuffers.begin(); it != partition.stagingBuffers.end(); it++) {
             if (isActiveCommit)
-                it->updateLastActiveTime(displayType, time);
+                (*it)->lastActiveTime = time;
+            partition.cacheIndex.emplace(getKey(*it), it);
         }
-        mCachedBuffers.splice(mCachedBuffers.begin(), mStagingBuffers);
+        partition.cachedBuffers.splice(partition.cachedBuffers.begin(), partition.stagingBuffers);
     }
     cleanupSignal(false);
 }
 
 void FramebufferManager::releaseAll() {
-    Mutex::Autolock lock(mMutex);
-    mStagingBuffers.clear();
-    mCachedBuffers.clear();
+    for (auto &partition : mPartitions) {
+        Mutex::Autolock lock(partition.mutex);
+        partition.cacheIndex.clear();
+        partition.stagingBuffers.clear();
+        partition.cachedBuffers.clear();
+        partition.cleanupBuffers.clear();
+    }
 }
 
 void FramebufferManager::onDisplayRemoved(const uint32_t displayType) {
+    if (displayType >= HWC_NUM_DISPLAY_TYPES)
+        return;
+
     {
         /*
          * We don't need to check active commit time of removed display.
@@ -375,29 +406,37 @@ void FramebufferManager::onDisplayRemoved(const uint32_t displayType) {
          * after this function call so active commit time wouldn't be
          * added after this function call.
          */
-        Mutex::Autolock lock(mMutex);
-        mLastActiveCommitTime[displayType] = 0;
+        Partition &partition = mPartitions[displayType];
+        Mutex::Autolock lock(partition.mutex);
+        partition.lastActiveCommitTime = 0;
     }
     removeBuffersForDisplay(displayType);
 }
 
-void FramebufferManager::removeBufferInternal(std::function<bool(const std::unique_ptr<Framebuffer> &buf)> compareFunc) {
-    {
-        Mutex::Autolock lock(mMutex);
-        FBList::iterator it = mCachedBuffers.begin();
-        while (it != mCachedBuffers.end()) {
+void FramebufferManager::removeBufferInternal(std::function<bool(const std::unique_ptr<Framebuffer> &buf)> compareFunc,
+                                              uint32_t displayType) {
+    bool needSignal = false;
+    for (uint32_t i = 0; i < HWC_NUM_DISPLAY_TYPES; i++) {
+        if ((displayType != HWC_NUM_DISPLAY_TYPES) && (displayType != i))
+            continue;
+        Partition &partition = mPartitions[i];
+        Mutex::Autolock lock(partition.mutex);
+        FBList::iterator it = partition.cachedBuffers.begin();
+        while (it != partition.cachedBuffers.end()) {
             auto const cit = it;
             it++;
             if ((*cit)->removePending || compareFunc(*cit)) {
-                if (canRemoveBuffer(*cit)) {
-                    mCleanupBuffers.splice(mCleanupBuffers.end(), mCachedBuffers, cit);
+                if (canRemoveBuffer(partition, *cit)) {
+                    evictBuffer(partition, cit);
                 } else {
                     (*cit)->pendRemove();
                 }
             }
         }
+        if (partition.cleanupBuffers.size() > 0)
+            needSignal = true;
     }
-    if (mCleanupBuffers.size() > 0)
+    if (needSignal)
         mCondition.signal();
 }
 
@@ -412,7 +451,7 @@ void FramebufferManager::removeBuffersForDisplay(const uint32_t displayType) {
     auto compareFunc = [=](const std::unique_ptr<Framebuffer> &buf) {
         return (buf->displayType == displayType);
     };
-    removeBufferInternal(compareFunc);
+    removeBufferInternal(compareFunc, displayType);
 }
 
 void FramebufferManager::removeBuffersForOwner(const void *owner) {
@@ -421,3 +460,19 @@ void FramebufferManager::removeBuffersForOwner(const void *owner) {
     };
     removeBufferInternal(compareFunc);
 }
+
+void FramebufferManager::dump(String8 &result) {
+    result.appendFormat("FramebufferManager\n");
+    for (uint32_t i = 0; i < HWC_NUM_DISPLAY_TYPES; i++) {
+        Partition &partition = mPartitions[i];
+        Mutex::Autolock lock(partition.mutex);
+        uint64_t lookupCount = partition.hitCount + partition.missCount;
+        result.appendFormat("\tdisplay type[%u] staging: %zu, cached: %zu, "
+                            "hit: %" PRIu64 ", miss: %" PRIu64 " (hit ratio %" PRIu64 "%%), "
+                            "eviction: %" PRIu64 "\n",
+                            i, partition.stagingBuffers.size(), partition.cachedBuffers.size(),
+                            partition.hitCount, partition.missCount,
+                            lookupCount ? (partition.hitCount * 100 / lookupCount) : 0,
+                            partition.evictionCount);
+    }
+}
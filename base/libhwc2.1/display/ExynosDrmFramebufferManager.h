@@ -21,9 +21,12 @@
 #include <utils/Mutex.h>
 #include <list>
 #include <array>
+#include <unordered_map>
 #include <thread>
 #include <xf86drmMode.h>
+#include "drmbackend.h"
 #include <utils/Singleton.h>
+#include <utils/String8.h>
 #include "ExynosHWCTypes.h"
 #include "ExynosDpuData.h"
 
@@ -51,26 +54,22 @@ class FramebufferManager : public Singleton<FramebufferManager> {
     int32_t getBuffer(const uint32_t displayType, const exynos_win_config_data &config, uint32_t &fbId, const bool caching);
 
     // this should be called after frame update
-    // this will move all staged buffers to front of the cached buffers queue
+    // this will move staged buffers of the display to front of its cached buffers queue
     // This will also schedule a cleanup of cached buffers if cached buffer list goes
     // beyond MAX_CACHED_BUFFERS_NO_LAYER_NUM_CHANGE
-    void flip(uint32_t displayId, bool isActiveCommit);
+    void flip(uint32_t displayType, bool isActiveCommit);
 
     // release all currently tracked buffers
     void releaseAll();
 
-    void updateLastActiveCommitTime(uint32_t displayType, nsecs_t time) {
-        mLastActiveCommitTime[displayType] = time;
-    };
-
-    void onDisplayRemoved(const uint32_t displayId);
+    void onDisplayRemoved(const uint32_t displayType);
 
     void cleanupSignal(bool hasLayerNumChange = true) {
         bool needSignal = false;
         uint32_t maxCacheBuffer = hasLayerNumChange ? MAX_CACHED_BUFFERS : MAX_CACHED_BUFFERS_NO_LAYER_NUM_CHANGE;
-        {
-            Mutex::Autolock lock(mMutex);
-            if (mCachedBuffers.size() > maxCacheBuffer)
+        for (auto &partition : mPartitions) {
+            Mutex::Autolock lock(partition.mutex);
+            if (partition.cachedBuffers.size() > maxCacheBuffer)
                 needSignal = true;
         }
         if (needSignal)
@@ -81,6 +80,8 @@ class FramebufferManager : public Singleton<FramebufferManager> {
     void removeBuffersForDisplay(const uint32_t displayType);
     void removeBuffersForOwner(const void *owner);
 
+    void dump(String8 &result);
+
   private:
     uint32_t getBufHandleFromFd(int fd);
     // this struct should contain elements that can be used to identify framebuffer more easily
@@ -92,10 +93,7 @@ class FramebufferManager : public Singleton<FramebufferManager> {
               format(_format), width(_width), height(_height), modifier(_modifier),
               fbId(_fbId), drmFd(_drmFd), removePending(false){};
         ~Framebuffer() {
-            drmModeRmFB(drmFd, fbId);
-        };
-        void updateLastActiveTime(uint32_t displayType, nsecs_t time) {
-            lastActiveTime[displayType] = time;
+            android::DrmBackend::GetInstance().RmFB(drmFd, fbId);
         };
         void pendRemove() { removePending = true; };
 
@@ -113,11 +111,54 @@ class FramebufferManager : public Singleton<FramebufferManager> {
 
         uint32_t fbId;
         int drmFd;
-        nsecs_t lastActiveTime[HWC_NUM_DISPLAY_TYPES] = {0};
+        nsecs_t lastActiveTime = 0;
         bool removePending;
     };
     using FBList = std::list<std::unique_ptr<Framebuffer>>;
 
+    struct FBKey {
+        uint64_t bufferId;
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+        uint64_t modifier;
+        bool operator==(const FBKey &rhs) const {
+            return (bufferId == rhs.bufferId) && (format == rhs.format) &&
+                   (width == rhs.width) && (height == rhs.height) &&
+                   (modifier == rhs.modifier);
+        };
+    };
+    struct FBKeyHash {
+        size_t operator()(const FBKey &key) const {
+            uint64_t hash = key.bufferId * 0x9E3779B97F4A7C15ULL;
+            hash ^= ((uint64_t)key.format << 32) | key.width;
+            hash ^= ((uint64_t)key.height << 40) ^ key.modifier;
+            return (size_t)(hash ^ (hash >> 29));
+        };
+    };
+    static FBKey getKey(const std::unique_ptr<Framebuffer> &buf) {
+        return {buf->bufferId, buf->format, buf->width, buf->height, buf->modifier};
+    };
+
+    /* Buffers of a display type are cached and locked separately from other displays */
+    struct Partition {
+        Mutex mutex;
+        // buffers that are going to be committed in the next atomic frame update
+        FBList stagingBuffers;
+        // unused buffers that have been used recently, front of the queue has the most
+        // recently used ones
+        FBList cachedBuffers;
+        // buffers that are going to be removed
+        FBList cleanupBuffers;
+        // index of cachedBuffers, list iterators are kept by splice()
+        std::unordered_multimap<FBKey, FBList::iterator, FBKeyHash> cacheIndex;
+        nsecs_t lastActiveCommitTime = 0;
+
+        uint64_t hitCount = 0;
+        uint64_t missCount = 0;
+        uint64_t evictionCount = 0;
+    };
+
     int addFB2WithModifiers(uint32_t width, uint32_t height, uint32_t pixel_format,
                             const BufHandles handles, const uint32_t pitches[4],
                             const uint32_t offsets[4], const uint64_t modifier[4], uint32_t *buf_id,
@@ -125,28 +166,25 @@ class FramebufferManager : public Singleton<FramebufferManager> {
 
     void removeFBsThreadRoutine();
 
-    bool canRemoveBuffer(const std::unique_ptr<Framebuffer> &frameBuf)
-        REQUIRES(mMutex);
-    void removeBufferInternal(std::function<bool(const std::unique_ptr<Framebuffer> &buf)> compareFunc);
+    bool canRemoveBuffer(Partition &partition, const std::unique_ptr<Framebuffer> &frameBuf)
+        REQUIRES(partition.mutex);
+    // Move the cached framebuffer to cleanupBuffers of the partition
+    void evictBuffer(Partition &partition, FBList::iterator it) REQUIRES(partition.mutex);
+    void removeBufferInternal(std::function<bool(const std::unique_ptr<Framebuffer> &buf)> compareFunc,
+                              uint32_t displayType = HWC_NUM_DISPLAY_TYPES);
     // Put the framebuffers at the back of the cached buffer queue that go beyond
-    // MAX_CACHED_BUFFERS to the FBList. Framebuffers in the FBList would be
+    // MAX_CACHED_BUFFERS to cleanupBuffers. Framebuffers in cleanupBuffers would be
     // released by removeFBsThreadRoutine()
-    void fillCleanupBuffer();
+    void fillCleanupBuffer(Partition &partition) REQUIRES(partition.mutex);
 
-    // buffers that are going to be committed in the next atomic frame update
-    FBList mStagingBuffers;
-    // unused buffers that have been used recently, front of the queue has the most recently used
-    // ones
-    FBList mCachedBuffers;
-    // buffers that are going to be removed
-    FBList mCleanupBuffers;
+    Partition mPartitions[HWC_NUM_DISPLAY_TYPES];
 
     int mDrmFd = -1;
-    nsecs_t mLastActiveCommitTime[HWC_NUM_DISPLAY_TYPES] = {0};
 
     std::thread mRmFBThread;
     bool mRmFBThreadRunning = false;
     Condition mCondition;
+    // Lock for the cleanup thread
     Mutex mMutex;
 };
 #endif
@@ -44,6 +44,7 @@ ExynosLayer::ExynosLayer(DisplayInfo displayInfo)
       mValidateExynosCompositionType(HWC2_COMPOSITION_INVALID),
       mOverlayInfo(0x0),
       mSupportedMPPFlag(0x0),
+      mUncheckedMPPFlag(0x0),
       mFps(0),
       mOverlayPriority(ePriorityLow),
       mGeometryChanged(0x0),
@@ -56,6 +57,9 @@ ExynosLayer::ExynosLayer(DisplayInfo displayInfo)
       mLastFrameCount(0),
       mLastFpsTime(0),
       mLastLayerBuffer(NULL),
+      mFingerprint(0),
+      mLastFingerprint(0),
+      mStaticFrameCount(0),
       mLayerBuffer(NULL),
       mDamageNum(0),
       mBlending(HWC2_BLEND_MODE_NONE),
@@ -797,6 +801,50 @@ void ExynosLayer::setSrcAcquireFence() {
     }
 }
 
+static inline void addFingerprint(uint64_t &fingerprint, uint64_t value) {
+    for (uint32_t i = 0; i < sizeof(value); i++) {
+        fingerprint ^= (value >> (i * 8)) & 0xff;
+        fingerprint *= 0x100000001b3ULL;
+    }
+}
+
+static inline void addFingerprint(uint64_t &fingerprint, float value) {
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    addFingerprint(fingerprint, (uint64_t)bits);
+}
+
+void ExynosLayer::updateFingerprint() {
+    uint64_t fingerprint = 0xcbf29ce484222325ULL;
+
+    addFingerprint(fingerprint, (uint64_t)(uintptr_t)mLayerBuffer);
+    addFingerprint(fingerprint, mPreprocessedInfo.sourceCrop.left);
+    addFingerprint(fingerprint, mPreprocessedInfo.sourceCrop.top);
+    addFingerprint(fingerprint, mPreprocessedInfo.sourceCrop.right);
+    addFingerprint(fingerprint, mPreprocessedInfo.sourceCrop.bottom);
+    addFingerprint(fingerprint, ((uint64_t)(uint32_t)mPreprocessedInfo.displayFrame.left << 32) |
+                                    (uint32_t)mPreprocessedInfo.displayFrame.top);
+    addFingerprint(fingerprint, ((uint64_t)(uint32_t)mPreprocessedInfo.displayFrame.right << 32) |
+                                    (uint32_t)mPreprocessedInfo.displayFrame.bottom);
+    addFingerprint(fingerprint, mPlaneAlpha);
+    addFingerprint(fingerprint, ((uint64_t)mDataSpace << 32) | (uint32_t)mTransform);
+    addFingerprint(fingerprint, ((uint64_t)(uint32_t)mBlending << 32) |
+                                    ((uint32_t)mColor.r << 24) | ((uint32_t)mColor.g << 16) |
+                                    ((uint32_t)mColor.b << 8) | mColor.a);
+
+    mFingerprint = fingerprint;
+}
+
+void ExynosLayer::updateStaticFrameCount() {
+    if (mFingerprint == mLastFingerprint) {
+        if (mStaticFrameCount < UINT32_MAX)
+            mStaticFrameCount++;
+    } else {
+        mStaticFrameCount = 0;
+    }
+    mLastFingerprint = mFingerprint;
+}
+
 void ExynosLayer::dump(String8 &result) {
     int32_t fd, fd1, fd2;
     if (mLayerBuffer != NULL) {
@@ -837,6 +885,8 @@ void ExynosLayer::dump(String8 &result) {
     }
 
     result.appendFormat("acquireFence: %d\n", mAcquireFence);
+    result.appendFormat("fingerprint: 0x%" PRIx64 ", static frames: %u\n",
+                        mFingerprint, mStaticFrameCount);
     if ((mOtfMPP == NULL) && (mM2mMPP == NULL))
         result.appendFormat("\tresource is not assigned.\n");
     if (mOtfMPP != NULL)
@@ -28,6 +28,7 @@
 #include "VendorVideoAPI.h"
 #include "ExynosHWCHelper.h"
 #include "ExynosHWCTypes.h"
+#include "ExynosRecompPolicy.h"
 
 #ifndef HWC2_HDR10_PLUS_SEI
 /* based on android.hardware.composer.2_3 */
@@ -87,6 +88,8 @@ class ExynosLayer : public ExynosMPPSource {
          * This infor will be used for supported infomation at resource arranging time
          */
     uint32_t mSupportedMPPFlag;
+    /* Logical types of MPPs that were partitioned away when mSupportedMPPFlag was updated */
+    uint32_t mUncheckedMPPFlag;
 
     /**
          * TODO : Should be defined..
@@ -134,11 +137,26 @@ class ExynosLayer : public ExynosMPPSource {
     uint32_t mLastFrameCount;
     nsecs_t mLastFpsTime;
 
+    /**
+         * Buffer update timestamps, mFps is updated from it on every present
+         */
+    ExynosUpdateRate mUpdateRate;
+
     /**
          * Previous buffer's handle
          */
     buffer_handle_t mLastLayerBuffer;
 
+    /**
+         * Fingerprint of the content (handle, crop, frame, alpha, dataspace, transform)
+         * It is updated once a frame by updateFingerprint() and mLastFingerprint
+         * is the one of the last presented frame
+         */
+    uint64_t mFingerprint;
+    uint64_t mLastFingerprint;
+    /* Number of presented frames that the fingerprint was not changed */
+    uint32_t mStaticFrameCount;
+
     /**
          * Display buffer handle
          */
@@ -354,6 +372,14 @@ class ExynosLayer : public ExynosMPPSource {
 
     void setSrcAcquireFence();
 
+    void updateFingerprint();
+    void updateStaticFrameCount();
+    /* Layer is not changed in this frame and previous minFrames frames */
+    bool isStatic(uint32_t minFrames) const {
+        return (mLayerBuffer != NULL) && (mFingerprint == mLastFingerprint) &&
+               (mStaticFrameCount >= minFrames);
+    };
+
     bool isDrm() { return ((mLayerBuffer != NULL) && (getDrmMode(mLayerBuffer) != NO_DRM)); };
     void setGeometryChanged(uint64_t changedBit,
                             uint64_t &outGeometryChanged);
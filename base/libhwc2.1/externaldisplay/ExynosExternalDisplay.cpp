@@ -389,6 +389,7 @@ int32_t ExynosExternalDisplay::setPowerMode(int32_t /*hwc2_power_mode_t*/ mode,
         int fb_blank = 0;
         int err = 0;
         if (mode == HWC_POWER_MODE_OFF) {
+            mPresentScheduler.cancel();
             fb_blank = FB_BLANK_POWERDOWN;
             err = disable();
         } else if (mHpdStatus == false) {
@@ -422,6 +423,7 @@ int32_t ExynosExternalDisplay::setPowerMode(int32_t /*hwc2_power_mode_t*/ mode,
                 closeFencesForSkipFrame(RENDERING_STATE_VALIDATED);
             mRenderingState = RENDERING_STATE_NONE;
         } else {
+            mPresentScheduler.resume();
             setGeometryChanged(GEOMETRY_DISPLAY_POWER_ON, geometryFlag);
         }
     }
@@ -197,6 +197,9 @@ int ExynosHWCService::setHWCCtl(uint32_t display, uint32_t ctrl, int32_t val) {
     case HWC_CTL_SYS_FENCE_LOGGING:
     case HWC_CTL_DO_FENCE_FILE_DUMP:
     case HWC_CTL_USE_PERF_FILE:
+    case HWC_CTL_COMPOSITION_PLANNER:
+    case HWC_CTL_PARALLEL_VALIDATE:
+    case HWC_CTL_PRESENT_SCHEDULER:
     case HWC_CTL_ADJUST_DYNAMIC_RECOMP_TIMER:
         ALOGI("%s::%d on/off=%d", __func__, ctrl, val);
         mExynosDevice->setHWCControl(display, ctrl, val);
@@ -268,6 +271,11 @@ int ExynosHWCService::getCPUPerfInfo(int display, int config, int32_t *cpuIDs, i
     return mExynosDevice->getCPUPerfInfo(display, config, cpuIDs, min_clock);
 }
 
+int ExynosHWCService::getLatencyHistogram(int display, int reset, String8 *stats) {
+    ALOGD_IF(HWC_SERVICE_DEBUG, "%s::display(%d), reset(%d)", __func__, display, reset);
+    return mExynosDevice->dumpLatencyHistogram(display, reset != 0, *stats);
+}
+
 int ExynosHWCService::createServiceLocked() {
     ALOGD_IF(HWC_SERVICE_DEBUG, "%s::", __func__);
     sp<IServiceManager> sm = defaultServiceManager();
@@ -441,6 +449,16 @@ status_t ExynosHWCService::onTransact(
         reply->writeInt32(res);
         return NO_ERROR;
     } break;
+    case GET_LATENCY_HISTOGRAM: {
+        CHECK_INTERFACE(IExynosHWCService, data, reply);
+        int display = data.readInt32();
+        int reset = data.readInt32();
+        String8 stats;
+        int res = getLatencyHistogram(display, reset, &stats);
+        reply->writeInt32(res);
+        reply->writeString8(stats);
+        return NO_ERROR;
+    } break;
     default:
         return BBinder::onTransact(code, data, reply, flags);
     }
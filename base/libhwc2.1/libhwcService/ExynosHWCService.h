@@ -48,6 +48,7 @@ class ExynosHWCService
     virtual void setBootFinished(void);
     virtual uint32_t getHWCDebug();
     virtual int getCPUPerfInfo(int display, int config, int32_t *cpuIDs, int32_t *min_clock);
+    virtual int getLatencyHistogram(int display, int reset, String8 *stats);
 
     void enableMPP(uint32_t physicalType, uint32_t physicalIndex, uint32_t logicalIndex, uint32_t enable);
     /* Below functions are used only with vndservice call */
@@ -161,6 +161,21 @@ class BpExynosHWCService : public BpInterface<IExynosHWCService> {
         }
         return result;
     }
+
+    virtual int getLatencyHistogram(int display, int reset, String8 *stats) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IExynosHWCService::getInterfaceDescriptor());
+        data.writeInt32(display);
+        data.writeInt32(reset);
+        int result = remote()->transact(GET_LATENCY_HISTOGRAM, data, &reply);
+        if (result == NO_ERROR) {
+            result = reply.readInt32();
+            *stats = reply.readString8();
+        } else {
+            ALOGE("GET_LATENCY_HISTOGRAM transact error(%d)", result);
+        }
+        return result;
+    }
 };
 
 IMPLEMENT_META_INTERFACE(ExynosHWCService, "android.hal.ExynosHWCService");
@@ -23,6 +23,7 @@
 
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
+#include <utils/String8.h>
 #include <binder/IInterface.h>
 
 namespace android {
@@ -56,6 +57,7 @@ enum {
 
     GET_CPU_PERF_INFO = 109,
     SET_INTERFACE_DEBUG = 110,
+    GET_LATENCY_HISTOGRAM = 111,
 };
 
 class IExynosHWCService : public IInterface {
@@ -76,6 +78,12 @@ class IExynosHWCService : public IInterface {
     virtual void setBootFinished(void) = 0;
     virtual uint32_t getHWCDebug() = 0;
     virtual int getCPUPerfInfo(int display, int config, int32_t *cpuIDs, int32_t *min_clock) = 0;
+    /*
+     * getLatencyHistogram() returns validate/present latency of the display.
+     * All of displays are returned if display is -1.
+     * Histograms are cleared after they are read if reset is not 0.
+     */
+    virtual int getLatencyHistogram(int display, int reset, String8 *stats) = 0;
 
     /*
     virtual void notifyPSRExit() = 0;
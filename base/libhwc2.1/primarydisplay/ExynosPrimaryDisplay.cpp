@@ -193,6 +193,12 @@ int32_t ExynosPrimaryDisplay::setPowerMode(int32_t mode,
     mPendConfigInfo.dump(pendConfigDump);
     ALOGD("\tactiveConfig:: %d, %s", mActiveConfig, pendConfigDump.string());
 
+    /* Held frame is released on power off, it is not held again until power on */
+    if (mode == HWC2_POWER_MODE_OFF)
+        mPresentScheduler.cancel();
+    else
+        mPresentScheduler.resume();
+
     switch (mode) {
     case HWC2_POWER_MODE_DOZE_SUSPEND:
         return setPowerDoze(true);
@@ -408,6 +414,13 @@ void ExynosPrimaryDisplay::init(uint32_t maxWindowNum, ExynosMPP *blendingMPP) {
 
 void ExynosPrimaryDisplay::checkLayersForSettingDR() {
     Mutex::Autolock lock(mDRMutex);
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    nsecs_t idleTime = now - mUpdateRate.getLastUpdateTime();
+    uint32_t updateRate = mUpdateRate.getRate(now);
+
+    if (mDynamicRecompMode == DEVICE_TO_CLIENT)
+        return;
+
     /* According to the following conditions, HWC will skip the mode switch
      * 1. There is YUV layer
      * 2. There is scaling layer
@@ -431,8 +444,14 @@ void ExynosPrimaryDisplay::checkLayersForSettingDR() {
             }
         }
     }
-    DISPLAY_LOGD(eDebugDynamicRecomp, "[DYNAMIC_RECOMP] DEVICE_TO_CLIENT is set");
+
+    /* It is checked again after the next frame */
+    if (!mRecompPolicy.shouldFlatten(idleTime, updateRate, getRecompCostInfo()))
+        return;
+
+    DISPLAY_LOGD(eDebugDynamicRecomp, "[DYNAMIC_RECOMP] DEVICE_TO_CLIENT is set, rate(%u)", updateRate);
     mDynamicRecompMode = DEVICE_TO_CLIENT;
+    mRecompPolicy.setMode(ExynosRecompPolicy::MODE_CLIENT, ExynosRecompPolicy::REASON_STATIC, now);
     invalidate();
 }
 
@@ -67,7 +67,9 @@ ExynosMPPSource::ExynosMPPSource(uint32_t sourceType, void *source)
     : mSourceType(sourceType),
       mSource(source),
       mOtfMPP(NULL),
-      mM2mMPP(NULL) {
+      mM2mMPP(NULL),
+      mBaseCycles{0, 0},
+      mCapaException(false) {
     mSrcImg.reset();
     mDstImg.reset();
     mMidImg.reset();
@@ -105,10 +107,10 @@ ExynosMPP::ExynosMPP(uint32_t physicalType, uint32_t logicalType, const char *na
       mAssignedState(MPP_ASSIGN_STATE_FREE),
       mEnableByDebug(true),
       mDisableByUserScenario(0),
+      mPartitionDisplayId(MPP_PARTITION_NONE),
       mMaxSrcLayerNum(1),
       mPrevAssignedState(MPP_ASSIGN_STATE_FREE),
       mPrevAssignedDisplayType(-1),
-      mResourceManageThread(this),
       mCapacity(-1),
       mUsedCapacity(0),
       mAllocOutBufFlag(true),
@@ -117,6 +119,7 @@ ExynosMPP::ExynosMPP(uint32_t physicalType, uint32_t logicalType, const char *na
       mWasUsedPrevFrame(false),
       mCurrentDstBuf(0),
       mPrivDstBuf(-1),
+      mLastDstBuf(-1),
       mTargetCompressionInfo({COMP_TYPE_NONE, 0, 0}),
       mCurrentTargetCompressionInfoType(COMP_TYPE_NONE),
       mAcrylicHandle(NULL),
@@ -130,6 +133,7 @@ ExynosMPP::ExynosMPP(uint32_t physicalType, uint32_t logicalType, const char *na
         mSrcSizeRestrictions[i] = {};
         mDstSizeRestrictions[i] = {};
     }
+    memset(mFormatCapaTable, 0, sizeof(mFormatCapaTable));
 
     if (mPhysicalType == MPP_G2D) {
         if (mLogicalType == MPP_LOGICAL_G2D_RGB) {
@@ -198,8 +202,9 @@ ExynosMPP::ExynosMPP(uint32_t physicalType, uint32_t logicalType, const char *na
     mAssignedSources.clear();
     resetUsedCapacity();
 
-    mResourceManageThread.mRunning = true;
-    mResourceManageThread.run();
+    if (USE_ASYNC_M2M_PROCESSING && (mMPPType == MPP_TYPE_M2M) &&
+        (mAcrylicHandle != NULL))
+        mAsyncPostProcessing = true;
 
     mPrevFrameInfo.reset();
 
@@ -217,6 +222,12 @@ ExynosMPP::ExynosMPP(uint32_t physicalType, uint32_t logicalType, const char *na
 }
 
 ExynosMPP::~ExynosMPP() {
+    /* Submitted job uses mSrcImgs and mAcrylicHandle */
+    waitPostProcessing();
+    /* Callbacks of the reactor use this MPP */
+    ExynosFenceReactor::getInstance().cancel(this);
+
+    releasePartialComposition();
     for (uint32_t i = 0; i < NUM_MPP_SRC_BUFS; i++) {
         if (mSrcImgs[i].mppLayer != NULL) {
             delete mSrcImgs[i].mppLayer;
@@ -232,21 +243,62 @@ ExynosMPP::~ExynosMPP() {
         close(mLutParcelFd);
 }
 
-ExynosMPP::ResourceManageThread::ResourceManageThread(ExynosMPP *exynosMPP)
-    : mExynosMPP(exynosMPP),
-      mRunning(false) {
+/* It is never destroyed because MPPs can wait for it until the process exits */
+ExynosMPP::PostProcessingWorker &ExynosMPP::PostProcessingWorker::getInstance() {
+    static PostProcessingWorker *worker = new PostProcessingWorker();
+    return *worker;
+}
+
+ExynosMPP::PostProcessingWorker::PostProcessingWorker() {
+    mThread = std::thread(&PostProcessingWorker::threadLoop, this);
+    mThread.detach();
 }
 
-ExynosMPP::ResourceManageThread::~ResourceManageThread() {
-    mRunning = false;
-    mCondition.signal();
-    if (mThread.joinable()) {
-        mThread.join();
+void ExynosMPP::PostProcessingWorker::threadLoop() {
+    ALOGI("M2M postProcessing worker is started");
+    while (true) {
+        ExynosMPP *exynosMPP;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this] { return !mJobs.empty(); });
+            exynosMPP = mJobs.front();
+            mJobs.pop_front();
+        }
+
+        /*
+         * The caller doesn't touch the job data until wait() returns,
+         * so the job runs without the lock.
+         */
+        int32_t ret = exynosMPP->doPostProcessingInternal();
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        exynosMPP->mPostProcessingResult = ret;
+        exynosMPP->mPostProcessingRequested = false;
+        mDoneCondition.notify_all();
+    }
+}
+
+void ExynosMPP::PostProcessingWorker::request(ExynosMPP *exynosMPP) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        exynosMPP->mPostProcessingRequested = true;
+        exynosMPP->mPostProcessingResult = NO_ERROR;
+        mJobs.push_back(exynosMPP);
     }
+    mCondition.notify_one();
 }
 
-void ExynosMPP::ResourceManageThread::run() {
-    mThread = std::thread(&ResourceManageThread::threadLoop, this);
+/*
+ * @return result of the last requested job of exynosMPP.
+ * It is returned only once, NO_ERROR is returned after that.
+ */
+int32_t ExynosMPP::PostProcessingWorker::wait(ExynosMPP *exynosMPP) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDoneCondition.wait(lock, [exynosMPP] { return !exynosMPP->mPostProcessingRequested; });
+
+    int32_t ret = exynosMPP->mPostProcessingResult;
+    exynosMPP->mPostProcessingResult = NO_ERROR;
+    return ret;
 }
 
 bool ExynosMPP::isDataspaceSupportedByMPP(struct exynos_image &src, struct exynos_image &dst) {
@@ -362,6 +414,15 @@ bool ExynosMPP::checkRotationCondition(struct exynos_image &src) {
     }
 }
 
+static uint32_t compileUnsupportedTransform(uint64_t attr) {
+    uint32_t unsupported = 0;
+    for (auto transform_map : transform_map_table) {
+        if (!(attr & transform_map.hwc_tr))
+            unsupported |= transform_map.hal_tr;
+    }
+    return unsupported;
+}
+
 bool ExynosMPP::isSupportedTransform(struct exynos_image &src) {
     if (src.transform == 0)
         return true;
@@ -372,14 +433,11 @@ bool ExynosMPP::isSupportedTransform(struct exynos_image &src) {
     if (!checkRotationCondition(src))
         return false;
 
-    for (auto transform_map : transform_map_table) {
-        if (src.transform & transform_map.hal_tr) {
-            if (!(mAttr & transform_map.hwc_tr))
-                return false;
-        }
-    }
-
-    return true;
+    /* mAttr can be changed by the feature update after the table is compiled */
+    uint32_t unsupported = (isCapabilityTableValid() && (mTransformCapaAttr == mAttr))
+                               ? mUnsupportedTransform
+                               : compileUnsupportedTransform(mAttr);
+    return !(src.transform & unsupported);
 }
 
 bool ExynosMPP::isSupportedCompression(struct exynos_image &src) {
@@ -452,38 +510,62 @@ int32_t ExynosMPP::isDimLayerSupported() {
 }
 
 bool ExynosMPP::isSrcFormatSupported(struct exynos_image &src) {
-    if (mLogicalType == MPP_LOGICAL_G2D_YUV) {
-        /* Support YUV layer and HDR RGB layer */
-        if (src.exynosFormat.isRgb() && (hasHdrInfo(src) == false))
-            return false;
-    }
-    if ((mLogicalType == MPP_LOGICAL_G2D_RGB) &&
-        src.exynosFormat.isYUV())
-        return false;
-    if ((mLogicalType == MPP_LOGICAL_MSC_YUV) &&
-        src.exynosFormat.isRgb()) {
-        return false;
-    }
+    uint8_t capa = getFormatCapa(src.exynosFormat.descIndex()) & FORMAT_CAPA_SRC;
+    if ((capa == 0) || (capa == FORMAT_CAPA_SRC))
+        return (capa != 0);
 
-    for (uint32_t i = 0; i < mFormatRestrictions.size(); i++) {
-        if (((mFormatRestrictions[i].nodeType == NODE_NONE) ||
-             (mFormatRestrictions[i].nodeType == NODE_SRC)) &&
-            (mFormatRestrictions[i].format == src.exynosFormat.halFormat()))
-            return true;
-    }
-
-    return false;
+    /* Format is supported only for one of HDR or SDR layer */
+    if (hasHdrInfo(src))
+        return !!(capa & FORMAT_CAPA_SRC_HDR);
+    return !!(capa & FORMAT_CAPA_SRC_SDR);
 }
 
 bool ExynosMPP::isDstFormatSupported(struct exynos_image &dst) {
-    for (uint32_t i = 0; i < mFormatRestrictions.size(); i++) {
-        if (((mFormatRestrictions[i].nodeType == NODE_NONE) ||
-             (mFormatRestrictions[i].nodeType == NODE_DST)) &&
-            (mFormatRestrictions[i].format == dst.exynosFormat.halFormat()))
-            return true;
+    return !!(getFormatCapa(dst.exynosFormat.descIndex()) & FORMAT_CAPA_DST);
+}
+
+uint8_t ExynosMPP::getFormatCapa(uint32_t descIndex) {
+    if (mFormatCapaTableValid.load(std::memory_order_acquire))
+        return mFormatCapaTable[descIndex];
+
+    /* Restrictions are being added, the table is not written from here */
+    return compileFormatCapa(descIndex);
+}
+
+uint8_t ExynosMPP::compileFormatCapa(uint32_t descIndex) {
+    const format_description_t &desc = exynos_format_desc[descIndex];
+    bool isRgb = (desc.type & FORMAT_RGB_MASK) ? true : false;
+    uint8_t capa = 0;
+
+    for (uint32_t j = 0; j < mFormatRestrictions.size(); j++) {
+        if (mFormatRestrictions[j].format != (uint32_t)desc.halFormat)
+            continue;
+        if ((mFormatRestrictions[j].nodeType == NODE_NONE) ||
+            (mFormatRestrictions[j].nodeType == NODE_SRC))
+            capa |= FORMAT_CAPA_SRC;
+        if ((mFormatRestrictions[j].nodeType == NODE_NONE) ||
+            (mFormatRestrictions[j].nodeType == NODE_DST))
+            capa |= FORMAT_CAPA_DST;
     }
 
-    return false;
+    /* Support YUV layer and HDR RGB layer */
+    if ((mLogicalType == MPP_LOGICAL_G2D_YUV) && isRgb)
+        capa &= ~FORMAT_CAPA_SRC_SDR;
+    if ((mLogicalType == MPP_LOGICAL_G2D_RGB) && !isRgb)
+        capa &= ~FORMAT_CAPA_SRC;
+    if ((mLogicalType == MPP_LOGICAL_MSC_YUV) && isRgb)
+        capa &= ~FORMAT_CAPA_SRC;
+
+    return capa;
+}
+
+/* Called only where restrictions are built, never from validate */
+void ExynosMPP::updateCapabilityTable() {
+    for (uint32_t i = 0; i < FORMAT_MAX_CNT; i++)
+        mFormatCapaTable[i] = compileFormatCapa(i);
+    mTransformCapaAttr = mAttr;
+    mUnsupportedTransform = compileUnsupportedTransform(mAttr);
+    mFormatCapaTableValid.store(true, std::memory_order_release);
 }
 
 uint32_t ExynosMPP::getMaxUpscale(struct exynos_image &src, struct exynos_image __unused &dst) {
@@ -758,6 +840,22 @@ uint32_t ExynosMPP::getOutBufAlign() {
         return 1;
 }
 
+void ExynosMPP::getDefaultOutBufSize(uint32_t xres, uint32_t yres,
+                                     uint32_t &width, uint32_t &height) {
+    uint32_t bufAlign = getOutBufAlign();
+    width = xres;
+    height = yres;
+    // For using the compressed output in G2D composition,
+    // allocated buffer size should be larger than FHD.
+    if ((mMaxSrcLayerNum > 1) && (mPhysicalType == MPP_G2D) &&
+        (xres * yres < 1920 * 1080)) {
+        width = 1080;
+        height = 1920;
+    }
+    width = ALIGN_UP(width, bufAlign);
+    height = ALIGN_UP(height, bufAlign);
+}
+
 int32_t ExynosMPP::isSupportLayerColorTransform(
     struct exynos_image &src, struct exynos_image __unused &dst) {
     if (src.needColorTransform == false)
@@ -769,116 +867,6 @@ int32_t ExynosMPP::isSupportLayerColorTransform(
     return false;
 }
 
-void ExynosMPP::ResourceManageThread::threadLoop() {
-    if (mExynosMPP == NULL)
-        return;
-
-    ALOGI("%s threadLoop is started", mExynosMPP->mName.string());
-    while (mRunning) {
-        Mutex::Autolock lock(mMutex);
-        while ((mFreedBuffers.size() == 0) &&
-               (mStateFences.size() == 0) &&
-               (mRunning == true)) {
-            mCondition.wait(mMutex);
-        }
-
-        if ((mExynosMPP->mHWState == MPP_HW_STATE_RUNNING) &&
-            (mStateFences.size() != 0)) {
-            if (checkStateFences()) {
-                mExynosMPP->mHWState = MPP_HW_STATE_IDLE;
-            }
-        } else {
-            if ((mStateFences.size() != 0) &&
-                (mExynosMPP->mHWState != MPP_HW_STATE_RUNNING)) {
-                ALOGW("%s, mHWState(%d) but mStateFences size(%zu)",
-                      mExynosMPP->mName.string(), mExynosMPP->mHWState,
-                      mStateFences.size());
-                checkStateFences();
-            }
-        }
-
-        if (mFreedBuffers.size() != 0) {
-            freeBuffers();
-        }
-    }
-    ALOGI("%s threadLoop is ended", mExynosMPP->mName.string());
-}
-
-void ExynosMPP::ResourceManageThread::freeBuffers() {
-    ExynosGraphicBufferAllocator &gAllocator(ExynosGraphicBufferAllocator::get());
-    android::List<exynos_mpp_img_info>::iterator it;
-    android::List<exynos_mpp_img_info>::iterator end;
-    it = mFreedBuffers.begin();
-    end = mFreedBuffers.end();
-
-    uint32_t freebufNum = 0;
-    while (it != end) {
-        exynos_mpp_img_info freeBuffer = (exynos_mpp_img_info)(*it);
-        HDEBUGLOGD(eDebugMPP | eDebugBuf, "freebufNum: %d, buffer: %p", freebufNum, freeBuffer.bufferHandle);
-        dumpExynosMPPImgInfo(eDebugMPP | eDebugBuf, freeBuffer);
-        if (mExynosMPP->mFenceTracer.fence_valid(freeBuffer.acrylicAcquireFenceFd)) {
-            // mExynosMPP->mAssignedDisplay can be null
-            freeBuffer.acrylicAcquireFenceFd =
-                mExynosMPP->mFenceTracer.fence_close(freeBuffer.acrylicAcquireFenceFd,
-                                                     mExynosMPP->mAssignedDisplayInfo.displayIdentifier,
-                                                     FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_ALL,
-                                                     "mpp::freeBuffers: acrylicAcquireFence");
-        }
-        if (mExynosMPP->mFenceTracer.fence_valid(freeBuffer.acrylicReleaseFenceFd)) {
-            // mExynosMPP->mAssignedDisplay can be null
-            freeBuffer.acrylicReleaseFenceFd =
-                mExynosMPP->mFenceTracer.fence_close(freeBuffer.acrylicReleaseFenceFd,
-                                                     mExynosMPP->mAssignedDisplayInfo.displayIdentifier,
-                                                     FENCE_TYPE_SRC_RELEASE, FENCE_IP_ALL,
-                                                     "mpp::freeBuffers: acrylicReleaseFence");
-        }
-        gAllocator.free(freeBuffer.bufferHandle);
-        it = mFreedBuffers.erase(it);
-    }
-}
-
-bool ExynosMPP::ResourceManageThread::checkStateFences() {
-    bool ret = true;
-    android::List<int>::iterator it;
-    android::List<int>::iterator end;
-
-    it = mStateFences.begin();
-    end = mStateFences.end();
-    uint32_t waitFenceNum = 0;
-    while (it != end) {
-        int fence = (int)(*it);
-        HDEBUGLOGD(eDebugMPP, "%d wait fence: %d", waitFenceNum, fence);
-        waitFenceNum++;
-        if (mExynosMPP->mFenceTracer.fence_valid(fence)) {
-            if (sync_wait(fence, 5000) < 0) {
-                HWC_LOGE_NODISP("%s::[%s][%d] sync_wait(%d) error(%s)", __func__,
-                                mExynosMPP->mName.string(), mExynosMPP->mLogicalIndex, fence, strerror(errno));
-                ret = false;
-            }
-            // mExynosMPP->mAssignedDisplay can be null
-            fence = mExynosMPP->mFenceTracer.fence_close(fence,
-                                                         mExynosMPP->mAssignedDisplayInfo.displayIdentifier,
-                                                         FENCE_TYPE_UNDEFINED, FENCE_IP_ALL,
-                                                         "mpp::checkStateFences:: hw state fence");
-        }
-        it = mStateFences.erase(it);
-    }
-    return ret;
-}
-
-void ExynosMPP::ResourceManageThread::addFreedBuffer(exynos_mpp_img_info freedBuffer) {
-    Mutex::Autolock lock(mMutex);
-    mFreedBuffers.push_back(freedBuffer);
-    mCondition.signal();
-}
-
-void ExynosMPP::ResourceManageThread::addStateFence(int fence) {
-    Mutex::Autolock lock(mMutex);
-    HDEBUGLOGD(eDebugMPP, "wait fence is added: %d", fence);
-    mStateFences.push_back(fence);
-    mCondition.signal();
-}
-
 /**
  * @param w
  * @param h
@@ -902,6 +890,8 @@ int32_t ExynosMPP::allocOutBuf(uint32_t w, uint32_t h, uint32_t format, uint64_t
 
     uint64_t allocUsage = getBufferUsage(usage);
     buffer_handle_t dstBuffer;
+    /* Fence of the previous user of the pool buffer, the HW waits for it */
+    int dstFence = -1;
 
     MPP_LOGD(eDebugMPP | eDebugBuf, "\tw: %d, h: %d, format: 0x%8x, previousBuffer: %p, allocUsage: 0x%" PRIx64 ", usage: 0x%" PRIx64 "",
              w, h, format, freeDstBuf.bufferHandle, allocUsage, usage);
@@ -909,9 +899,15 @@ int32_t ExynosMPP::allocOutBuf(uint32_t w, uint32_t h, uint32_t format, uint64_t
     status_t error = NO_ERROR;
     ExynosGraphicBufferAllocator &gAllocator(ExynosGraphicBufferAllocator::get());
 
+    auto allocBuffer = [&]() -> status_t {
+        if (mDstBufPool != nullptr)
+            return mDstBufPool->acquire(w, h, format, allocUsage, &dstBuffer, &dstFence);
+        return gAllocator.allocate(w, h, format, 1, allocUsage, &dstBuffer, &dstStride, "HWC");
+    };
+
     {
         ATRACE_CALL();
-        error = gAllocator.allocate(w, h, format, 1, allocUsage, &dstBuffer, &dstStride, "HWC");
+        error = allocBuffer();
     }
 
     bool freeBuffer = false;
@@ -923,21 +919,26 @@ int32_t ExynosMPP::allocOutBuf(uint32_t w, uint32_t h, uint32_t format, uint64_t
 
             auto freeOutBuf = [&]() -> void {
                 dumpExynosMPPImgInfo(eDebugMPP | eDebugBuf, freeDstBuf);
-                if (mFenceTracer.fence_valid(freeDstBuf.acrylicAcquireFenceFd)) {
-                    freeDstBuf.acrylicAcquireFenceFd =
-                        mFenceTracer.fence_close(freeDstBuf.acrylicAcquireFenceFd,
-                                                 mAssignedDisplayInfo.displayIdentifier,
-                                                 FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_ALL,
-                                                 "mpp::freeBuffers: acrylicAcquireFence");
-                }
-                if (mFenceTracer.fence_valid(freeDstBuf.acrylicReleaseFenceFd)) {
-                    freeDstBuf.acrylicReleaseFenceFd =
-                        mFenceTracer.fence_close(freeDstBuf.acrylicReleaseFenceFd,
-                                                 mAssignedDisplayInfo.displayIdentifier,
-                                                 FENCE_TYPE_SRC_RELEASE, FENCE_IP_ALL,
-                                                 "mpp::freeBuffers: acrylicReleaseFence");
+                if (mDstBufPool != nullptr) {
+                    /* The pool destroys free buffers before it retries */
+                    releaseOutBufToPool(freeDstBuf);
+                } else {
+                    if (mFenceTracer.fence_valid(freeDstBuf.acrylicAcquireFenceFd)) {
+                        freeDstBuf.acrylicAcquireFenceFd =
+                            mFenceTracer.fence_close(freeDstBuf.acrylicAcquireFenceFd,
+                                                     mAssignedDisplayInfo.displayIdentifier,
+                                                     FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_ALL,
+                                                     "mpp::freeBuffers: acrylicAcquireFence");
+                    }
+                    if (mFenceTracer.fence_valid(freeDstBuf.acrylicReleaseFenceFd)) {
+                        freeDstBuf.acrylicReleaseFenceFd =
+                            mFenceTracer.fence_close(freeDstBuf.acrylicReleaseFenceFd,
+                                                     mAssignedDisplayInfo.displayIdentifier,
+                                                     FENCE_TYPE_SRC_RELEASE, FENCE_IP_ALL,
+                                                     "mpp::freeBuffers: acrylicReleaseFence");
+                    }
+                    gAllocator.free(freeDstBuf.bufferHandle);
                 }
-                gAllocator.free(freeDstBuf.bufferHandle);
                 freeDstBuf.reset();
                 freeBuffer = true;
                 ALOGW("free buffer: %p", freeDstBuf.bufferHandle);
@@ -946,7 +947,7 @@ int32_t ExynosMPP::allocOutBuf(uint32_t w, uint32_t h, uint32_t format, uint64_t
             {
                 ATRACE_CALL();
                 freeOutBuf();
-                error = gAllocator.allocate(w, h, format, 1, allocUsage, &dstBuffer, &dstStride, "HWC");
+                error = allocBuffer();
             }
             if ((error != NO_ERROR) || (dstBuffer == NULL)) {
                 MPP_LOGE("retry is failed to allocate destination buffer(%dx%d): %d", w, h, error);
@@ -959,6 +960,8 @@ int32_t ExynosMPP::allocOutBuf(uint32_t w, uint32_t h, uint32_t format, uint64_t
     mDstImgs[index].bufferHandle = dstBuffer;
     mDstImgs[index].bufferType = getBufferType(usage);
     mDstImgs[index].format = format;
+    /* It is given to libacryl as the fence of the dst buffer by setupDst() */
+    mDstImgs[index].acrylicReleaseFenceFd = dstFence;
 
     if (!freeBuffer) {
         MPP_LOGD(eDebugMPP | eDebugBuf, "free outbuf[%d] %p", index, freeDstBuf.bufferHandle);
@@ -1003,10 +1006,76 @@ int32_t ExynosMPP::setOutBuf(buffer_handle_t outbuf, int32_t fence,
  * @param dst
  * @return int32_t
  */
+void ExynosMPP::releaseOutBufToPool(exynos_mpp_img_info &dst) {
+    const DisplayIdentifier &display = mAssignedDisplayInfo.displayIdentifier;
+    int acquireFence = dst.acrylicAcquireFenceFd;
+    int releaseFence = dst.acrylicReleaseFenceFd;
+    int fence = -1;
+    int writeFence = -1;
+
+    /* Buffer can be still written by this MPP and read by the display */
+    if (mFenceTracer.fence_valid(acquireFence) && mFenceTracer.fence_valid(releaseFence)) {
+        fence = sync_merge("mpp_dst_buf", acquireFence, releaseFence);
+        if (fence < 0) {
+            /* The pool thread waits for the write, the display read is given as a fence */
+            MPP_LOGE("%s:: failed to merge fences(%d, %d)", __func__,
+                     acquireFence, releaseFence);
+            writeFence = acquireFence;
+            fence = releaseFence;
+        } else {
+            mFenceTracer.setFenceInfo(fence, display, FENCE_TYPE_DST_RELEASE, FENCE_IP_ALL,
+                                      FENCE_FROM);
+            mFenceTracer.fence_close(acquireFence, display, FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_ALL,
+                                     "mpp::releaseOutBufToPool: acrylicAcquireFence");
+            mFenceTracer.fence_close(releaseFence, display, FENCE_TYPE_SRC_RELEASE, FENCE_IP_ALL,
+                                     "mpp::releaseOutBufToPool: acrylicReleaseFence");
+        }
+    } else if (mFenceTracer.fence_valid(acquireFence)) {
+        fence = acquireFence;
+    } else if (mFenceTracer.fence_valid(releaseFence)) {
+        fence = releaseFence;
+    }
+
+    /* Buffer is given to other MPPs, the pool calls mBufDestoryedCallback */
+    mDstBufPool->release(dst.bufferHandle, fence, display, writeFence);
+    dst.acrylicAcquireFenceFd = -1;
+    dst.acrylicReleaseFenceFd = -1;
+    dst.bufferHandle = NULL;
+}
+
 int32_t ExynosMPP::freeOutBuf(struct exynos_mpp_img_info dst) {
+    if (mDstBufPool != nullptr) {
+        releaseOutBufToPool(dst);
+        return NO_ERROR;
+    }
+
     if (mBufDestoryedCallback)
         mBufDestoryedCallback(ExynosGraphicBufferMeta::get_buffer_id(dst.bufferHandle));
-    mResourceManageThread.addFreedBuffer(dst);
+    /*
+     * Buffer is freed after its fences are closed by the reactor thread.
+     * The callback doesn't use this MPP and has no owner, so it isn't dropped
+     * by cancel() in the destructor and the buffer is freed after the MPP is gone.
+     */
+    DisplayIdentifier display = mAssignedDisplayInfo.displayIdentifier;
+    String8 name = mName;
+    ExynosFenceReactor::getInstance().post(nullptr, [name, dst, display](int32_t) mutable {
+        ExynosGraphicBufferAllocator &gAllocator(ExynosGraphicBufferAllocator::get());
+        ExynosFenceTracer &fenceTracer = ExynosFenceTracer::getInstance();
+        HDEBUGLOGD(eDebugMPP | eDebugBuf, "%s:: free buffer: %p", name.string(), dst.bufferHandle);
+        if (fenceTracer.fence_valid(dst.acrylicAcquireFenceFd)) {
+            dst.acrylicAcquireFenceFd =
+                fenceTracer.fence_close(dst.acrylicAcquireFenceFd, display,
+                                        FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_ALL,
+                                        "mpp::freeBuffers: acrylicAcquireFence");
+        }
+        if (fenceTracer.fence_valid(dst.acrylicReleaseFenceFd)) {
+            dst.acrylicReleaseFenceFd =
+                fenceTracer.fence_close(dst.acrylicReleaseFenceFd, display,
+                                        FENCE_TYPE_SRC_RELEASE, FENCE_IP_ALL,
+                                        "mpp::freeBuffers: acrylicReleaseFence");
+        }
+        gAllocator.free(dst.bufferHandle);
+    });
     dst.bufferHandle = NULL;
     return NO_ERROR;
 }
@@ -1125,6 +1194,42 @@ bool ExynosMPP::needDstBufRealloc(struct exynos_image &dst, uint32_t index) {
     return realloc;
 }
 
+/*
+ * Check whether the source is the same as the one of the previous frame
+ * except its buffer
+ */
+bool ExynosMPP::isSameAsPrevSource(uint32_t index) {
+    if ((index >= mPrevFrameInfo.srcNum) || (index >= mAssignedSources.size()))
+        return false;
+
+    exynos_image &prevSrc = mPrevFrameInfo.srcInfo[index];
+    exynos_image &prevDst = mPrevFrameInfo.dstInfo[index];
+    exynos_image &src = mAssignedSources[index]->mSrcImg;
+    exynos_image &dst = mAssignedSources[index]->mMidImg;
+
+    return !((prevSrc.x != src.x) ||
+             (prevSrc.y != src.y) ||
+             (prevSrc.w != src.w) ||
+             (prevSrc.h != src.h) ||
+             (prevSrc.exynosFormat != src.exynosFormat) ||
+             (prevSrc.usageFlags != src.usageFlags) ||
+             (prevSrc.dataSpace != src.dataSpace) ||
+             (prevSrc.blending != src.blending) ||
+             (prevSrc.transform != src.transform) ||
+             (prevSrc.compressionInfo.type != src.compressionInfo.type) ||
+             (prevSrc.planeAlpha != src.planeAlpha) ||
+             (prevSrc.layerFlags != src.layerFlags) ||
+             (prevSrc.color.r != src.color.r) ||
+             (prevSrc.color.g != src.color.g) ||
+             (prevSrc.color.b != src.color.b) ||
+             (prevSrc.color.a != src.color.a) ||
+             (prevDst.x != dst.x) ||
+             (prevDst.y != dst.y) ||
+             (prevDst.w != dst.w) ||
+             (prevDst.h != dst.h) ||
+             (prevDst.exynosFormat != dst.exynosFormat));
+}
+
 bool ExynosMPP::canUsePrevFrame(struct exynos_image &src) {
     if (canUseVotf(src))
         return false;
@@ -1141,38 +1246,260 @@ bool ExynosMPP::canUsePrevFrame(struct exynos_image &src) {
 
     for (uint32_t i = 0; i < mPrevFrameInfo.srcNum; i++) {
         if ((mPrevFrameInfo.srcInfo[i].bufferHandle != mAssignedSources[i]->mSrcImg.bufferHandle) ||
-            (mPrevFrameInfo.srcInfo[i].x != mAssignedSources[i]->mSrcImg.x) ||
-            (mPrevFrameInfo.srcInfo[i].y != mAssignedSources[i]->mSrcImg.y) ||
-            (mPrevFrameInfo.srcInfo[i].w != mAssignedSources[i]->mSrcImg.w) ||
-            (mPrevFrameInfo.srcInfo[i].h != mAssignedSources[i]->mSrcImg.h) ||
-            (mPrevFrameInfo.srcInfo[i].exynosFormat != mAssignedSources[i]->mSrcImg.exynosFormat) ||
-            (mPrevFrameInfo.srcInfo[i].usageFlags != mAssignedSources[i]->mSrcImg.usageFlags) ||
-            (mPrevFrameInfo.srcInfo[i].dataSpace != mAssignedSources[i]->mSrcImg.dataSpace) ||
-            (mPrevFrameInfo.srcInfo[i].blending != mAssignedSources[i]->mSrcImg.blending) ||
-            (mPrevFrameInfo.srcInfo[i].transform != mAssignedSources[i]->mSrcImg.transform) ||
-            (mPrevFrameInfo.srcInfo[i].compressionInfo.type != mAssignedSources[i]->mSrcImg.compressionInfo.type) ||
-            (mPrevFrameInfo.srcInfo[i].planeAlpha != mAssignedSources[i]->mSrcImg.planeAlpha) ||
-            (mPrevFrameInfo.srcInfo[i].layerFlags != mAssignedSources[i]->mSrcImg.layerFlags) ||
-            (mPrevFrameInfo.srcInfo[i].usageFlags != mAssignedSources[i]->mSrcImg.usageFlags) ||
-            (mPrevFrameInfo.srcInfo[i].color.r != mAssignedSources[i]->mSrcImg.color.r) ||
-            (mPrevFrameInfo.srcInfo[i].color.g != mAssignedSources[i]->mSrcImg.color.g) ||
-            (mPrevFrameInfo.srcInfo[i].color.b != mAssignedSources[i]->mSrcImg.color.b) ||
-            (mPrevFrameInfo.srcInfo[i].color.a != mAssignedSources[i]->mSrcImg.color.a) ||
-            (mPrevFrameInfo.dstInfo[i].x != mAssignedSources[i]->mMidImg.x) ||
-            (mPrevFrameInfo.dstInfo[i].y != mAssignedSources[i]->mMidImg.y) ||
-            (mPrevFrameInfo.dstInfo[i].w != mAssignedSources[i]->mMidImg.w) ||
-            (mPrevFrameInfo.dstInfo[i].h != mAssignedSources[i]->mMidImg.h) ||
-            (mPrevFrameInfo.dstInfo[i].exynosFormat != mAssignedSources[i]->mMidImg.exynosFormat))
+            (isSameAsPrevSource(i) == false))
             return false;
     }
 
-    int32_t prevDstIndex = (mCurrentDstBuf + NUM_MPP_DST_BUFS(mLogicalType) - 1) % NUM_MPP_DST_BUFS(mLogicalType);
-    if (mDstImgs[prevDstIndex].bufferHandle == NULL)
+    if ((mLastDstBuf < 0) || (mLastDstBuf >= NUM_MPP_DST_BUFS(mLogicalType)) ||
+        (mDstImgs[mLastDstBuf].bufferHandle == NULL))
         return false;
 
     return true;
 }
 
+static inline bool isEmptyRect(const hwc_rect_t &rect) {
+    return (rect.left >= rect.right) || (rect.top >= rect.bottom);
+}
+
+static inline hwc_rect_t intersectRect(const hwc_rect_t &r1, const hwc_rect_t &r2) {
+    return {std::max(r1.left, r2.left), std::max(r1.top, r2.top),
+            std::min(r1.right, r2.right), std::min(r1.bottom, r2.bottom)};
+}
+
+static inline hwc_rect_t getImageRect(const exynos_image &img) {
+    return {(int)img.x, (int)img.y, (int)(img.x + img.w), (int)(img.y + img.h)};
+}
+
+static inline bool isSameRect(const hwc_rect_t &r1, const hwc_rect_t &r2) {
+    return (r1.left == r2.left) && (r1.top == r2.top) &&
+           (r1.right == r2.right) && (r1.bottom == r2.bottom);
+}
+
+uint32_t ExynosMPP::getPartialCopyRects(const hwc_rect_t &damage, const hwc_rect_t &dstRect,
+                                        hwc_rect_t rects[G2D_PARTIAL_COPY_LAYER_NUM]) {
+    hwc_rect_t candidates[G2D_PARTIAL_COPY_LAYER_NUM] = {
+        {dstRect.left, dstRect.top, dstRect.right, damage.top},
+        {dstRect.left, damage.bottom, dstRect.right, dstRect.bottom},
+        {dstRect.left, damage.top, damage.left, damage.bottom},
+        {damage.right, damage.top, dstRect.right, damage.bottom},
+    };
+    uint32_t num = 0;
+
+    for (auto &rect : candidates) {
+        if (!isEmptyRect(rect))
+            rects[num++] = rect;
+    }
+    return num;
+}
+
+/*
+ * Partial composition is used if the job makes the exynos composition target,
+ * the sources are the same as the previous frame except the content of
+ * their buffers and the damage is small.
+ * The damaged area is blended again and the rest is copied from the
+ * previous composition result.
+ */
+bool ExynosMPP::canUsePartialComposition(hwc_rect_t &damage) {
+    PartialCompositionInfo &info = mPartialComposition;
+    size_t sourceNum = mAssignedSources.size();
+    const hwc_rect_t &dstRect = info.dstRect;
+
+    /* Damage of the sources is set only for the exynos composition target */
+    if (!info.target || (mPhysicalType != MPP_G2D) || (mMaxSrcLayerNum <= 1) ||
+        (mAllocOutBufFlag == false) || mUseM2MSrcFence || isEmptyRect(dstRect))
+        return false;
+
+    if ((info.validBuf < 0) || (info.validBuf == mCurrentDstBuf) ||
+        !mFenceTracer.fence_valid(info.validFence) ||
+        !isSameRect(info.validDstRect, dstRect) ||
+        (info.validDisplayId != mAssignedDisplayInfo.displayIdentifier.id) ||
+        (info.validDataspace != colorModeToDataspace(mAssignedDisplayInfo.colorMode)))
+        return false;
+
+    exynos_mpp_img_info &validDst = mDstImgs[info.validBuf];
+    if ((validDst.bufferHandle == NULL) || (validDst.bufferHandle != info.validHandle) ||
+        (validDst.bufferType == MPP_BUFFER_SECURE_DRM) ||
+        (validDst.format != mDstImgs[mCurrentDstBuf].format) || validDst.format.isYUV())
+        return false;
+
+    if ((mPrevFrameInfo.srcNum != sourceNum) || (sourceNum == 0))
+        return false;
+
+    damage = {dstRect.right, dstRect.bottom, dstRect.left, dstRect.top};
+    for (uint32_t i = 0; i < sourceNum; i++) {
+        ExynosMPPSource *source = mAssignedSources[i];
+        if (canUseVotf(source->mSrcImg) || (isSameAsPrevSource(i) == false))
+            return false;
+
+        buffer_handle_t prevBuffer = mPrevFrameInfo.srcInfo[i].bufferHandle;
+        if (source->mSrcImg.bufferHandle == prevBuffer)
+            continue;
+
+        hwc_rect_t rect = intersectRect(getImageRect(source->mMidImg), dstRect);
+        if (source->mDamageValid && (source->mDamageBaseBuffer == prevBuffer))
+            rect = intersectRect(rect, source->mDamage);
+        if (isEmptyRect(rect))
+            continue;
+
+        damage = expand(damage, rect);
+    }
+
+    /* Buffers are changed but nothing is damaged */
+    if (isEmptyRect(damage))
+        return false;
+
+    if (mCurrentTargetCompressionInfoType == COMP_TYPE_AFBC) {
+        damage.left = std::max(pixel_align_down(damage.left, G2D_PARTIAL_COMPOSITION_AFBC_ALIGN), dstRect.left);
+        damage.top = std::max(pixel_align_down(damage.top, G2D_PARTIAL_COMPOSITION_AFBC_ALIGN), dstRect.top);
+        damage.right = std::min(pixel_align(damage.right, G2D_PARTIAL_COMPOSITION_AFBC_ALIGN), dstRect.right);
+        damage.bottom = std::min(pixel_align(damage.bottom, G2D_PARTIAL_COMPOSITION_AFBC_ALIGN), dstRect.bottom);
+    }
+
+    if ((uint64_t)WIDTH(damage) * HEIGHT(damage) * 100 >
+        (uint64_t)WIDTH(dstRect) * HEIGHT(dstRect) * G2D_PARTIAL_COMPOSITION_MAX_PERCENT)
+        return false;
+
+    /* Sources in the damage are cropped without scaling */
+    uint32_t layerNum = 0;
+    for (uint32_t i = 0; i < sourceNum; i++) {
+        exynos_image &src = mAssignedSources[i]->mSrcImg;
+        exynos_image &dst = mAssignedSources[i]->mMidImg;
+        if (isEmptyRect(intersectRect(getImageRect(dst), damage)))
+            continue;
+
+        layerNum++;
+        if ((src.transform != 0) || src.exynosFormat.isYUV() ||
+            (src.w != dst.w) || (src.h != dst.h))
+            return false;
+    }
+
+    hwc_rect_t copyRects[G2D_PARTIAL_COPY_LAYER_NUM];
+    if (layerNum + getPartialCopyRects(damage, dstRect, copyRects) > mMaxSrcLayerNum)
+        return false;
+
+    return true;
+}
+
+void ExynosMPP::clipLayerToDamage(exynos_mpp_img_info *srcImgInfo, struct exynos_image &src,
+                                  struct exynos_image &dst, const hwc_rect_t &damage) {
+    hwc_rect_t dst_rect = intersectRect(getImageRect(dst), damage);
+    hwc_rect_t src_rect = {(int)src.x + dst_rect.left - (int)dst.x,
+                           (int)src.y + dst_rect.top - (int)dst.y,
+                           (int)src.x + dst_rect.right - (int)dst.x,
+                           (int)src.y + dst_rect.bottom - (int)dst.y};
+
+    MPP_LOGD(eDebugMPP, "\tpartial src_rect[%d, %d, %d, %d], dst_rect[%d, %d, %d, %d]",
+             src_rect.left, src_rect.top, src_rect.right, src_rect.bottom,
+             dst_rect.left, dst_rect.top, dst_rect.right, dst_rect.bottom);
+    srcImgInfo->mppLayer->setCompositArea(src_rect, dst_rect, 0, AcrylicLayer::ATTR_NORESAMPLING);
+}
+
+/*
+ * Copy layers read the previous composition result out of the damage.
+ * They are deleted if they are not used by the current job.
+ */
+int32_t ExynosMPP::setupPartialCopyLayers() {
+    PartialCompositionInfo &info = mPartialComposition;
+    hwc_rect_t rects[G2D_PARTIAL_COPY_LAYER_NUM];
+    uint32_t num = 0;
+
+    if (info.enabled)
+        num = getPartialCopyRects(info.damage, info.dstRect, rects);
+
+    for (uint32_t i = num; i < G2D_PARTIAL_COPY_LAYER_NUM; i++) {
+        if (info.copyLayers[i] != NULL) {
+            delete info.copyLayers[i];
+            info.copyLayers[i] = NULL;
+        }
+    }
+    if (num == 0)
+        return 0;
+
+    exynos_mpp_img_info &copySrc = mDstImgs[info.validBuf];
+    auto formatDesc = copySrc.format.getFormatDesc();
+    uint32_t width = pixel_align(mAssignedDisplayInfo.xres, GET_M2M_DST_ALIGN(formatDesc.halFormat));
+    uint32_t height = pixel_align(mAssignedDisplayInfo.yres, GET_M2M_DST_ALIGN(formatDesc.halFormat));
+    ExynosGraphicBufferMeta gmeta(copySrc.bufferHandle);
+    int bufFds[MAX_HW2D_PLANES] = {gmeta.fd, gmeta.fd1, gmeta.fd2};
+    size_t bufLength[MAX_HW2D_PLANES] = {0};
+    uint32_t attribute = 0;
+
+    if (getBufLength(copySrc.bufferHandle, MAX_HW2D_PLANES, bufLength, formatDesc.halFormat,
+                     gmeta.stride, gmeta.vstride) != NO_ERROR) {
+        MPP_LOGE("%s:: invalid bufferLength(%zu, %zu, %zu), format(%s)", __func__,
+                 bufLength[0], bufLength[1], bufLength[2], copySrc.format.name().string());
+        return -EINVAL;
+    }
+    if (isAFBCCompressed(copySrc.bufferHandle))
+        attribute |= AcrylicCanvas::ATTR_COMPRESSED;
+
+    for (uint32_t i = 0; i < num; i++) {
+        if ((info.copyLayers[i] == NULL) &&
+            ((info.copyLayers[i] = mAcrylicHandle->createLayer()) == NULL)) {
+            MPP_LOGE("%s:: Fail to create copy layer", __func__);
+            return -EINVAL;
+        }
+
+        AcrylicLayer *layer = info.copyLayers[i];
+        int fence = mFenceTracer.hwc_dup(info.validFence, mAssignedDisplayInfo.displayIdentifier,
+                                         FENCE_TYPE_SRC_ACQUIRE, mFenceTracer.getM2MIPFenceType(mPhysicalType));
+        layer->setImageDimension(width, height);
+        layer->setImageType(formatDesc.halFormat, copySrc.dataspace);
+        layer->setImageBuffer(bufFds, bufLength, formatDesc.bufferNum, fence, attribute);
+        /* Copy layers don't overlap the sources in the damage */
+        layer->setCompositMode(HWC2_BLEND_MODE_NONE, 255, 0);
+        layer->setCompositArea(rects[i], rects[i], 0, AcrylicLayer::ATTR_NORESAMPLING);
+        MPP_LOGD(eDebugMPP, "\tcopy[%d] from dstImg[%d], rect[%d, %d, %d, %d]", i, info.validBuf,
+                 rects[i].left, rects[i].top, rects[i].right, rects[i].bottom);
+    }
+
+    return num;
+}
+
+/*
+ * mDstImgs[mCurrentDstBuf] has the complete composition result
+ * of the current sources if the job succeeded
+ */
+void ExynosMPP::updatePartialCompositionResult(bool success) {
+    PartialCompositionInfo &info = mPartialComposition;
+
+    info.validFence = mFenceTracer.fence_close(info.validFence, mAssignedDisplayInfo.displayIdentifier,
+                                               FENCE_TYPE_SRC_ACQUIRE, mFenceTracer.getM2MIPFenceType(mPhysicalType),
+                                               "mpp::updatePartialCompositionResult: validFence");
+    info.validBuf = -1;
+    info.validHandle = NULL;
+
+    int fence = mDstImgs[mCurrentDstBuf].acrylicAcquireFenceFd;
+    if (!success || !info.target || (mPhysicalType != MPP_G2D) || (mMaxSrcLayerNum <= 1) ||
+        !mFenceTracer.fence_valid(fence))
+        return;
+
+    info.validBuf = mCurrentDstBuf;
+    info.validHandle = mDstImgs[mCurrentDstBuf].bufferHandle;
+    info.validDstRect = info.dstRect;
+    info.validDisplayId = mAssignedDisplayInfo.displayIdentifier.id;
+    info.validDataspace = colorModeToDataspace(mAssignedDisplayInfo.colorMode);
+    info.validFence = mFenceTracer.hwc_dup(fence, mAssignedDisplayInfo.displayIdentifier,
+                                           FENCE_TYPE_SRC_ACQUIRE, mFenceTracer.getM2MIPFenceType(mPhysicalType));
+}
+
+void ExynosMPP::releasePartialComposition() {
+    PartialCompositionInfo &info = mPartialComposition;
+
+    for (auto &layer : info.copyLayers) {
+        if (layer != NULL) {
+            delete layer;
+            layer = NULL;
+        }
+    }
+    info.enabled = false;
+    info.validFence = mFenceTracer.fence_close(info.validFence, mAssignedDisplayInfo.displayIdentifier,
+                                               FENCE_TYPE_SRC_ACQUIRE, mFenceTracer.getM2MIPFenceType(mPhysicalType),
+                                               "mpp::releasePartialComposition: validFence");
+    info.validBuf = -1;
+    info.validHandle = NULL;
+}
+
 int32_t ExynosMPP::enableVotfInfo(VotfInfo &info) {
     if (mMPPType != MPP_TYPE_OTF)
         return -EINVAL;
@@ -1470,6 +1797,12 @@ int32_t ExynosMPP::doPostProcessingInternal() {
     int ret = NO_ERROR;
     size_t sourceNum = mAssignedSources.size();
 
+    /* Result of a failed job can't be the base of the next partial composition */
+    bool jobDone = false;
+    funcReturnCallback partialCallback([&]() {
+        updatePartialCompositionResult(jobDone);
+    });
+
     if (mAcrylicHandle == NULL) {
         MPP_LOGE("%s:: mAcrylicHandle is NULL", __func__);
         return -EINVAL;
@@ -1484,30 +1817,46 @@ int32_t ExynosMPP::doPostProcessingInternal() {
     }
 
     /* setup source layers */
+    bool partial = mPartialComposition.enabled;
+    size_t layerNum = 0;
     for (size_t i = 0; i < sourceNum; i++) {
+        exynos_image &src = mAssignedSources[i]->mSrcImg;
+        exynos_image &dst = mAssignedSources[i]->mMidImg;
+        /* Sources out of the damage are not blended by partial composition */
+        if (partial && isEmptyRect(intersectRect(getImageRect(dst), mPartialComposition.damage))) {
+            MPP_LOGD(eDebugMPP, "Skip [%zu] source out of damage: %p", i, mAssignedSources[i]);
+            src.acquireFenceFd =
+                mFenceTracer.fence_close(src.acquireFenceFd, mAssignedDisplayInfo.displayIdentifier,
+                                         FENCE_TYPE_SRC_ACQUIRE, mFenceTracer.getM2MIPFenceType(mPhysicalType),
+                                         "mpp::doPostProcessingInternal: src acquireFence out of damage");
+            if (mSrcImgs[i].mppLayer != NULL) {
+                delete mSrcImgs[i].mppLayer;
+                mSrcImgs[i].mppLayer = NULL;
+            }
+            continue;
+        }
+
         MPP_LOGD(eDebugMPP, "Setup [%zu] source: %p", i, mAssignedSources[i]);
-        if ((ret = setupLayer(&mSrcImgs[i], mAssignedSources[i]->mSrcImg, mAssignedSources[i]->mMidImg)) != NO_ERROR) {
+        if ((ret = setupLayer(&mSrcImgs[i], src, dst)) != NO_ERROR) {
             MPP_LOGE("%s:: fail to setupLayer[%zu], ret %d",
                      __func__, i, ret);
             return ret;
         }
+        if (partial)
+            clipLayerToDamage(&mSrcImgs[i], src, dst, mPartialComposition.damage);
+        layerNum++;
     }
 
-    if (mPrevFrameInfo.srcNum > sourceNum) {
-        MPP_LOGD(eDebugMPP, "prev sourceNum(%d), current sourceNum(%zu)",
-                 mPrevFrameInfo.srcNum, sourceNum);
-        for (size_t i = sourceNum; i < mPrevFrameInfo.srcNum; i++) {
-            MPP_LOGD(eDebugMPP, "Remove mSrcImgs[%zu], %p", i, mSrcImgs[i].mppLayer);
-            if (mSrcImgs[i].mppLayer != NULL) {
-                delete mSrcImgs[i].mppLayer;
-                mSrcImgs[i].mppLayer = NULL;
-            }
-        }
+    if ((ret = setupPartialCopyLayers()) < 0) {
+        MPP_LOGE("%s:: fail to setup copy layers, ret %d", __func__, ret);
+        return ret;
     }
+    layerNum += ret;
+    ret = NO_ERROR;
 
-    if (mAcrylicHandle->layerCount() != mAssignedSources.size()) {
-        MPP_LOGE("Different layer number, acrylic layers(%d), assigned size(%zu)",
-                 mAcrylicHandle->layerCount(), mAssignedSources.size());
+    if (mAcrylicHandle->layerCount() != layerNum) {
+        MPP_LOGE("Different layer number, acrylic layers(%d), assigned size(%zu), layers(%zu)",
+                 mAcrylicHandle->layerCount(), mAssignedSources.size(), layerNum);
         return -EINVAL;
     }
 
@@ -1540,7 +1889,8 @@ int32_t ExynosMPP::doPostProcessingInternal() {
     }
 
     for (size_t i = 0; i < sourceNum; i++) {
-        mSrcImgs[i].mppLayer->clearLayerData();
+        if (mSrcImgs[i].mppLayer != NULL)
+            mSrcImgs[i].mppLayer->clearLayerData();
     }
 
     auto setAcrylFence = [&]() {
@@ -1612,8 +1962,19 @@ int32_t ExynosMPP::doPostProcessingInternal() {
         mDstImgs[mCurrentDstBuf].acrylicAcquireFenceFd =
             mFenceTracer.checkFenceDebug(mAssignedDisplayInfo.displayIdentifier,
                                          FENCE_TYPE_DST_ACQUIRE, mFenceTracer.getM2MIPFenceType(mPhysicalType), outFences[dstBufIdx]);
+
+        /* Latency of the job is recorded by the reactor */
+        if (mFenceTracer.fence_valid(mDstImgs[mCurrentDstBuf].acrylicAcquireFenceFd)) {
+            int jobFence = mFenceTracer.hwc_dup(mDstImgs[mCurrentDstBuf].acrylicAcquireFenceFd,
+                                                mAssignedDisplayInfo.displayIdentifier,
+                                                FENCE_TYPE_DST_ACQUIRE, mFenceTracer.getM2MIPFenceType(mPhysicalType));
+            ExynosFenceReactor::getInstance().add(jobFence, mAssignedDisplayInfo.displayIdentifier,
+                                                  FENCE_TYPE_DST_ACQUIRE, mFenceTracer.getM2MIPFenceType(mPhysicalType),
+                                                  std::string(mName.string()) + " job", this, nullptr);
+        }
     }
 
+    jobDone = true;
     dumpDstBuf();
 
     return ret;
@@ -1690,6 +2051,13 @@ int32_t ExynosMPP::doPostProcessing(struct exynos_image &src, struct exynos_imag
     ATRACE_CALL();
     MPP_LOGD(eDebugMPP, "total assigned sources (%zu)++++++++", mAssignedSources.size());
 
+    /* The previous job still can use mSrcImgs and mDstImgs */
+    waitPostProcessing();
+
+    mPartialComposition.target = mPartialComposition.targetRequested;
+    mPartialComposition.targetRequested = false;
+    mPartialComposition.dstRect = getImageRect(dst);
+
     auto save_frame_info = [=]() {
         /* Save current frame information for next frame*/
         mPrevAssignedDisplayType = mAssignedDisplayInfo.displayIdentifier.type;
@@ -1708,6 +2076,7 @@ int32_t ExynosMPP::doPostProcessing(struct exynos_image &src, struct exynos_imag
     if (mAssignedSources.size() == 0) {
         MPP_LOGE("Assigned source size(%zu) is not valid",
                  mAssignedSources.size());
+        updatePartialCompositionResult(false);
         save_frame_info();
         return -EINVAL;
     }
@@ -1735,6 +2104,7 @@ int32_t ExynosMPP::doPostProcessing(struct exynos_image &src, struct exynos_imag
         }
         if (ret < 0) {
             MPP_LOGE("%s:: fail to allocate dst buffer[%d]", __func__, mCurrentDstBuf);
+            updatePartialCompositionResult(false);
             save_frame_info();
             return ret;
         }
@@ -1746,7 +2116,7 @@ int32_t ExynosMPP::doPostProcessing(struct exynos_image &src, struct exynos_imag
     }
 
     if ((realloc == false) && canUsePrevFrame(src)) {
-        mCurrentDstBuf = (mCurrentDstBuf + NUM_MPP_DST_BUFS(mLogicalType) - 1) % NUM_MPP_DST_BUFS(mLogicalType);
+        mCurrentDstBuf = mLastDstBuf;
         MPP_LOGD(eDebugMPP, "Reuse previous frame, dstImg[%d]", mCurrentDstBuf);
         for (uint32_t i = 0; i < mAssignedSources.size(); i++) {
             mAssignedSources[i]->mSrcImg.acquireFenceFd =
@@ -1760,11 +2130,54 @@ int32_t ExynosMPP::doPostProcessing(struct exynos_image &src, struct exynos_imag
         return 0;
     }
 
-    /* G2D or sclaer case */
+    /* mPrevFrameInfo is still the previous frame here */
+    mPartialComposition.enabled = (realloc == false) &&
+                                  canUsePartialComposition(mPartialComposition.damage);
+    if ((mPhysicalType == MPP_G2D) && (mMaxSrcLayerNum > 1)) {
+        if (mPartialComposition.enabled) {
+            mPartialComposition.partialCount++;
+            MPP_LOGD(eDebugMPP, "partial composition, damage[%d, %d, %d, %d]",
+                     mPartialComposition.damage.left, mPartialComposition.damage.top,
+                     mPartialComposition.damage.right, mPartialComposition.damage.bottom);
+        } else {
+            mPartialComposition.fullCount++;
+        }
+    }
+
+    /*
+     * Layers of the sources that are not used anymore are removed here
+     * because mPrevFrameInfo is updated before the submitted job is done
+     */
+    size_t sourceNum = mAssignedSources.size();
+    if (mPrevFrameInfo.srcNum > sourceNum) {
+        MPP_LOGD(eDebugMPP, "prev sourceNum(%d), current sourceNum(%zu)",
+                 mPrevFrameInfo.srcNum, sourceNum);
+        for (size_t i = sourceNum; i < mPrevFrameInfo.srcNum; i++) {
+            MPP_LOGD(eDebugMPP, "Remove mSrcImgs[%zu], %p", i, mSrcImgs[i].mppLayer);
+            if (mSrcImgs[i].mppLayer != NULL) {
+                delete mSrcImgs[i].mppLayer;
+                mSrcImgs[i].mppLayer = NULL;
+            }
+        }
+    }
+
+    /*
+     * G2D or sclaer case.
+     * Frame info is saved before the job is done because the sources
+     * can be changed after this, waitPostProcessing() resets it if the job fails.
+     */
+    if (mAsyncPostProcessing) {
+        save_frame_info();
+        requestPostProcessing();
+        return 0;
+    }
+
     if ((ret = doPostProcessingInternal()) < 0) {
         MPP_LOGE("%s:: fail to post processing, ret %d",
                  __func__, ret);
         save_frame_info();
+        /* Output of the failed job can't be reused by the next frame */
+        mPrevFrameInfo.reset();
         return ret;
     }
 
@@ -1781,12 +2194,15 @@ int32_t ExynosMPP::getSrcReleaseFence(uint32_t srcIndex) {
     if (srcIndex >= NUM_MPP_SRC_BUFS)
         return -EINVAL;
 
+    waitPostProcessing();
+
     return mSrcImgs[srcIndex].acrylicReleaseFenceFd;
 
     return -EINVAL;
 }
 
 int32_t ExynosMPP::resetSrcReleaseFence() {
+    waitPostProcessing();
     for (uint32_t i = 0; i < mAssignedSources.size(); i++) {
         mSrcImgs[i].acrylicReleaseFenceFd = -1;
     }
@@ -1794,6 +2210,8 @@ int32_t ExynosMPP::resetSrcReleaseFence() {
 }
 
 int32_t ExynosMPP::getDstImageInfo(exynos_image *img) {
+    waitPostProcessing();
+
     if ((mCurrentDstBuf < 0) || (mCurrentDstBuf >= NUM_MPP_DST_BUFS(mLogicalType)) ||
         (mAssignedDisplayInfo.displayIdentifier.id == UINT32_MAX)) {
         MPP_LOGE("mCurrentDstBuf(%d), mAssignedDisplay(0x%8x)",
@@ -1847,6 +2265,8 @@ int32_t ExynosMPP::getDstImageInfo(exynos_image *img) {
 int32_t ExynosMPP::setDstReleaseFence(int releaseFence, DisplayInfo &display) {
     int dstBufIndex = 0;
 
+    waitPostProcessing();
+
     dstBufIndex = mPrivDstBuf;
 
     if (mPrivDstBuf == mCurrentDstBuf)
@@ -1882,6 +2302,8 @@ int32_t ExynosMPP::setDstReleaseFence(int releaseFence, DisplayInfo &display) {
 }
 
 int32_t ExynosMPP::resetDstAcquireFence() {
+    waitPostProcessing();
+
     if (mCurrentDstBuf < 0 || mCurrentDstBuf >= NUM_MPP_DST_BUFS(mLogicalType))
         return -EINVAL;
 
@@ -1890,7 +2312,33 @@ int32_t ExynosMPP::resetDstAcquireFence() {
     return NO_ERROR;
 }
 
+/*
+ * Wait until the job that is requested by doPostProcessing()
+ * is submitted to the HW.
+ * @return result of doPostProcessingInternal()
+ */
+int32_t ExynosMPP::waitPostProcessing() {
+    if (mAsyncPostProcessing == false)
+        return NO_ERROR;
+
+    int32_t ret = PostProcessingWorker::getInstance().wait(this);
+    /* Frame info is saved when the job is requested, output of the failed job can't be reused */
+    if (ret < 0)
+        mPrevFrameInfo.reset();
+    return ret;
+}
+
+/*
+ * doPostProcessingInternal() is called by the shared worker.
+ * The job data must not be changed until waitPostProcessing() returns.
+ */
+void ExynosMPP::requestPostProcessing() {
+    PostProcessingWorker::getInstance().request(this);
+}
+
 int32_t ExynosMPP::requestHWStateChange(uint32_t state) {
+    waitPostProcessing();
+
     MPP_LOGD(eDebugMPP | eDebugBuf, "state: %d", state);
     /* Set HW state to running */
     if (mHWState == state) {
@@ -1911,7 +2359,7 @@ int32_t ExynosMPP::requestHWStateChange(uint32_t state) {
         mHWState = MPP_HW_STATE_RUNNING;
     else if (state == MPP_HW_STATE_IDLE) {
         if (mLastStateFenceFd >= 0)
-            mResourceManageThread.addStateFence(mLastStateFenceFd);
+            addStateFence(mLastStateFenceFd);
         else
             mHWState = MPP_HW_STATE_IDLE;
         mLastStateFenceFd = -1;
@@ -1936,6 +2384,17 @@ int32_t ExynosMPP::requestHWStateChange(uint32_t state) {
                     MPP_LOGD(eDebugMPP | eDebugBuf, "free outbuf[%d] %p",
                              i, freeDstBuf.bufferHandle);
                     if (freeDstBuf.bufferHandle != NULL && mAllocOutBufFlag) {
+                        if (mDstBufPool != nullptr) {
+                            /* Fences are kept in mDstImgs, the pool waits on their copies */
+                            freeDstBuf.acrylicAcquireFenceFd =
+                                mFenceTracer.hwc_dup(mDstImgs[i].acrylicAcquireFenceFd,
+                                                     mAssignedDisplayInfo.displayIdentifier,
+                                                     FENCE_TYPE_DST_ACQUIRE, FENCE_IP_ALL);
+                            freeDstBuf.acrylicReleaseFenceFd =
+                                mFenceTracer.hwc_dup(mDstImgs[i].acrylicReleaseFenceFd,
+                                                     mAssignedDisplayInfo.displayIdentifier,
+                                                     FENCE_TYPE_DST_RELEASE, FENCE_IP_ALL);
+                        }
                         freeOutBuf(freeDstBuf);
                     }
                 } else {
@@ -1945,6 +2404,7 @@ int32_t ExynosMPP::requestHWStateChange(uint32_t state) {
             }
         }
 
+        releasePartialComposition();
         for (uint32_t i = 0; i < NUM_MPP_SRC_BUFS; i++) {
             if (mSrcImgs[i].mppLayer != NULL) {
                 delete mSrcImgs[i].mppLayer;
@@ -1957,6 +2417,29 @@ int32_t ExynosMPP::requestHWStateChange(uint32_t state) {
     return NO_ERROR;
 }
 
+void ExynosMPP::addStateFence(int fence) {
+    HDEBUGLOGD(eDebugMPP, "%s:: wait fence is added: %d", mName.string(), fence);
+    mPendingStateFenceNum++;
+    ExynosFenceReactor::getInstance().add(
+        fence, mAssignedDisplayInfo.displayIdentifier, FENCE_TYPE_UNDEFINED, FENCE_IP_ALL,
+        std::string(mName.string()) + " state", this, [this](int32_t status) {
+            if (status != NO_ERROR) {
+                HWC_LOGE_NODISP("%s::[%s][%d] state fence error(%d)", __func__,
+                                mName.string(), mLogicalIndex, status);
+                mStateFenceFailed = true;
+            }
+            /* HW is idle after all of state fences are signaled */
+            if (--mPendingStateFenceNum > 0)
+                return;
+            if (mHWState != MPP_HW_STATE_RUNNING)
+                ALOGW("%s, mHWState(%d) but state fences are pending",
+                      mName.string(), mHWState);
+            else if (!mStateFenceFailed)
+                mHWState = MPP_HW_STATE_IDLE;
+            mStateFenceFailed = false;
+        });
+}
+
 int32_t ExynosMPP::setHWStateFence(int32_t fence) {
     mLastStateFenceFd = fence;
     return NO_ERROR;
@@ -2067,6 +2550,8 @@ int64_t ExynosMPP::checkScaleRatio(DisplayInfo &display, exynos_image &src,
 int64_t ExynosMPP::isSupported(DisplayInfo &display, struct exynos_image &src, struct exynos_image &dst) {
     int32_t ret = NO_ERROR;
 
+    mSupportedCheckCount.fetch_add(1, std::memory_order_relaxed);
+
     if ((ret = checkDstSize(dst)) < 0)
         return ret;
 
@@ -2164,6 +2649,8 @@ int32_t ExynosMPP::resetAssignedState(ExynosMPPSource *mppSource) {
             mAssignedSources.removeItemsAt(i);
             if (needUpdateCapacity)
                 updateUsedCapacity();
+            if (hwcCheckDebugMessages(eDebugCapacityCheck))
+                checkUsedCapacity();
 
             break;
         }
@@ -2212,6 +2699,8 @@ int32_t ExynosMPP::assignMPP(DisplayInfo &display, ExynosMPPSource *mppSource) {
 
     if (needUpdateCapacity)
         updateUsedCapacity();
+    if (hwcCheckDebugMessages(eDebugCapacityCheck))
+        checkUsedCapacity();
 
     if (mMaxSrcLayerNum > 1) {
         std::sort(mAssignedSources.begin(), mAssignedSources.end(), exynosMPPSourceComp);
@@ -2240,6 +2729,12 @@ bool ExynosMPP::needPreAllocation(uint32_t displayMode) {
 
 bool ExynosMPP::isAssignableState(DisplayInfo &display,
                                   struct exynos_image &src, struct exynos_image &dst) {
+    /* Other state of the MPP may be written by the validate thread of its owner */
+    if (isPartitionedAway(display.displayIdentifier.id)) {
+        MPP_LOGD(eDebugMPP, "\tpartitioned to other display(%d)", mPartitionDisplayId);
+        return false;
+    }
+
     if (mDisableByUserScenario) {
         MPP_LOGD(eDebugMPP, "\tmDisableByUserScenario(0x%8x)", mDisableByUserScenario);
         return false;
@@ -2434,11 +2929,40 @@ float ExynosMPP::getPPC(const struct exynos_image &src,
     return PPC;
 }
 
-float ExynosMPP::getAssignedCapacity() {
-    float capacity = 0;
-    float baseCycles = 0;
-    uint32_t rotIndex = 0;
+float ExynosMPP::getPPC(const struct exynos_image &src,
+                        const struct exynos_image &dst, uint32_t rotIndex) {
+    float PPC = 0;
+    uint32_t formatIndex = 0;
+    uint32_t criteriaRotIndex = 0;
+    uint32_t scaleIndex = 0;
+
+    if ((mPhysicalType == MPP_G2D) &&
+        (src.layerFlags & EXYNOS_HWC_DIM_LAYER))
+        return G2D_BASE_PPC_COLORFILL;
+
+    getPPCIndex(src, dst, formatIndex, criteriaRotIndex, scaleIndex, src);
+
+    if (hasPPC(mPhysicalType, formatIndex, rotIndex)) {
+        auto node = ppc_table_map.find(PPC_IDX(mPhysicalType, formatIndex, rotIndex));
+        if (node != ppc_table_map.end())
+            PPC = node->second.ppcList[scaleIndex];
+    }
+
+    if (PPC == 0) {
+        /* PPC_ROT of not rotated source is used only if rotated source is added */
+        if ((rotIndex == PPC_ROT) && ((src.transform & HAL_TRANSFORM_ROT_90) == 0))
+            MPP_LOGD(eDebugCapacity, "%s:: formatIndex(%d), rotIndex(%d), scaleIndex(%d), PPC is not valid",
+                     __func__, formatIndex, rotIndex, scaleIndex);
+        else
+            MPP_LOGE("%s:: mPhysicalType(%d), formatIndex(%d), rotIndex(%d), scaleIndex(%d), PPC(%f) is not valid",
+                     __func__, mPhysicalType, formatIndex, rotIndex, scaleIndex, PPC);
+        PPC = 0.000001; /* It means can't use mPhysicalType H/W  */
+    }
 
+    return PPC;
+}
+
+float ExynosMPP::getAssignedCapacity() {
     if (mPhysicalType != MPP_G2D)
         return 0;
 
@@ -2450,124 +2974,49 @@ float ExynosMPP::getAssignedCapacity() {
         (mAssignedDisplayInfo.displayIdentifier.type == HWC_DISPLAY_VIRTUAL))
         return 0;
 
-    for (uint32_t i = 0; i < mAssignedSources.size(); i++) {
-        if ((mAssignedSources[i]->mSrcImg.transform & HAL_TRANSFORM_ROT_90) != 0)
-            rotIndex = PPC_ROT;
-    }
-
-    MPP_LOGD(eDebugCapacity, "Check all of assigned layers cycles");
-    /* PPC of layers that were added before should be changed */
-    /* Check cycles of all assigned layers again */
-    if ((mAssignedDisplayInfo.displayIdentifier.id != UINT32_MAX) && (mMaxSrcLayerNum > 1)) {
-        baseCycles += ((mAssignedDisplayInfo.xres * mAssignedDisplayInfo.yres) / G2D_BASE_PPC_COLORFILL);
-        MPP_LOGD(eDebugCapacity, "colorfill cycles: %f, total cycles: %f",
-                 ((mAssignedDisplayInfo.xres * mAssignedDisplayInfo.yres) / G2D_BASE_PPC_COLORFILL), baseCycles);
-    }
+    /* Hdr and drm layer is exception */
+    uint32_t rotIndex = getUsedRotIndex();
+    float baseCycles = getColorFillCycles(mAssignedDisplayInfo) +
+            mSrcBaseCycles[rotIndex] - mCapaExceptionCycles[rotIndex];
 
-    for (uint32_t i = 0; i < mAssignedSources.size(); i++) {
-        float srcCycles = 0;
-        uint32_t srcResolution = mAssignedSources[i]->mSrcImg.w * mAssignedSources[i]->mSrcImg.h;
-        uint32_t dstResolution = mAssignedSources[i]->mMidImg.w * mAssignedSources[i]->mMidImg.h;
-        uint32_t maxResolution = max(srcResolution, dstResolution);
-        float PPC = 0;
+    MPP_LOGD(eDebugCapacity, "assigned cycles: %f, exception cycles: %f, rotIndex: %d",
+             baseCycles, mCapaExceptionCycles[rotIndex], rotIndex);
 
-        if (mAssignedSources[i]->mSrcImg.layerFlags & EXYNOS_HWC_DIM_LAYER) {
-            PPC = G2D_BASE_PPC_COLORFILL;
-        } else {
-            PPC = getPPC(mAssignedSources[i]->mSrcImg, mAssignedSources[i]->mMidImg, mAssignedSources[i]->mSrcImg,
-                         &mAssignedSources[i]->mSrcImg, &mAssignedSources[i]->mMidImg);
-        }
-        srcCycles = maxResolution / PPC;
-
-        /* Hdr and drm layer is exception */
-        if ((hasHdrInfo(mAssignedSources[i]->mSrcImg) ||
-             (getDrmMode(mAssignedSources[i]->mSrcImg.usageFlags) != NO_DRM))) {
-            MPP_LOGD(eDebugCapacity, "Src[%d] is skipped(drm or hdr), cycles: %f, PPC: %f, srcResolution: %d, dstResolution: %d, rot(%d)",
-                     i, srcCycles, PPC, srcResolution, dstResolution, mAssignedSources[i]->mSrcImg.transform);
-            continue;
-        }
-
-        baseCycles += srcCycles;
-
-        MPP_LOGD(eDebugCapacity, "Src[%d] cycles: %f, total cycles: %f, PPC: %f, srcResolution: %d, dstResolution: %d, rot(%d)",
-                 i, srcCycles, baseCycles, PPC, srcResolution, dstResolution, mAssignedSources[i]->mSrcImg.transform);
-    }
-
-    capacity = baseCycles / getMPPClock();
-
-    return capacity;
+    return baseCycles / getMPPClock();
 }
 
 float ExynosMPP::getRequiredCapacity(DisplayInfo &display,
                                      struct exynos_image &src,
                                      struct exynos_image &dst) {
     float capacity = 0;
-    float cycles = 0;
     if (mPhysicalType == MPP_G2D) {
-        /* Initialize value with the cycles that were already assigned */
-        float baseCycles = mUsedBaseCycles;
-        float srcCycles = 0;
-        uint32_t srcResolution = src.w * src.h;
-        uint32_t dstResolution = dst.w * dst.h;
-        uint32_t maxResolution = max(srcResolution, dstResolution);
-        float curBaseCycles = 0;
-        float PPC = 0;
-
-        if ((mAssignedSources.size() == 0) ||
-            (mRotatedSrcCropBW != 0) ||
-            ((mRotatedSrcCropBW == 0) &&
-             ((src.transform & HAL_TRANSFORM_ROT_90) == 0))) {
-            /* Just add cycles for current layer */
-            if ((mAssignedSources.size() == 0) &&
-                (display.displayIdentifier.id != UINT32_MAX) && (mMaxSrcLayerNum > 1)) {
-                curBaseCycles = ((display.xres * display.yres) / G2D_BASE_PPC_COLORFILL);
-                MPP_LOGD(eDebugCapacity, "There is no assigned layer. Colorfill cycles: %f should be added",
-                         curBaseCycles);
-            }
-            curBaseCycles += getRequiredBaseCycles(src, dst);
-            baseCycles += curBaseCycles;
-            MPP_LOGD(eDebugCapacity, "mUsedBaseCycles was %f, Add base cycles %f, totalBaseCycle(%f)",
-                     mUsedBaseCycles, curBaseCycles, baseCycles);
+        float baseCycles = 0;
+        float curBaseCycles = getRequiredBaseCycles(src, dst);
+
+        if (mAssignedSources.size() == 0) {
+            baseCycles = getColorFillCycles(display);
+            MPP_LOGD(eDebugCapacity, "There is no assigned layer. Colorfill cycles: %f should be added",
+                     baseCycles);
+        } else if ((mRotatedSrcCropBW != 0) ||
+                   ((src.transform & HAL_TRANSFORM_ROT_90) == 0)) {
+            /* Initialize value with the cycles that were already assigned */
+            baseCycles = mUsedBaseCycles;
         } else {
-            /* Recalculate cycles for all of layers */
-            baseCycles = 0;
-            MPP_LOGD(eDebugCapacity, "Check all of assigned layers cycles");
-            /* PPC of layers that were added before should be changed */
-            /* Check cycles of all assigned layers again */
-            if ((display.displayIdentifier.id != UINT32_MAX) && (mMaxSrcLayerNum > 1)) {
-                baseCycles += ((display.xres * display.yres) / G2D_BASE_PPC_COLORFILL);
-                MPP_LOGD(eDebugCapacity, "colorfill cycles: %f, total cycles: %f",
-                         ((display.xres * display.yres) / G2D_BASE_PPC_COLORFILL), cycles);
-            }
-
-            for (uint32_t i = 0; i < mAssignedSources.size(); i++) {
-                float assignedSrcCycles = 0;
-                uint32_t assignedSrcResolution = mAssignedSources[i]->mSrcImg.w * mAssignedSources[i]->mSrcImg.h;
-                uint32_t assignedDstResolution = mAssignedSources[i]->mMidImg.w * mAssignedSources[i]->mMidImg.h;
-                uint32_t assignedMaxResolution = max(assignedSrcResolution, assignedDstResolution);
-                float assignedPPC = getPPC(mAssignedSources[i]->mSrcImg, mAssignedSources[i]->mMidImg,
-                                           mAssignedSources[i]->mSrcImg, &src, &dst);
-
-                assignedSrcCycles = assignedMaxResolution / assignedPPC;
-                baseCycles += assignedSrcCycles;
-
-                MPP_LOGD(eDebugCapacity, "Src[%d] cycles: %f, total cycles: %f, PPC: %f, srcResolution: %d, dstResolution: %d, rot(%d)",
-                         i, assignedSrcCycles, baseCycles, assignedPPC, assignedSrcResolution, assignedDstResolution, mAssignedSources[i]->mSrcImg.transform);
-            }
-
-            PPC = getPPC(src, dst, src, &src, &dst);
-
-            srcCycles = maxResolution / PPC;
-            baseCycles += srcCycles;
-
-            MPP_LOGD(eDebugCapacity, "check mppSource cycles: %f, total cycles: %f, PPC: %f, srcResolution: %d, dstResolution: %d, rot(%d)",
-                     srcCycles, baseCycles, PPC, srcResolution, dstResolution, src.transform);
+            /*
+             * PPC of layers that were added before should be changed
+             * because the first rotated layer is added.
+             * Cycles for rotation were already cached for all of layers.
+             */
+            baseCycles = getColorFillCycles(display) + mSrcBaseCycles[PPC_ROT];
+            MPP_LOGD(eDebugCapacity, "Rotated layer is added, cycles of assigned layers: %f -> %f",
+                     mUsedBaseCycles, baseCycles);
         }
+        baseCycles += curBaseCycles;
 
         capacity = baseCycles / getMPPClock();
 
-        MPP_LOGD(eDebugCapacity, "baseCycles: %f, capacity: %f",
-                 baseCycles, capacity);
+        MPP_LOGD(eDebugCapacity, "mUsedBaseCycles was %f, Add base cycles %f, baseCycles: %f, capacity: %f",
+                 mUsedBaseCycles, curBaseCycles, baseCycles, capacity);
     } else if (mPhysicalType == MPP_MSC) {
         /* Initialize value with the capacity that were already assigned */
         capacity = mUsedCapacity;
@@ -2604,50 +3053,64 @@ float ExynosMPP::getRequiredBaseCycles(struct exynos_image &src, struct exynos_i
     return maxResolution / (float)getPPC(src, dst, src);
 }
 
+float ExynosMPP::getColorFillCycles(DisplayInfo &display) {
+    if ((display.displayIdentifier.id == UINT32_MAX) || (mMaxSrcLayerNum <= 1))
+        return 0;
+
+    return ((display.xres * display.yres) / G2D_BASE_PPC_COLORFILL);
+}
+
+void ExynosMPP::getSrcBaseCycles(struct exynos_image &src, struct exynos_image &dst,
+                                 float cycles[PPC_ROT_MAX]) {
+    uint32_t srcResolution = src.w * src.h;
+    uint32_t dstResolution = dst.w * dst.h;
+    uint32_t maxResolution = max(srcResolution, dstResolution);
+
+    cycles[PPC_ROT] = maxResolution / getPPC(src, dst, PPC_ROT);
+    /* Rotated source always uses PPC_ROT */
+    if ((src.transform & HAL_TRANSFORM_ROT_90) == 0)
+        cycles[PPC_ROT_NO] = maxResolution / getPPC(src, dst, PPC_ROT_NO);
+    else
+        cycles[PPC_ROT_NO] = cycles[PPC_ROT];
+}
+
+void ExynosMPP::updateSrcBaseCycles(ExynosMPPSource *mppSource) {
+    exynos_image &src = mppSource->mSrcImg;
+
+    getSrcBaseCycles(src, mppSource->mMidImg, mppSource->mBaseCycles);
+    mppSource->mCapaException = (hasHdrInfo(src) || (getDrmMode(src.usageFlags) != NO_DRM));
+}
+
 bool ExynosMPP::addCapacity(ExynosMPPSource *mppSource) {
     if ((mppSource == NULL) || mCapacity == -1)
         return false;
 
     if (mPhysicalType == MPP_G2D) {
-        bool needUpdateCapacity = true;
-        if ((mAssignedSources.size() == 0) ||
-            (mRotatedSrcCropBW != 0) ||
-            ((mRotatedSrcCropBW == 0) &&
-             ((mppSource->mSrcImg.transform & HAL_TRANSFORM_ROT_90) == 0))) {
-            needUpdateCapacity = false;
+        if ((mMaxSrcLayerNum > 1) && (mAssignedSources.size() == 0) &&
+            (mAssignedDisplayInfo.displayIdentifier.id == UINT32_MAX))
+            MPP_LOGE("mAssignedDisplay is not set");
+
+        updateSrcBaseCycles(mppSource);
+        for (uint32_t i = 0; i < PPC_ROT_MAX; i++) {
+            mSrcBaseCycles[i] += mppSource->mBaseCycles[i];
+            if (mppSource->mCapaException)
+                mCapaExceptionCycles[i] += mppSource->mBaseCycles[i];
         }
 
-        if (needUpdateCapacity)
-            return true;
-
-        if ((mMaxSrcLayerNum > 1) &&
-            (mAssignedSources.size() == 0)) {
-            if (mAssignedDisplayInfo.displayIdentifier.id != UINT32_MAX) {
-                /* This will be the first mppSource that is assigned to the ExynosMPP */
-                /* Add capacity for background */
-                mUsedBaseCycles += ((mAssignedDisplayInfo.xres * mAssignedDisplayInfo.yres) / G2D_BASE_PPC_COLORFILL);
-                MPP_LOGD(eDebugCapacity, "\tcolorfill cycles: %f, total cycles: %f",
-                         ((mAssignedDisplayInfo.xres * mAssignedDisplayInfo.yres) / G2D_BASE_PPC_COLORFILL), mUsedBaseCycles);
-            } else {
-                MPP_LOGE("mAssignedDisplay is not set");
-            }
-        }
-
-        float baseCycles = getRequiredBaseCycles(mppSource->mSrcImg, mppSource->mMidImg);
-        mUsedBaseCycles += baseCycles;
-
         uint32_t srcResolution = mppSource->mSrcImg.w * mppSource->mSrcImg.h;
-        uint32_t dstResolution = mppSource->mMidImg.w * mppSource->mMidImg.h;
         if ((mppSource->mSrcImg.transform & HAL_TRANSFORM_ROT_90) == 0)
             mNoRotatedSrcCropBW += srcResolution;
         else
             mRotatedSrcCropBW += srcResolution;
 
+        /* Colorfill cycles are added with the first mppSource */
+        mUsedBaseCycles = getColorFillCycles(mAssignedDisplayInfo) +
+                mSrcBaseCycles[getUsedRotIndex()];
         mUsedCapacity = mUsedBaseCycles / getMPPClock();
 
-        MPP_LOGD(eDebugCapacity, "src num: %zu base cycle is added: %f, mUsedBaseCycles: %f, mUsedCapacity(%f), srcResolution: %d, dstResolution: %d, rot: %d, mNoRotatedSrcCropBW(%d), mRotatedSrcCropBW(%d)",
+        MPP_LOGD(eDebugCapacity, "src num: %zu base cycle is added: %f, mUsedBaseCycles: %f, mUsedCapacity(%f), rot: %d, mNoRotatedSrcCropBW(%d), mRotatedSrcCropBW(%d)",
                  mAssignedSources.size(),
-                 baseCycles, mUsedBaseCycles, mUsedCapacity, srcResolution, dstResolution,
+                 mppSource->mBaseCycles[getUsedRotIndex()], mUsedBaseCycles, mUsedCapacity,
                  mppSource->mSrcImg.transform, mNoRotatedSrcCropBW, mRotatedSrcCropBW);
     } else if (mPhysicalType == MPP_MSC) {
         mUsedCapacity = getRequiredCapacity(mAssignedDisplayInfo,
@@ -2662,27 +3125,31 @@ bool ExynosMPP::removeCapacity(ExynosMPPSource *mppSource) {
         return false;
 
     if (mPhysicalType == MPP_G2D) {
-        uint32_t srcResolution = mppSource->mSrcImg.w * mppSource->mSrcImg.h;
-        uint32_t dstResolution = mppSource->mDstImg.w * mppSource->mDstImg.h;
-
-        uint32_t prevRotatedSrcCropBW = mRotatedSrcCropBW;
+        /* mppSource is not removed from mAssignedSources yet */
+        if (mAssignedSources.size() <= 1) {
+            resetUsedCapacity();
+            return false;
+        }
 
-        if (mppSource->mSrcImg.transform == 0)
+        uint32_t srcResolution = mppSource->mSrcImg.w * mppSource->mSrcImg.h;
+        if ((mppSource->mSrcImg.transform & HAL_TRANSFORM_ROT_90) == 0)
             mNoRotatedSrcCropBW -= srcResolution;
         else
             mRotatedSrcCropBW -= srcResolution;
 
-        if ((prevRotatedSrcCropBW > 0) && (mRotatedSrcCropBW == 0))
-            return true;
-
-        float baseCycles = getRequiredBaseCycles(mppSource->mSrcImg, mppSource->mMidImg);
-        mUsedBaseCycles -= baseCycles;
+        for (uint32_t i = 0; i < PPC_ROT_MAX; i++) {
+            mSrcBaseCycles[i] -= mppSource->mBaseCycles[i];
+            if (mppSource->mCapaException)
+                mCapaExceptionCycles[i] -= mppSource->mBaseCycles[i];
+        }
 
+        mUsedBaseCycles = getColorFillCycles(mAssignedDisplayInfo) +
+                mSrcBaseCycles[getUsedRotIndex()];
         mUsedCapacity = mUsedBaseCycles / getMPPClock();
 
-        MPP_LOGD(eDebugCapacity, "src num: %zu, base cycle is removed: %f, mUsedBaseCycles: %f, mUsedCapacity(%f), srcResolution: %d, dstResolution: %d, rot: %d, mNoRotatedSrcCropBW(%d), mRotatedSrcCropBW(%d)",
+        MPP_LOGD(eDebugCapacity, "src num: %zu, base cycle is removed: %f, mUsedBaseCycles: %f, mUsedCapacity(%f), rot: %d, mNoRotatedSrcCropBW(%d), mRotatedSrcCropBW(%d)",
                  mAssignedSources.size(),
-                 baseCycles, mUsedBaseCycles, mUsedCapacity, srcResolution, dstResolution,
+                 mppSource->mBaseCycles[getUsedRotIndex()], mUsedBaseCycles, mUsedCapacity,
                  mppSource->mSrcImg.transform, mNoRotatedSrcCropBW, mRotatedSrcCropBW);
     } else if (mPhysicalType == MPP_MSC) {
         exynos_image &src = mppSource->mSrcImg;
@@ -2704,6 +3171,10 @@ void ExynosMPP::resetUsedCapacity() {
     mUsedBaseCycles = 0;
     mRotatedSrcCropBW = 0;
     mNoRotatedSrcCropBW = 0;
+    for (uint32_t i = 0; i < PPC_ROT_MAX; i++) {
+        mSrcBaseCycles[i] = 0;
+        mCapaExceptionCycles[i] = 0;
+    }
 }
 
 int32_t ExynosMPP::updateUsedCapacity() {
@@ -2711,54 +3182,59 @@ int32_t ExynosMPP::updateUsedCapacity() {
     if (mCapacity == -1)
         return ret;
 
-    float capacity = 0;
-    mUsedCapacity = 0;
-
-    mRotatedSrcCropBW = 0;
-    mNoRotatedSrcCropBW = 0;
+    resetUsedCapacity();
 
     if ((mPhysicalType == MPP_G2D) &&
         (mAssignedDisplayInfo.displayIdentifier.id != UINT32_MAX) &&
         (mAssignedSources.size() > 0)) {
-        float cycles = 0;
-
-        if (mMaxSrcLayerNum > 1) {
-            cycles += ((mAssignedDisplayInfo.xres * mAssignedDisplayInfo.yres) / G2D_BASE_PPC_COLORFILL);
-            MPP_LOGD(eDebugCapacity, "\tcolorfill cycles: %f, total cycles: %f",
-                     ((mAssignedDisplayInfo.xres * mAssignedDisplayInfo.yres) / G2D_BASE_PPC_COLORFILL), cycles);
-        }
         for (uint32_t i = 0; i < mAssignedSources.size(); i++) {
-            uint32_t srcResolution = mAssignedSources[i]->mSrcImg.w * mAssignedSources[i]->mSrcImg.h;
-            if ((mAssignedSources[i]->mSrcImg.transform & HAL_TRANSFORM_ROT_90) == 0)
+            ExynosMPPSource *mppSource = mAssignedSources[i];
+            uint32_t srcResolution = mppSource->mSrcImg.w * mppSource->mSrcImg.h;
+            if ((mppSource->mSrcImg.transform & HAL_TRANSFORM_ROT_90) == 0)
                 mNoRotatedSrcCropBW += srcResolution;
             else
                 mRotatedSrcCropBW += srcResolution;
+
+            updateSrcBaseCycles(mppSource);
+            for (uint32_t j = 0; j < PPC_ROT_MAX; j++) {
+                mSrcBaseCycles[j] += mppSource->mBaseCycles[j];
+                if (mppSource->mCapaException)
+                    mCapaExceptionCycles[j] += mppSource->mBaseCycles[j];
+            }
         }
         MPP_LOGD(eDebugCapacity, "mNoRotatedSrcCropBW(%d), mRotatedSrcCropBW(%d)",
                  mNoRotatedSrcCropBW, mRotatedSrcCropBW);
-        for (uint32_t i = 0; i < mAssignedSources.size(); i++) {
-            float srcCycles = 0;
-            uint32_t srcResolution = mAssignedSources[i]->mSrcImg.w * mAssignedSources[i]->mSrcImg.h;
-            uint32_t dstResolution = mAssignedSources[i]->mMidImg.w * mAssignedSources[i]->mMidImg.h;
-            uint32_t maxResolution = max(srcResolution, dstResolution);
-            float PPC = getPPC(mAssignedSources[i]->mSrcImg, mAssignedSources[i]->mMidImg, mAssignedSources[i]->mSrcImg);
-            srcCycles = maxResolution / PPC;
-            cycles += srcCycles;
-
-            MPP_LOGD(eDebugCapacity, "Src[%d] cycles: %f, total cycles: %f, PPC: %f, srcResolution: %d, dstResolution: %d, rot(%d)",
-                     i, srcCycles, cycles, PPC, srcResolution, dstResolution, mAssignedSources[i]->mSrcImg.transform);
-        }
 
-        mUsedBaseCycles = cycles;
-        capacity = cycles / getMPPClock();
-
-        mUsedCapacity = capacity;
+        mUsedBaseCycles = getColorFillCycles(mAssignedDisplayInfo) +
+                mSrcBaseCycles[getUsedRotIndex()];
+        mUsedCapacity = mUsedBaseCycles / getMPPClock();
     }
     MPP_LOGD(eDebugCapacity, "assigned layer size(%zu), mUsedCapacity: %f", mAssignedSources.size(), mUsedCapacity);
 
     return mUsedCapacity;
 }
 
+void ExynosMPP::checkUsedCapacity() {
+    if ((mPhysicalType != MPP_G2D) || (mCapacity == -1) ||
+        (mAssignedDisplayInfo.displayIdentifier.id == UINT32_MAX) ||
+        (mAssignedSources.size() == 0))
+        return;
+
+    /* Recompute cycles of all assigned layers */
+    float cycles = getColorFillCycles(mAssignedDisplayInfo);
+    for (uint32_t i = 0; i < mAssignedSources.size(); i++) {
+        uint32_t srcResolution = mAssignedSources[i]->mSrcImg.w * mAssignedSources[i]->mSrcImg.h;
+        uint32_t dstResolution = mAssignedSources[i]->mMidImg.w * mAssignedSources[i]->mMidImg.h;
+        uint32_t maxResolution = max(srcResolution, dstResolution);
+        cycles += maxResolution / getPPC(mAssignedSources[i]->mSrcImg, mAssignedSources[i]->mMidImg,
+                                         mAssignedSources[i]->mSrcImg);
+    }
+
+    if (fabs(cycles - mUsedBaseCycles) > (cycles * 0.001))
+        MPP_LOGE("%s:: incremental cycles(%f) is different from recomputed cycles(%f), src num: %zu",
+                 __func__, mUsedBaseCycles, cycles, mAssignedSources.size());
+}
+
 uint32_t ExynosMPP::getMPPClock() {
     if (mPhysicalType == MPP_G2D)
         return G2D_CLOCK;
@@ -2790,14 +3266,73 @@ int ExynosMPP::prioritize(int priority) {
     return ret;
 }
 
+bool ExynosMPP::isDstBufReleased(int32_t index) {
+    int fence = mDstImgs[index].acrylicReleaseFenceFd;
+
+    if (!mFenceTracer.fence_valid(fence))
+        return true;
+
+    return (sync_wait(fence, 0) == 0);
+}
+
 uint32_t ExynosMPP::increaseDstBuffIndex() {
-    if (mAllocOutBufFlag)
-        mCurrentDstBuf = (mCurrentDstBuf + 1) % NUM_MPP_DST_BUFS(mLogicalType);
+    waitPostProcessing();
+
+    mLastDstBuf = mCurrentDstBuf;
+    if (mAllocOutBufFlag) {
+        int32_t numBufs = NUM_MPP_DST_BUFS(mLogicalType);
+        int32_t oldestBuf = -1;
+        int32_t oldestReleasedBuf = -1;
+
+        if ((mCurrentDstBuf >= 0) && (mCurrentDstBuf < numBufs))
+            mDstImgs[mCurrentDstBuf].usedFrame = ++mDstBufFrameCount;
+
+        /*
+         * Select the oldest buffer that is already released by the display.
+         * A job on a buffer that is still scanned out waits for
+         * the release fence in the driver and delays the jobs queued after it.
+         * The oldest buffer is used if no buffer is released.
+         */
+        for (int32_t i = 0; i < numBufs; i++) {
+            if (i == mCurrentDstBuf)
+                continue;
+            if ((oldestBuf < 0) || (mDstImgs[i].usedFrame < mDstImgs[oldestBuf].usedFrame))
+                oldestBuf = i;
+            if (isDstBufReleased(i) &&
+                ((oldestReleasedBuf < 0) ||
+                 (mDstImgs[i].usedFrame < mDstImgs[oldestReleasedBuf].usedFrame)))
+                oldestReleasedBuf = i;
+        }
+        if (oldestReleasedBuf >= 0) {
+            mCurrentDstBuf = oldestReleasedBuf;
+        } else if (oldestBuf >= 0) {
+            MPP_LOGD(eDebugMPP, "no dstImg is released, dstImg[%d] is used", oldestBuf);
+            mCurrentDstBuf = oldestBuf;
+        }
+    }
     return mCurrentDstBuf;
 }
 
+/*
+ * Buffers of the default destination format for the display size
+ * are allocated in advance by the pool so that allocOutBuf()
+ * doesn't allocate them in the validate or present path.
+ */
+void ExynosMPP::prewarmDstBufs(uint32_t xres, uint32_t yres, uint32_t count) {
+    if ((mDstBufPool == nullptr) || (mAllocOutBufFlag == false) ||
+        (mFreeOutBufFlag == false))
+        return;
+
+    /* Same size and usage as ExynosResourceManager::doAllocDstBufs() */
+    uint32_t width = 0, height = 0;
+    getDefaultOutBufSize(xres, yres, width, height);
+    mDstBufPool->prewarm(width, height, DEFAULT_MPP_DST_FORMAT, getBufferUsage(0), count);
+}
+
 void ExynosMPP::reloadResourceForHWFC() {
     ALOGI("reloadResourceForHWFC()");
+    waitPostProcessing();
+    releasePartialComposition();
     if (mAcrylicHandle != NULL)
         delete mAcrylicHandle;
     mAcrylicHandle = AcrylicFactory::createAcrylic("default_compositor");
@@ -2828,7 +3363,7 @@ void ExynosMPP::setTargetDisplayDevice(int device) {
     if (mAcrylicHandle == NULL) {
         MPP_LOGE("mAcrylicHandle is NULL");
     } else
-        mAcrylicHandle->setTargetDisplayInfo(&device);
+        mAcrylicHandle->setTargetDisplayDevice(device);
 }
 
 void ExynosMPP::dump(String8 &result) {
@@ -2844,6 +3379,9 @@ void ExynosMPP::dump(String8 &result) {
                         mPrevAssignedState, mPrevAssignedDisplayType, mReservedDisplayInfo.displayIdentifier.id);
     result.appendFormat("\tassinedSourceNum(%zu), Capacity(%f), CapaUsed(%f), mCurrentDstBuf(%d)\n",
                         mAssignedSources.size(), mCapacity, mUsedCapacity, mCurrentDstBuf);
+    if ((mPhysicalType == MPP_G2D) && (mMaxSrcLayerNum > 1))
+        result.appendFormat("\tcomposition partial(%" PRIu64 "), full(%" PRIu64 ")\n",
+                            mPartialComposition.partialCount, mPartialComposition.fullCount);
 }
 
 void ExynosMPP::dumpBufInfo(String8 &str) {
@@ -2882,6 +3420,9 @@ void ExynosMPP::dumpBufInfo(String8 &str) {
 }
 
 void ExynosMPP::closeFences() {
+    /* The requested job still can use the fences */
+    waitPostProcessing();
+
     for (uint32_t i = 0; i < mAssignedSources.size(); i++) {
         mSrcImgs[i].acrylicAcquireFenceFd =
             mFenceTracer.fence_close(mSrcImgs[i].acrylicAcquireFenceFd,
@@ -2909,6 +3450,7 @@ void ExynosMPP::closeFences() {
 
 void ExynosMPP::addFormatRestrictions(restriction_key table) {
     mFormatRestrictions.push_back(table);
+    mFormatCapaTableValid.store(false, std::memory_order_release);
     HDEBUGLOGD(eDebugAttrSetting, "MPP : %s, %d, %s, %d",
                mName.string(),
                mFormatRestrictions.back().nodeType,
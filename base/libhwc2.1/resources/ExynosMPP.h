@@ -27,7 +27,12 @@
 #include <utils/String8.h>
 #include <utils/List.h>
 #include <utils/Vector.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <mutex>
+#include <thread>
 #include <hardware/exynos/acryl.h>
 #include <map>
 #include "ExynosHWCModule.h"
@@ -35,6 +40,8 @@
 #include "ExynosHWCHelper.h"
 #include "ExynosMPPType.h"
 #include "ExynosFenceTracer.h"
+#include "ExynosMPPBufferPool.h"
+#include "ExynosFenceReactor.h"
 
 #include <hardware/exynos/hdrInterface.h>
 
@@ -53,10 +60,34 @@ class ExynosMPP;
 #define G2D_MAX_SRC_NUM 15
 #endif
 
+/*
+ * M2M jobs are submitted to libacryl by a worker thread shared by all MPPs.
+ * The present path only waits for the submission, not for the HW.
+ */
+#ifndef USE_ASYNC_M2M_PROCESSING
+#define USE_ASYNC_M2M_PROCESSING true
+#endif
+
 #ifndef MSC_MAX_SRC_NUM
 #define MSC_MAX_SRC_NUM 2
 #endif
 
+/*
+ * G2D composition blends only the damaged area of the sources
+ * and copies the rest from the previous composition result.
+ * The whole frame is composed if the damage is larger than this
+ * percentage of the display.
+ */
+#ifndef G2D_PARTIAL_COMPOSITION_MAX_PERCENT
+#define G2D_PARTIAL_COMPOSITION_MAX_PERCENT 50
+#endif
+/* Damage is aligned to the AFBC super block if the target is compressed */
+#ifndef G2D_PARTIAL_COMPOSITION_AFBC_ALIGN
+#define G2D_PARTIAL_COMPOSITION_AFBC_ALIGN 16
+#endif
+/* Area out of the damage is copied by up to 4 rects (top, bottom, left, right) */
+#define G2D_PARTIAL_COPY_LAYER_NUM 4
+
 #define M2M_JUSTIFIED_DST_ALIGN 16
 
 /* RGB565 needs 32pixel align for Gralloc */
@@ -135,6 +166,10 @@ class ExynosMPP;
 /* Currently allowed capacity percentage is over 10% */
 #define MPP_CAPA_OVER_THRESHOLD 1.1
 
+/* Values of ExynosMPP::mPartitionDisplayId other than display id */
+#define MPP_PARTITION_NONE UINT32_MAX
+#define MPP_PARTITION_SHARED (UINT32_MAX - 1)
+
 #ifndef MPP_G2D_SRC_SCALED_WEIGHT
 #define MPP_G2D_SRC_SCALED_WEIGHT 1.125
 #endif
@@ -248,6 +283,8 @@ typedef struct exynos_mpp_img_info {
     AcrylicLayer *mppLayer = NULL;
     int acrylicAcquireFenceFd = -1;
     int acrylicReleaseFenceFd = -1;
+    /* Frame count when the buffer was used last, 0 if it is not used */
+    uint64_t usedFrame = 0;
     void reset() {
         *this = {};
     };
@@ -322,6 +359,14 @@ enum class DisableType {
 #define ROT_SHIFT 20
 #define PPC_IDX(x, y, z) (x | (y << FORMAT_SHIFT) | (z << ROT_SHIFT))
 
+/* Bits of ExynosMPP::mFormatCapaTable */
+enum {
+    FORMAT_CAPA_SRC_SDR = 1 << 0, /* src format is supported without HDR info */
+    FORMAT_CAPA_SRC_HDR = 1 << 1, /* src format is supported with HDR info */
+    FORMAT_CAPA_DST = 1 << 2,
+    FORMAT_CAPA_SRC = FORMAT_CAPA_SRC_SDR | FORMAT_CAPA_SRC_HDR,
+};
+
 typedef struct dataspace_standard_mapper {
     int32_t supported_hwc_attr;
     uint32_t eq_mode;
@@ -449,6 +494,28 @@ class ExynosMPPSource {
     ExynosMPP *mOtfMPP;
     ExynosMPP *mM2mMPP;
 
+    /*
+     * G2D base cycles of this source, cached when it is assigned to mM2mMPP.
+     * Index is rot_index_t, PPC_ROT is used if any assigned source is rotated.
+     */
+    float mBaseCycles[PPC_ROT_MAX];
+    /* hdr or drm source, it is not counted by ExynosMPP::getAssignedCapacity() */
+    bool mCapaException;
+
+    /*
+     * Changed area of the source in display coordinates since mDamageBaseBuffer.
+     * It is set by the display for partial G2D composition of the current frame,
+     * the whole dst area is damaged if it is not valid.
+     */
+    bool mDamageValid = false;
+    hwc_rect_t mDamage = {0, 0, 0, 0};
+    buffer_handle_t mDamageBaseBuffer = nullptr;
+    void resetDamage() {
+        mDamageValid = false;
+        mDamage = {0, 0, 0, 0};
+        mDamageBaseBuffer = nullptr;
+    }
+
     /**
          * SRAM/HW resource info
          */
@@ -467,28 +534,29 @@ bool exynosMPPSourceComp(const ExynosMPPSource *l, const ExynosMPPSource *r);
 
 class ExynosMPP {
   private:
-    class ResourceManageThread {
-      private:
-        ExynosMPP *mExynosMPP;
-        List<exynos_mpp_img_info> mFreedBuffers;
-        List<int> mStateFences;
+    /*
+     * Submits the requested jobs of all M2M MPPs in the request order.
+     * Each MPP has at most one requested job and waits only for its own job.
+     */
+    class PostProcessingWorker {
+      public:
+        static PostProcessingWorker &getInstance();
+        void request(ExynosMPP *exynosMPP);
+        int32_t wait(ExynosMPP *exynosMPP);
 
-        void freeBuffers();
-        bool checkStateFences();
+      private:
+        PostProcessingWorker();
         void threadLoop();
-        std::thread mThread;
-        Condition mCondition;
-        Mutex mMutex;
-        String8 mName;
 
-      public:
-        bool mRunning;
-        ResourceManageThread(ExynosMPP *exynosMPP);
-        ~ResourceManageThread();
-        void run();
-        void addFreedBuffer(exynos_mpp_img_info freedBuffer);
-        void addStateFence(int fence);
+        std::thread mThread;
+        std::mutex mMutex;
+        std::condition_variable mCondition;
+        std::condition_variable mDoneCondition;
+        std::deque<ExynosMPP *> mJobs;
     };
+    /* Guarded by the mutex of PostProcessingWorker */
+    bool mPostProcessingRequested = false;
+    int32_t mPostProcessingResult = NO_ERROR;
     ExynosFenceTracer &mFenceTracer = ExynosFenceTracer::getInstance();
     std::function<void(uint64_t)> mBufDestoryedCallback = nullptr;
 
@@ -511,11 +579,19 @@ class ExynosMPP {
 
     uint32_t mHWState;
     int mLastStateFenceFd;
+    /* State fences that are waited by the fence reactor */
+    std::atomic<uint32_t> mPendingStateFenceNum{0};
+    std::atomic<bool> mStateFenceFailed{false};
     uint32_t mAssignedState;
 
     /* Runtime enable/disable */
     bool mEnableByDebug;
     uint32_t mDisableByUserScenario;
+    /*
+     * Display that owns the MPP while displays are validated in parallel.
+     * MPP_PARTITION_SHARED MPP can't be assigned until the partition is cleared.
+     */
+    uint32_t mPartitionDisplayId;
 
     DisplayInfo mAssignedDisplayInfo;
 
@@ -528,7 +604,8 @@ class ExynosMPP {
     int32_t mPrevAssignedDisplayType;
     DisplayInfo mReservedDisplayInfo;
 
-    ResourceManageThread mResourceManageThread;
+    /* Jobs are submitted by PostProcessingWorker */
+    bool mAsyncPostProcessing = false;
     float mCapacity;
     float mUsedCapacity;
     float mPreAssignedCapacity;
@@ -540,6 +617,13 @@ class ExynosMPP {
             uint32_t mNoRotatedSrcCropBW;
         };
     };
+    /*
+     * Sum of mBaseCycles of assigned sources for each rot_index_t
+     * mUsedBaseCycles is colorfill cycles + mSrcBaseCycles[getUsedRotIndex()]
+     */
+    float mSrcBaseCycles[PPC_ROT_MAX];
+    /* Sum of mBaseCycles of the sources that have mCapaException */
+    float mCapaExceptionCycles[PPC_ROT_MAX];
 
     bool mAllocOutBufFlag;
     bool mFreeOutBufFlag;
@@ -552,15 +636,66 @@ class ExynosMPP {
     struct exynos_mpp_img_info mDstImgs[NUM_MPP_DST_BUFS_DEFAULT];
     int32_t mCurrentDstBuf;
     int32_t mPrivDstBuf;
+    /* Index of mDstImgs that was used by the last frame */
+    int32_t mLastDstBuf;
+    /* Frame count of mDstImgs[].usedFrame */
+    uint64_t mDstBufFrameCount = 0;
     compressionInfo_t mTargetCompressionInfo;
     int32_t mCurrentTargetCompressionInfoType;
     struct restriction_size mSrcSizeRestrictions[RESTRICTION_MAX];
     struct restriction_size mDstSizeRestrictions[RESTRICTION_MAX];
     std::vector<struct restriction_key> mFormatRestrictions;
+    /*
+     * mFormatRestrictions and logical type restrictions compiled
+     * per exynos_format_desc index (FORMAT_CAPA_XXX bits).
+     * It is rebuilt by updateCapabilityTable() when restrictions are changed,
+     * validate threads only read it.
+     */
+    uint8_t mFormatCapaTable[FORMAT_MAX_CNT];
+    std::atomic<bool> mFormatCapaTableValid{false};
+    /*
+     * HAL_TRANSFORM_XXX bits that are not supported by mTransformCapaAttr.
+     * It is compiled with the table and used while mAttr is not changed.
+     */
+    uint32_t mUnsupportedTransform = 0;
+    uint64_t mTransformCapaAttr = 0;
+
+    /*
+     * Number of isSupported() calls, it is reported by hwcomposer_simulator.
+     * Displays can call isSupported() of the same MPP in parallel validate.
+     */
+    std::atomic<uint64_t> mSupportedCheckCount{0};
 
     /* For libacryl */
     Acrylic *mAcrylicHandle;
 
+    /* Destination buffers are allocated from it if it is set */
+    ExynosMPPBufferPool *mDstBufPool = nullptr;
+
+    struct PartialCompositionInfo {
+        /* Set by the display before the job that makes its exynos composition target */
+        bool targetRequested = false;
+        /* Only the exynos composition target job can be composed partially */
+        bool target = false;
+        /* Area of the current job in the dst buffer */
+        hwc_rect_t dstRect = {0, 0, 0, 0};
+        /* The current job blends only the damage, the rest is copied from validBuf */
+        bool enabled = false;
+        hwc_rect_t damage = {0, 0, 0, 0};
+        AcrylicLayer *copyLayers[G2D_PARTIAL_COPY_LAYER_NUM] = {};
+        /* mDstImgs index that has the last complete composition result */
+        int32_t validBuf = -1;
+        buffer_handle_t validHandle = NULL;
+        hwc_rect_t validDstRect = {0, 0, 0, 0};
+        uint32_t validDisplayId = UINT32_MAX;
+        android_dataspace_t validDataspace = HAL_DATASPACE_UNKNOWN;
+        /* Duplicated dst acquire fence of the job that wrote validBuf */
+        int validFence = -1;
+        uint64_t partialCount = 0;
+        uint64_t fullCount = 0;
+    };
+    PartialCompositionInfo mPartialComposition;
+
     bool mUseM2MSrcFence;
     /* MPP's attribute bit (supported feature bit) */
     uint64_t mAttr;
@@ -605,6 +740,8 @@ class ExynosMPP {
     int32_t allocOutBuf(uint32_t w, uint32_t h, uint32_t format, uint64_t usage, uint32_t index);
     int32_t setOutBuf(buffer_handle_t outbuf, int32_t fence, DisplayInfo &display);
     int32_t freeOutBuf(exynos_mpp_img_info dst);
+    /* Gives the buffer back to the pool with a fence of its pending write and read */
+    void releaseOutBufToPool(exynos_mpp_img_info &dst);
     int32_t doPostProcessing(struct exynos_image &src, struct exynos_image &dst);
     int32_t doPostProcessing(uint32_t totalImags, uint32_t imageIndex, struct exynos_image &src, struct exynos_image &dst);
     int32_t getSrcReleaseFence(uint32_t srcIndex);
@@ -612,6 +749,8 @@ class ExynosMPP {
     int32_t getDstImageInfo(exynos_image *img);
     int32_t setDstReleaseFence(int releaseFence, DisplayInfo &display);
     int32_t resetDstAcquireFence();
+    int32_t waitPostProcessing();
+    void requestPostProcessing();
     int32_t requestHWStateChange(uint32_t state);
     int32_t setHWStateFence(int32_t fence);
     int64_t checkDstSize(exynos_image &dst);
@@ -669,6 +808,8 @@ class ExynosMPP {
     uint32_t getDstXOffsetAlign(struct exynos_image &dst);
     uint32_t getDstYOffsetAlign(struct exynos_image &dst);
     uint32_t getOutBufAlign();
+    /* Size of the dst buffers that are allocated in advance for the display size */
+    void getDefaultOutBufSize(uint32_t xres, uint32_t yres, uint32_t &width, uint32_t &height);
     virtual bool isDstFormatSupported(struct exynos_image &dst);
     int32_t isSupportLayerColorTransform(
         struct exynos_image &src, struct exynos_image &dst);
@@ -682,6 +823,14 @@ class ExynosMPP {
     virtual int32_t resetAssignedState(ExynosMPPSource *mppSource);
     int32_t reserveMPP(DisplayInfo &display);
 
+    /*
+     * MPP is given to another display or blocked while displays are validated in parallel.
+     * The validate thread of displayId must not touch any other state of the MPP.
+     */
+    bool isPartitionedAway(uint32_t displayId) const {
+        return (mPartitionDisplayId != MPP_PARTITION_NONE) &&
+               (mPartitionDisplayId != displayId);
+    }
     virtual bool isAssignableState(DisplayInfo &display,
                                    struct exynos_image &src, struct exynos_image &dst);
     bool isAssignable(DisplayInfo &display, struct exynos_image &src,
@@ -694,17 +843,27 @@ class ExynosMPP {
                               struct exynos_image &dst);
     int32_t updateUsedCapacity();
     void resetUsedCapacity();
+    float getColorFillCycles(DisplayInfo &display);
+    /* Base cycles of a source for each rot_index_t without assigning it */
+    void getSrcBaseCycles(struct exynos_image &src, struct exynos_image &dst,
+                          float cycles[PPC_ROT_MAX]);
     virtual int prioritize(int priority);
 
     uint32_t getMPPClock();
 
     void dump(String8 &result);
     void dumpBufInfo(String8 &str);
+    /* Rects of the dst area that are out of the damage, it returns the number of rects */
+    static uint32_t getPartialCopyRects(const hwc_rect_t &damage, const hwc_rect_t &dstRect,
+                                        hwc_rect_t rects[G2D_PARTIAL_COPY_LAYER_NUM]);
+    /* The next job makes the exynos composition target of the display */
+    void requestPartialComposition() { mPartialComposition.targetRequested = true; };
 
     uint32_t increaseDstBuffIndex();
     bool canSkipProcessing();
 
     virtual bool isSupportedCompression(struct exynos_image &src);
+    void prewarmDstBufs(uint32_t xres, uint32_t yres, uint32_t count);
     virtual bool isSharedMPPUsed();
 
     void closeFences();
@@ -741,6 +900,11 @@ class ExynosMPP {
 
     virtual void addFormatRestrictions(struct restriction_key table);
     virtual void addSizeRestrictions(restriction_size srcSize, restriction_size dstSize, restriction_classification format);
+    void updateCapabilityTable();
+    bool isCapabilityTableValid() { return mFormatCapaTableValid.load(std::memory_order_acquire); };
+    /* Capability of exynos_format_desc[descIndex], from the table if it is valid */
+    uint8_t getFormatCapa(uint32_t descIndex);
+    uint8_t compileFormatCapa(uint32_t descIndex);
 
     virtual uint32_t getHWBlockId() { return mHWBlockId; }
     virtual uint32_t getAXIPortId() { return mAXIPortId; }
@@ -757,6 +921,15 @@ class ExynosMPP {
     uint64_t getBufferUsage(uint64_t usage);
     bool needDstBufRealloc(struct exynos_image &dst, uint32_t index);
     bool canUsePrevFrame(struct exynos_image &src);
+    bool isSameAsPrevSource(uint32_t index);
+    bool canUsePartialComposition(hwc_rect_t &damage);
+    void clipLayerToDamage(exynos_mpp_img_info *srcImgInfo, struct exynos_image &src,
+                           struct exynos_image &dst, const hwc_rect_t &damage);
+    int32_t setupPartialCopyLayers();
+    void updatePartialCompositionResult(bool success);
+    void releasePartialComposition();
+    bool isDstBufReleased(int32_t index);
+    void addStateFence(int fence);
     android_dataspace_t getDstDataspace(int dstFormat, DisplayInfo &display,
                                         android_dataspace_t dstDataspace);
     int32_t setupDst(exynos_mpp_img_info *dstImgInfo);
@@ -783,9 +956,16 @@ class ExynosMPP {
                      uint32_t &formatIndex, uint32_t &rotIndex, uint32_t &scaleIndex,
                      const struct exynos_image &criteria);
 
+    float getPPC(const struct exynos_image &src, const struct exynos_image &dst,
+                 uint32_t rotIndex);
+
     float getRequiredBaseCycles(struct exynos_image &src, struct exynos_image &dst);
+    uint32_t getUsedRotIndex() { return (mRotatedSrcCropBW > 0) ? PPC_ROT : PPC_ROT_NO; };
+    void updateSrcBaseCycles(ExynosMPPSource *mppSource);
     bool addCapacity(ExynosMPPSource *mppSource);
     bool removeCapacity(ExynosMPPSource *mppSource);
+    /* Compare incremental capacity with full recomputation (eDebugCapacityCheck) */
+    void checkUsedCapacity();
     /*
      * This should be called by isCSCSupportedByMPP()
      * This function checks additional restriction for color space conversion
@@ -0,0 +1,377 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
+#include <utils/Trace.h>
+#include <inttypes.h>
+#include <sync/sync.h>
+#include "ExynosMPPBufferPool.h"
+#include "ExynosGraphicBuffer.h"
+#include "ExynosHWCDebug.h"
+
+using namespace android;
+using namespace vendor::graphics;
+
+ExynosMPPBufferPool::ExynosMPPBufferPool() {
+    mThread = std::thread(&ExynosMPPBufferPool::threadLoop, this);
+}
+
+ExynosMPPBufferPool::~ExynosMPPBufferPool() {
+    {
+        Mutex::Autolock lock(mMutex);
+        mRunning = false;
+        mCondition.signal();
+    }
+    if (mThread.joinable())
+        mThread.join();
+
+    std::vector<PoolBuffer> buffers;
+    for (auto &it : mClasses) {
+        for (auto &buffer : it.second.freeBuffers)
+            buffers.push_back(buffer);
+        it.second.freeBuffers.clear();
+    }
+    buffers.insert(buffers.end(), mDestroyBuffers.begin(), mDestroyBuffers.end());
+    mDestroyBuffers.clear();
+    buffers.insert(buffers.end(), mWaitBuffers.begin(), mWaitBuffers.end());
+    mWaitBuffers.clear();
+    destroyBuffers(buffers);
+}
+
+ExynosMPPBufferPool::BufferClass ExynosMPPBufferPool::getBufferClass(uint32_t width, uint32_t height,
+                                                                     uint32_t format, uint64_t usage) {
+    BufferClass bufClass;
+    bufClass.width = pixel_align(width, MPP_BUFFER_POOL_SIZE_ALIGN);
+    bufClass.height = pixel_align(height, MPP_BUFFER_POOL_SIZE_ALIGN);
+    bufClass.format = format;
+    bufClass.usage = usage;
+    return bufClass;
+}
+
+buffer_handle_t ExynosMPPBufferPool::allocate(const BufferClass &bufClass) {
+    ATRACE_CALL();
+    ExynosGraphicBufferAllocator &gAllocator(ExynosGraphicBufferAllocator::get());
+    buffer_handle_t buffer = NULL;
+    uint32_t stride = 0;
+
+    status_t error = gAllocator.allocate(bufClass.width, bufClass.height, bufClass.format, 1,
+                                         bufClass.usage, &buffer, &stride, "HWC");
+    if (error != NO_ERROR)
+        return NULL;
+
+    return buffer;
+}
+
+void ExynosMPPBufferPool::destroy(PoolBuffer &buffer) {
+    ExynosGraphicBufferAllocator &gAllocator(ExynosGraphicBufferAllocator::get());
+
+    HDEBUGLOGD(eDebugBuf, "%s:: buffer: %p", __func__, buffer.handle);
+    if (mFenceTracer.fence_valid(buffer.releaseFence)) {
+        buffer.releaseFence = mFenceTracer.fence_close(buffer.releaseFence, buffer.display,
+                                                       FENCE_TYPE_DST_RELEASE, FENCE_IP_ALL,
+                                                       "mppBufferPool::destroy: releaseFence");
+    }
+    if (mFenceTracer.fence_valid(buffer.writeFence)) {
+        buffer.writeFence = mFenceTracer.fence_close(buffer.writeFence, buffer.display,
+                                                     FENCE_TYPE_DST_ACQUIRE, FENCE_IP_ALL,
+                                                     "mppBufferPool::destroy: writeFence");
+    }
+    if (mBufDestoryedCallback)
+        mBufDestoryedCallback(ExynosGraphicBufferMeta::get_buffer_id(buffer.handle));
+    gAllocator.free(buffer.handle);
+    buffer.handle = NULL;
+}
+
+bool ExynosMPPBufferPool::isReleased(const PoolBuffer &buffer) {
+    if (!mFenceTracer.fence_valid(buffer.releaseFence))
+        return true;
+    return (sync_wait(buffer.releaseFence, 0) == 0);
+}
+
+/* Called only by the pool thread, the present path never waits for the fences */
+void ExynosMPPBufferPool::waitWrite(PoolBuffer &buffer) {
+    if (!mFenceTracer.fence_valid(buffer.writeFence))
+        return;
+
+    ATRACE_CALL();
+    if (sync_wait(buffer.writeFence, MPP_BUFFER_POOL_FENCE_WAIT_MS) < 0)
+        HWC_LOGE_NODISP("%s:: fence sync_wait error, buffer: %p, fence(%d)",
+                        __func__, buffer.handle, buffer.writeFence);
+    buffer.writeFence = mFenceTracer.fence_close(buffer.writeFence, buffer.display,
+                                                 FENCE_TYPE_DST_ACQUIRE, FENCE_IP_ALL,
+                                                 "mppBufferPool::waitWrite: writeFence");
+}
+
+void ExynosMPPBufferPool::destroyBuffers(std::vector<PoolBuffer> &buffers) {
+    for (auto &buffer : buffers)
+        destroy(buffer);
+    buffers.clear();
+}
+
+void ExynosMPPBufferPool::touchLocked() {
+    mLastActiveTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (mTrimmed) {
+        mTrimmed = false;
+        mCondition.signal();
+    }
+}
+
+int32_t ExynosMPPBufferPool::acquire(uint32_t width, uint32_t height, uint32_t format, uint64_t usage,
+                                     buffer_handle_t *outBuffer, int *outFence) {
+    BufferClass bufClass = getBufferClass(width, height, format, usage);
+    PoolBuffer buffer = {NULL, -1, DisplayIdentifier()};
+
+    *outBuffer = NULL;
+    *outFence = -1;
+
+    {
+        Mutex::Autolock lock(mMutex);
+        touchLocked();
+
+        ClassInfo &info = mClasses[bufClass];
+        if (!info.freeBuffers.empty()) {
+            /* The oldest buffer is taken if no buffer is released yet */
+            auto it = std::find_if(info.freeBuffers.begin(), info.freeBuffers.end(),
+                                   [this](const PoolBuffer &buf) { return isReleased(buf); });
+            if (it == info.freeBuffers.end())
+                it = info.freeBuffers.begin();
+            buffer = *it;
+            info.freeBuffers.erase(it);
+            info.hitCount++;
+            mAcquiredBuffers[buffer.handle] = bufClass;
+        } else {
+            info.missCount++;
+        }
+    }
+
+    if (buffer.handle != NULL) {
+        /* Buffer is written by the new user after the HW waits for the previous user */
+        *outBuffer = buffer.handle;
+        *outFence = buffer.releaseFence;
+        HDEBUGLOGD(eDebugBuf, "%s:: reuse buffer %p (%dx%d, format: 0x%8x, usage: 0x%" PRIx64 ")",
+                   __func__, buffer.handle, bufClass.width, bufClass.height,
+                   bufClass.format, bufClass.usage);
+        return NO_ERROR;
+    }
+
+    buffer.handle = allocate(bufClass);
+    if (buffer.handle == NULL) {
+        ALOGW("%s:: failed to allocate buffer(%dx%d), retry after flush",
+              __func__, bufClass.width, bufClass.height);
+        flush();
+        buffer.handle = allocate(bufClass);
+    }
+    if (buffer.handle == NULL) {
+        HWC_LOGE_NODISP("%s:: failed to allocate buffer(%dx%d, format: 0x%8x)",
+                        __func__, bufClass.width, bufClass.height, bufClass.format);
+        return -ENOMEM;
+    }
+
+    Mutex::Autolock lock(mMutex);
+    mClasses[bufClass].allocatedCount++;
+    mAcquiredBuffers[buffer.handle] = bufClass;
+    *outBuffer = buffer.handle;
+
+    HDEBUGLOGD(eDebugBuf, "%s:: new buffer %p (%dx%d, format: 0x%8x, usage: 0x%" PRIx64 ")",
+               __func__, buffer.handle, bufClass.width, bufClass.height,
+               bufClass.format, bufClass.usage);
+    return NO_ERROR;
+}
+
+void ExynosMPPBufferPool::release(buffer_handle_t buffer, int releaseFence,
+                                  const DisplayIdentifier &display, int writeFence) {
+    if (buffer == NULL)
+        return;
+
+    PoolBuffer poolBuffer = {buffer, releaseFence, display, writeFence};
+
+    Mutex::Autolock lock(mMutex);
+    touchLocked();
+
+    if (mFenceTracer.fence_valid(writeFence)) {
+        mWaitBuffers.push_back(poolBuffer);
+        mCondition.signal();
+        return;
+    }
+
+    auto it = mAcquiredBuffers.find(buffer);
+    if (it == mAcquiredBuffers.end()) {
+        ALOGW("%s:: buffer %p is not acquired from the pool", __func__, buffer);
+        mDestroyBuffers.push_back(poolBuffer);
+        mCondition.signal();
+        return;
+    }
+
+    ClassInfo &info = mClasses[it->second];
+    mAcquiredBuffers.erase(it);
+
+    if (info.freeBuffers.size() >= std::max(info.highWatermark, info.lowWatermark)) {
+        info.allocatedCount--;
+        mDestroyBuffers.push_back(poolBuffer);
+        mCondition.signal();
+        return;
+    }
+    info.freeBuffers.push_back(poolBuffer);
+}
+
+void ExynosMPPBufferPool::prewarm(uint32_t width, uint32_t height, uint32_t format, uint64_t usage,
+                                  uint32_t count) {
+    BufferClass bufClass = getBufferClass(width, height, format, usage);
+
+    Mutex::Autolock lock(mMutex);
+    ClassInfo &info = mClasses[bufClass];
+    info.lowWatermark = count;
+
+    if (info.freeBuffers.size() + info.prewarmCount >= count)
+        return;
+
+    info.prewarmCount = count - info.freeBuffers.size();
+    mPrewarmRequested = true;
+    touchLocked();
+    mCondition.signal();
+}
+
+void ExynosMPPBufferPool::flush() {
+    ATRACE_CALL();
+    std::vector<PoolBuffer> buffers;
+    {
+        Mutex::Autolock lock(mMutex);
+        for (auto &it : mClasses) {
+            for (auto &buffer : it.second.freeBuffers)
+                buffers.push_back(buffer);
+            it.second.allocatedCount -= it.second.freeBuffers.size();
+            it.second.freeBuffers.clear();
+        }
+    }
+    destroyBuffers(buffers);
+}
+
+void ExynosMPPBufferPool::trim() {
+    std::vector<PoolBuffer> buffers;
+    {
+        Mutex::Autolock lock(mMutex);
+        trimLocked(buffers);
+    }
+    destroyBuffers(buffers);
+}
+
+uint32_t ExynosMPPBufferPool::getFreeCount(uint32_t width, uint32_t height, uint32_t format,
+                                           uint64_t usage) {
+    Mutex::Autolock lock(mMutex);
+    auto it = mClasses.find(getBufferClass(width, height, format, usage));
+    if (it == mClasses.end())
+        return 0;
+    return it->second.freeBuffers.size();
+}
+
+void ExynosMPPBufferPool::trimLocked(std::vector<PoolBuffer> &buffers) {
+    for (auto &it : mClasses) {
+        ClassInfo &info = it.second;
+        while (info.freeBuffers.size() > info.lowWatermark) {
+            buffers.push_back(info.freeBuffers.front());
+            info.freeBuffers.pop_front();
+            info.allocatedCount--;
+        }
+    }
+}
+
+void ExynosMPPBufferPool::threadLoop() {
+    ALOGI("mppBufferPool threadLoop is started");
+    const nsecs_t idleTimeout = ms2ns(MPP_BUFFER_POOL_IDLE_TIMEOUT_MS);
+
+    Mutex::Autolock lock(mMutex);
+    while (mRunning) {
+        std::vector<PoolBuffer> buffers;
+        std::vector<PoolBuffer> waitBuffers;
+        std::vector<BufferClass> prewarmClasses;
+
+        if (mDestroyBuffers.empty() && mWaitBuffers.empty() && !mPrewarmRequested) {
+            if (mTrimmed) {
+                mCondition.wait(mMutex);
+                continue;
+            }
+            nsecs_t idleTime = systemTime(SYSTEM_TIME_MONOTONIC) - mLastActiveTime;
+            if (idleTime < idleTimeout) {
+                mCondition.waitRelative(mMutex, idleTimeout - idleTime);
+                continue;
+            }
+            trimLocked(buffers);
+            mTrimmed = true;
+        }
+
+        buffers.insert(buffers.end(), mDestroyBuffers.begin(), mDestroyBuffers.end());
+        mDestroyBuffers.clear();
+        waitBuffers.swap(mWaitBuffers);
+
+        if (mPrewarmRequested) {
+            for (auto &it : mClasses) {
+                for (uint32_t i = 0; i < it.second.prewarmCount; i++)
+                    prewarmClasses.push_back(it.first);
+                it.second.prewarmCount = 0;
+            }
+            mPrewarmRequested = false;
+        }
+
+        /* Buffers are allocated and destroyed without the lock */
+        mMutex.unlock();
+
+        for (auto &buffer : waitBuffers) {
+            waitWrite(buffer);
+            release(buffer.handle, buffer.releaseFence, buffer.display);
+        }
+
+        if (!buffers.empty()) {
+            ATRACE_NAME("mppBufferPool: destroy");
+            destroyBuffers(buffers);
+        }
+
+        std::vector<std::pair<BufferClass, buffer_handle_t>> allocated;
+        for (auto &bufClass : prewarmClasses) {
+            ATRACE_NAME("mppBufferPool: prewarm");
+            buffer_handle_t buffer = allocate(bufClass);
+            if (buffer == NULL) {
+                ALOGW("mppBufferPool:: failed to prewarm buffer(%dx%d, format: 0x%8x)",
+                      bufClass.width, bufClass.height, bufClass.format);
+                break;
+            }
+            allocated.push_back(std::make_pair(bufClass, buffer));
+        }
+
+        mMutex.lock();
+
+        for (auto &it : allocated) {
+            ClassInfo &info = mClasses[it.first];
+            info.allocatedCount++;
+            info.freeBuffers.push_back({it.second, -1, DisplayIdentifier()});
+        }
+    }
+    ALOGI("mppBufferPool threadLoop is ended");
+}
+
+void ExynosMPPBufferPool::dump(String8 &result) {
+    Mutex::Autolock lock(mMutex);
+    result.appendFormat("M2M dst buffer pool: classes(%zu), acquired(%zu)\n",
+                        mClasses.size(), mAcquiredBuffers.size());
+    for (auto &it : mClasses) {
+        const BufferClass &bufClass = it.first;
+        const ClassInfo &info = it.second;
+        result.appendFormat("\t%dx%d, format(0x%8x), usage(0x%" PRIx64 "): allocated(%d), free(%zu), "
+                            "watermark(%d, %d), hit(%" PRIu64 "), miss(%" PRIu64 ")\n",
+                            bufClass.width, bufClass.height, bufClass.format, bufClass.usage,
+                            info.allocatedCount, info.freeBuffers.size(),
+                            info.lowWatermark, info.highWatermark, info.hitCount, info.missCount);
+    }
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSMPPBUFFERPOOL_H
+#define _EXYNOSMPPBUFFERPOOL_H
+
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <hardware/hwcomposer2.h>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <map>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ExynosFenceTracer.h"
+
+/* Width and height of a size class are aligned to this */
+#ifndef MPP_BUFFER_POOL_SIZE_ALIGN
+#define MPP_BUFFER_POOL_SIZE_ALIGN 64
+#endif
+
+/* Free buffers of a class more than this are destroyed */
+#ifndef MPP_BUFFER_POOL_HIGH_WATERMARK
+#define MPP_BUFFER_POOL_HIGH_WATERMARK 3
+#endif
+
+/* Number of buffers that are pre-allocated for the display size */
+#ifndef MPP_BUFFER_POOL_PREWARM_COUNT
+#define MPP_BUFFER_POOL_PREWARM_COUNT 3
+#endif
+
+/* Free buffers are trimmed to the low watermark after this idle time */
+#ifndef MPP_BUFFER_POOL_IDLE_TIMEOUT_MS
+#define MPP_BUFFER_POOL_IDLE_TIMEOUT_MS 3000
+#endif
+
+/* Time that the pool thread waits for writeFence of a returned buffer */
+#ifndef MPP_BUFFER_POOL_FENCE_WAIT_MS
+#define MPP_BUFFER_POOL_FENCE_WAIT_MS 1000
+#endif
+
+/*
+ * Destination buffers of M2M MPPs shared by all MPPs of the device.
+ * Buffers are classified by format, aligned size and allocation usage
+ * (protection and compression). Allocation and destruction of buffers
+ * are done by the pool thread except when there is no free buffer
+ * of the requested class.
+ */
+class ExynosMPPBufferPool {
+  public:
+    struct BufferClass {
+        uint32_t width;
+        uint32_t height;
+        uint32_t format;
+        uint64_t usage;
+
+        bool operator<(const BufferClass &rhs) const {
+            if (format != rhs.format)
+                return format < rhs.format;
+            if (usage != rhs.usage)
+                return usage < rhs.usage;
+            if (width != rhs.width)
+                return width < rhs.width;
+            return height < rhs.height;
+        }
+    };
+
+    ExynosMPPBufferPool();
+    ~ExynosMPPBufferPool();
+
+    static BufferClass getBufferClass(uint32_t width, uint32_t height,
+                                      uint32_t format, uint64_t usage);
+
+    /*
+     * Gets a buffer of the class. A free buffer that is not used by
+     * the previous user anymore is preferred. The CPU doesn't wait for
+     * the previous user, the caller takes outFence and the HW should wait
+     * for it before it writes the buffer. outFence is -1 if it is released.
+     */
+    int32_t acquire(uint32_t width, uint32_t height, uint32_t format, uint64_t usage,
+                    buffer_handle_t *outBuffer, int *outFence);
+    /*
+     * Returns the buffer that is acquired from the pool.
+     * The pool takes releaseFence, it should be signaled
+     * when the buffer is neither written nor read.
+     * If writeFence is valid, the pool thread waits for it before
+     * the buffer is given to other users. It is used when both fences
+     * can't be merged into releaseFence.
+     */
+    void release(buffer_handle_t buffer, int releaseFence,
+                 const DisplayIdentifier &display, int writeFence = -1);
+    /*
+     * Sets the low watermark of the class to count and keeps count
+     * free buffers of the class, 0 lets them be trimmed.
+     * Buffers are allocated by the pool thread.
+     */
+    void prewarm(uint32_t width, uint32_t height, uint32_t format, uint64_t usage,
+                 uint32_t count);
+    /* Destroys all of free buffers, it is called when allocation fails */
+    void flush();
+    /* Destroys free buffers over the low watermark, the pool thread does it when idle */
+    void trim();
+    uint32_t getFreeCount(uint32_t width, uint32_t height, uint32_t format, uint64_t usage);
+
+    void registerBufDestoryedCallback(std::function<void(uint64_t)> const &cb) {
+        mBufDestoryedCallback = cb;
+    };
+    void dump(android::String8 &result);
+
+  private:
+    struct PoolBuffer {
+        buffer_handle_t handle;
+        int releaseFence;
+        DisplayIdentifier display;
+        int writeFence = -1;
+    };
+    struct ClassInfo {
+        std::deque<PoolBuffer> freeBuffers;
+        uint32_t lowWatermark = 0;
+        uint32_t highWatermark = MPP_BUFFER_POOL_HIGH_WATERMARK;
+        /* Number of buffers that should be allocated by the pool thread */
+        uint32_t prewarmCount = 0;
+        uint32_t allocatedCount = 0;
+        uint64_t hitCount = 0;
+        uint64_t missCount = 0;
+    };
+
+    buffer_handle_t allocate(const BufferClass &bufClass);
+    void destroy(PoolBuffer &buffer);
+    bool isReleased(const PoolBuffer &buffer);
+    void waitWrite(PoolBuffer &buffer);
+    void destroyBuffers(std::vector<PoolBuffer> &buffers);
+    /* Called with mMutex held */
+    void touchLocked();
+    void trimLocked(std::vector<PoolBuffer> &buffers);
+    void threadLoop();
+
+    ExynosFenceTracer &mFenceTracer = ExynosFenceTracer::getInstance();
+    std::function<void(uint64_t)> mBufDestoryedCallback = nullptr;
+
+    std::map<BufferClass, ClassInfo> mClasses;
+    /* Buffers that are given to MPPs */
+    std::unordered_map<buffer_handle_t, BufferClass> mAcquiredBuffers;
+    /* Buffers that exceed the high watermark */
+    std::vector<PoolBuffer> mDestroyBuffers;
+    /* Returned buffers whose writeFence is waited by the pool thread */
+    std::vector<PoolBuffer> mWaitBuffers;
+    bool mPrewarmRequested = false;
+    nsecs_t mLastActiveTime = 0;
+    bool mTrimmed = true;
+
+    std::thread mThread;
+    android::Condition mCondition;
+    android::Mutex mMutex;
+    bool mRunning = true;
+};
+
+#endif  // _EXYNOSMPPBUFFERPOOL_H
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSSIMINTERFACE_H
+#define _EXYNOSSIMINTERFACE_H
+
+#include "ExynosDeviceInterface.h"
+#include "ExynosDisplayInterface.h"
+
+/*
+ * Interfaces that are used by hwcomposer_simulator instead of
+ * DRM or FB interface. Nothing is delivered to the display driver.
+ */
+class ExynosSimDeviceInterface : public ExynosDeviceInterface {
+  public:
+    ExynosSimDeviceInterface() { mType = INTERFACE_TYPE_NONE; };
+    virtual void init(void *__unused deviceData, size_t &deviceDataSize) { deviceDataSize = 0; };
+    /* Restrictions of ExynosResourceManager tables are used */
+    virtual int32_t getRestrictions(struct dpp_restrictions_info_v2 *&__unused restrictions,
+                                    uint32_t __unused otfMPPSize) { return -EINVAL; };
+};
+
+class ExynosSimDisplayInterface : public ExynosDisplayInterface {
+  public:
+    ExynosSimDisplayInterface(uint32_t xres, uint32_t yres, uint32_t maxWindowNum,
+                              uint32_t vsyncPeriod)
+        : mXres(xres), mYres(yres), mMaxWindowNum(maxWindowNum), mVsyncPeriod(vsyncPeriod) {
+        mType = INTERFACE_TYPE_NONE;
+    };
+
+    virtual int32_t getDisplayConfigs(uint32_t *outNumConfigs, hwc2_config_t *outConfigs,
+                                      std::map<uint32_t, displayConfigs_t> &displayConfigs) {
+        *outNumConfigs = 1;
+        if (outConfigs == NULL)
+            return HWC2_ERROR_NONE;
+
+        outConfigs[0] = 0;
+        displayConfigs_t config;
+        config.vsyncPeriod = mVsyncPeriod;
+        config.width = mXres;
+        config.height = mYres;
+        config.Xdpi = 0;
+        config.Ydpi = 0;
+        config.groupId = 0;
+        displayConfigs[0] = config;
+        return HWC2_ERROR_NONE;
+    };
+    virtual int32_t getDPUConfig(hwc2_config_t *outConfig) {
+        *outConfig = 0;
+        return HWC2_ERROR_NONE;
+    };
+    virtual void getDisplayHWInfo(uint32_t &xres, uint32_t &yres, int __unused &psrMode,
+                                  std::vector<ResolutionInfo> __unused &resolutionInfo) {
+        xres = mXres;
+        yres = mYres;
+    };
+    virtual uint32_t getMaxWindowNum() { return mMaxWindowNum; };
+    virtual uint64_t getWorkingVsyncPeriod() { return mVsyncPeriod; };
+    virtual int32_t deliverWinConfigData(exynos_dpu_data &dpuData) {
+        mDeliveredWinConfigCount++;
+        for (auto &config : dpuData.configs) {
+            if (config.state != config.WIN_STATE_DISABLED)
+                mDeliveredWindowCount++;
+        }
+        return NO_ERROR;
+    };
+
+  public:
+    uint32_t mXres;
+    uint32_t mYres;
+    uint32_t mMaxWindowNum;
+    uint32_t mVsyncPeriod;
+    uint64_t mDeliveredWinConfigCount = 0;
+    uint64_t mDeliveredWindowCount = 0;
+};
+
+#endif  //_EXYNOSSIMINTERFACE_H
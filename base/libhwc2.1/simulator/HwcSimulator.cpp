@@ -0,0 +1,599 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * hwcomposer_simulator replays recorded layer stacks through the resource
+ * assignment of libexynosdisplay without display driver.
+ * It is a vendor executable that runs only on the device, because layer
+ * buffers are allocated with gralloc.
+ *
+ * Trace format (one command per line, '#' starts a comment)
+ *   display <xres> <yres> [vsync period(ns)]
+ *   frame
+ *   layer <composition> <format> <buffer w> <buffer h>
+ *         <crop l> <crop t> <crop r> <crop b>
+ *         <frame l> <frame t> <frame r> <frame b>
+ *         [transform] [blend] [plane alpha] [dataspace]
+ *
+ *   composition : device, client, solid, cursor
+ *   format      : rgba8888, rgbx8888, bgra8888, rgb565, rgba1010102,
+ *                 nv12, nv21, p010 or HAL pixel format number
+ *   blend       : none, premultiplied, coverage
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <hardware/gralloc.h>
+#include <utils/Timers.h>
+
+#include "ExynosDisplay.h"
+#include "ExynosLayer.h"
+#include "ExynosHWCHelper.h"
+#include "ExynosHWCDebug.h"
+#include "ExynosMPP.h"
+#include "ExynosResourceManagerModule.h"
+#include "ExynosPrimaryDisplayModule.h"
+#include "ExynosGraphicBuffer.h"
+#include "ExynosSimInterface.h"
+
+using namespace android;
+using namespace vendor::graphics;
+
+extern struct exynos_hwc_control exynosHWCControl;
+
+#define SIM_DEFAULT_XRES 1080
+#define SIM_DEFAULT_YRES 2400
+#define SIM_DEFAULT_VSYNC_PERIOD 16666666
+
+struct SimLayer {
+    int32_t composition = HWC2_COMPOSITION_DEVICE;
+    int32_t format = HAL_PIXEL_FORMAT_RGBA_8888;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    hwc_frect_t crop = {0, 0, 0, 0};
+    hwc_rect_t frame = {0, 0, 0, 0};
+    int32_t transform = 0;
+    int32_t blend = HWC2_BLEND_MODE_PREMULTIPLIED;
+    float alpha = 1.0f;
+    int32_t dataspace = HAL_DATASPACE_UNKNOWN;
+};
+
+struct SimFrame {
+    std::vector<SimLayer> layers;
+};
+
+struct SimTrace {
+    uint32_t xres = SIM_DEFAULT_XRES;
+    uint32_t yres = SIM_DEFAULT_YRES;
+    uint32_t vsyncPeriod = SIM_DEFAULT_VSYNC_PERIOD;
+    std::vector<SimFrame> frames;
+};
+
+struct SimFrameResult {
+    nsecs_t validateTime = 0;
+    nsecs_t presentTime = 0;
+    uint64_t supportedCheckCount = 0;
+    uint32_t clientFallbackCount = 0;
+    uint32_t deviceCount = 0;
+    uint32_t exynosCount = 0;
+    uint32_t clientCount = 0;
+    float g2dCapacity = 0;
+    bool geometryChanged = false;
+    int32_t validateRet = NO_ERROR;
+};
+
+static bool parseComposition(const std::string &str, int32_t &composition) {
+    static const std::map<std::string, int32_t> table = {
+        {"device", HWC2_COMPOSITION_DEVICE},
+        {"client", HWC2_COMPOSITION_CLIENT},
+        {"solid", HWC2_COMPOSITION_SOLID_COLOR},
+        {"cursor", HWC2_COMPOSITION_CURSOR},
+    };
+    auto it = table.find(str);
+    if (it == table.end())
+        return false;
+    composition = it->second;
+    return true;
+}
+
+static bool parseFormat(const std::string &str, int32_t &format) {
+    static const std::map<std::string, int32_t> table = {
+        {"rgba8888", HAL_PIXEL_FORMAT_RGBA_8888},
+        {"rgbx8888", HAL_PIXEL_FORMAT_RGBX_8888},
+        {"bgra8888", HAL_PIXEL_FORMAT_BGRA_8888},
+        {"rgb565", HAL_PIXEL_FORMAT_RGB_565},
+        {"rgba1010102", HAL_PIXEL_FORMAT_RGBA_1010102},
+        {"nv12", HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M},
+        {"nv21", HAL_PIXEL_FORMAT_YCrCb_420_SP},
+        {"p010", HAL_PIXEL_FORMAT_YCBCR_P010},
+    };
+    auto it = table.find(str);
+    if (it != table.end()) {
+        format = it->second;
+        return true;
+    }
+    char *end = nullptr;
+    format = (int32_t)strtol(str.c_str(), &end, 0);
+    return (end != nullptr) && (*end == '\0');
+}
+
+static bool parseBlend(const std::string &str, int32_t &blend) {
+    static const std::map<std::string, int32_t> table = {
+        {"none", HWC2_BLEND_MODE_NONE},
+        {"premultiplied", HWC2_BLEND_MODE_PREMULTIPLIED},
+        {"coverage", HWC2_BLEND_MODE_COVERAGE},
+    };
+    auto it = table.find(str);
+    if (it == table.end())
+        return false;
+    blend = it->second;
+    return true;
+}
+
+static bool parseLayer(std::istringstream &in, SimLayer &layer) {
+    std::string composition, format, blend;
+    if (!(in >> composition >> format >> layer.width >> layer.height >>
+          layer.crop.left >> layer.crop.top >> layer.crop.right >> layer.crop.bottom >>
+          layer.frame.left >> layer.frame.top >> layer.frame.right >> layer.frame.bottom))
+        return false;
+    if (!parseComposition(composition, layer.composition) ||
+        !parseFormat(format, layer.format))
+        return false;
+
+    /* Optional fields */
+    if (!(in >> layer.transform))
+        return true;
+    if (!(in >> blend))
+        return true;
+    if (!parseBlend(blend, layer.blend))
+        return false;
+    if (!(in >> layer.alpha))
+        return true;
+    in >> layer.dataspace;
+    return true;
+}
+
+static int32_t loadTrace(const char *path, SimTrace &trace) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        fprintf(stderr, "Fail to open trace %s\n", path);
+        return -ENOENT;
+    }
+
+    std::string line;
+    uint32_t lineNum = 0;
+    while (std::getline(file, line)) {
+        lineNum++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+
+        std::istringstream in(line);
+        std::string cmd;
+        if (!(in >> cmd))
+            continue;
+
+        if (cmd == "display") {
+            if (!(in >> trace.xres >> trace.yres)) {
+                fprintf(stderr, "%s:%d invalid display command\n", path, lineNum);
+                return -EINVAL;
+            }
+            in >> trace.vsyncPeriod;
+        } else if (cmd == "frame") {
+            trace.frames.emplace_back();
+        } else if (cmd == "layer") {
+            SimLayer layer;
+            if (trace.frames.empty() || !parseLayer(in, layer)) {
+                fprintf(stderr, "%s:%d invalid layer command\n", path, lineNum);
+                return -EINVAL;
+            }
+            trace.frames.back().layers.push_back(layer);
+        } else {
+            fprintf(stderr, "%s:%d unknown command %s\n", path, lineNum, cmd.c_str());
+            return -EINVAL;
+        }
+    }
+
+    if (trace.frames.empty()) {
+        fprintf(stderr, "There is no frame in %s\n", path);
+        return -EINVAL;
+    }
+    return NO_ERROR;
+}
+
+class HwcSimulator {
+  public:
+    ~HwcSimulator();
+    int32_t init(const SimTrace &trace);
+    int32_t runFrame(const SimFrame &frame, SimFrameResult &result);
+    float getG2dCapacityLimit() { return mResourceManager->getM2MCapa(MPP_G2D); };
+    void dumpCompositionPlanner(String8 &result) { mResourceManager->dumpCompositionPlanner(result); };
+
+  private:
+    buffer_handle_t getBuffer(uint32_t w, uint32_t h, int32_t format);
+    void setLayers(const SimFrame &frame, uint64_t &geometryFlag);
+    int32_t validate(uint64_t &geometryFlag);
+    uint64_t getSupportedCheckCount();
+
+    ExynosResourceManager *mResourceManager = nullptr;
+    ExynosDisplay *mDisplay = nullptr;
+    std::vector<hwc2_layer_t> mLayers;
+    std::map<std::tuple<uint32_t, uint32_t, int32_t>, buffer_handle_t> mBuffers;
+    buffer_handle_t mClientTarget = nullptr;
+};
+
+HwcSimulator::~HwcSimulator() {
+    if (mDisplay != nullptr) {
+        mDisplay->destroyLayers();
+        delete mDisplay;
+    }
+    delete mResourceManager;
+
+    ExynosGraphicBufferAllocator &gAllocator(ExynosGraphicBufferAllocator::get());
+    for (auto &it : mBuffers)
+        gAllocator.free(it.second);
+}
+
+buffer_handle_t HwcSimulator::getBuffer(uint32_t w, uint32_t h, int32_t format) {
+    auto key = std::make_tuple(w, h, format);
+    auto it = mBuffers.find(key);
+    if (it != mBuffers.end())
+        return it->second;
+
+    ExynosGraphicBufferAllocator &gAllocator(ExynosGraphicBufferAllocator::get());
+    buffer_handle_t buffer = nullptr;
+    uint32_t stride = 0;
+    if ((gAllocator.allocate(w, h, format, 1,
+                             GRALLOC_USAGE_HW_COMPOSER | GRALLOC_USAGE_HW_TEXTURE,
+                             &buffer, &stride, "hwcomposer_simulator") != NO_ERROR) ||
+        (buffer == nullptr)) {
+        fprintf(stderr, "Fail to allocate buffer (%dx%d, format: 0x%x)\n", w, h, format);
+        return nullptr;
+    }
+    mBuffers[key] = buffer;
+    return buffer;
+}
+
+int32_t HwcSimulator::init(const SimTrace &trace) {
+    /* It is done by ExynosDevice on the target */
+    PredefinedFormat::init();
+    ExynosMPP::initDefaultMppFormats();
+    exynosHWCControl.windowUpdate = false;
+    exynosHWCControl.skipResourceAssign = true;
+    exynosHWCControl.skipWinConfig = true;
+    exynosHWCControl.displayMode = DISPLAY_MODE_NUM;
+    ExynosMPP::mainDisplayWidth = trace.xres;
+    ExynosMPP::mainDisplayHeight = trace.yres;
+
+    mResourceManager = new ExynosResourceManagerModule();
+
+    /* M2M MPPs don't access the device */
+    for (uint32_t i = 0; i < mResourceManager->getM2mMPPSize(); i++) {
+        ExynosMPP *mpp = mResourceManager->getM2mMPP(i);
+        delete mpp->mAcrylicHandle;
+        mpp->mAcrylicHandle = AcrylicFactory::createAcrylic("dummy");
+    }
+
+    DisplayIdentifier node = {getDisplayId(HWC_DISPLAY_PRIMARY, 0), HWC_DISPLAY_PRIMARY, 0,
+                              String8("PrimaryDisplay"), String8("sim_decon")};
+    mDisplay = new ExynosPrimaryDisplayModule(node);
+    mDisplay->mPlugState = true;
+
+    android::Vector<ExynosDisplay *> displays;
+    std::map<uint32_t, ExynosDisplay *> displayMap;
+    displays.add(mDisplay);
+    displayMap.insert(std::make_pair(mDisplay->mDisplayId, mDisplay));
+
+    uint32_t maxWindowNum = mResourceManager->getOtfMPPSize() - mResourceManager->mVirtualMPPNum;
+    mDisplay->mDisplayInterface =
+        std::make_unique<ExynosSimDisplayInterface>(trace.xres, trace.yres, maxWindowNum,
+                                                    trace.vsyncPeriod);
+    mDisplay->mDisplayInterface->init(mDisplay->mDisplayInfo.displayIdentifier, nullptr, 0);
+
+    /* Same order with ExynosDevice::registerRestrictions() */
+    ExynosSimDeviceInterface deviceInterface;
+    struct dpp_restrictions_info_v2 *restrictions = nullptr;
+    if (deviceInterface.getRestrictions(restrictions, mResourceManager->getOtfMPPSize() + 1) == NO_ERROR) {
+        mResourceManager->makeDPURestrictions(restrictions, true);
+        mResourceManager->updateFeatureTable(restrictions);
+        mResourceManager->makeM2MRestrictions();
+    } else {
+        mResourceManager->updateRestrictions();
+    }
+    mResourceManager->updateMPPFeature(true);
+    mResourceManager->setVirtualOtfMPPsRestrictions();
+    mResourceManager->updateCapabilityTables();
+    mResourceManager->checkAttrMPP(mDisplay);
+    mResourceManager->updateSupportWCG();
+
+    mDisplay->init(maxWindowNum, mResourceManager->getExynosMPPForBlending(mDisplay));
+    mResourceManager->initDisplays(displays, displayMap);
+    if (mResourceManager->doPreProcessing() != NO_ERROR)
+        fprintf(stderr, "ExynosResourceManager::doPreProcessing fail\n");
+
+    uint64_t geometryFlag = 0;
+    mDisplay->setPowerMode(HWC2_POWER_MODE_ON, geometryFlag);
+
+    mClientTarget = getBuffer(trace.xres, trace.yres, HAL_PIXEL_FORMAT_RGBA_8888);
+    if (mClientTarget == nullptr)
+        return -ENOMEM;
+
+    return NO_ERROR;
+}
+
+void HwcSimulator::setLayers(const SimFrame &frame, uint64_t &geometryFlag) {
+    while (mLayers.size() > frame.layers.size()) {
+        mDisplay->destroyLayer(mLayers.back(), geometryFlag);
+        mLayers.pop_back();
+    }
+    while (mLayers.size() < frame.layers.size()) {
+        hwc2_layer_t layer;
+        mDisplay->createLayer(&layer, geometryFlag);
+        mLayers.push_back(layer);
+    }
+
+    for (size_t i = 0; i < frame.layers.size(); i++) {
+        const SimLayer &simLayer = frame.layers[i];
+        ExynosLayer *layer = mDisplay->checkLayer(mLayers[i]);
+        if (layer == nullptr)
+            continue;
+
+        buffer_handle_t buffer = nullptr;
+        if (simLayer.composition != HWC2_COMPOSITION_SOLID_COLOR)
+            buffer = getBuffer(simLayer.width, simLayer.height, simLayer.format);
+
+        layer->setLayerCompositionType(simLayer.composition, geometryFlag);
+        layer->setLayerBuffer(buffer, -1, geometryFlag);
+        layer->setLayerSourceCrop(simLayer.crop, geometryFlag);
+        layer->setLayerDisplayFrame(simLayer.frame, geometryFlag);
+        layer->setLayerTransform(simLayer.transform, geometryFlag);
+        layer->setLayerBlendMode(simLayer.blend, geometryFlag);
+        layer->setLayerPlaneAlpha(simLayer.alpha);
+        layer->setLayerDataspace(simLayer.dataspace, geometryFlag);
+        layer->setLayerZOrder(i, geometryFlag);
+    }
+
+    mDisplay->setClientTarget(mClientTarget, -1, HAL_DATASPACE_UNKNOWN, geometryFlag);
+}
+
+/* Stages of ExynosDevice::validateAllDisplays() for one display */
+int32_t HwcSimulator::validate(uint64_t &geometryFlag) {
+    int32_t ret = NO_ERROR;
+    DeviceValidateInfo validateInfo;
+
+    ExynosResourceManager::applyEnableMPPRequests();
+    mDisplay->mNeedSkipValidatePresent = false;
+    mDisplay->preProcessValidate(validateInfo, geometryFlag);
+
+    if ((ret = mResourceManager->checkExceptionScenario(geometryFlag)) != NO_ERROR)
+        fprintf(stderr, "checkExceptionScenario error ret(%d)\n", ret);
+
+    if (geometryFlag) {
+        if ((ret = mResourceManager->prepareResources()) != NO_ERROR)
+            return ret;
+        if (!mDisplay->mIsSkipFrame)
+            ret = mResourceManager->assignResource(mDisplay);
+    }
+
+    if (ret == NO_ERROR)
+        ret = mResourceManager->deliverPerformanceInfo(mDisplay);
+    if (ret == NO_ERROR)
+        ret = mDisplay->postProcessValidate();
+
+    if (ret != NO_ERROR) {
+        mDisplay->setGeometryChanged(GEOMETRY_ERROR_CASE, geometryFlag);
+        mDisplay->setForceClient();
+        mResourceManager->resetAssignedResources(mDisplay, true);
+        mResourceManager->assignCompositionTarget(mDisplay, COMPOSITION_CLIENT);
+        mResourceManager->assignWindow(mDisplay);
+    }
+
+    uint32_t outNumTypes = 0;
+    uint32_t outNumRequests = 0;
+    mDisplay->setValidateState(outNumTypes, outNumRequests, geometryFlag);
+
+    return ret;
+}
+
+uint64_t HwcSimulator::getSupportedCheckCount() {
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < mResourceManager->getOtfMPPSize(); i++)
+        count += mResourceManager->getOtfMPP(i)->mSupportedCheckCount;
+    for (uint32_t i = 0; i < mResourceManager->getM2mMPPSize(); i++)
+        count += mResourceManager->getM2mMPP(i)->mSupportedCheckCount;
+    return count;
+}
+
+int32_t HwcSimulator::runFrame(const SimFrame &frame, SimFrameResult &result) {
+    uint64_t geometryFlag = 0;
+    setLayers(frame, geometryFlag);
+    result.geometryChanged = (geometryFlag != 0);
+
+    uint64_t supportedCheckCount = getSupportedCheckCount();
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    result.validateRet = validate(geometryFlag);
+    result.validateTime = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    result.supportedCheckCount = getSupportedCheckCount() - supportedCheckCount;
+
+    for (uint32_t i = 0; i < mDisplay->mLayers.size(); i++) {
+        ExynosLayer *layer = mDisplay->mLayers[i];
+        switch (layer->mValidateCompositionType) {
+        case HWC2_COMPOSITION_CLIENT:
+            result.clientCount++;
+            if (layer->mCompositionType != HWC2_COMPOSITION_CLIENT)
+                result.clientFallbackCount++;
+            break;
+        case HWC2_COMPOSITION_EXYNOS:
+            result.exynosCount++;
+            break;
+        default:
+            result.deviceCount++;
+            break;
+        }
+    }
+    result.g2dCapacity = mResourceManager->getAssignedCapacity(MPP_G2D);
+
+    mDisplay->acceptDisplayChanges();
+
+    DevicePresentInfo presentInfo;
+    int32_t presentFence = -1;
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
+    mDisplay->presentDisplay(presentInfo, &presentFence);
+    result.presentTime = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    if (presentFence >= 0)
+        close(presentFence);
+
+    for (uint32_t i = 0; i < mDisplay->mLayers.size(); i++) {
+        ExynosLayer *layer = mDisplay->mLayers[i];
+        if (layer->mReleaseFence >= 0) {
+            close(layer->mReleaseFence);
+            layer->mReleaseFence = -1;
+        }
+    }
+
+    return result.validateRet;
+}
+
+static nsecs_t getPercentile(std::vector<nsecs_t> times, uint32_t percent) {
+    if (times.empty())
+        return 0;
+    std::sort(times.begin(), times.end());
+    size_t index = (times.size() - 1) * percent / 100;
+    return times[index];
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-l loop count] [-p planner budget] [-v] <trace file>\n", name);
+    fprintf(stderr, "  -l : replay the trace N times (default 1)\n");
+    fprintf(stderr, "  -p : use composition planner with time budget in usec (1: default budget)\n");
+    fprintf(stderr, "  -v : print result of every frame\n");
+}
+
+int main(int argc, char **argv) {
+    uint32_t loopCount = 1;
+    uint32_t plannerBudget = 0;
+    bool verbose = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "l:p:vh")) != -1) {
+        switch (opt) {
+        case 'l':
+            loopCount = (uint32_t)atoi(optarg);
+            break;
+        case 'p':
+            plannerBudget = (uint32_t)atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if ((optind >= argc) || (loopCount == 0)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    SimTrace trace;
+    if (loadTrace(argv[optind], trace) != NO_ERROR)
+        return EXIT_FAILURE;
+
+    HwcSimulator simulator;
+    if (simulator.init(trace) != NO_ERROR) {
+        fprintf(stderr, "Fail to initialize simulator\n");
+        return EXIT_FAILURE;
+    }
+    exynosHWCControl.compositionPlanner = plannerBudget;
+
+    std::vector<nsecs_t> validateTimes;
+    std::vector<nsecs_t> presentTimes;
+    uint64_t totalSupportedCheckCount = 0;
+    uint64_t totalClientFallbackCount = 0;
+    uint64_t totalLayerCount = 0;
+    uint32_t geometryChangedCount = 0;
+    uint32_t validateFailCount = 0;
+    float maxG2dCapacity = 0;
+
+    if (verbose)
+        printf("frame,geometry,validate_us,present_us,is_supported,device,exynos,client,client_fallback,g2d_capa\n");
+
+    uint32_t frameIndex = 0;
+    for (uint32_t loop = 0; loop < loopCount; loop++) {
+        for (auto &frame : trace.frames) {
+            SimFrameResult result;
+            if (simulator.runFrame(frame, result) != NO_ERROR)
+                validateFailCount++;
+
+            validateTimes.push_back(result.validateTime);
+            presentTimes.push_back(result.presentTime);
+            totalSupportedCheckCount += result.supportedCheckCount;
+            totalClientFallbackCount += result.clientFallbackCount;
+            totalLayerCount += frame.layers.size();
+            if (result.geometryChanged)
+                geometryChangedCount++;
+            maxG2dCapacity = std::max(maxG2dCapacity, result.g2dCapacity);
+
+            if (verbose)
+                printf("%u,%d,%.1f,%.1f,%" PRIu64 ",%u,%u,%u,%u,%.2f\n",
+                       frameIndex, result.geometryChanged,
+                       result.validateTime / 1000.0f, result.presentTime / 1000.0f,
+                       result.supportedCheckCount, result.deviceCount, result.exynosCount,
+                       result.clientCount, result.clientFallbackCount, result.g2dCapacity);
+            frameIndex++;
+        }
+    }
+
+    nsecs_t totalValidateTime = 0;
+    for (auto time : validateTimes)
+        totalValidateTime += time;
+
+    printf("frames: %u (geometry changed: %u, validate fail: %u)\n",
+           frameIndex, geometryChangedCount, validateFailCount);
+    printf("validate(us): avg %.1f, p50 %.1f, p95 %.1f, p99 %.1f, max %.1f\n",
+           (totalValidateTime / 1000.0f) / frameIndex,
+           getPercentile(validateTimes, 50) / 1000.0f,
+           getPercentile(validateTimes, 95) / 1000.0f,
+           getPercentile(validateTimes, 99) / 1000.0f,
+           getPercentile(validateTimes, 100) / 1000.0f);
+    printf("present(us): p50 %.1f, p95 %.1f, max %.1f\n",
+           getPercentile(presentTimes, 50) / 1000.0f,
+           getPercentile(presentTimes, 95) / 1000.0f,
+           getPercentile(presentTimes, 100) / 1000.0f);
+    printf("isSupported() calls: %" PRIu64 " (%.1f per frame)\n",
+           totalSupportedCheckCount, (float)totalSupportedCheckCount / frameIndex);
+    printf("client fallback layers: %" PRIu64 " / %" PRIu64 "\n",
+           totalClientFallbackCount, totalLayerCount);
+    printf("max G2D capacity: %.2f / %.2f\n", maxG2dCapacity, simulator.getG2dCapacityLimit());
+    if (plannerBudget != 0) {
+        String8 plannerResult;
+        simulator.dumpCompositionPlanner(plannerResult);
+        printf("%s", plannerResult.string());
+    }
+
+    return (validateFailCount == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -34,7 +34,11 @@
 
 #include "ExynosDisplayInterface.h"
 #include "ExynosHWCService.h"
+#include "HalImpl.h"
+#include "LatencyHistogram.h"
 
+#include <fcntl.h>
+#include <float.h>
 #include <sys/types.h>
 #include <drm_fourcc.h>
 #include <xf86drm.h>
@@ -46,11 +50,17 @@
 #include "ExynosGraphicBuffer.h"
 
 #include "OneShotTimer.h"
+#include "WorkerPool.h"
 
 #include "TraceUtils.h"
 
+#include "drmcrtc.h"
+#include "drmconnector.h"
 #include "drmdevice.h"
+#include "drmfakebackend.h"
+#include "drmplane.h"
 #include "resourcemanager.h"
+#include "vsyncpredictor.h"
 
 #include "ui/GraphicBuffer.h"
 
@@ -104,6 +114,25 @@ TEST_F(HwcUnitTest, Destructor_ExynosSortedLayer) {
     delete tmp;
 }
 
+TEST_F(HwcUnitTest, ExynosSortedLayer_contains) {
+    ExynosSortedLayer layers;
+    ExynosLayer *layer0 = (ExynosLayer *)0x1000;
+    ExynosLayer *layer1 = (ExynosLayer *)0x2000;
+
+    layers.add(layer0);
+    layers.add(layer1);
+    EXPECT_TRUE(layers.contains(layer0));
+    EXPECT_TRUE(layers.contains(layer1));
+
+    EXPECT_EQ(layers.remove(layer0), 0);
+    EXPECT_FALSE(layers.contains(layer0));
+    EXPECT_EQ(layers.remove(layer0), -1);
+    EXPECT_EQ(layers.size(), 1u);
+
+    layers.clear();
+    EXPECT_FALSE(layers.contains(layer1));
+}
+
 TEST_F(HwcUnitTest, Destructor_ExynosDisplayDrmInterface) {
     ExynosDisplayInterface* tmp = new ExynosDisplayDrmInterface();
     delete tmp;
@@ -139,6 +168,54 @@ TEST_F(HwcUnitTest, Destructor_ExynosMPP) {
     delete tmp;
 }
 
+TEST_F(HwcUnitTest, ExynosMPP_FormatCapaTable) {
+    ExynosMPP* mpp = new ExynosMPP(MPP_DPP_G, MPP_LOGICAL_DPP_G, "DPP_G0", 0, 0,
+                                   HWC_DISPLAY_PRIMARY_BIT, MPP_TYPE_OTF);
+    exynos_image img;
+    img.exynosFormat = HAL_PIXEL_FORMAT_RGBA_8888;
+    EXPECT_FALSE(mpp->isSrcFormatSupported(img));
+
+    mpp->addFormatRestrictions({MPP_DPP_G, NODE_SRC, HAL_PIXEL_FORMAT_RGBA_8888, 0});
+    EXPECT_TRUE(mpp->isSrcFormatSupported(img));
+    EXPECT_FALSE(mpp->isDstFormatSupported(img));
+
+    /* Queries before the rebuild are compiled from the restrictions */
+    mpp->addFormatRestrictions({MPP_DPP_G, NODE_NONE, HAL_PIXEL_FORMAT_RGBA_8888, 0});
+    EXPECT_FALSE(mpp->isCapabilityTableValid());
+    EXPECT_TRUE(mpp->isDstFormatSupported(img));
+    mpp->updateCapabilityTable();
+    EXPECT_TRUE(mpp->isCapabilityTableValid());
+    EXPECT_TRUE(mpp->isDstFormatSupported(img));
+
+    img.exynosFormat = HAL_PIXEL_FORMAT_RGB_565;
+    EXPECT_FALSE(mpp->isSrcFormatSupported(img));
+    delete mpp;
+}
+
+TEST_F(HwcUnitTest, ExynosMPP_TransformCapaTable) {
+    ExynosMPP* mpp = new ExynosMPP(MPP_G2D, MPP_LOGICAL_G2D_RGB, "G2D0", 0, 0,
+                                   HWC_DISPLAY_PRIMARY_BIT, MPP_TYPE_M2M);
+    exynos_image img;
+    img.exynosFormat = HAL_PIXEL_FORMAT_RGBA_8888;
+
+    mpp->mAttr = MPP_ATTR_FLIP_H | MPP_ATTR_FLIP_V;
+    mpp->updateCapabilityTable();
+    img.transform = HAL_TRANSFORM_ROT_180;
+    EXPECT_TRUE(mpp->isSupportedTransform(img));
+    img.transform = HAL_TRANSFORM_ROT_90;
+    EXPECT_FALSE(mpp->isSupportedTransform(img));
+
+    /* Attribute that is changed after the table is compiled is not ignored */
+    mpp->mAttr |= MPP_ATTR_ROT_90;
+    EXPECT_TRUE(mpp->isSupportedTransform(img));
+    mpp->updateCapabilityTable();
+    img.transform = HAL_TRANSFORM_ROT_270;
+    EXPECT_TRUE(mpp->isSupportedTransform(img));
+    mpp->mAttr &= ~MPP_ATTR_FLIP_V;
+    EXPECT_FALSE(mpp->isSupportedTransform(img));
+    delete mpp;
+}
+
 TEST_F(HwcUnitTest, Destructor_ExynosFenceTracer) {
     ExynosFenceTracer* tmp = new ExynosFenceTracer();
     delete tmp;
@@ -347,6 +424,384 @@ TEST_F(HwcUnitTest, ExynosDisplayDrmInterface) {
     delete tmp;
 }
 
+TEST_F(HwcUnitTest, ExynosDisplayDrmInterface_PlaneShadow) {
+    ExynosDisplayDrmInterface::PlaneShadow shadow;
+
+    /* Staged value is not committed until apply() */
+    shadow.stage(10, 1, 100);
+    shadow.stage(10, 2, 200);
+    shadow.stage(11, 1, 300);
+    EXPECT_FALSE(shadow.isCommitted(10, 1, 100));
+    shadow.apply();
+    EXPECT_TRUE(shadow.isCommitted(10, 1, 100));
+    EXPECT_TRUE(shadow.isCommitted(10, 2, 200));
+    EXPECT_FALSE(shadow.isCommitted(10, 2, 201));
+    EXPECT_FALSE(shadow.isCommitted(10, 3, 0));
+
+    /* Only changed value is staged for the next commit */
+    shadow.stage(10, 2, 201);
+    shadow.apply();
+    EXPECT_TRUE(shadow.isCommitted(10, 1, 100));
+    EXPECT_TRUE(shadow.isCommitted(10, 2, 201));
+
+    /* Disabled plane */
+    shadow.invalidate(10);
+    EXPECT_FALSE(shadow.isCommitted(10, 1, 100));
+    EXPECT_TRUE(shadow.isCommitted(11, 1, 300));
+
+    /* Commit failure */
+    shadow.stage(11, 2, 400);
+    shadow.invalidate();
+    shadow.apply();
+    EXPECT_FALSE(shadow.isCommitted(11, 1, 300));
+    EXPECT_FALSE(shadow.isCommitted(11, 2, 400));
+}
+
+TEST_F(HwcUnitTest, DrmDevice_FakeDrmBackend) {
+    android::FakeDrmBackend fake;
+    fake.SetVBlank(ms2ns(5), us2ns(500));
+    fake.SetCommitLatency(ms2ns(1));
+    uint32_t connectorId = fake.AddDisplay(1080, 2400, 60, 4);
+    android::DrmBackend::SetInstance(&fake);
+
+    android::DrmDevice *drm = new android::DrmDevice();
+    int ret, displays;
+    std::tie(ret, displays) = drm->Init("/dev/dri/card0", 0);
+    EXPECT_EQ(ret, 0);
+    EXPECT_EQ(displays, 1);
+    EXPECT_EQ(drm->planes().size(), 4u);
+
+    android::DrmCrtc *crtc = drm->GetCrtcForDisplay(0);
+    android::DrmPlane *plane = drm->planes()[0].get();
+    ASSERT_NE(crtc, nullptr);
+
+    /* Nonblocking commit returns an out-fence that is signaled on the vblank */
+    int64_t outFence = -1;
+    android::DrmAtomicRequest req;
+    req.AddProperty(plane->id(), plane->zpos_property().id(), 1);
+    req.AddProperty(crtc->id(), crtc->out_fence_ptr_property().id(), (uint64_t)&outFence);
+    EXPECT_EQ(drm->backend().AtomicCommit(drm->fd(), req, DRM_MODE_ATOMIC_NONBLOCK, nullptr), 0);
+    EXPECT_EQ(drm->backend().AtomicCommit(drm->fd(), req, DRM_MODE_ATOMIC_NONBLOCK, nullptr),
+              -EBUSY);
+    EXPECT_EQ(fake.WaitIdle(ms2ns(100)), 0);
+    EXPECT_GE((int32_t)outFence, 0);
+    close((int32_t)outFence);
+
+    android::FakeDrmBackend::CommitStats stats = fake.GetCommitStats();
+    EXPECT_EQ(stats.commits, 1u);
+    EXPECT_EQ(stats.last_properties, 2u);
+    uint64_t zpos = 0;
+    EXPECT_EQ(fake.GetPropertyValue(plane->id(), "zpos", &zpos), 0);
+    EXPECT_EQ(zpos, 1u);
+
+    /* Injected failure */
+    fake.FailNextCommits(1, -EIO);
+    EXPECT_EQ(drm->backend().AtomicCommit(drm->fd(), req, 0, nullptr), -EIO);
+
+    /* Hotplug */
+    android::DrmConnector *connector = drm->GetConnectorForDisplay(0);
+    ASSERT_NE(connector, nullptr);
+    EXPECT_EQ(fake.InjectHotplug(connectorId, false), 0);
+    connector->UpdateModes();
+    EXPECT_EQ(connector->state(), DRM_MODE_DISCONNECTED);
+
+    delete drm;
+    android::DrmBackend::SetInstance(nullptr);
+}
+
+TEST_F(HwcUnitTest, VSyncPredictor_fit) {
+    android::VSyncPredictor predictor;
+    EXPECT_EQ(predictor.PredictNextVSync(1000), 0);
+
+    /* Panel runs slightly faster than the nominal 60Hz with some jitter */
+    const int64_t period = 16600000;
+    const int64_t start = s2ns(1);
+    predictor.SetPeriod(16666667);
+    EXPECT_EQ(predictor.PredictNextVSync(start), start + 16666667);
+    for (int64_t i = 0; i < 30; i++)
+        predictor.AddTimestamp(start + i * period + ((i % 2) ? 50000 : -50000));
+    EXPECT_TRUE(predictor.HasModel());
+    EXPECT_NEAR(predictor.period(), period, 20000);
+    int64_t next = start + 30 * period;
+    EXPECT_NEAR(predictor.PredictNextVSync(next - ms2ns(5)), next, 100000);
+    /* A late timestamp is rejected */
+    EXPECT_FALSE(predictor.AddTimestamp(next + ms2ns(6)));
+    EXPECT_EQ(predictor.GetStats().outliers, 1u);
+
+    /* Mode switch restarts on the nominal period */
+    predictor.SetPeriod(8333333);
+    EXPECT_FALSE(predictor.HasModel());
+    EXPECT_EQ(predictor.period(), 8333333);
+    EXPECT_EQ(predictor.GetStats().resets, 1u);
+    for (int64_t i = 0; i < 10; i++)
+        predictor.AddTimestamp(next + i * 8333333);
+    EXPECT_TRUE(predictor.HasModel());
+    EXPECT_NEAR(predictor.PredictNextVSync(next + 9 * 8333333 + 1), next + 10 * 8333333, 1000);
+}
+
+TEST_F(HwcUnitTest, VSyncPredictor_stale) {
+    android::VSyncPredictor predictor;
+    const int64_t period = 16666667;
+    const int64_t start = s2ns(1);
+    predictor.SetPeriod(period);
+    for (int64_t i = 0; i < 10; i++)
+        predictor.AddTimestamp(start + i * period + us2ns(100));
+    EXPECT_TRUE(predictor.HasModel());
+    int64_t last = start + 9 * period + us2ns(100);
+    EXPECT_NEAR(predictor.PredictNextVSync(last + 2 * period + ms2ns(1)), last + 3 * period, 1000);
+
+    /* Long after the last timestamp, one nominal period from the time */
+    int64_t later = last + 20 * period + ms2ns(3);
+    EXPECT_EQ(predictor.PredictNextVSync(later), later + period);
+
+    /* A timestamp after the gap restarts the model */
+    EXPECT_TRUE(predictor.AddTimestamp(later));
+    EXPECT_FALSE(predictor.HasModel());
+    EXPECT_EQ(predictor.GetStats().resets, 1u);
+    EXPECT_EQ(predictor.PredictNextVSync(later + ms2ns(1)), later + period);
+}
+
+/* Vsync model of the display interface on a fixed timeline */
+class VsyncModelInterface : public ExynosDisplayInterface {
+  public:
+    virtual int64_t predictNextVsync(int64_t time) {
+        if (mPeriod == 0)
+            return 0;
+        return mBase + ((time - mBase) / mPeriod + 1) * mPeriod;
+    };
+    virtual int64_t getPredictedVsyncPeriod() { return mPeriod; };
+    int64_t mBase = 0;
+    int64_t mPeriod = 0;
+};
+
+TEST_F(HwcUnitTest, ExynosDisplay_predictNextVsync) {
+    uint32_t id = getDisplayId(HWC_DISPLAY_PRIMARY, 0);
+    DisplayIdentifier node = {id, HWC_DISPLAY_PRIMARY, 0,
+                              String8("PrimaryDisplay"),
+                              String8("fake_decon_fb")};
+    ExynosDisplay *display = new ExynosDisplay(node);
+    VsyncModelInterface *model = new VsyncModelInterface();
+    display->mDisplayInterface.reset(model);
+    display->mVsyncPeriod = 16666667;
+    int32_t duration = model->getConfigChangeDuration();
+    int64_t appliedTime, refreshTime;
+
+    /* Without the model, on the nominal period */
+    EXPECT_EQ(display->predictNextVsync(ms2ns(100)), ms2ns(100) + 16666667);
+    EXPECT_EQ(display->getConfigAppliedTime(ms2ns(150), ms2ns(100), appliedTime, refreshTime),
+              NO_ERROR);
+    EXPECT_EQ(appliedTime, ms2ns(100) + 3 * 16666667);
+    EXPECT_EQ(refreshTime, appliedTime - duration * 16666667);
+
+    /* Panel runs slightly faster than the nominal period */
+    model->mBase = ms2ns(95);
+    model->mPeriod = 16600000;
+    EXPECT_EQ(display->predictNextVsync(ms2ns(100)), ms2ns(95) + 16600000);
+    EXPECT_EQ(display->getConfigAppliedTime(ms2ns(150), ms2ns(100), appliedTime, refreshTime),
+              NO_ERROR);
+    EXPECT_EQ(appliedTime, ms2ns(100) + 4 * 16600000);
+    EXPECT_EQ(refreshTime, appliedTime - duration * 16600000);
+
+    delete display;
+}
+
+class NullVsyncHandler : public ExynosVsyncHandler {
+  public:
+    virtual void handleVsync(uint64_t __unused timestamp){};
+};
+
+TEST_F(HwcUnitTest, ExynosDisplayDrmInterface_getVsyncAppliedTime) {
+    android::FakeDrmBackend fake;
+    fake.SetVBlank(16666667, 0);
+    fake.AddDisplay(1080, 2400, 60, 4);
+    android::DrmBackend::SetInstance(&fake);
+
+    android::DrmDevice *drm = new android::DrmDevice();
+    int ret, displays;
+    std::tie(ret, displays) = drm->Init("/dev/dri/card0", 0);
+    EXPECT_EQ(ret, 0);
+
+    /* The active mode sets the nominal period of the vsync model */
+    NullVsyncHandler handler;
+    ExynosDisplayDrmInterface *interface = new ExynosDisplayDrmInterface();
+    interface->registerVsyncHandler(&handler);
+    interface->initDrmDevice(drm, 0);
+    const int64_t nominal = nsecsPerSec / 60;
+    const int32_t duration = interface->getConfigChangeDuration();
+
+    /* Transient frames run with the period of the new config */
+    displayConfigs_t config = {};
+    config.vsyncPeriod = 8333333;
+    int64_t changeTime = 0;
+    int64_t before = systemTime(SYSTEM_TIME_MONOTONIC);
+    EXPECT_EQ(interface->getVsyncAppliedTime(0, config, &changeTime), HWC2_ERROR_NONE);
+    int64_t after = systemTime(SYSTEM_TIME_MONOTONIC);
+    EXPECT_GE(changeTime, before + nominal + duration * 8333333);
+    EXPECT_LE(changeTime, after + nominal + duration * 8333333);
+
+    /* Fit the model to the vblanks of the fake device */
+    String8 dump;
+    interface->setVsyncEnabled(HWC2_VSYNC_ENABLE);
+    for (int i = 0; (i < 50) && (strstr(dump.string(), "fitted") == nullptr); i++) {
+        usleep(20000);
+        dump.clear();
+        interface->dumpVsyncModel(dump);
+    }
+    interface->setVsyncEnabled(HWC2_VSYNC_DISABLE);
+    usleep(40000);
+    EXPECT_NE(strstr(dump.string(), "fitted"), nullptr);
+
+    /* Change starts from a vsync on the fitted timeline */
+    EXPECT_EQ(interface->getVsyncAppliedTime(0, config, &changeTime), HWC2_ERROR_NONE);
+    int64_t nextVsync = changeTime - duration * 8333333;
+    EXPECT_NEAR(interface->predictNextVsync(nextVsync - ms2ns(1)), nextVsync, us2ns(10));
+    EXPECT_LE(nextVsync, systemTime(SYSTEM_TIME_MONOTONIC) + nominal + us2ns(10));
+
+    delete interface;
+    delete drm;
+    android::DrmBackend::SetInstance(nullptr);
+}
+
+TEST_F(HwcUnitTest, ExynosDisplayDrmInterface_deliverWinConfigData) {
+    android::FakeDrmBackend fake;
+    fake.SetVBlank(16666667, 0);
+    fake.AddDisplay(1080, 2400, 60, 4);
+    android::DrmBackend::SetInstance(&fake);
+
+    android::DrmDevice *drm = new android::DrmDevice();
+    int ret, displays;
+    std::tie(ret, displays) = drm->Init("/dev/dri/card0", 0);
+    EXPECT_EQ(ret, 0);
+
+    NullVsyncHandler handler;
+    ExynosDisplayDrmInterface *interface = new ExynosDisplayDrmInterface();
+    interface->mDisplayIdentifier = {getDisplayId(HWC_DISPLAY_PRIMARY, 0), HWC_DISPLAY_PRIMARY, 0,
+                                     String8("PrimaryDisplay"), String8("fake_decon_fb")};
+    interface->registerVsyncHandler(&handler);
+    interface->initDrmDevice(drm, 0);
+
+    ExynosMPP *mpp = new ExynosMPP(MPP_DPP_G, MPP_LOGICAL_DPP_G, "DPP_G0", 0, 0,
+                                   HWC_DISPLAY_PRIMARY_BIT, MPP_TYPE_OTF);
+    mpp->mChId = 0;
+    int bufferFd = open("/dev/null", O_RDONLY);
+    ASSERT_GE(bufferFd, 0);
+
+    exynos_win_config_data config;
+    config.state = config.WIN_STATE_BUFFER;
+    config.fd_idma[0] = bufferFd;
+    config.buffer_id = 1;
+    config.assignedMPP = mpp;
+    config.format = HAL_PIXEL_FORMAT_RGBA_8888;
+    config.blending = HWC2_BLEND_MODE_PREMULTIPLIED;
+    config.dataspace = HAL_DATASPACE_V0_SRGB;
+    config.src = {0, 0, 1080, 2400, 1080, 2400};
+    config.dst = {0, 0, 1080, 2400, 1080, 2400};
+
+    auto deliverFrame = [&](uint64_t bufferId) -> uint32_t {
+        exynos_dpu_data dpuData;
+        config.buffer_id = bufferId;
+        dpuData.configs.push_back(config);
+        EXPECT_EQ(interface->deliverWinConfigData(dpuData), NO_ERROR);
+        EXPECT_EQ(fake.WaitIdle(ms2ns(100)), 0);
+        if (dpuData.present_fence >= 0)
+            close(dpuData.present_fence);
+        if (dpuData.configs[0].rel_fence >= 0)
+            close(dpuData.configs[0].rel_fence);
+        return fake.GetCommitStats().last_properties;
+    };
+
+    /* Every plane property is sent with the first frame */
+    uint32_t fullFrame = deliverFrame(1);
+    android::DrmPlane *plane = drm->planes()[0].get();
+    uint64_t firstFb = 0, zpos = UINT64_MAX;
+    EXPECT_EQ(fake.GetPropertyValue(plane->id(), "FB_ID", &firstFb), 0);
+    EXPECT_EQ(fake.GetPropertyValue(plane->id(), "zpos", &zpos), 0);
+    EXPECT_NE(firstFb, 0u);
+    EXPECT_EQ(zpos, 0u);
+
+    /* Only the framebuffer changes with the new buffer */
+    uint32_t fbOnlyFrame = deliverFrame(2);
+    uint64_t secondFb = 0;
+    EXPECT_EQ(fake.GetPropertyValue(plane->id(), "FB_ID", &secondFb), 0);
+    EXPECT_NE(secondFb, 0u);
+    EXPECT_NE(secondFb, firstFb);
+    EXPECT_LT(fbOnlyFrame, fullFrame);
+    EXPECT_EQ(fake.GetCommitStats().failed_commits, 0u);
+
+    /* A geometry change is sent again */
+    config.dst.y = 100;
+    config.dst.h = 2300;
+    config.src.h = 2300;
+    uint32_t geometryFrame = deliverFrame(1);
+    EXPECT_GT(geometryFrame, fbOnlyFrame);
+    EXPECT_LT(geometryFrame, fullFrame);
+
+    delete interface;
+    delete mpp;
+    close(bufferFd);
+    delete drm;
+    android::DrmBackend::SetInstance(nullptr);
+}
+
+TEST_F(HwcUnitTest, FramebufferManager_cache) {
+    android::FakeDrmBackend fake;
+    android::DrmBackend::SetInstance(&fake);
+    FramebufferManager *fbManager = new FramebufferManager();
+    int bufferFd = open("/dev/null", O_RDONLY);
+    ASSERT_GE(bufferFd, 0);
+
+    exynos_win_config_data config;
+    config.state = config.WIN_STATE_BUFFER;
+    config.fd_idma[0] = bufferFd;
+    config.buffer_id = 1;
+    config.format = HAL_PIXEL_FORMAT_RGBA_8888;
+    config.src = {0, 0, 1080, 2400, 1080, 2400};
+    config.dst = {0, 0, 1080, 2400, 1080, 2400};
+
+    uint32_t firstFb = 0, fbId = 0;
+    EXPECT_EQ(fbManager->getBuffer(HWC_DISPLAY_PRIMARY, config, firstFb, true), NO_ERROR);
+    EXPECT_EQ(fake.GetFramebufferCount(), 1u);
+    fbManager->flip(HWC_DISPLAY_PRIMARY, false);
+
+    /* Hit doesn't import the buffer, an invalid fd would fail the import */
+    config.fd_idma[0] = -1;
+    EXPECT_EQ(fbManager->getBuffer(HWC_DISPLAY_PRIMARY, config, fbId, true), NO_ERROR);
+    EXPECT_EQ(fbId, firstFb);
+    EXPECT_EQ(fake.GetFramebufferCount(), 1u);
+    fbManager->flip(HWC_DISPLAY_PRIMARY, false);
+
+    /* Miss imports the buffer */
+    config.buffer_id = 2;
+    EXPECT_NE(fbManager->getBuffer(HWC_DISPLAY_PRIMARY, config, fbId, true), NO_ERROR);
+    config.buffer_id = 1;
+
+    /* Framebuffer cached by a display is not shared with other displays */
+    config.fd_idma[0] = bufferFd;
+    EXPECT_EQ(fbManager->getBuffer(HWC_DISPLAY_EXTERNAL, config, fbId, true), NO_ERROR);
+    EXPECT_NE(fbId, firstFb);
+    EXPECT_EQ(fake.GetFramebufferCount(), 2u);
+    fbManager->flip(HWC_DISPLAY_EXTERNAL, false);
+
+    /* Removed buffer is evicted from every display */
+    fbManager->removeBuffer(1);
+    EXPECT_EQ(fbManager->getBuffer(HWC_DISPLAY_PRIMARY, config, fbId, true), NO_ERROR);
+    EXPECT_NE(fbId, firstFb);
+    EXPECT_EQ(fake.GetFramebufferCount(), 3u);
+    fbManager->flip(HWC_DISPLAY_PRIMARY, false);
+
+    String8 result;
+    fbManager->dump(result);
+    EXPECT_GE(result.find("display type[0] staging: 0, cached: 1, hit: 1, miss: 3 "
+                          "(hit ratio 25%), eviction: 1"), 0);
+    EXPECT_GE(result.find("display type[1] staging: 0, cached: 0, hit: 0, miss: 1 "
+                          "(hit ratio 0%), eviction: 1"), 0);
+
+    delete fbManager;
+    EXPECT_EQ(fake.GetFramebufferCount(), 0u);
+    close(bufferFd);
+    android::DrmBackend::SetInstance(nullptr);
+}
+
 TEST_F(HwcUnitTest, ExynosDevice) {
     ExynosDevice* tmp = new ExynosDevice();
     tmp->handleHotplug();
@@ -363,6 +818,525 @@ TEST_F(HwcUnitTest, ExynosResourceManager) {
     tmp->updateRestrictions();
 }
 
+TEST_F(HwcUnitTest, WorkerPool_run) {
+    WorkerPool pool(2);
+    std::vector<WorkerPool::Task> tasks;
+
+    /* Each task waits for the other one, so both have to run at the same time */
+    std::atomic<uint32_t> arrived(0);
+    std::atomic<uint32_t> met(0);
+    for (uint32_t i = 0; i < 2; i++) {
+        tasks.push_back([&] {
+            arrived++;
+            for (uint32_t j = 0; (j < 1000) && (arrived < 2); j++)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            if (arrived == 2)
+                met++;
+        });
+    }
+    pool.run(tasks);
+    EXPECT_EQ(met.load(), 2u);
+
+    /* All tasks are finished when run() returns even if there are more tasks than threads */
+    std::atomic<uint32_t> count(0);
+    tasks.clear();
+    for (uint32_t i = 0; i < 8; i++)
+        tasks.push_back([&] { count++; });
+    pool.run(tasks);
+    EXPECT_EQ(count.load(), 8u);
+    pool.run(tasks);
+    EXPECT_EQ(count.load(), 16u);
+
+    /* Threads are not started for a single task */
+    WorkerPool single(2);
+    std::thread::id taskThread;
+    tasks.clear();
+    tasks.push_back([&] { taskThread = std::this_thread::get_id(); });
+    single.run(tasks);
+    EXPECT_EQ(taskThread, std::this_thread::get_id());
+}
+
+/* Resource manager that has the MPPs of the test instead of the module ones */
+class PartitionTestResourceManager : public ExynosResourceManagerModule {
+  public:
+    void setMPPs(const std::vector<ExynosMPP *> &otfMPPs, const std::vector<ExynosMPP *> &m2mMPPs) {
+        for (size_t i = 0; i < mOtfMPPs.size(); i++)
+            delete mOtfMPPs[i];
+        mOtfMPPs.clear();
+        for (size_t i = 0; i < mM2mMPPs.size(); i++)
+            delete mM2mMPPs[i];
+        mM2mMPPs.clear();
+        for (auto mpp : otfMPPs)
+            mOtfMPPs.add(mpp);
+        for (auto mpp : m2mMPPs) {
+            mpp->mDstBufPool = &mDstBufPool;
+            mM2mMPPs.add(mpp);
+        }
+    }
+};
+
+TEST_F(HwcUnitTest, ExynosResourceManager_parallelValidate) {
+    PartitionTestResourceManager *rm = new PartitionTestResourceManager();
+    ExynosMPP *dppPri = new ExynosMPP(MPP_DPP_G, MPP_LOGICAL_DPP_G, "DPP_G0", 0, 0,
+                                      HWC_DISPLAY_PRIMARY_BIT, MPP_TYPE_OTF);
+    ExynosMPP *dppExt = new ExynosMPP(MPP_DPP_G, MPP_LOGICAL_DPP_G, "DPP_G1", 1, 0,
+                                      HWC_DISPLAY_EXTERNAL_BIT, MPP_TYPE_OTF);
+    ExynosMPP *vgs = new ExynosMPP(MPP_DPP_VGS, MPP_LOGICAL_DPP_VGS, "DPP_VGS0", 0, 0,
+                                   HWC_DISPLAY_PRIMARY_BIT, MPP_TYPE_OTF);
+    /* Logical MPPs of the same MSC HW */
+    ExynosMPP *mscPri = new ExynosMPP(MPP_MSC, MPP_LOGICAL_MSC, "MSC0_PRI", 0, 0,
+                                      HWC_DISPLAY_PRIMARY_BIT, MPP_TYPE_M2M);
+    ExynosMPP *mscExt = new ExynosMPP(MPP_MSC, MPP_LOGICAL_MSC_YUV, "MSC0_EXT", 0, 1,
+                                      HWC_DISPLAY_EXTERNAL_BIT, MPP_TYPE_M2M);
+    rm->setMPPs({dppPri, dppExt, vgs}, {mscPri, mscExt});
+    std::vector<ExynosMPP *> mpps = {dppPri, dppExt, vgs, mscPri, mscExt};
+
+    DisplayIdentifier priNode = {getDisplayId(HWC_DISPLAY_PRIMARY, 0), HWC_DISPLAY_PRIMARY, 0,
+                                 String8("PrimaryDisplay"), String8("fake_decon_fb")};
+    DisplayIdentifier extNode = {getDisplayId(HWC_DISPLAY_EXTERNAL, 0), HWC_DISPLAY_EXTERNAL, 0,
+                                 String8("ExternalDisplay"), String8("fake_decon_fb")};
+    ExynosDisplay *primary = new ExynosDisplay(priNode);
+    ExynosDisplay *external = new ExynosDisplay(extNode);
+    android::Vector<ExynosDisplay *> displays;
+    displays.add(primary);
+    displays.add(external);
+    DisplayInfo priInfo, extInfo;
+    primary->getDisplayInfo(priInfo);
+    external->getDisplayInfo(extInfo);
+
+    std::vector<ExynosLayer *> layers;
+    for (auto display : displays) {
+        DisplayInfo info;
+        display->getDisplayInfo(info);
+        for (uint32_t i = 0; i < 2; i++) {
+            ExynosLayer *layer = new ExynosLayer(info);
+            display->mLayers.add(layer);
+            layers.push_back(layer);
+        }
+    }
+    auto resetMPPs = [&] {
+        rm->clearMPPPartition();
+        for (auto mpp : mpps) {
+            mpp->mAssignedState = MPP_ASSIGN_STATE_FREE;
+            mpp->mReservedDisplayInfo.reset();
+        }
+    };
+    auto validateInParallel = [&] {
+        for (auto layer : layers)
+            layer->mGeometryChanged = 0x1;
+        WorkerPool pool(2);
+        std::vector<WorkerPool::Task> tasks;
+        for (auto display : displays)
+            tasks.push_back([rm, display] { rm->updateSupportedMPPFlag(display); });
+        pool.run(tasks);
+    };
+
+    /* 1. Disjoint: each display owns its otfMPP, the others are blocked */
+    android::Vector<ExynosDisplay *> parallelDisplays;
+    dppPri->reserveMPP(priInfo);
+    dppExt->reserveMPP(extInfo);
+    rm->partitionMPPs(displays, parallelDisplays);
+    ASSERT_EQ(parallelDisplays.size(), 2u);
+    EXPECT_EQ(dppPri->mPartitionDisplayId, primary->mDisplayId);
+    EXPECT_EQ(dppExt->mPartitionDisplayId, external->mDisplayId);
+    EXPECT_EQ(vgs->mPartitionDisplayId, (uint32_t)MPP_PARTITION_SHARED);
+    EXPECT_EQ(mscPri->mPartitionDisplayId, (uint32_t)MPP_PARTITION_SHARED);
+    EXPECT_EQ(mscExt->mPartitionDisplayId, (uint32_t)MPP_PARTITION_SHARED);
+
+    /* MPP of the other display is not assignable whatever its state is */
+    exynos_image src, dst;
+    EXPECT_TRUE(dppPri->isAssignableState(priInfo, src, dst));
+    EXPECT_FALSE(dppExt->isAssignableState(priInfo, src, dst));
+    EXPECT_FALSE(dppPri->isAssignableState(extInfo, src, dst));
+
+    /* Blocked MPPs are not touched while the displays are validated at the same time */
+    std::vector<uint64_t> checkCounts;
+    for (auto mpp : mpps)
+        checkCounts.push_back(mpp->mSupportedCheckCount.load());
+    validateInParallel();
+    EXPECT_GT(dppPri->mSupportedCheckCount.load(), checkCounts[0]);
+    EXPECT_GT(dppExt->mSupportedCheckCount.load(), checkCounts[1]);
+    for (size_t i = 2; i < mpps.size(); i++)
+        EXPECT_EQ(mpps[i]->mSupportedCheckCount.load(), checkCounts[i]);
+    const uint32_t blockedTypes = MPP_LOGICAL_DPP_G | MPP_LOGICAL_DPP_VGS |
+                                  MPP_LOGICAL_MSC | MPP_LOGICAL_MSC_YUV;
+    for (auto layer : layers)
+        EXPECT_EQ(layer->mUncheckedMPPFlag, blockedTypes);
+
+    /* Unchecked MPPs are checked after the partition is cleared, as in serial validate */
+    rm->clearMPPPartition();
+    std::vector<uint32_t> supportedFlags;
+    std::vector<std::unordered_map<uint32_t, uint64_t>> checkFlags;
+    for (auto display : displays) {
+        rm->updateUncheckedMPPFlag(display);
+        for (size_t i = 0; i < display->mLayers.size(); i++) {
+            EXPECT_EQ(display->mLayers[i]->mUncheckedMPPFlag, 0u);
+            supportedFlags.push_back(display->mLayers[i]->mSupportedMPPFlag);
+            checkFlags.push_back(display->mLayers[i]->mCheckMPPFlag);
+        }
+    }
+    for (size_t i = 2; i < mpps.size(); i++)
+        EXPECT_GT(mpps[i]->mSupportedCheckCount.load(), checkCounts[i]);
+    for (auto layer : layers)
+        layer->mGeometryChanged = 0x1;
+    for (auto display : displays)
+        rm->updateSupportedMPPFlag(display);
+    for (size_t i = 0; i < layers.size(); i++) {
+        EXPECT_EQ(layers[i]->mSupportedMPPFlag, supportedFlags[i]);
+        EXPECT_EQ(layers[i]->mCheckMPPFlag, checkFlags[i]);
+    }
+
+    /* 2. Overlapping m2mMPPs: logical MPPs of one HW are reserved for different displays */
+    resetMPPs();
+    dppPri->reserveMPP(priInfo);
+    dppExt->reserveMPP(extInfo);
+    mscPri->reserveMPP(priInfo);
+    mscExt->reserveMPP(extInfo);
+    rm->partitionMPPs(displays, parallelDisplays);
+    ASSERT_EQ(parallelDisplays.size(), 2u);
+    EXPECT_EQ(mscPri->mPartitionDisplayId, (uint32_t)MPP_PARTITION_SHARED);
+    EXPECT_EQ(mscExt->mPartitionDisplayId, (uint32_t)MPP_PARTITION_SHARED);
+    EXPECT_FALSE(mscPri->isAssignableState(priInfo, src, dst));
+    EXPECT_FALSE(mscExt->isAssignableState(extInfo, src, dst));
+    uint64_t mscPriCount = mscPri->mSupportedCheckCount.load();
+    uint64_t mscExtCount = mscExt->mSupportedCheckCount.load();
+    validateInParallel();
+    EXPECT_EQ(mscPri->mSupportedCheckCount.load(), mscPriCount);
+    EXPECT_EQ(mscExt->mSupportedCheckCount.load(), mscExtCount);
+
+    /* Display that fell back to client composition for a blocked MPP is assigned again */
+    ExynosLayer *layer = primary->mLayers[0];
+    rm->clearMPPPartition();
+    rm->updateUncheckedMPPFlag(primary);
+    layer->mSupportedMPPFlag |= MPP_LOGICAL_MSC;
+    layer->mCompositionType = HWC2_COMPOSITION_DEVICE;
+    layer->mValidateCompositionType = HWC2_COMPOSITION_CLIENT;
+    EXPECT_TRUE(rm->needSharedMPPs(primary));
+    layer->mValidateCompositionType = HWC2_COMPOSITION_DEVICE;
+    EXPECT_FALSE(rm->needSharedMPPs(primary));
+
+    /* 3. Overlapping otfMPPs: a display that owns no otfMPP is validated serially */
+    resetMPPs();
+    dppPri->reserveMPP(priInfo);
+    dppExt->reserveMPP(priInfo);
+    rm->partitionMPPs(displays, parallelDisplays);
+    EXPECT_EQ(parallelDisplays.size(), 0u);
+    for (auto mpp : mpps)
+        EXPECT_EQ(mpp->mPartitionDisplayId, (uint32_t)MPP_PARTITION_NONE);
+
+    resetMPPs();
+    for (auto display : displays) {
+        display->mLayers.clear();
+        delete display;
+    }
+    for (auto layer : layers)
+        delete layer;
+    delete rm;
+}
+
+class SignatureTestResourceManager : public ExynosResourceManagerModule {
+  public:
+    using ExynosResourceManager::getAssignSignature;
+};
+
+TEST_F(HwcUnitTest, ExynosResourceManager_assignSignature) {
+    SignatureTestResourceManager *rm = new SignatureTestResourceManager();
+    DisplayIdentifier node = {getDisplayId(HWC_DISPLAY_PRIMARY, 0), HWC_DISPLAY_PRIMARY, 0,
+                              String8("PrimaryDisplay"), String8("fake_decon_fb")};
+    ExynosDisplay *display = new ExynosDisplay(node);
+    DisplayInfo info;
+    display->getDisplayInfo(info);
+    ExynosLayer *layers[2];
+    for (uint32_t i = 0; i < 2; i++) {
+        layers[i] = new ExynosLayer(info);
+        layers[i]->mDisplayFrame = {0, 0, 1080, (int)(1200 * (i + 1))};
+        layers[i]->mCompositionType = HWC2_COMPOSITION_DEVICE;
+        display->mLayers.add(layers[i]);
+    }
+
+    AssignSignature signature, next;
+    rm->getAssignSignature(display, signature);
+    ASSERT_FALSE(signature.key.empty());
+
+    /* Identical frame hits, the key buffer is reused without allocation */
+    rm->getAssignSignature(display, next);
+    EXPECT_TRUE(next == signature);
+    const uint64_t *keyData = next.key.data();
+    size_t keyCapacity = next.key.capacity();
+    rm->getAssignSignature(display, next);
+    EXPECT_TRUE(next == signature);
+    EXPECT_EQ(next.key.data(), keyData);
+    EXPECT_EQ(next.key.capacity(), keyCapacity);
+
+    /* One field of a layer misses */
+    layers[1]->mCompositionType = HWC2_COMPOSITION_CLIENT;
+    rm->getAssignSignature(display, next);
+    EXPECT_FALSE(next == signature);
+    EXPECT_EQ(next.key.size(), signature.key.size());
+    layers[1]->mCompositionType = HWC2_COMPOSITION_DEVICE;
+    layers[0]->mDisplayFrame.bottom = 1100;
+    rm->getAssignSignature(display, next);
+    EXPECT_FALSE(next == signature);
+    layers[0]->mDisplayFrame.bottom = 1200;
+    rm->getAssignSignature(display, next);
+    EXPECT_TRUE(next == signature);
+
+    /* Same hash with a different key misses */
+    next.key[0] ^= 0x1;
+    EXPECT_FALSE(next == signature);
+
+    display->mLayers.clear();
+    delete display;
+    for (auto layer : layers)
+        delete layer;
+    delete rm;
+}
+
+class PlannerTestResourceManager : public ExynosResourceManagerModule {
+  public:
+    using ExynosResourceManager::searchCompositionPlan;
+};
+
+static PlanLayerOption makePlanOption(int32_t compositionType, int32_t otfIndex,
+                                      int32_t m2mIndex, float cost) {
+    PlanLayerOption option;
+    option.compositionType = compositionType;
+    option.otfIndex = otfIndex;
+    option.m2mIndex = m2mIndex;
+    option.cost = cost;
+    return option;
+}
+
+static void resetPlanSearch(CompositionPlan &plan) {
+    uint32_t layerNum = plan.options.size();
+    plan.remainingMinCost.assign(layerNum + 1, 0);
+    for (int32_t i = layerNum - 1; i >= 0; i--)
+        plan.remainingMinCost[i] = plan.remainingMinCost[i + 1] + plan.options[i][0].cost;
+    plan.choice.assign(layerNum, -1);
+    plan.bestChoice.clear();
+    plan.bestCost = FLT_MAX;
+    plan.deadline = systemTime(SYSTEM_TIME_MONOTONIC) + s2ns(10);
+    plan.timeout = false;
+    plan.visitedNodes = 0;
+}
+
+/* Reference of the planner: every feasible plan is enumerated without any bound */
+struct PlanReference {
+    std::vector<int32_t> choice;
+    std::vector<int32_t> bestChoice;
+    float bestCost = FLT_MAX;
+    uint32_t nodes = 0;
+};
+
+static void enumeratePlans(const CompositionPlan &plan, uint32_t index, uint64_t otfMask,
+                           uint64_t m2mMask, uint32_t windowNum, uint32_t clientRange,
+                           float cost, PlanReference &ref) {
+    ref.nodes++;
+    if (index == plan.options.size()) {
+        bool needClient = (clientRange != PLAN_RANGE_NONE);
+        if (needClient && ((plan.clientTargetOtfMask & ~otfMask) == 0))
+            return;
+        if (cost < ref.bestCost) {
+            ref.bestCost = cost;
+            ref.bestChoice = ref.choice;
+        }
+        return;
+    }
+    for (uint32_t i = 0; i < plan.options[index].size(); i++) {
+        const PlanLayerOption &option = plan.options[index][i];
+        uint64_t nextOtfMask = otfMask;
+        uint64_t nextM2mMask = m2mMask;
+        uint32_t nextWindowNum = windowNum;
+        uint32_t nextClientRange = clientRange;
+        float nextCost = cost + option.cost;
+        if (option.compositionType == HWC2_COMPOSITION_CLIENT) {
+            if (clientRange == PLAN_RANGE_CLOSED)
+                continue;
+            if (clientRange == PLAN_RANGE_NONE) {
+                nextClientRange = PLAN_RANGE_OPEN;
+                nextCost += plan.clientTargetCost;
+                nextWindowNum++;
+            }
+        } else {
+            if (clientRange == PLAN_RANGE_OPEN)
+                nextClientRange = PLAN_RANGE_CLOSED;
+            if (otfMask & (1ULL << option.otfIndex))
+                continue;
+            nextOtfMask |= (1ULL << option.otfIndex);
+            if (option.m2mIndex >= 0) {
+                if (m2mMask & (1ULL << option.m2mIndex))
+                    continue;
+                nextM2mMask |= (1ULL << option.m2mIndex);
+            }
+            nextWindowNum++;
+        }
+        if (nextWindowNum > plan.maxWindowNum)
+            continue;
+        ref.choice[index] = i;
+        enumeratePlans(plan, index + 1, nextOtfMask, nextM2mMask, nextWindowNum,
+                       nextClientRange, nextCost, ref);
+    }
+}
+
+TEST_F(HwcUnitTest, ExynosResourceManager_compositionPlanner) {
+    PlannerTestResourceManager *rm = new PlannerTestResourceManager();
+    CompositionPlan plan;
+
+    /*
+     * Three otfMPPs and one M2M MPP for four layers. Client target can use only
+     * otfMPP 2, and four layers don't fit three windows without client composition.
+     * Options of each layer are sorted by cost as buildCompositionPlan() does.
+     */
+    plan.options = {
+        {makePlanOption(HWC2_COMPOSITION_DEVICE, 0, -1, 10),
+         makePlanOption(HWC2_COMPOSITION_DEVICE, 1, -1, 11),
+         makePlanOption(HWC2_COMPOSITION_CLIENT, -1, -1, 30)},
+        {makePlanOption(HWC2_COMPOSITION_DEVICE, 0, -1, 8),
+         makePlanOption(HWC2_COMPOSITION_DEVICE, 2, -1, 14),
+         makePlanOption(HWC2_COMPOSITION_CLIENT, -1, -1, 20)},
+        {makePlanOption(HWC2_COMPOSITION_DEVICE, 1, 0, 5),
+         makePlanOption(HWC2_COMPOSITION_DEVICE, 0, -1, 7),
+         makePlanOption(HWC2_COMPOSITION_CLIENT, -1, -1, 15)},
+        {makePlanOption(HWC2_COMPOSITION_DEVICE, 1, 0, 4),
+         makePlanOption(HWC2_COMPOSITION_CLIENT, -1, -1, 6)},
+    };
+    plan.clientTargetOtfMask = (1ULL << 2);
+    plan.clientTargetCost = 6;
+    plan.maxWindowNum = 3;
+
+    PlanReference ref;
+    ref.choice.assign(plan.options.size(), -1);
+    enumeratePlans(plan, 0, 0, 0, 0, PLAN_RANGE_NONE, 0, ref);
+    ASSERT_FALSE(ref.bestChoice.empty());
+
+    /* Cheapest option of each layer is not a feasible plan */
+    float greedyCost = 0;
+    for (auto &options : plan.options)
+        greedyCost += options[0].cost;
+    EXPECT_LT(greedyCost, ref.bestCost);
+
+    /* Planner finds the same plan as exhaustive search */
+    resetPlanSearch(plan);
+    PlanSearchState state;
+    rm->searchCompositionPlan(plan, 0, state);
+    EXPECT_FALSE(plan.timeout);
+    EXPECT_FLOAT_EQ(plan.bestCost, ref.bestCost);
+    EXPECT_EQ(plan.bestChoice, ref.bestChoice);
+
+    /* Bound prunes subtrees that exhaustive search visits */
+    EXPECT_LT(plan.visitedNodes, ref.nodes);
+
+    /* Subtrees that can't be cheaper than the known best plan are not visited */
+    resetPlanSearch(plan);
+    plan.bestCost = ref.bestCost;
+    rm->searchCompositionPlan(plan, 0, state);
+    EXPECT_TRUE(plan.bestChoice.empty());
+    EXPECT_LT(plan.visitedNodes, ref.nodes);
+
+    /*
+     * Without a window for client target there is no feasible plan, so that
+     * bestChoice is empty and planAssignResources() falls back to
+     * assignResourceByPriority().
+     */
+    plan.clientTargetOtfMask = 0;
+    resetPlanSearch(plan);
+    rm->searchCompositionPlan(plan, 0, state);
+    EXPECT_FALSE(plan.timeout);
+    EXPECT_TRUE(plan.bestChoice.empty());
+    EXPECT_EQ(plan.bestCost, FLT_MAX);
+
+    delete rm;
+}
+
+static const stHW2DCapability qosTestCapa = {};
+static const HW2DCapability qosTestCapability(qosTestCapa);
+
+/* Acrylic that counts QoS requests instead of calling the driver */
+class QoSTestAcrylic : public Acrylic {
+  public:
+    QoSTestAcrylic() : Acrylic(qosTestCapability){};
+    virtual bool execute(int __unused fence[], unsigned int __unused num_fences) { return true; };
+    virtual bool execute(int __unused *handle = NULL) { return true; };
+    virtual bool waitExecution(int __unused handle) { return true; };
+    virtual bool requestPerformanceQoS(AcrylicPerformanceRequest __unused *request) {
+        qosCount++;
+        return qosResult;
+    };
+    uint32_t qosCount = 0;
+    bool qosResult = true;
+};
+
+class QoSTestResourceManager : public ExynosResourceManagerModule {
+  public:
+    using ExynosResourceManager::PerformanceRequestInfo;
+    using ExynosResourceManager::deliverPerformanceRequest;
+};
+
+TEST_F(HwcUnitTest, ExynosResourceManager_deliverPerformanceRequest) {
+    QoSTestResourceManager *rm = new QoSTestResourceManager();
+    QoSTestResourceManager::PerformanceRequestInfo requestInfo;
+    AcrylicPerformanceRequest &request = requestInfo.request;
+    QoSTestAcrylic acrylic, otherAcrylic;
+
+    auto fillRequest = [&](int srcWidth, bool compressed) {
+        ASSERT_TRUE(request.reset(1));
+        AcrylicPerformanceRequestFrame *frame = request.getFrame(0);
+        ASSERT_NE(frame, nullptr);
+        ASSERT_TRUE(frame->reset(2));
+        for (int i = 0; i < 2; i++) {
+            hwc_rect_t srcArea = {0, 0, srcWidth, 1080};
+            hwc_rect_t outArea = {0, 0, 1080, 2400};
+            frame->setSourceDimension(i, srcWidth, 1080, HAL_PIXEL_FORMAT_RGBA_8888);
+            frame->setTransfer(i, srcArea, outArea, 0);
+        }
+        if (compressed)
+            frame->setAttribute(1, AcrylicCanvas::ATTR_COMPRESSED);
+        frame->setTargetDimension(1080, 2400, HAL_PIXEL_FORMAT_RGBA_8888, false);
+    };
+
+    fillRequest(1920, false);
+    EXPECT_TRUE(rm->deliverPerformanceRequest(requestInfo, &acrylic));
+    EXPECT_EQ(acrylic.qosCount, 1u);
+
+    /* Frames are kept for the next request */
+    AcrylicPerformanceRequestFrame *frame = request.getFrame(0);
+    ASSERT_TRUE(request.reset(0));
+    EXPECT_EQ(request.getFrame(0), nullptr);
+    ASSERT_TRUE(request.reset(1));
+    EXPECT_EQ(request.getFrame(0), frame);
+
+    /* Same request is not delivered again */
+    fillRequest(1920, false);
+    EXPECT_FALSE(rm->deliverPerformanceRequest(requestInfo, &acrylic));
+    EXPECT_EQ(acrylic.qosCount, 1u);
+    EXPECT_EQ(requestInfo.skippedCount, 1u);
+
+    fillRequest(1280, false);
+    EXPECT_TRUE(rm->deliverPerformanceRequest(requestInfo, &acrylic));
+    fillRequest(1280, true);
+    EXPECT_TRUE(rm->deliverPerformanceRequest(requestInfo, &acrylic));
+    /* Attribute of the previous request is cleared by reset() */
+    fillRequest(1280, false);
+    EXPECT_TRUE(rm->deliverPerformanceRequest(requestInfo, &acrylic));
+    EXPECT_EQ(acrylic.qosCount, 4u);
+
+    /* Same request through another handle is delivered */
+    EXPECT_TRUE(rm->deliverPerformanceRequest(requestInfo, &otherAcrylic));
+    EXPECT_EQ(otherAcrylic.qosCount, 1u);
+
+    /* Failed request is delivered again */
+    otherAcrylic.qosResult = false;
+    fillRequest(1920, false);
+    EXPECT_FALSE(rm->deliverPerformanceRequest(requestInfo, &otherAcrylic));
+    otherAcrylic.qosResult = true;
+    EXPECT_TRUE(rm->deliverPerformanceRequest(requestInfo, &otherAcrylic));
+    EXPECT_EQ(otherAcrylic.qosCount, 3u);
+    EXPECT_EQ(requestInfo.deliveredCount, 7u);
+    EXPECT_EQ(requestInfo.skippedCount, 1u);
+
+    delete rm;
+}
+
 TEST_F(HwcUnitTest, ExynosDisplay) {
     uint32_t id = getDisplayId(HWC_DISPLAY_PRIMARY, 0);
     DisplayIdentifier node = {id, HWC_DISPLAY_PRIMARY, 0,
@@ -390,6 +1364,564 @@ TEST_F(HwcUnitTest, getMetaParcel) {
 }
 
 
+TEST_F(HwcUnitTest, ExynosMPP_increaseDstBuffIndex) {
+    ExynosMPP* mpp = new ExynosMPP(MPP_DPP_G, MPP_LOGICAL_DPP_G, "DPP_G0", 0, 0,
+                                   HWC_DISPLAY_PRIMARY_BIT, MPP_TYPE_OTF);
+    EXPECT_EQ(mpp->increaseDstBuffIndex(), 1u);
+    EXPECT_EQ(mpp->mLastDstBuf, 0);
+
+    /* Buffer that isn't released by the display is skipped */
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    mpp->mDstImgs[2].acrylicReleaseFenceFd = fds[0];
+    EXPECT_EQ(mpp->increaseDstBuffIndex(), 0u);
+    EXPECT_EQ(mpp->mLastDstBuf, 1);
+
+    mpp->mDstImgs[2].acrylicReleaseFenceFd = -1;
+    close(fds[0]);
+    close(fds[1]);
+    delete mpp;
+}
+
+TEST_F(HwcUnitTest, ExynosMPPBufferPool_getBufferClass) {
+    ExynosMPPBufferPool::BufferClass fhd =
+        ExynosMPPBufferPool::getBufferClass(1080, 2400, HAL_PIXEL_FORMAT_RGBA_8888, 0);
+    EXPECT_EQ(fhd.width % MPP_BUFFER_POOL_SIZE_ALIGN, 0u);
+    EXPECT_EQ(fhd.height % MPP_BUFFER_POOL_SIZE_ALIGN, 0u);
+    EXPECT_GE(fhd.width, 1080u);
+
+    /* Sizes in the same class share buffers */
+    ExynosMPPBufferPool::BufferClass near =
+        ExynosMPPBufferPool::getBufferClass(1072, 2400, HAL_PIXEL_FORMAT_RGBA_8888, 0);
+    EXPECT_FALSE(fhd < near);
+    EXPECT_FALSE(near < fhd);
+
+    ExynosMPPBufferPool::BufferClass secure =
+        ExynosMPPBufferPool::getBufferClass(1080, 2400, HAL_PIXEL_FORMAT_RGBA_8888, 1);
+    EXPECT_TRUE((fhd < secure) || (secure < fhd));
+}
+
+TEST_F(HwcUnitTest, ExynosMPPBufferPool_acquire) {
+    ExynosMPPBufferPool pool;
+    const uint32_t format = HAL_PIXEL_FORMAT_RGBA_8888;
+    const uint64_t usage = GRALLOC_USAGE_HW_TEXTURE | GRALLOC_USAGE_HW_COMPOSER;
+    buffer_handle_t first = NULL, second = NULL, reused = NULL;
+    int fence = -1;
+
+    ASSERT_EQ(pool.acquire(1080, 2400, format, usage, &first, &fence), NO_ERROR);
+    EXPECT_EQ(fence, -1);
+    ASSERT_EQ(pool.acquire(1080, 2400, format, usage, &second, &fence), NO_ERROR);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(pool.getFreeCount(1080, 2400, format, usage), 0u);
+
+    /* Released buffer is reused for a size in the same class */
+    pool.release(first, -1, DisplayIdentifier());
+    EXPECT_EQ(pool.getFreeCount(1080, 2400, format, usage), 1u);
+    ASSERT_EQ(pool.acquire(1072, 2400, format, usage, &reused, &fence), NO_ERROR);
+    EXPECT_EQ(reused, first);
+    EXPECT_EQ(fence, -1);
+    EXPECT_EQ(pool.getFreeCount(1080, 2400, format, usage), 0u);
+
+    pool.release(reused, -1, DisplayIdentifier());
+    pool.release(second, -1, DisplayIdentifier());
+    EXPECT_EQ(pool.getFreeCount(1080, 2400, format, usage), 2u);
+
+    /* Free buffers over the low watermark are trimmed */
+    pool.trim();
+    EXPECT_EQ(pool.getFreeCount(1080, 2400, format, usage), 0u);
+}
+
+TEST_F(HwcUnitTest, ExynosMPPBufferPool_fence) {
+    ExynosMPPBufferPool pool;
+    const uint32_t format = HAL_PIXEL_FORMAT_RGBA_8888;
+    const uint64_t usage = GRALLOC_USAGE_HW_TEXTURE | GRALLOC_USAGE_HW_COMPOSER;
+    buffer_handle_t buffer = NULL, reused = NULL;
+    int fence = -1;
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+
+    /* Buffer that is still read is given with its fence without waiting for it */
+    ASSERT_EQ(pool.acquire(1080, 2400, format, usage, &buffer, &fence), NO_ERROR);
+    pool.release(buffer, fds[0], DisplayIdentifier());
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    ASSERT_EQ(pool.acquire(1080, 2400, format, usage, &reused, &fence), NO_ERROR);
+    EXPECT_LT(ns2ms(systemTime(SYSTEM_TIME_MONOTONIC) - start), 100);
+    EXPECT_EQ(reused, buffer);
+    EXPECT_EQ(fence, fds[0]);
+    close(fence);
+    close(fds[1]);
+
+    /* Buffer with a write fence is free after the pool thread waits for it */
+    ASSERT_EQ(pipe(fds), 0);
+    pool.release(reused, -1, DisplayIdentifier(), fds[0]);
+    EXPECT_EQ(pool.getFreeCount(1080, 2400, format, usage), 0u);
+    ASSERT_EQ(write(fds[1], "s", 1), 1);
+    for (uint32_t i = 0; (i < 100) && (pool.getFreeCount(1080, 2400, format, usage) < 1); i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(pool.getFreeCount(1080, 2400, format, usage), 1u);
+    close(fds[1]);
+}
+
+TEST_F(HwcUnitTest, ExynosMPPBufferPool_prewarm) {
+    ExynosMPPBufferPool pool;
+    const uint32_t format = HAL_PIXEL_FORMAT_RGBA_8888;
+    const uint64_t usage = GRALLOC_USAGE_HW_TEXTURE | GRALLOC_USAGE_HW_COMPOSER;
+
+    /* Buffers are allocated by the pool thread */
+    pool.prewarm(1080, 2400, format, usage, 2);
+    for (uint32_t i = 0; (i < 100) && (pool.getFreeCount(1080, 2400, format, usage) < 2); i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(pool.getFreeCount(1080, 2400, format, usage), 2u);
+
+    /* Pre-warmed buffers are kept by trim until the watermark is lowered */
+    pool.trim();
+    EXPECT_EQ(pool.getFreeCount(1080, 2400, format, usage), 2u);
+    pool.prewarm(1080, 2400, format, usage, 0);
+    pool.trim();
+    EXPECT_EQ(pool.getFreeCount(1080, 2400, format, usage), 0u);
+}
+
+TEST_F(HwcUnitTest, ExynosFenceReactor_add) {
+    ExynosFenceReactor &reactor = ExynosFenceReactor::getInstance();
+    std::atomic<int32_t> status(-1);
+
+    /* Read end of a pipe is signaled when the write end is written */
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    reactor.add(fds[0], DisplayIdentifier(), FENCE_TYPE_UNDEFINED, FENCE_IP_ALL,
+                "unittest", &status, [&status](int32_t ret) { status = ret; });
+    EXPECT_EQ(reactor.getPendingFenceCount(), 1u);
+    EXPECT_EQ(status, -1);
+
+    /* Callback of the fence that is already added is called with an error */
+    std::atomic<int32_t> dupStatus(-1);
+    reactor.add(fds[0], DisplayIdentifier(), FENCE_TYPE_UNDEFINED, FENCE_IP_ALL,
+                "unittest", &status, [&dupStatus](int32_t ret) { dupStatus = ret; });
+    for (uint32_t i = 0; (i < 100) && (dupStatus == -1); i++)
+        usleep(1000);
+    EXPECT_EQ(dupStatus, -EINVAL);
+    EXPECT_EQ(reactor.getPendingFenceCount(), 1u);
+    EXPECT_EQ(status, -1);
+
+    /* Callback without an owner is not dropped by cancel() */
+    std::atomic<bool> posted(false);
+    reactor.post(nullptr, [&posted](int32_t) { posted = true; });
+    reactor.cancel(&posted);
+    for (uint32_t i = 0; (i < 100) && !posted; i++)
+        usleep(1000);
+    EXPECT_TRUE(posted);
+
+    ASSERT_EQ(write(fds[1], "s", 1), 1);
+    for (uint32_t i = 0; (i < 100) && (status != NO_ERROR); i++)
+        usleep(1000);
+    EXPECT_EQ(status, NO_ERROR);
+    EXPECT_EQ(reactor.getPendingFenceCount(), 0u);
+
+    reactor.cancel(&status);
+    close(fds[1]);
+}
+
+TEST_F(HwcUnitTest, ExynosDamageRegion_plan) {
+    ExynosDamageRegion region;
+    PartialUpdateRestriction restriction;
+    std::vector<hwc_rect> rects;
+
+    /* Clock on the top and navigation bar on the bottom */
+    region.add({900, 0, 1080, 100});
+    region.add({0, 2300, 1080, 2340});
+    EXPECT_EQ(region.getRects().size(), 2u);
+    EXPECT_EQ(region.plan(restriction, 1080, 2400, rects), (uint32_t)ExynosDamageRegion::UPDATE_SINGLE);
+    EXPECT_EQ(rects.size(), 1u);
+
+    restriction.maxRegionNum = 2;
+    EXPECT_EQ(region.plan(restriction, 1080, 2400, rects), (uint32_t)ExynosDamageRegion::UPDATE_SPLIT);
+    ASSERT_EQ(rects.size(), 2u);
+    EXPECT_EQ(rects[0].bottom, 100);
+    EXPECT_EQ(rects[1].top, 2300);
+
+    region.clear();
+    region.add({0, 0, 1080, 2390});
+    EXPECT_EQ(region.plan(restriction, 1080, 2400, rects), (uint32_t)ExynosDamageRegion::UPDATE_FULL);
+    EXPECT_TRUE(rects.empty());
+}
+
+TEST_F(HwcUnitTest, ExynosMPP_getPartialCopyRects) {
+    hwc_rect_t rects[G2D_PARTIAL_COPY_LAYER_NUM];
+
+    /* Cursor in the middle, top, bottom, left and right of it are copied */
+    EXPECT_EQ(ExynosMPP::getPartialCopyRects({500, 1000, 532, 1032}, {0, 0, 1080, 2400}, rects), 4u);
+    EXPECT_EQ(rects[0].bottom, 1000);
+    EXPECT_EQ(rects[1].top, 1032);
+    EXPECT_EQ(rects[2].right, 500);
+    EXPECT_EQ(rects[3].left, 532);
+
+    /* Band on the top of the display */
+    EXPECT_EQ(ExynosMPP::getPartialCopyRects({0, 0, 1080, 100}, {0, 0, 1080, 2400}, rects), 1u);
+    EXPECT_EQ(rects[0].top, 100);
+    EXPECT_EQ(rects[0].bottom, 2400);
+
+    /* Copy rects stay in the dst area of the job */
+    EXPECT_EQ(ExynosMPP::getPartialCopyRects({200, 300, 400, 1300}, {100, 200, 500, 1300}, rects), 3u);
+    EXPECT_EQ(rects[0].left, 100);
+    EXPECT_EQ(rects[0].top, 200);
+    EXPECT_EQ(rects[0].right, 500);
+    EXPECT_EQ(rects[0].bottom, 300);
+    EXPECT_EQ(rects[1].left, 100);
+    EXPECT_EQ(rects[1].right, 200);
+    EXPECT_EQ(rects[2].left, 400);
+    EXPECT_EQ(rects[2].right, 500);
+}
+
+class PartialCompositionMPP : public ExynosMPP {
+  public:
+    using ExynosMPP::ExynosMPP;
+    using ExynosMPP::canUsePartialComposition;
+};
+
+static void setPartialTestImage(exynos_image &img, uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                                buffer_handle_t handle) {
+    img.reset();
+    img.exynosFormat = ExynosFormat(HAL_PIXEL_FORMAT_RGBA_8888);
+    img.x = x;
+    img.y = y;
+    img.w = w;
+    img.h = h;
+    img.bufferHandle = handle;
+}
+
+TEST_F(HwcUnitTest, ExynosMPP_canUsePartialComposition) {
+    PartialCompositionMPP *mpp = new PartialCompositionMPP(MPP_G2D, MPP_LOGICAL_G2D_RGB, "G2D0", 0, 0,
+                                                           HWC_DISPLAY_PRIMARY_BIT, MPP_TYPE_M2M);
+    PartialCompositionMPP::PartialCompositionInfo &info = mpp->mPartialComposition;
+    buffer_handle_t prevBuffer = (buffer_handle_t)0x1000;
+    buffer_handle_t curBuffer = (buffer_handle_t)0x2000;
+    buffer_handle_t dstBuffer = (buffer_handle_t)0x3000;
+    hwc_rect_t damage;
+
+    mpp->mMaxSrcLayerNum = 16;
+    mpp->mAllocOutBufFlag = true;
+    mpp->mUseM2MSrcFence = false;
+    mpp->mCurrentTargetCompressionInfoType = COMP_TYPE_NONE;
+
+    /* Background whose buffer is not changed and a small layer that is updated */
+    ExynosMPPSource background(MPP_SOURCE_LAYER, nullptr);
+    ExynosMPPSource cursor(MPP_SOURCE_LAYER, nullptr);
+    setPartialTestImage(background.mSrcImg, 0, 0, 1080, 2400, (buffer_handle_t)0x4000);
+    setPartialTestImage(background.mMidImg, 0, 0, 1080, 2400, nullptr);
+    setPartialTestImage(cursor.mSrcImg, 0, 0, 64, 64, curBuffer);
+    setPartialTestImage(cursor.mMidImg, 500, 1000, 64, 64, nullptr);
+    mpp->mAssignedSources.add(&background);
+    mpp->mAssignedSources.add(&cursor);
+
+    mpp->mPrevFrameInfo.srcNum = 2;
+    mpp->mPrevFrameInfo.srcInfo[0] = background.mSrcImg;
+    mpp->mPrevFrameInfo.dstInfo[0] = background.mMidImg;
+    mpp->mPrevFrameInfo.srcInfo[1] = cursor.mSrcImg;
+    mpp->mPrevFrameInfo.srcInfo[1].bufferHandle = prevBuffer;
+    mpp->mPrevFrameInfo.dstInfo[1] = cursor.mMidImg;
+
+    /* dst buffer 0 has the composition result of the previous frame */
+    mpp->mCurrentDstBuf = 1;
+    mpp->mDstImgs[0].bufferHandle = dstBuffer;
+    info.validBuf = 0;
+    info.validHandle = dstBuffer;
+    info.validDstRect = {0, 0, 1080, 2400};
+    info.validDisplayId = mpp->mAssignedDisplayInfo.displayIdentifier.id;
+    info.validDataspace = colorModeToDataspace(mpp->mAssignedDisplayInfo.colorMode);
+    info.validFence = open("/dev/null", O_RDONLY);
+    ASSERT_GE(info.validFence, 3);
+
+    /* Exynos composition target with the damage of the current frame */
+    info.target = true;
+    info.dstRect = {0, 0, 1080, 2400};
+    cursor.mDamageValid = true;
+    cursor.mDamage = {500, 1000, 532, 1032};
+    cursor.mDamageBaseBuffer = prevBuffer;
+    EXPECT_TRUE(mpp->canUsePartialComposition(damage));
+    EXPECT_EQ(damage.left, 500);
+    EXPECT_EQ(damage.top, 1000);
+    EXPECT_EQ(damage.right, 532);
+    EXPECT_EQ(damage.bottom, 1032);
+
+    /* Sources of other M2M jobs have no damage of their own */
+    info.target = false;
+    EXPECT_FALSE(mpp->canUsePartialComposition(damage));
+    info.target = true;
+
+    /* Damage of the previous frame is not reused, the whole source is damaged */
+    cursor.resetDamage();
+    EXPECT_TRUE(mpp->canUsePartialComposition(damage));
+    EXPECT_EQ(damage.right, 564);
+    EXPECT_EQ(damage.bottom, 1064);
+
+    /* Damage that is based on an older buffer is not used */
+    cursor.mDamageValid = true;
+    cursor.mDamage = {500, 1000, 532, 1032};
+    cursor.mDamageBaseBuffer = (buffer_handle_t)0x5000;
+    EXPECT_TRUE(mpp->canUsePartialComposition(damage));
+    EXPECT_EQ(damage.right, 564);
+    EXPECT_EQ(damage.bottom, 1064);
+
+    /* Full frame if the dst buffer of the valid result is changed */
+    cursor.mDamageBaseBuffer = prevBuffer;
+    mpp->mDstImgs[0].bufferHandle = (buffer_handle_t)0x6000;
+    EXPECT_FALSE(mpp->canUsePartialComposition(damage));
+    mpp->mDstImgs[0].bufferHandle = dstBuffer;
+
+    /* Full frame if the dst area of the job is changed */
+    info.dstRect = {0, 0, 1080, 2300};
+    EXPECT_FALSE(mpp->canUsePartialComposition(damage));
+    info.dstRect = {0, 0, 1080, 2400};
+    EXPECT_TRUE(mpp->canUsePartialComposition(damage));
+
+    mpp->mAssignedSources.clear();
+    delete mpp;
+}
+
+TEST_F(HwcUnitTest, ExynosDisplay_getStaticLayerRuns) {
+    uint32_t id = getDisplayId(HWC_DISPLAY_PRIMARY, 0);
+    DisplayIdentifier node = {id, HWC_DISPLAY_PRIMARY, 0,
+                              String8("PrimaryDisplay"),
+                              String8("fake_decon_fb")};
+    ExynosDisplay *display = new ExynosDisplay(node);
+    DisplayInfo display_info;
+    display->getDisplayInfo(display_info);
+
+    /* Wallpaper, launcher and status bar are static, the widget on the top is animating */
+    ExynosLayer *layers[4];
+    for (uint32_t i = 0; i < 4; i++) {
+        layers[i] = new ExynosLayer(display_info);
+        layers[i]->mLayerBuffer = (buffer_handle_t)(uintptr_t)(0x1000 * (i + 1));
+        layers[i]->mPlaneAlpha = 1.0f;
+        display->mLayers.add(layers[i]);
+    }
+    for (uint32_t frame = 0; frame <= STATIC_LAYER_FLATTEN_FRAMES; frame++) {
+        layers[3]->mLayerBuffer = (buffer_handle_t)(uintptr_t)(0x10000 + frame);
+        for (uint32_t i = 0; i < 4; i++) {
+            layers[i]->updateFingerprint();
+            layers[i]->updateStaticFrameCount();
+        }
+    }
+
+    std::vector<StaticLayerRun> runs;
+    display->getStaticLayerRuns(0, 3, runs);
+    ASSERT_EQ(runs.size(), 2u);
+    EXPECT_TRUE(runs[0].isStatic);
+    EXPECT_EQ(runs[0].firstIndex, 0);
+    EXPECT_EQ(runs[0].lastIndex, 2);
+    EXPECT_FALSE(runs[1].isStatic);
+    EXPECT_EQ(runs[1].firstIndex, 3);
+
+    /* Change of plane alpha breaks the run */
+    layers[1]->mPlaneAlpha = 0.5f;
+    layers[1]->updateFingerprint();
+    display->getStaticLayerRuns(0, 3, runs);
+    EXPECT_EQ(runs.size(), 4u);
+
+    display->mLayers.clear();
+    for (uint32_t i = 0; i < 4; i++) {
+        layers[i]->mLayerBuffer = NULL;
+        delete layers[i];
+    }
+    delete display;
+}
+
+TEST_F(HwcUnitTest, ExynosDisplay_skipStaticLayers) {
+    uint32_t id = getDisplayId(HWC_DISPLAY_PRIMARY, 0);
+    DisplayIdentifier node = {id, HWC_DISPLAY_PRIMARY, 0,
+                              String8("PrimaryDisplay"),
+                              String8("fake_decon_fb")};
+    ExynosDisplay *display = new ExynosDisplay(node);
+    DisplayInfo display_info;
+    display->getDisplayInfo(display_info);
+    display->mDisplayControl.skipStaticLayers = true;
+    display->mGeometryChanged = 0;
+
+    ExynosLayer *layers[2];
+    for (uint32_t i = 0; i < 2; i++) {
+        layers[i] = new ExynosLayer(display_info);
+        layers[i]->mLayerBuffer = (buffer_handle_t)(uintptr_t)(0x1000 * (i + 1));
+        layers[i]->mValidateCompositionType = HWC2_COMPOSITION_CLIENT;
+        layers[i]->updateFingerprint();
+        display->mLayers.add(layers[i]);
+    }
+    ExynosCompositionInfo &client = display->mClientCompositionInfo;
+    client.mEnableSkipStatic = true;
+    client.mHasCompositionLayer = true;
+    client.mFirstIndex = 0;
+    client.mLastIndex = 1;
+
+    /* Layers are stored in the first frame and skipped in the next one */
+    EXPECT_EQ(display->skipStaticLayers(client), NO_ERROR);
+    EXPECT_FALSE(client.mSkipFlag);
+    EXPECT_EQ(display->skipStaticLayers(client), NO_ERROR);
+    EXPECT_TRUE(client.mSkipFlag);
+
+    /* Another handle with the same fingerprint is a change */
+    layers[1]->mLayerBuffer = (buffer_handle_t)(uintptr_t)0x3000;
+    EXPECT_EQ(display->skipStaticLayers(client), NO_ERROR);
+    EXPECT_FALSE(client.mSkipFlag);
+    EXPECT_FALSE(client.mSkipStaticInitFlag);
+
+    layers[1]->mLayerBuffer = (buffer_handle_t)(uintptr_t)0x2000;
+    EXPECT_EQ(display->skipStaticLayers(client), NO_ERROR);
+    EXPECT_EQ(display->skipStaticLayers(client), NO_ERROR);
+    EXPECT_TRUE(client.mSkipFlag);
+
+    /* Buffer latched again with the same handle */
+    layers[0]->mAcquireFence = 0;
+    EXPECT_EQ(display->skipStaticLayers(client), NO_ERROR);
+    EXPECT_FALSE(client.mSkipFlag);
+    layers[0]->mAcquireFence = -1;
+
+    display->mLayers.clear();
+    for (uint32_t i = 0; i < 2; i++) {
+        layers[i]->mLayerBuffer = NULL;
+        delete layers[i];
+    }
+    delete display;
+}
+
+TEST_F(HwcUnitTest, ExynosRecompPolicy_decide) {
+    ExynosUpdateRate rate;
+    for (uint32_t i = 0; i < 10; i++)
+        rate.update(s2ns(1) + ms2ns(100 * i));
+    EXPECT_EQ(rate.getRate(s2ns(1) + ms2ns(950)), 10u);
+    EXPECT_EQ(rate.getRate(s2ns(2) + ms2ns(500)), 4u);
+    EXPECT_EQ(rate.getLastUpdateTime(), s2ns(1) + ms2ns(900));
+
+    const nsecs_t idleTimeout = ms2ns(DYNAMIC_RECOMP_TIMER_MS);
+    ExynosRecompPolicy policy(idleTimeout);
+    EXPECT_EQ(policy.getIdleTimeout(), idleTimeout);
+    ExynosRecompPolicy::CostInfo info;
+    info.targetBytes = 1080 * 2400 * 4;
+    info.refreshRate = 60;
+
+    /* Client composition of a single full screen layer can't save bandwidth */
+    info.layerBytes = info.targetBytes;
+    EXPECT_FALSE(policy.shouldFlatten(s2ns(1), 0, info));
+
+    /* Four full screen layers, expected rate is 2 after 500ms of idle time */
+    info.layerBytes = info.targetBytes * 4;
+    EXPECT_FALSE(policy.shouldFlatten(idleTimeout / 2, 30, info));
+    EXPECT_TRUE(policy.shouldFlatten(idleTimeout, 30, info));
+
+    nsecs_t now = s2ns(10);
+    policy.setMode(ExynosRecompPolicy::MODE_CLIENT, ExynosRecompPolicy::REASON_STATIC, now);
+    EXPECT_FALSE(policy.shouldFlatten(s2ns(1), 0, info));
+    EXPECT_EQ(policy.getRevertReason(1, info), (uint32_t)ExynosRecompPolicy::REASON_NONE);
+    EXPECT_EQ(policy.getRevertReason(DR_REVERT_UPDATE_RATE, info),
+              (uint32_t)ExynosRecompPolicy::REASON_UPDATE_RATE);
+
+    /* Quick revert doubles the idle timeout */
+    policy.setMode(ExynosRecompPolicy::MODE_DEVICE, ExynosRecompPolicy::REASON_UPDATE_RATE,
+                   now + ms2ns(DR_OSCILLATION_MS / 2));
+    EXPECT_EQ(policy.getIdleTimeout(), idleTimeout * 2);
+    EXPECT_FALSE(policy.shouldFlatten(idleTimeout, 0, info));
+
+    /* It goes back to the default, not shorter than that */
+    policy.setMode(ExynosRecompPolicy::MODE_CLIENT, ExynosRecompPolicy::REASON_STATIC, now + s2ns(1));
+    policy.setMode(ExynosRecompPolicy::MODE_DEVICE, ExynosRecompPolicy::REASON_UPDATE_RATE, now + s2ns(3));
+    EXPECT_EQ(policy.getIdleTimeout(), idleTimeout);
+    policy.setMode(ExynosRecompPolicy::MODE_CLIENT, ExynosRecompPolicy::REASON_STATIC, now + s2ns(4));
+    policy.setMode(ExynosRecompPolicy::MODE_DEVICE, ExynosRecompPolicy::REASON_UPDATE_RATE, now + s2ns(6));
+    EXPECT_EQ(policy.getIdleTimeout(), idleTimeout);
+
+    String8 result;
+    policy.dump(result);
+}
+
+TEST_F(HwcUnitTest, ExynosPresentScheduler_hold) {
+    ExynosCommitLatency latency;
+    EXPECT_EQ(latency.getEstimate(), us2ns(PRESENT_DEFAULT_LATENCY_US));
+    for (uint32_t i = 1; i <= 10; i++)
+        latency.update(ms2ns(i));
+    EXPECT_EQ(latency.getEstimate(), ms2ns(9));
+    EXPECT_EQ(latency.getMax(), ms2ns(10));
+
+    ExynosPresentScheduler scheduler;
+    scheduler.setExpectedPresentTime(s2ns(1));
+    EXPECT_EQ(scheduler.takeExpectedPresentTime(), s2ns(1));
+    EXPECT_EQ(scheduler.takeExpectedPresentTime(), 0);
+
+    /* Frame is held until the deadline before the target vsync */
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    nsecs_t target = now + ms2ns(20);
+    nsecs_t deadline = scheduler.getDeadline(target);
+    EXPECT_EQ(deadline, target - us2ns(PRESENT_DEFAULT_LATENCY_US + PRESENT_DEADLINE_MARGIN_US));
+    scheduler.hold(target, now);
+    EXPECT_GE(systemTime(SYSTEM_TIME_MONOTONIC), deadline);
+    /* Latency is measured from the atomic commit, the hold time is not included */
+    nsecs_t commit = systemTime(SYSTEM_TIME_MONOTONIC);
+    scheduler.onCommit(commit);
+    scheduler.onCommitDone(commit + ms2ns(2));
+    EXPECT_EQ(scheduler.getMissCount(), 0u);
+    EXPECT_EQ(scheduler.getDeadline(target), target - ms2ns(2) - us2ns(PRESENT_DEADLINE_MARGIN_US));
+
+    /* Return of a commit that is not started is not measured */
+    scheduler.onCommitDone(commit + ms2ns(30));
+    EXPECT_EQ(scheduler.getDeadline(target), target - ms2ns(2) - us2ns(PRESENT_DEADLINE_MARGIN_US));
+
+    /* Late frame is not held and misses the target vsync */
+    now = systemTime(SYSTEM_TIME_MONOTONIC);
+    scheduler.hold(now + us2ns(100), now);
+    scheduler.onCommit(now);
+    scheduler.onCommitDone(now + ms2ns(1));
+    EXPECT_EQ(scheduler.getMissCount(), 1u);
+
+    /* Held frame is released by cancel() */
+    now = systemTime(SYSTEM_TIME_MONOTONIC);
+    std::thread canceler([&scheduler] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        scheduler.cancel();
+    });
+    scheduler.hold(now + ms2ns(PRESENT_MAX_HOLD_MS / 2), now);
+    canceler.join();
+    EXPECT_LT(systemTime(SYSTEM_TIME_MONOTONIC), now + ms2ns(PRESENT_MAX_HOLD_MS / 2) - ms2ns(10));
+
+    /* cancel() without a held frame, as on power off, is dropped on power on */
+    scheduler.cancel();
+    scheduler.resume();
+    now = systemTime(SYSTEM_TIME_MONOTONIC);
+    target = now + ms2ns(20);
+    deadline = scheduler.getDeadline(target);
+    scheduler.hold(target, now);
+    EXPECT_GE(systemTime(SYSTEM_TIME_MONOTONIC), deadline);
+
+    String8 result;
+    scheduler.dump(result);
+}
+
+TEST_F(HwcUnitTest, HalImpl_setExpectedPresentTime) {
+    using aidl::android::hardware::graphics::composer3::ClockMonotonicTimestamp;
+    using aidl::android::hardware::graphics::composer3::impl::HalImpl;
+
+    ExynosDevice* device = new ExynosDevice();
+    uint32_t id = getDisplayId(HWC_DISPLAY_PRIMARY, 0);
+    DisplayIdentifier node = {id, HWC_DISPLAY_PRIMARY, 0,
+                              String8("PrimaryDisplay"),
+                              String8("fake_decon_fb")};
+    ExynosDisplay* display = device->getDisplay(id);
+    if (display == nullptr) {
+        display = new ExynosDisplay(node);
+        device->mDisplayMap[id] = display;
+    }
+    HalImpl hal(std::unique_ptr<ExynosDevice>(device));
+
+    /* Expected present time of the frontend reaches the present scheduler */
+    nsecs_t expected = systemTime(SYSTEM_TIME_MONOTONIC) + ms2ns(16);
+    EXPECT_EQ(hal.setExpectedPresentTime(id, ClockMonotonicTimestamp{expected}), HWC2_ERROR_NONE);
+    EXPECT_EQ(display->mPresentScheduler.takeExpectedPresentTime(), expected);
+
+    /* Frame without expected present time is committed immediately */
+    EXPECT_EQ(hal.setExpectedPresentTime(id, ClockMonotonicTimestamp{expected}), HWC2_ERROR_NONE);
+    EXPECT_EQ(hal.setExpectedPresentTime(id, std::nullopt), HWC2_ERROR_NONE);
+    EXPECT_EQ(display->mPresentScheduler.takeExpectedPresentTime(), 0);
+
+    EXPECT_EQ(hal.setExpectedPresentTime(getDisplayId(HWC_DISPLAY_VIRTUAL, 7), std::nullopt),
+              HWC2_ERROR_BAD_DISPLAY);
+}
+
 TEST_F(HwcUnitTest, ExynosMPP) {
     ExynosMPP* tmp = new ExynosMPP(MPP_DPP_G, MPP_LOGICAL_DPP_G, "DPP_G0", 0, 0,
                                    HWC_DISPLAY_PRIMARY_BIT, MPP_TYPE_OTF);
@@ -404,6 +1936,80 @@ TEST_F(HwcUnitTest, ExynosMPP) {
 }
 
 
+TEST_F(HwcUnitTest, ExynosMPP_asyncPostProcessing) {
+    ExynosMPP* mpp = new ExynosMPP(MPP_G2D, MPP_LOGICAL_G2D_RGB, "G2D0", 0, 0,
+                                   HWC_DISPLAY_PRIMARY_BIT, MPP_TYPE_M2M);
+    ExynosMPP* msc = new ExynosMPP(MPP_MSC, MPP_LOGICAL_MSC, "MSC0", 0, 0,
+                                   HWC_DISPLAY_PRIMARY_BIT, MPP_TYPE_M2M);
+    ASSERT_TRUE(mpp->mAsyncPostProcessing);
+    ASSERT_TRUE(msc->mAsyncPostProcessing);
+
+    /* Frame info that is saved for a failed job is reset when the result is waited */
+    mpp->mPrevFrameInfo.srcNum = 1;
+    mpp->requestPostProcessing();
+    EXPECT_LT(mpp->waitPostProcessing(), 0);
+    EXPECT_EQ(mpp->mPrevFrameInfo.srcNum, 0u);
+    EXPECT_EQ(mpp->waitPostProcessing(), NO_ERROR);
+
+    /* closeFences() waits for the requested job before it closes the fences */
+    mpp->mPrevFrameInfo.srcNum = 1;
+    mpp->requestPostProcessing();
+    mpp->closeFences();
+    EXPECT_EQ(mpp->mPrevFrameInfo.srcNum, 0u);
+    EXPECT_EQ(mpp->waitPostProcessing(), NO_ERROR);
+
+    /* Jobs of MPPs share one worker, each MPP gets the result of its own job */
+    mpp->mPrevFrameInfo.srcNum = 1;
+    msc->mPrevFrameInfo.srcNum = 1;
+    mpp->requestPostProcessing();
+    msc->requestPostProcessing();
+    EXPECT_LT(msc->waitPostProcessing(), 0);
+    EXPECT_EQ(msc->mPrevFrameInfo.srcNum, 0u);
+    EXPECT_EQ(mpp->mPrevFrameInfo.srcNum, 1u);
+    EXPECT_LT(mpp->waitPostProcessing(), 0);
+    EXPECT_EQ(mpp->mPrevFrameInfo.srcNum, 0u);
+
+    delete msc;
+    delete mpp;
+}
+
+TEST_F(HwcUnitTest, ExynosMPP_increaseDstBuffIndex) {
+    ExynosMPP* mpp = new ExynosMPP(MPP_G2D, MPP_LOGICAL_G2D_RGB, "G2D0", 0, 0,
+                                   HWC_DISPLAY_PRIMARY_BIT, MPP_TYPE_M2M);
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+
+    /* Buffers are used in turn while all of them are released */
+    EXPECT_EQ(mpp->increaseDstBuffIndex(), 1u);
+    EXPECT_EQ(mpp->increaseDstBuffIndex(), 2u);
+    EXPECT_EQ(mpp->mLastDstBuf, 1);
+
+    /* The oldest buffer is still scanned out, the oldest released one is used */
+    mpp->mDstImgs[0].acrylicReleaseFenceFd = fds[0];
+    EXPECT_EQ(mpp->increaseDstBuffIndex(), 1u);
+    EXPECT_EQ(mpp->mLastDstBuf, 2);
+
+    /* The oldest buffer is used if no buffer is released */
+    mpp->mDstImgs[2].acrylicReleaseFenceFd = fds[0];
+    EXPECT_EQ(mpp->increaseDstBuffIndex(), 0u);
+
+    /* Both are released, buffer 2 is older than buffer 1 */
+    ASSERT_EQ(write(fds[1], "s", 1), 1);
+    EXPECT_EQ(mpp->increaseDstBuffIndex(), 2u);
+    mpp->mDstImgs[0].acrylicReleaseFenceFd = -1;
+    mpp->mDstImgs[2].acrylicReleaseFenceFd = -1;
+
+    /* The last buffer is updated even if the MPP doesn't have its own buffers */
+    mpp->mAllocOutBufFlag = false;
+    mpp->mCurrentDstBuf = 1;
+    EXPECT_EQ(mpp->increaseDstBuffIndex(), 1u);
+    EXPECT_EQ(mpp->mLastDstBuf, 1);
+
+    close(fds[0]);
+    close(fds[1]);
+    delete mpp;
+}
+
 TEST_F(HwcUnitTest, ExynosFenceTracer) {
     ExynosFenceTracer* tmp = new ExynosFenceTracer();
     timeval tv;
@@ -418,6 +2024,236 @@ TEST_F(HwcUnitTest, ExynosFenceTracer) {
     delete tmp;
 }
 
+TEST_F(HwcUnitTest, ExynosFenceTracer_leakCount) {
+    ExynosFenceTracer* tmp = new ExynosFenceTracer();
+    DisplayIdentifier primary, external;
+    primary.id = getDisplayId(HWC_DISPLAY_PRIMARY, 0);
+    external.id = getDisplayId(HWC_DISPLAY_EXTERNAL, 0);
+
+    int fd = open("/dev/null", O_RDONLY);
+    ASSERT_GE(fd, 3);
+    tmp->setFenceInfo(fd, primary, FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_LAYER, FENCE_FROM);
+    EXPECT_EQ(tmp->getLeakingFenceCount(primary), 1u);
+    EXPECT_EQ(tmp->getLeakingFenceCount(external), 0u);
+
+    /* Fence moves to other display */
+    tmp->changeFenceInfoState(fd, external, FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_LAYER, FENCE_DUP);
+    EXPECT_EQ(tmp->getLeakingFenceCount(primary), 0u);
+    EXPECT_EQ(tmp->getLeakingFenceCount(external), 1u);
+
+    tmp->setFenceInfo(fd, external, FENCE_TYPE_SRC_ACQUIRE, FENCE_IP_LAYER, FENCE_TO, true);
+    EXPECT_EQ(tmp->getLeakingFenceCount(external), 0u);
+    EXPECT_TRUE(tmp->validateFencePerFrame(external));
+
+    close(fd);
+    delete tmp;
+}
+
+/* Composites the source images with the CPU Acrylic onto a target image of the same size */
+struct AcrylicTestImage {
+    uint32_t format;
+    std::vector<uint8_t> data;
+};
+
+struct AcrylicTestLayer {
+    AcrylicTestImage image;
+    uint32_t blend;
+    uint8_t planeAlpha;
+};
+
+static bool compositeWithAcrylicCPU(std::vector<AcrylicTestLayer> layers, int32_t width,
+                                    int32_t height, AcrylicTestImage &target) {
+    const int dataspace = HAL_DATASPACE_STANDARD_BT709 | HAL_DATASPACE_RANGE_LIMITED;
+    std::unique_ptr<Acrylic> acrylic(Acrylic::createInstance("cpu"));
+    if (!acrylic)
+        return false;
+
+    void *addr[MAX_HW2D_PLANES] = {target.data.data()};
+    size_t len[MAX_HW2D_PLANES] = {target.data.size()};
+    if (!acrylic->setCanvasDimension(width, height) ||
+        !acrylic->setCanvasImageType(target.format, dataspace) ||
+        !acrylic->setCanvasBuffer(addr, len, 1))
+        return false;
+    acrylic->setDefaultColor(0, 0, 0, 0);
+
+    std::vector<std::unique_ptr<AcrylicLayer>> acrylicLayers;
+    for (size_t i = 0; i < layers.size(); i++) {
+        AcrylicLayer *layer = acrylic->createLayer();
+        if (!layer)
+            return false;
+        acrylicLayers.emplace_back(layer);
+
+        hwc_rect_t rect = {0, 0, width, height};
+        addr[0] = layers[i].image.data.data();
+        len[0] = layers[i].image.data.size();
+        if (!layer->setImageDimension(width, height) ||
+            !layer->setImageType(layers[i].image.format, dataspace) ||
+            !layer->setImageBuffer(addr, len, 1) ||
+            !layer->setCompositMode(layers[i].blend, layers[i].planeAlpha, i) ||
+            !layer->setCompositArea(rect, rect))
+            return false;
+    }
+
+    return acrylic->execute();
+}
+
+TEST_F(HwcUnitTest, AcrylicCompositorCPU_formats) {
+    /*
+     * 2x2 image in each format, its RGBA8888 decoding and the encoding of the decoded
+     * image back to the format if it differs from the image.
+     */
+    struct {
+        AcrylicTestImage image;
+        std::vector<uint8_t> rgba;
+        std::vector<uint8_t> encoded;
+    } references[] = {
+        {{HAL_PIXEL_FORMAT_RGBA_8888, {0xFF, 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0x80,
+                                       0x00, 0x00, 0xFF, 0x40, 0x12, 0x34, 0x56, 0x00}},
+         {0xFF, 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0x80,
+          0x00, 0x00, 0xFF, 0x40, 0x12, 0x34, 0x56, 0x00}},
+        {{HAL_PIXEL_FORMAT_RGBX_8888, {0xFF, 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF,
+                                       0x00, 0x00, 0xFF, 0xFF, 0x12, 0x34, 0x56, 0xFF}},
+         {0xFF, 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF,
+          0x00, 0x00, 0xFF, 0xFF, 0x12, 0x34, 0x56, 0xFF}},
+        {{HAL_PIXEL_FORMAT_BGRA_8888, {0x00, 0x00, 0xFF, 0xFF, 0x00, 0xFF, 0x00, 0x80,
+                                       0xFF, 0x00, 0x00, 0x40, 0x56, 0x34, 0x12, 0x00}},
+         {0xFF, 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0x80,
+          0x00, 0x00, 0xFF, 0x40, 0x12, 0x34, 0x56, 0x00}},
+        {{HAL_PIXEL_FORMAT_RGB_888, {0xFF, 0x00, 0x00, 0x00, 0xFF, 0x00,
+                                     0x00, 0x00, 0xFF, 0x12, 0x34, 0x56}},
+         {0xFF, 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF,
+          0x00, 0x00, 0xFF, 0xFF, 0x12, 0x34, 0x56, 0xFF}},
+        {{HAL_PIXEL_FORMAT_RGB_565, {0x00, 0xF8, 0xE0, 0x07, 0x1F, 0x00, 0xAA, 0x11}},
+         {0xFF, 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF,
+          0x00, 0x00, 0xFF, 0xFF, 0x10, 0x35, 0x52, 0xFF}},
+        {{HAL_PIXEL_FORMAT_RGBA_1010102, {0xFF, 0x03, 0x00, 0xC0, 0x00, 0xFC, 0x0F, 0x80,
+                                          0x00, 0x00, 0xF0, 0x7F, 0x48, 0x44, 0x93, 0x15}},
+         {0xFF, 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0xAA,
+          0x00, 0x00, 0xFF, 0x55, 0x12, 0x34, 0x56, 0x00}},
+        {{HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP, {0x50, 0x60, 0x70, 0x80, 0x70, 0x90}},
+         {0x67, 0x45, 0x29, 0xFF, 0x7A, 0x58, 0x3B, 0xFF,
+          0x8C, 0x6B, 0x4E, 0xFF, 0x9F, 0x7D, 0x61, 0xFF}},
+        {{HAL_PIXEL_FORMAT_YCrCb_420_SP, {0x50, 0x60, 0x70, 0x80, 0x90, 0x70}},
+         {0x67, 0x45, 0x29, 0xFF, 0x7A, 0x58, 0x3B, 0xFF,
+          0x8C, 0x6B, 0x4E, 0xFF, 0x9F, 0x7D, 0x61, 0xFF}},
+        {{HAL_PIXEL_FORMAT_YCBCR_P010, {0x00, 0x50, 0x00, 0x60, 0x00, 0x70, 0x00, 0x80,
+                                        0x00, 0x70, 0x00, 0x90}},
+         {0x67, 0x45, 0x29, 0xFF, 0x79, 0x58, 0x3B, 0xFF,
+          0x8C, 0x6A, 0x4E, 0xFF, 0x9F, 0x7D, 0x60, 0xFF},
+         /* 10-bit samples are not restored from 8-bit components */
+         {0xC0, 0x4F, 0xC0, 0x5F, 0x80, 0x6F, 0xC0, 0x7F, 0x00, 0x70, 0x00, 0x90}},
+    };
+
+    for (auto &reference : references) {
+        SCOPED_TRACE(testing::Message() << "format " << std::hex << reference.image.format);
+
+        AcrylicTestImage rgba = {HAL_PIXEL_FORMAT_RGBA_8888, std::vector<uint8_t>(16, 0)};
+        ASSERT_TRUE(compositeWithAcrylicCPU({{reference.image, HWC2_BLEND_MODE_PREMULTIPLIED, 0xFF}},
+                                            2, 2, rgba));
+        EXPECT_EQ(rgba.data, reference.rgba);
+
+        AcrylicTestImage encoded = {reference.image.format,
+                                    std::vector<uint8_t>(reference.image.data.size(), 0)};
+        ASSERT_TRUE(compositeWithAcrylicCPU({{{HAL_PIXEL_FORMAT_RGBA_8888, reference.rgba},
+                                              HWC2_BLEND_MODE_PREMULTIPLIED, 0xFF}}, 2, 2, encoded));
+        EXPECT_EQ(encoded.data,
+                  reference.encoded.empty() ? reference.image.data : reference.encoded);
+    }
+}
+
+TEST_F(HwcUnitTest, AcrylicCompositorCPU_blending) {
+    AcrylicTestImage bottom = {HAL_PIXEL_FORMAT_RGBA_8888, {0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+                                                            0x00, 0x00, 0x00, 0xFF, 0x40, 0x80, 0xC0, 0xFF}};
+    AcrylicTestImage top = {HAL_PIXEL_FORMAT_RGBA_8888, {0x80, 0x00, 0x00, 0x80, 0x00, 0x40, 0x00, 0x40,
+                                                         0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00}};
+    /* top blended onto the opaque bottom with the blending mode and the plane alpha */
+    struct {
+        uint32_t blend;
+        uint8_t planeAlpha;
+        std::vector<uint8_t> result;
+    } references[] = {
+        {HWC2_BLEND_MODE_NONE, 0xFF, {0x80, 0x00, 0x00, 0xFF, 0x00, 0x40, 0x00, 0xFF,
+                                      0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0xFF}},
+        {HWC2_BLEND_MODE_NONE, 0x80, {0x40, 0x00, 0x7F, 0xFF, 0x7F, 0x9F, 0x7F, 0xFF,
+                                      0x80, 0x80, 0x80, 0xFF, 0x20, 0x40, 0x60, 0xFF}},
+        {HWC2_BLEND_MODE_PREMULTIPLIED, 0xFF, {0x80, 0x00, 0x7F, 0xFF, 0xBF, 0xFF, 0xBF, 0xFF,
+                                               0xFF, 0xFF, 0xFF, 0xFF, 0x40, 0x80, 0xC0, 0xFF}},
+        {HWC2_BLEND_MODE_PREMULTIPLIED, 0x80, {0x40, 0x00, 0xBF, 0xFF, 0xDF, 0xFF, 0xDF, 0xFF,
+                                               0x80, 0x80, 0x80, 0xFF, 0x40, 0x80, 0xC0, 0xFF}},
+        {HWC2_BLEND_MODE_COVERAGE, 0xFF, {0x40, 0x00, 0x7F, 0xFF, 0xBF, 0xCF, 0xBF, 0xFF,
+                                          0xFF, 0xFF, 0xFF, 0xFF, 0x40, 0x80, 0xC0, 0xFF}},
+        {HWC2_BLEND_MODE_COVERAGE, 0x80, {0x20, 0x00, 0xBF, 0xFF, 0xDF, 0xE7, 0xDF, 0xFF,
+                                          0x80, 0x80, 0x80, 0xFF, 0x40, 0x80, 0xC0, 0xFF}},
+    };
+
+    for (auto &reference : references) {
+        SCOPED_TRACE(testing::Message() << "blend " << reference.blend << " plane alpha "
+                                        << (int)reference.planeAlpha);
+
+        AcrylicTestImage target = {HAL_PIXEL_FORMAT_RGBA_8888, std::vector<uint8_t>(16, 0)};
+        ASSERT_TRUE(compositeWithAcrylicCPU({{bottom, HWC2_BLEND_MODE_NONE, 0xFF},
+                                             {top, reference.blend, reference.planeAlpha}},
+                                            2, 2, target));
+        EXPECT_EQ(target.data, reference.result);
+    }
+}
+
+TEST_F(HwcUnitTest, AcrylicCompositorCPU_workers) {
+    /* Several decoding jobs and tiles of 32 rows per execution are run by the worker threads */
+    const int32_t width = 8, height = 258;
+    AcrylicTestImage source = {HAL_PIXEL_FORMAT_RGBA_8888, std::vector<uint8_t>(width * height * 4)};
+    for (size_t i = 0; i < source.data.size(); i++)
+        source.data[i] = (i % 4 == 3) ? 0xFF : static_cast<uint8_t>(i * 7);
+
+    for (int i = 0; i < 3; i++) {
+        AcrylicTestImage target = {HAL_PIXEL_FORMAT_RGBA_8888, std::vector<uint8_t>(source.data.size(), 0)};
+        ASSERT_TRUE(compositeWithAcrylicCPU({{source, HWC2_BLEND_MODE_NONE, 0xFF}}, width, height, target));
+        EXPECT_EQ(target.data, source.data);
+    }
+}
+
+/* Acrylic that exposes the target display information given to the implementation */
+class TargetDisplayAcrylic : public Acrylic {
+  public:
+    TargetDisplayAcrylic(const HW2DCapability &capability) : Acrylic(capability){};
+    virtual bool execute(int __unused fence[], unsigned int __unused num_fences) { return false; };
+    virtual bool execute(int __unused *handle = NULL) { return false; };
+    virtual bool waitExecution(int __unused handle) { return false; };
+    using Acrylic::getTargetDisplayDevice;
+    using Acrylic::getTargetDisplayInfo;
+    using Acrylic::hasTargetDisplayDevice;
+};
+
+TEST_F(HwcUnitTest, Acrylic_setTargetDisplayDevice) {
+    std::unique_ptr<Acrylic> cpu(Acrylic::createInstance("cpu"));
+    ASSERT_NE(cpu, nullptr);
+    TargetDisplayAcrylic acrylic(cpu->getCapabilities());
+    EXPECT_EQ(acrylic.getTargetDisplayInfo(), nullptr);
+    EXPECT_FALSE(acrylic.hasTargetDisplayDevice());
+
+    /* The device is kept after the variable of the caller is gone */
+    {
+        int device = 1;
+        acrylic.setTargetDisplayDevice(device);
+    }
+    void *info = acrylic.getTargetDisplayInfo();
+    ASSERT_NE(info, nullptr);
+    EXPECT_TRUE(acrylic.hasTargetDisplayDevice());
+    EXPECT_EQ(*static_cast<int *>(info), 1);
+
+    /* Another device is on the same storage, it is compared by the device */
+    acrylic.setTargetDisplayDevice(0);
+    EXPECT_EQ(acrylic.getTargetDisplayInfo(), info);
+    EXPECT_EQ(acrylic.getTargetDisplayDevice(), 0);
+    EXPECT_EQ(*static_cast<int *>(info), 0);
+
+    /* Opaque information is not a device */
+    int opaque = 0;
+    acrylic.setTargetDisplayInfo(&opaque);
+    EXPECT_EQ(acrylic.getTargetDisplayInfo(), &opaque);
+    EXPECT_FALSE(acrylic.hasTargetDisplayDevice());
+}
+
 TEST_F(HwcUnitTest, ExynosHWCHelper) {
     min(1,1);
 
@@ -446,6 +2282,28 @@ TEST_F(HwcUnitTest, ExynosHWCHelper) {
     halBlendingToDpuBlending(0);
 }
 
+TEST_F(HwcUnitTest, LatencyHistogram) {
+    for (uint64_t usec = 0; usec < 100000; usec++) {
+        uint32_t index = LatencyHistogram::getBucketIndex(usec);
+        EXPECT_GT(LatencyHistogram::getBucketUpperBound(index), usec);
+        if (index > 0)
+            EXPECT_LE(LatencyHistogram::getBucketUpperBound(index - 1), usec);
+    }
+    EXPECT_EQ(LatencyHistogram::getBucketIndex(UINT64_MAX), (uint32_t)(LATENCY_BUCKET_NUM - 1));
+
+    LatencyRecorder recorder;
+    for (uint32_t i = 1; i <= 100; i++)
+        recorder.record(LATENCY_STAGE_ASSIGN_RESOURCE, us2ns(i * 100));
+    String8 result;
+    recorder.dump(result);
+    EXPECT_NE(strstr(result.string(), "assignResource       count(100)"), nullptr);
+
+    recorder.reset();
+    result.clear();
+    recorder.dump(result);
+    EXPECT_EQ(strstr(result.string(), "count(100)"), nullptr);
+}
+
 TEST_F(HwcUnitTest, updateFeatureTableAndRestrictions) {
     ExynosResourceManager *resourceManager = new ExynosResourceManagerModule();
     struct dpp_restrictions_info_v2 restrictions;
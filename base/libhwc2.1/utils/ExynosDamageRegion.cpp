@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ExynosDamageRegion.h"
+
+static inline int64_t getArea(const hwc_rect &rect) {
+    return static_cast<int64_t>(WIDTH(rect)) * HEIGHT(rect);
+}
+
+static inline bool contains(const hwc_rect &outer, const hwc_rect &inner) {
+    return (outer.left <= inner.left) && (outer.top <= inner.top) &&
+           (outer.right >= inner.right) && (outer.bottom >= inner.bottom);
+}
+
+void ExynosDamageRegion::add(const hwc_rect &rect) {
+    if ((rect.left >= rect.right) || (rect.top >= rect.bottom))
+        return;
+
+    for (auto &it : mRects) {
+        if (contains(it, rect))
+            return;
+    }
+    mRects.push_back(rect);
+
+    if (mRects.size() <= DAMAGE_REGION_MAX_RECTS)
+        return;
+
+    /* Merge two rects that add the smallest area */
+    size_t mergeIndex[2] = {0, 1};
+    int64_t minAddedArea = INT64_MAX;
+    for (size_t i = 0; i < mRects.size(); i++) {
+        for (size_t j = i + 1; j < mRects.size(); j++) {
+            int64_t addedArea = getArea(expand(mRects[i], mRects[j])) -
+                                getArea(mRects[i]) - getArea(mRects[j]);
+            if (addedArea < minAddedArea) {
+                minAddedArea = addedArea;
+                mergeIndex[0] = i;
+                mergeIndex[1] = j;
+            }
+        }
+    }
+    mRects[mergeIndex[0]] = expand(mRects[mergeIndex[0]], mRects[mergeIndex[1]]);
+    mRects.erase(mRects.begin() + mergeIndex[1]);
+}
+
+hwc_rect ExynosDamageRegion::getBounds() const {
+    hwc_rect bounds = {INT_MAX, INT_MAX, 0, 0};
+    for (auto &it : mRects)
+        bounds = expand(bounds, it);
+    return bounds;
+}
+
+hwc_rect ExynosDamageRegion::alignRect(const hwc_rect &rect, const PartialUpdateRestriction &restriction,
+                                       uint32_t xres, uint32_t yres) {
+    hwc_rect aligned;
+
+    aligned.left = pixel_align_down(std::max(rect.left, 0), restriction.xAlign);
+    aligned.top = pixel_align_down(std::max(rect.top, 0), restriction.yAlign);
+    aligned.right = aligned.left + pixel_align(rect.right - aligned.left, restriction.wAlign);
+    aligned.bottom = aligned.top + pixel_align(rect.bottom - aligned.top, restriction.hAlign);
+
+    if (restriction.fullWidth) {
+        aligned.left = 0;
+        aligned.right = xres;
+    }
+    aligned.right = std::min(aligned.right, static_cast<int>(xres));
+    aligned.bottom = std::min(aligned.bottom, static_cast<int>(yres));
+
+    return aligned;
+}
+
+uint64_t ExynosDamageRegion::getRegionCost(const hwc_rect &rect, uint32_t xres) {
+    return getArea(rect) + static_cast<uint64_t>(PARTIAL_UPDATE_REGION_COST_LINES) * xres;
+}
+
+uint32_t ExynosDamageRegion::plan(const PartialUpdateRestriction &restriction, uint32_t xres, uint32_t yres,
+                                  std::vector<hwc_rect> &outRects) const {
+    uint32_t type = UPDATE_FULL;
+    uint64_t minCost = static_cast<uint64_t>(xres) * yres;
+
+    outRects.clear();
+    if (mRects.empty() || (restriction.maxRegionNum == 0))
+        return UPDATE_FULL;
+
+    hwc_rect single = alignRect(getBounds(), restriction, xres, yres);
+    uint64_t cost = getRegionCost(single, xres);
+    if (cost < minCost) {
+        minCost = cost;
+        type = UPDATE_SINGLE;
+        outRects.push_back(single);
+    }
+
+    if ((restriction.maxRegionNum < 2) || (mRects.size() < 2))
+        return type;
+
+    /* Sort by top, then find the cut that makes two bands with the lowest cost */
+    hwc_rect sorted[DAMAGE_REGION_MAX_RECTS];
+    size_t num = mRects.size();
+    for (size_t i = 0; i < num; i++) {
+        size_t j = i;
+        for (; (j > 0) && (sorted[j - 1].top > mRects[i].top); j--)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = mRects[i];
+    }
+
+    for (size_t cut = 1; cut < num; cut++) {
+        hwc_rect top = {INT_MAX, INT_MAX, 0, 0};
+        hwc_rect bottom = {INT_MAX, INT_MAX, 0, 0};
+        for (size_t i = 0; i < num; i++) {
+            if (i < cut)
+                top = expand(top, sorted[i]);
+            else
+                bottom = expand(bottom, sorted[i]);
+        }
+        top = alignRect(top, restriction, xres, yres);
+        bottom = alignRect(bottom, restriction, xres, yres);
+        if (top.bottom > bottom.top)
+            continue;
+
+        cost = getRegionCost(top, xres) + getRegionCost(bottom, xres);
+        if (cost < minCost) {
+            minCost = cost;
+            type = UPDATE_SPLIT;
+            outRects.clear();
+            outRects.push_back(top);
+            outRects.push_back(bottom);
+        }
+    }
+
+    return type;
+}
+
+const char *ExynosDamageRegion::getUpdateTypeStr(uint32_t type) {
+    switch (type) {
+    case UPDATE_FULL:
+        return "full";
+    case UPDATE_SINGLE:
+        return "single";
+    case UPDATE_SPLIT:
+        return "split";
+    default:
+        return "unknown";
+    }
+}
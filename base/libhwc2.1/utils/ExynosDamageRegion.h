@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSDAMAGEREGION_H
+#define _EXYNOSDAMAGEREGION_H
+
+#include <vector>
+#include "ExynosHWCHelper.h"
+
+/* Damage rects more than this are merged to the nearest one */
+#ifndef DAMAGE_REGION_MAX_RECTS
+#define DAMAGE_REGION_MAX_RECTS 4
+#endif
+
+/*
+ * Fixed cost of one partial update region in lines of the display.
+ * Partial update isn't used unless it saves more than this.
+ */
+#ifndef PARTIAL_UPDATE_REGION_COST_LINES
+#define PARTIAL_UPDATE_REGION_COST_LINES 16
+#endif
+
+#define MAX_PARTIAL_UPDATE_REGIONS 2
+
+/* Restrictions of the partial update regions of the display */
+struct PartialUpdateRestriction {
+    /* Number of regions in a frame, 0 means partial update isn't supported */
+    uint32_t maxRegionNum = 1;
+    uint32_t xAlign = 1;
+    uint32_t yAlign = 1;
+    uint32_t wAlign = 1;
+    uint32_t hAlign = 1;
+    /* Region should cover the whole width of the display */
+    bool fullWidth = false;
+};
+
+/*
+ * Small set of damaged rects of a frame.
+ * plan() chooses the way to update the display with the lowest
+ * bandwidth among full, single rect and split (top/bottom bands) update.
+ */
+class ExynosDamageRegion {
+  public:
+    enum {
+        UPDATE_FULL = 0,
+        UPDATE_SINGLE,
+        UPDATE_SPLIT,
+        UPDATE_TYPE_MAX,
+    };
+
+    ExynosDamageRegion() { mRects.reserve(DAMAGE_REGION_MAX_RECTS + 1); };
+
+    void clear() { mRects.clear(); };
+    void add(const hwc_rect &rect);
+    bool isEmpty() const { return mRects.empty(); };
+    const std::vector<hwc_rect> &getRects() const { return mRects; };
+    hwc_rect getBounds() const;
+
+    /* outRects are aligned regions, it is empty for UPDATE_FULL */
+    uint32_t plan(const PartialUpdateRestriction &restriction, uint32_t xres, uint32_t yres,
+                  std::vector<hwc_rect> &outRects) const;
+
+    static hwc_rect alignRect(const hwc_rect &rect, const PartialUpdateRestriction &restriction,
+                              uint32_t xres, uint32_t yres);
+    static uint64_t getRegionCost(const hwc_rect &rect, uint32_t xres);
+    static const char *getUpdateTypeStr(uint32_t type);
+
+  private:
+    std::vector<hwc_rect> mRects;
+};
+
+#endif  // _EXYNOSDAMAGEREGION_H
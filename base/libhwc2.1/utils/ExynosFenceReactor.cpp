@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
+#include <utils/Trace.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <log/log.h>
+#include "ExynosFenceReactor.h"
+#include "ExynosHWCDebug.h"
+
+ANDROID_SINGLETON_STATIC_INSTANCE(ExynosFenceReactor);
+
+#define FENCE_REACTOR_MAX_EVENTS 16
+
+ExynosFenceReactor::ExynosFenceReactor() {
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    mEventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if ((mEpollFd < 0) || (mEventFd < 0)) {
+        ALOGE("%s:: failed to create epoll(%d) or eventfd(%d): %s",
+              __func__, mEpollFd, mEventFd, strerror(errno));
+        return;
+    }
+
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = mEventFd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mEventFd, &event) < 0) {
+        ALOGE("%s:: failed to add eventfd: %s", __func__, strerror(errno));
+        return;
+    }
+
+    mThread = std::thread(&ExynosFenceReactor::threadLoop, this);
+}
+
+ExynosFenceReactor::~ExynosFenceReactor() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRunning = false;
+    }
+    wakeUp();
+    if (mThread.joinable())
+        mThread.join();
+
+    ExynosFenceTracer &fenceTracer = ExynosFenceTracer::getInstance();
+    for (auto &it : mPendingFences) {
+        PendingFence &pending = it.second;
+        fenceTracer.fence_close(pending.fence, pending.display, pending.type, pending.ip,
+                                "fenceReactor::~ExynosFenceReactor: pending fence");
+    }
+    mPendingFences.clear();
+
+    if (mEventFd >= 0)
+        close(mEventFd);
+    if (mEpollFd >= 0)
+        close(mEpollFd);
+}
+
+void ExynosFenceReactor::wakeUp() {
+    uint64_t value = 1;
+    if (write(mEventFd, &value, sizeof(value)) < 0)
+        ALOGE("%s:: failed to write eventfd: %s", __func__, strerror(errno));
+}
+
+void ExynosFenceReactor::add(int fence, const DisplayIdentifier &display,
+                             hwc_fdebug_fence_type type, hwc_fdebug_ip_type ip,
+                             const std::string &name, const void *owner, Callback callback) {
+    ExynosFenceTracer &fenceTracer = ExynosFenceTracer::getInstance();
+
+    if (!fenceTracer.fence_valid(fence)) {
+        if (callback)
+            post(owner, callback);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mPendingFences.find(fence) != mPendingFences.end()) {
+        /* The fence is owned by the pending one, only the callback is handled as an error */
+        ALOGE("%s:: fence(%d) is already added", __func__, fence);
+        mErrorCount++;
+        if (callback)
+            mPostedCallbacks.push_back({owner, [=](int32_t) { callback(-EINVAL); }});
+        wakeUp();
+        return;
+    }
+
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fence;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fence, &event) < 0) {
+        /* The fence is handled as an error by the reactor thread */
+        ALOGE("%s:: failed to add fence(%d): %s", __func__, fence, strerror(errno));
+        mErrorCount++;
+        fenceTracer.fence_close(fence, display, type, ip, "fenceReactor::add: fence in error case");
+        if (callback)
+            mPostedCallbacks.push_back({owner, [=](int32_t) { callback(-EINVAL); }});
+        wakeUp();
+        return;
+    }
+
+    PendingFence &pending = mPendingFences[fence];
+    pending.fence = fence;
+    pending.display = display;
+    pending.type = type;
+    pending.ip = ip;
+    pending.owner = owner;
+    pending.callback = callback;
+    pending.latency = &mLatencies[name];
+    pending.addTime = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    HDEBUGLOGD(eDebugFence, "%s:: %s fence(%d) is added", __func__, name.c_str(), fence);
+
+    /* Timeout of the reactor thread should be updated */
+    if (mPendingFences.size() == 1)
+        wakeUp();
+}
+
+void ExynosFenceReactor::post(const void *owner, Callback callback) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPostedCallbacks.push_back({owner, callback});
+    }
+    wakeUp();
+}
+
+void ExynosFenceReactor::cancel(const void *owner) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (auto &it : mPendingFences) {
+        if (it.second.owner == owner)
+            it.second.callback = nullptr;
+    }
+    for (auto it = mPostedCallbacks.begin(); it != mPostedCallbacks.end();) {
+        if (it->owner == owner)
+            it = mPostedCallbacks.erase(it);
+        else
+            it++;
+    }
+    mDispatchCondition.wait(lock, [this] { return !mDispatching; });
+}
+
+uint32_t ExynosFenceReactor::getPendingFenceCount() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mPendingFences.size();
+}
+
+int ExynosFenceReactor::getWaitTimeoutLocked(nsecs_t now) {
+    if (mPendingFences.empty())
+        return -1;
+
+    nsecs_t oldest = now;
+    for (auto &it : mPendingFences)
+        oldest = std::min(oldest, it.second.addTime);
+
+    nsecs_t remaining = oldest + ms2ns(FENCE_REACTOR_TIMEOUT_MS) - now;
+    if (remaining <= 0)
+        return 0;
+    /* Round up not to wake up before the deadline */
+    return static_cast<int>((remaining + ms2ns(1) - 1) / ms2ns(1));
+}
+
+void ExynosFenceReactor::threadLoop() {
+    ALOGI("fenceReactor threadLoop is started");
+    ExynosFenceTracer &fenceTracer = ExynosFenceTracer::getInstance();
+    struct epoll_event events[FENCE_REACTOR_MAX_EVENTS];
+    std::vector<std::pair<PendingFence, int32_t>> done;
+    std::vector<PostedCallback> posted;
+
+    while (true) {
+        int timeout;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mRunning)
+                break;
+            timeout = getWaitTimeoutLocked(systemTime(SYSTEM_TIME_MONOTONIC));
+        }
+
+        int eventNum = epoll_wait(mEpollFd, events, FENCE_REACTOR_MAX_EVENTS, timeout);
+        if ((eventNum < 0) && (errno != EINTR)) {
+            ALOGE("%s:: epoll_wait error: %s", __func__, strerror(errno));
+            continue;
+        }
+
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            for (int i = 0; i < eventNum; i++) {
+                int fd = events[i].data.fd;
+                if (fd == mEventFd) {
+                    uint64_t value;
+                    if (read(mEventFd, &value, sizeof(value)) < 0)
+                        ALOGE("%s:: failed to read eventfd: %s", __func__, strerror(errno));
+                    continue;
+                }
+                auto it = mPendingFences.find(fd);
+                if (it == mPendingFences.end())
+                    continue;
+
+                int32_t status = NO_ERROR;
+                if (events[i].events & EPOLLERR) {
+                    status = -EINVAL;
+                    mErrorCount++;
+                } else {
+                    it->second.latency->record(now - it->second.addTime);
+                }
+                epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, NULL);
+                done.push_back(std::make_pair(it->second, status));
+                mPendingFences.erase(it);
+            }
+
+            for (auto it = mPendingFences.begin(); it != mPendingFences.end();) {
+                if ((now - it->second.addTime) < ms2ns(FENCE_REACTOR_TIMEOUT_MS)) {
+                    it++;
+                    continue;
+                }
+                HWC_LOGE_NODISP("%s:: fence(%d) is not signaled for %d ms", __func__,
+                                it->first, FENCE_REACTOR_TIMEOUT_MS);
+                mTimeoutCount++;
+                epoll_ctl(mEpollFd, EPOLL_CTL_DEL, it->first, NULL);
+                done.push_back(std::make_pair(it->second, -ETIME));
+                it = mPendingFences.erase(it);
+            }
+
+            posted.swap(mPostedCallbacks);
+            mDispatching = true;
+        }
+
+        /* Callbacks are called without the lock because they can add fences */
+        for (auto &it : done) {
+            PendingFence &pending = it.first;
+            if (pending.callback) {
+                ATRACE_NAME("fenceReactor: callback");
+                pending.callback(it.second);
+            }
+            fenceTracer.fence_close(pending.fence, pending.display, pending.type, pending.ip,
+                                    "fenceReactor::threadLoop: signaled fence");
+        }
+        for (auto &it : posted) {
+            if (it.callback)
+                it.callback(NO_ERROR);
+        }
+        done.clear();
+        posted.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mDispatching = false;
+        }
+        mDispatchCondition.notify_all();
+    }
+    ALOGI("fenceReactor threadLoop is ended");
+}
+
+void ExynosFenceReactor::dump(android::String8 &result) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    result.appendFormat("Fence reactor: pending(%zu), timeout(%" PRIu64 "), error(%" PRIu64 ")\n",
+                        mPendingFences.size(), mTimeoutCount, mErrorCount);
+    for (auto &it : mLatencies)
+        it.second.dump(result, it.first.c_str());
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSFENCEREACTOR_H
+#define _EXYNOSFENCEREACTOR_H
+
+#include <utils/Singleton.h>
+#include <utils/String8.h>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ExynosFenceTracer.h"
+#include "LatencyHistogram.h"
+
+/* Fence that isn't signaled for this time is handled as an error */
+#ifndef FENCE_REACTOR_TIMEOUT_MS
+#define FENCE_REACTOR_TIMEOUT_MS 5000
+#endif
+
+/*
+ * Waits for all of pending fences with one epoll thread and
+ * calls the callback of the fence when it is signaled.
+ * Signal latency of the fences is recorded for each name.
+ */
+class ExynosFenceReactor : public Singleton<ExynosFenceReactor> {
+  public:
+    /* status is NO_ERROR if the fence is signaled */
+    using Callback = std::function<void(int32_t status)>;
+
+    ExynosFenceReactor();
+    ~ExynosFenceReactor();
+
+    /*
+     * The reactor owns the fence. It is closed with the tracer
+     * after the callback is called on the reactor thread.
+     * callback can be null to record the latency only.
+     * If the fence can't be waited for, callback is called with -EINVAL.
+     */
+    void add(int fence, const DisplayIdentifier &display,
+             hwc_fdebug_fence_type type, hwc_fdebug_ip_type ip,
+             const std::string &name, const void *owner, Callback callback);
+    /*
+     * Calls callback on the reactor thread. owner is null for the callback
+     * that must not be dropped by cancel().
+     */
+    void post(const void *owner, Callback callback);
+    /*
+     * Drops callbacks of the owner. It returns after the callback
+     * of the owner that is being called is finished.
+     */
+    void cancel(const void *owner);
+
+    uint32_t getPendingFenceCount();
+    void dump(android::String8 &result);
+
+  private:
+    struct PendingFence {
+        int fence;
+        DisplayIdentifier display;
+        hwc_fdebug_fence_type type;
+        hwc_fdebug_ip_type ip;
+        const void *owner;
+        Callback callback;
+        LatencyHistogram *latency;
+        nsecs_t addTime;
+    };
+    struct PostedCallback {
+        const void *owner;
+        Callback callback;
+    };
+
+    void threadLoop();
+    /* Called with mMutex held */
+    int getWaitTimeoutLocked(nsecs_t now);
+    void wakeUp();
+
+    int mEpollFd = -1;
+    int mEventFd = -1;
+    std::thread mThread;
+
+    std::mutex mMutex;
+    std::condition_variable mDispatchCondition;
+    std::unordered_map<int, PendingFence> mPendingFences;
+    std::vector<PostedCallback> mPostedCallbacks;
+    /* Elements are never removed, so pointers are valid */
+    std::map<std::string, LatencyHistogram> mLatencies;
+    uint64_t mTimeoutCount = 0;
+    uint64_t mErrorCount = 0;
+    bool mDispatching = false;
+    bool mRunning = true;
+};
+
+#endif  // _EXYNOSFENCEREACTOR_H
@@ -43,36 +43,136 @@ extern uint64_t errorFrameCount;
     }
 ANDROID_SINGLETON_STATIC_INSTANCE(ExynosFenceTracer);
 
-ExynosFenceTracer::ExynosFenceTracer() {
-    mFenceInfo.clear();
+namespace {
+struct FenceState {
+    int32_t usage;
+    uint32_t slot;
+    bool pendingAllowed;
+    bool leaking;
+};
+
+inline uint64_t packFenceState(const FenceState &state) {
+    return (uint64_t)(uint32_t)state.usage |
+           ((uint64_t)(state.slot & 0xff) << 32) |
+           ((uint64_t)state.pendingAllowed << 40) |
+           ((uint64_t)state.leaking << 41);
+}
+
+inline FenceState unpackFenceState(uint64_t value) {
+    FenceState state;
+    state.usage = (int32_t)(uint32_t)(value & 0xffffffff);
+    state.slot = (value >> 32) & 0xff;
+    state.pendingAllowed = (value >> 40) & 0x1;
+    state.leaking = (value >> 41) & 0x1;
+    return state;
+}
+
+inline bool isLeakingState(const FenceState &state) {
+    return (state.usage != 0) && !state.pendingAllowed && !state.leaking;
+}
+
+inline uint64_t packFenceEvent(uint32_t dir, uint32_t type, uint32_t ip, int32_t usage) {
+    return ((uint64_t)(dir & 0xff) << 48) | ((uint64_t)(type & 0xff) << 40) |
+           ((uint64_t)(ip & 0xff) << 32) | (uint64_t)(uint32_t)usage;
+}
+
+inline uint32_t getFenceDisplaySlot(uint32_t displayId) {
+    uint32_t type = displayId >> DISPLAYID_MASK_LEN;
+    uint32_t index = displayId & ((1 << DISPLAYID_MASK_LEN) - 1);
+    if ((type >= HWC_NUM_DISPLAY_TYPES) || (index >= MAX_FENCE_DISPLAY_INDEX))
+        return MAX_FENCE_DISPLAY_SLOT - 1;
+    return type * MAX_FENCE_DISPLAY_INDEX + index;
+}
+}  // namespace
+
+ExynosFenceTracer::ExynosFenceTracer()
+    : mFenceInfo(new hwc_fence_info_t[MAX_FENCE_FD]) {
+    for (uint32_t i = 0; i < MAX_FENCE_FD; i++) {
+        hwc_fence_info_t &info = mFenceInfo[i];
+        info.state.store(0, std::memory_order_relaxed);
+        info.displayId.store(0, std::memory_order_relaxed);
+        info.seq_no.store(0, std::memory_order_relaxed);
+        for (auto &seq : info.seq) {
+            seq.event.store(0, std::memory_order_relaxed);
+            seq.timeUs.store(0, std::memory_order_relaxed);
+            seq.frame.store(0, std::memory_order_relaxed);
+        }
+    }
 }
 
 ExynosFenceTracer::~ExynosFenceTracer() {
 }
 
-void ExynosFenceTracer::writeFenceInfo(uint32_t fd, hwc_fence_info_t *info,
-                                       hwc_fdebug_fence_type type, hwc_fdebug_ip_type ip,
-                                       uint32_t direction, bool pendingAllowed) {
-    /* Sequnce is ring buffer */
-    /* update last flag, sequence */
-    info->seq[info->seq_no].isLast = false;
-    info->seq_no++;
-    if (info->seq_no >= MAX_FENCE_SEQUENCE)
-        info->seq_no = 0;
-    fenceTrace_t *seq = &info->seq[info->seq_no];
-    seq->isLast = true;
-
-    /* direction, type, ip */
-    seq->dir = direction;
-    seq->type = type;
-    seq->ip = ip;
-    seq->curFlag = 1;
-    info->pendingAllowed = pendingAllowed;
-
-    /* time */
+hwc_fence_info_t *ExynosFenceTracer::getFenceInfo(int fd) {
+    if ((fd < 0) || (fd >= MAX_FENCE_FD))
+        return nullptr;
+    return &mFenceInfo[fd];
+}
+
+void ExynosFenceTracer::writeFenceInfo(hwc_fence_info_t *info, hwc_fdebug_fence_type type,
+                                       hwc_fdebug_ip_type ip, uint32_t direction, int32_t usage) {
+    /* Sequnce is ring buffer, the last one is pointed by seq_no */
+    uint32_t seqNo = info->seq_no.fetch_add(1, std::memory_order_relaxed) + 1;
+    fenceTrace_t *seq = &info->seq[seqNo % MAX_FENCE_SEQUENCE];
+
     struct timeval tv;
-    gettimeofday(&seq->time, NULL);
-    tv = seq->time;
+    gettimeofday(&tv, NULL);
+    seq->event.store(packFenceEvent(direction, type, ip, usage), std::memory_order_relaxed);
+    seq->timeUs.store((int64_t)tv.tv_sec * 1000000 + tv.tv_usec, std::memory_order_relaxed);
+    seq->frame.store(mFrameCount.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void ExynosFenceTracer::updateFenceState(int fd, hwc_fence_info_t *info,
+                                         const DisplayIdentifier &display,
+                                         int32_t usageDelta, bool clampUsage,
+                                         bool pendingAllowed) {
+    uint32_t slot = getFenceDisplaySlot(display.id);
+    uint64_t oldValue = info->state.load(std::memory_order_relaxed);
+    FenceState oldState, newState;
+    do {
+        oldState = unpackFenceState(oldValue);
+        newState = oldState;
+        newState.slot = slot;
+        newState.pendingAllowed = pendingAllowed;
+        newState.usage += usageDelta;
+        if (clampUsage && (newState.usage < 0))
+            newState.usage = 0;
+        // Fence's usage count shuld be zero at end of frame(present done).
+        // pendingAllowed means usage count of the fence can be pended over frame.
+        if ((usageDelta != 0) && (newState.usage == 0)) {
+            newState.pendingAllowed = false;
+            newState.leaking = false;
+        }
+    } while (!info->state.compare_exchange_weak(oldValue, packFenceState(newState),
+                                                std::memory_order_acq_rel));
+    info->displayId.store(display.id, std::memory_order_relaxed);
+
+    if ((oldState.usage != 0) != (newState.usage != 0))
+        mActiveFenceCount.fetch_add((newState.usage != 0) ? 1 : -1, std::memory_order_relaxed);
+    if (isLeakingState(oldState))
+        mLeakingFenceCount[oldState.slot].fetch_sub(1, std::memory_order_relaxed);
+    if (isLeakingState(newState))
+        mLeakingFenceCount[newState.slot].fetch_add(1, std::memory_order_relaxed);
+
+    int32_t maxFd = mMaxFenceFd.load(std::memory_order_relaxed);
+    while ((fd > maxFd) &&
+           !mMaxFenceFd.compare_exchange_weak(maxFd, fd, std::memory_order_relaxed))
+        ;
+}
+
+bool ExynosFenceTracer::setLeaking(hwc_fence_info_t *info) {
+    uint64_t oldValue = info->state.load(std::memory_order_relaxed);
+    FenceState oldState, newState;
+    do {
+        oldState = unpackFenceState(oldValue);
+        if (!isLeakingState(oldState))
+            return false;
+        newState = oldState;
+        newState.leaking = true;
+    } while (!info->state.compare_exchange_weak(oldValue, packFenceState(newState),
+                                                std::memory_order_acq_rel));
+    mLeakingFenceCount[oldState.slot].fetch_sub(1, std::memory_order_relaxed);
+    return true;
 }
 
 void ExynosFenceTracer::changeFenceInfoState(uint32_t fd, const DisplayIdentifier &display,
@@ -81,17 +181,14 @@ void ExynosFenceTracer::changeFenceInfoState(uint32_t fd, const DisplayIdentifie
     if (!fence_valid(fd))
         return;
 
-    /* init or recevice(from previous) trace info */
-    hwc_fence_info_t info;
-    if (mFenceInfo.count(fd) == 0) {
-        info = {};
-    } else
-        info = mFenceInfo.at(fd);
+    hwc_fence_info_t *info = getFenceInfo(fd);
+    if (info == nullptr)
+        return;
 
-    info.displayId = display.id;
-    writeFenceInfo(fd, &info, type, ip, direction, pendingAllowed);
+    updateFenceState(fd, info, display, 0, false, pendingAllowed);
+    int32_t usage = unpackFenceState(info->state.load(std::memory_order_relaxed)).usage;
+    writeFenceInfo(info, type, ip, direction, usage);
     FT_LOGD("FD : %d, direction : %d, type(%d), ip(%d) (%s)", fd, direction, type, ip, __func__);
-    mFenceInfo[fd] = info;
 }
 
 void ExynosFenceTracer::setFenceInfo(uint32_t fd, const DisplayIdentifier &display,
@@ -100,83 +197,84 @@ void ExynosFenceTracer::setFenceInfo(uint32_t fd, const DisplayIdentifier &displ
     if (!fence_valid(fd))
         return;
 
-    /* init or recevice(from previous) trace info */
-    hwc_fence_info_t info;
-    if (mFenceInfo.count(fd) == 0) {
-        info = {};
-    } else {
-        info = mFenceInfo.at(fd);
+    hwc_fence_info_t *info = getFenceInfo(fd);
+    if (info == nullptr) {
+        FT_LOGD("fd(%d) is over MAX_FENCE_FD, it is not traced", fd);
+        return;
     }
 
-    info.displayId = display.id;
-    writeFenceInfo(fd, &info, type, ip, direction, pendingAllowed);
-    fenceTrace_t *seq = &info.seq[info.seq_no];
-
     /* update usage count */
-    if ((seq->dir == FENCE_FROM) || (seq->dir == FENCE_DUP)) {
-        info.usage++;
-    } else if ((seq->dir == FENCE_TO) || (seq->dir == FENCE_CLOSE)) {
-        info.usage--;
-        if ((seq->dir == FENCE_CLOSE) && (info.usage < 0))
-            info.usage = 0;
-    } else
+    int32_t usageDelta = 0;
+    if ((direction == FENCE_FROM) || (direction == FENCE_DUP))
+        usageDelta = 1;
+    else if ((direction == FENCE_TO) || (direction == FENCE_CLOSE))
+        usageDelta = -1;
+    else
         ALOGE("Fence trace : Undefined direction!");
 
+    updateFenceState(fd, info, display, usageDelta, direction == FENCE_CLOSE, pendingAllowed);
+    int32_t usage = unpackFenceState(info->state.load(std::memory_order_relaxed)).usage;
+    writeFenceInfo(info, type, ip, direction, usage);
+
     FT_LOGI("setFenceInfo(%d):: %s, %s, %s, %s usage: %d",
             fd, display.name.string(),
-            getString(fence_dir_map, seq->dir),
-            getString(fence_type_map, seq->type),
-            getString(fence_ip_map, seq->ip),
-            info.usage);
-
-    seq->usage = info.usage;
-    // Fence's usage count shuld be zero at end of frame(present done).
-    // This flag means usage count of the fence can be pended over frame.
-    if (info.usage == 0)
-        info.pendingAllowed = false;
-
-    /* last direction */
-    info.last_dir = direction;
-    mFenceInfo[fd] = info;
+            getString(fence_dir_map, direction),
+            getString(fence_type_map, type),
+            getString(fence_ip_map, ip),
+            usage);
+}
+
+void ExynosFenceTracer::printFenceInfo(int fd, hwc_fence_info_t *info, String8 &result) {
+    FenceState state = unpackFenceState(info->state.load(std::memory_order_relaxed));
+    uint32_t lastSeq = info->seq_no.load(std::memory_order_relaxed) % MAX_FENCE_SEQUENCE;
+    uint64_t frameCount = mFrameCount.load(std::memory_order_relaxed);
+
+    result.appendFormat("FD hwc : %d, display(%d), usage %d, pending : %d\n", fd,
+                        info->displayId.load(std::memory_order_relaxed), state.usage,
+                        (int)state.pendingAllowed);
+    for (uint32_t i = 0; i < MAX_FENCE_SEQUENCE; i++) {
+        fenceTrace_t *seq = &info->seq[i];
+        uint64_t event = seq->event.load(std::memory_order_relaxed);
+        int64_t timeUs = seq->timeUs.load(std::memory_order_relaxed);
+        /* Not written yet */
+        if (timeUs == 0)
+            continue;
+        time_t sec = (time_t)(timeUs / 1000000);
+        struct tm *localTime = (struct tm *)localtime(&sec);
+
+        /* cur means that it was written in this frame */
+        result.appendFormat("    %s(%s)(%s)(cur:%d)(usage:%d)(last:%d)",
+                            getString(fence_dir_map, (event >> 48) & 0xff),
+                            getString(fence_ip_map, (event >> 32) & 0xff),
+                            getString(fence_type_map, (event >> 40) & 0xff),
+                            (int)(seq->frame.load(std::memory_order_relaxed) == frameCount),
+                            (int32_t)(uint32_t)(event & 0xffffffff), (int)(i == lastSeq));
+        result.appendFormat(" - time:%02d-%02d %02d:%02d:%02d.%03lu(%lu)\n",
+                            localTime->tm_mon + 1, localTime->tm_mday,
+                            localTime->tm_hour, localTime->tm_min,
+                            localTime->tm_sec, (unsigned long)((timeUs % 1000000) / 1000),
+                            (unsigned long)(timeUs / 1000));
+    }
 }
 
 void ExynosFenceTracer::printLastFenceInfo(uint32_t fd) {
-    struct timeval tv;
     if (!fence_valid(fd))
         return;
-    if (mFenceInfo.count(fd) == 0)
+    hwc_fence_info_t *info = getFenceInfo(fd);
+    if ((info == nullptr) || (info->seq_no.load(std::memory_order_relaxed) == 0))
         return;
 
-    hwc_fence_info_t info = mFenceInfo.at(fd);
-    FT_LOGD("---- Fence FD : %d, Display(%d), usage(%d) ----", fd, info.displayId, info.usage);
-
-    for (int i = 0; i < MAX_FENCE_SEQUENCE; i++) {
-        fenceTrace_t *seq = &info.seq[i];
-        FT_LOGD("fd(%d) %s(%s)(%s)(cur:%d)(usage:%d)(last:%d)",
-                fd, getString(fence_dir_map, seq->dir),
-                getString(fence_ip_map, seq->ip), getString(fence_type_map, seq->type),
-                seq->curFlag, seq->usage, (int)seq->isLast);
-
-        tv = seq->time;
-        struct tm *localTime = getLocalTime(tv);
-
-        FT_LOGD("time:%02d-%02d %02d:%02d:%02d.%03lu(%lu)",
-                localTime->tm_mon + 1, localTime->tm_mday,
-                localTime->tm_hour, localTime->tm_min,
-                localTime->tm_sec, tv.tv_usec / 1000,
-                ((tv.tv_sec * 1000) + (tv.tv_usec / 1000)));
-    }
+    String8 result;
+    printFenceInfo(fd, info, result);
+    FT_LOGD("%s", result.string());
 }
 
-void ExynosFenceTracer::dumpFenceInfo(int32_t depth) {
+void ExynosFenceTracer::dumpFenceInfo(int32_t __unused depth) {
     FT_LOGD("Dump fence ++");
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-
-        hwc_fence_info_t info = mFenceInfo.at(i);
-        if ((info.usage >= 1 || info.usage <= -1) && (!info.pendingAllowed))
+    int32_t maxFd = mMaxFenceFd.load(std::memory_order_relaxed);
+    for (int32_t i = 0; i <= maxFd; i++) {
+        FenceState state = unpackFenceState(mFenceInfo[i].state.load(std::memory_order_relaxed));
+        if ((state.usage != 0) && (!state.pendingAllowed))
             printLastFenceInfo(i);
     }
     FT_LOGD("Dump fence --");
@@ -185,14 +283,8 @@ void ExynosFenceTracer::dumpFenceInfo(int32_t depth) {
 bool ExynosFenceTracer::fenceWarn(uint32_t threshold) {
     uint32_t cnt = 0, r_cnt = 0;
 
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-        hwc_fence_info_t info = mFenceInfo.at(i);
-        if (info.usage >= 1 || info.usage <= -1)
-            cnt++;
-    }
+    int32_t activeCount = mActiveFenceCount.load(std::memory_order_relaxed);
+    cnt = (activeCount > 0) ? activeCount : 0;
 
     if ((cnt > threshold) || (exynosHWCControl.fenceTracer > 0))
         dumpFenceInfo(0);
@@ -206,50 +298,28 @@ bool ExynosFenceTracer::fenceWarn(uint32_t threshold) {
 
 void ExynosFenceTracer::resetFenceCurFlag() {
     FT_LOGD("%s ++", __func__);
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-        hwc_fence_info_t info = mFenceInfo.at(i);
-
-        if (info.usage == 0) {
-            hwc_fence_info_t *info_ = &mFenceInfo[i];
-            for (int j = 0; j < MAX_FENCE_SEQUENCE; j++)
-                info_->seq[j].curFlag = 0;
-        } else if (!info.pendingAllowed)
-            FT_LOGE("usage mismatched fd %d, usage %d, pending %d", i,
-                    info.usage, info.pendingAllowed);
+    /* Traces written before this are not in the current frame any more */
+    mFrameCount.fetch_add(1, std::memory_order_relaxed);
+
+    /* Only for the log, the table doesn't need to be scanned otherwise */
+    if (exynosHWCControl.fenceTracer > 0) {
+        int32_t maxFd = mMaxFenceFd.load(std::memory_order_relaxed);
+        for (int32_t i = 0; i <= maxFd; i++) {
+            FenceState state = unpackFenceState(mFenceInfo[i].state.load(std::memory_order_relaxed));
+            if ((state.usage != 0) && !state.pendingAllowed)
+                FT_LOGE("usage mismatched fd %d, usage %d, pending %d", i,
+                        state.usage, state.pendingAllowed);
+        }
     }
     FT_LOGD("%s --", __func__);
 }
 
-void ExynosFenceTracer::printFenceTrace(String8 &saveString, struct tm *localTime) {
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-
-        hwc_fence_info_t info = mFenceInfo.at(i);
-
-        if (info.usage >= 1) {
-            saveString.appendFormat("FD hwc : %d, usage %d, pending : %d\n", i, info.usage, (int)info.pendingAllowed);
-            for (int j = 0; j < MAX_FENCE_SEQUENCE; j++) {
-                fenceTrace_t *seq = &info.seq[j];
-                saveString.appendFormat("    %s(%s)(%s)(cur:%d)(usage:%d)(last:%d)",
-                                        getString(fence_dir_map, seq->dir),
-                                        getString(fence_ip_map, seq->ip), getString(fence_type_map, seq->type),
-                                        seq->curFlag, seq->usage, (int)seq->isLast);
-
-                struct timeval tv = seq->time;
-                localTime = (struct tm *)localtime((time_t *)&tv.tv_sec);
-
-                saveString.appendFormat(" - time:%02d-%02d %02d:%02d:%02d.%03lu(%lu)\n",
-                                        localTime->tm_mon + 1, localTime->tm_mday,
-                                        localTime->tm_hour, localTime->tm_min,
-                                        localTime->tm_sec, tv.tv_usec / 1000,
-                                        ((tv.tv_sec * 1000) + (tv.tv_usec / 1000)));
-            }
-        }
+void ExynosFenceTracer::printFenceTrace(String8 &saveString, struct tm *__unused localTime) {
+    int32_t maxFd = mMaxFenceFd.load(std::memory_order_relaxed);
+    for (int32_t i = 0; i <= maxFd; i++) {
+        FenceState state = unpackFenceState(mFenceInfo[i].state.load(std::memory_order_relaxed));
+        if (state.usage >= 1)
+            printFenceInfo(i, &mFenceInfo[i], saveString);
     }
 }
 
@@ -259,52 +329,34 @@ void ExynosFenceTracer::printLeakFds() {
     String8 errStringMinus;
 
     errStringPlus.appendFormat("Leak Fds (1) :\n");
+    errStringMinus.appendFormat("Leak Fds (-1) :\n");
 
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-        hwc_fence_info_t info = mFenceInfo.at(i);
-        if (info.usage >= 1) {
+    int minusCnt = 1;
+    int32_t maxFd = mMaxFenceFd.load(std::memory_order_relaxed);
+    for (int32_t i = 0; i <= maxFd; i++) {
+        FenceState state = unpackFenceState(mFenceInfo[i].state.load(std::memory_order_relaxed));
+        if (state.usage >= 1) {
             errStringPlus.appendFormat("%d,", i);
             if (cnt++ % 10 == 0)
                 errStringPlus.appendFormat("\n");
-        }
-    }
-    FT_LOGI("%s", errStringPlus.string());
-
-    errStringMinus.appendFormat("Leak Fds (-1) :\n");
-
-    cnt = 1;
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-        hwc_fence_info_t info = mFenceInfo.at(i);
-        if (info.usage < 0) {
+        } else if (state.usage < 0) {
             errStringMinus.appendFormat("%d,", i);
-            if (cnt++ % 10 == 0)
+            if (minusCnt++ % 10 == 0)
                 errStringMinus.appendFormat("\n");
         }
     }
+    FT_LOGI("%s", errStringPlus.string());
     FT_LOGI("%s", errStringMinus.string());
 }
 
-bool ExynosFenceTracer::validateFencePerFrame(const DisplayIdentifier &display) {
-    bool ret = true;
+uint32_t ExynosFenceTracer::getLeakingFenceCount(const DisplayIdentifier &display) {
+    int32_t count = mLeakingFenceCount[getFenceDisplaySlot(display.id)].load(std::memory_order_relaxed);
+    return (count > 0) ? count : 0;
+}
 
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-        hwc_fence_info_t info = mFenceInfo.at(i);
-        if (info.displayId != display.id)
-            continue;
-        if ((info.usage >= 1 || info.usage <= -1) &&
-            (!info.pendingAllowed) && (!info.leaking)) {
-            ret = false;
-        }
-    }
+bool ExynosFenceTracer::validateFencePerFrame(const DisplayIdentifier &display) {
+    /* Leaking fences are counted when they are updated */
+    bool ret = (getLeakingFenceCount(display) == 0);
 
     if (!ret) {
         int priv = exynosHWCControl.fenceTracer;
@@ -316,19 +368,13 @@ bool ExynosFenceTracer::validateFencePerFrame(const DisplayIdentifier &display)
     return ret;
 }
 
-void ExynosFenceTracer::dumpNCheckLeak(int32_t depth) {
+void ExynosFenceTracer::dumpNCheckLeak(int32_t __unused depth) {
     FT_LOGD("Dump leaking fence ++");
-    for (auto it = mFenceInfo.begin(); it != mFenceInfo.end(); ++it) {
-        uint32_t i = it->first;
-        if (mFenceInfo.count(i) == 0)
-            continue;
-        hwc_fence_info_t info = mFenceInfo.at(i);
-        if ((info.usage >= 1 || info.usage <= -1) && (!info.pendingAllowed))
-            // leak is occured in this frame first
-            if (!info.leaking) {
-                info.leaking = true;
-                printLastFenceInfo(i);
-            }
+    int32_t maxFd = mMaxFenceFd.load(std::memory_order_relaxed);
+    for (int32_t i = 0; i <= maxFd; i++) {
+        // leak is occured in this frame first
+        if (setLeaking(&mFenceInfo[i]))
+            printLastFenceInfo(i);
     }
 
     int priv = exynosHWCControl.fenceTracer;
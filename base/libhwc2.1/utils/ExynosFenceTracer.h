@@ -19,8 +19,10 @@
 
 #include "ExynosHWCHelper.h"
 #include "ExynosHWCTypes.h"
-#include <vector>
+#include <atomic>
+#include <memory>
 #include <unordered_map>
+#include <vector>
 #include <utils/Singleton.h>
 
 #define MAX_FENCE_NAME 64
@@ -94,24 +96,31 @@ const std::map<int32_t, String8> fence_dir_map = {
     {FENCE_CLOSE, String8("Close")},
 };
 
+/*
+ * Fences are traced in an fd-indexed table, so fds over MAX_FENCE_FD are not traced.
+ * Leaking fences are counted per display while fences are updated.
+ */
+#ifndef MAX_FENCE_FD
+#define MAX_FENCE_FD 4096
+#endif
+#define MAX_FENCE_DISPLAY_INDEX 4
+/* Last slot is for displays that are out of the range */
+#define MAX_FENCE_DISPLAY_SLOT (HWC_NUM_DISPLAY_TYPES * MAX_FENCE_DISPLAY_INDEX + 1)
+
 typedef struct fenceTrace {
-    uint32_t dir;
-    hwc_fdebug_fence_type type;
-    hwc_fdebug_ip_type ip;
-    struct timeval time;
-    int32_t curFlag;
-    int32_t usage;
-    bool isLast;
+    /* dir, type, ip and usage are packed */
+    std::atomic<uint64_t> event;
+    std::atomic<int64_t> timeUs;
+    /* Frame in which the trace was written */
+    std::atomic<uint64_t> frame;
 } fenceTrace_t;
 
 typedef struct hwc_fence_info {
-    uint32_t displayId;
+    /* usage, display slot, pendingAllowed and leaking are packed to be updated at once */
+    std::atomic<uint64_t> state;
+    std::atomic<uint32_t> displayId;
+    std::atomic<uint32_t> seq_no;
     fenceTrace_t seq[MAX_FENCE_SEQUENCE];
-    uint32_t seq_no = 0;
-    uint32_t last_dir;
-    int32_t usage;
-    bool pendingAllowed = false;
-    bool leaking = false;
 } hwc_fence_info_t;
 
 extern int hwcFenceDebug[FENCE_IP_MAX];
@@ -119,9 +128,8 @@ class ExynosFenceTracer : public Singleton<ExynosFenceTracer> {
   public:
     ExynosFenceTracer();
     ~ExynosFenceTracer();
-    void writeFenceInfo(uint32_t fd, hwc_fence_info_t *info,
-                        hwc_fdebug_fence_type type, hwc_fdebug_ip_type ip,
-                        uint32_t direction, bool pendingAllowed);
+    void writeFenceInfo(hwc_fence_info_t *info, hwc_fdebug_fence_type type,
+                        hwc_fdebug_ip_type ip, uint32_t direction, int32_t usage);
     void changeFenceInfoState(uint32_t fd, const DisplayIdentifier &display,
                               hwc_fdebug_fence_type type, hwc_fdebug_ip_type ip,
                               uint32_t direction, bool pendingAllowed = false);
@@ -156,8 +164,23 @@ class ExynosFenceTracer : public Singleton<ExynosFenceTracer> {
             return fence;
     }
 
+    uint32_t getLeakingFenceCount(const DisplayIdentifier &display);
+
+  private:
+    hwc_fence_info_t *getFenceInfo(int fd);
+    void updateFenceState(int fd, hwc_fence_info_t *info, const DisplayIdentifier &display,
+                          int32_t usageDelta, bool clampUsage, bool pendingAllowed);
+    bool setLeaking(hwc_fence_info_t *info);
+    void printFenceInfo(int fd, hwc_fence_info_t *info, String8 &result);
+
+  public:
     // Variable for fence tracer
-    std::unordered_map<int32_t, hwc_fence_info> mFenceInfo;
+    std::unique_ptr<hwc_fence_info_t[]> mFenceInfo;
+    /* Highest fd that has been traced */
+    std::atomic<int32_t> mMaxFenceFd = -1;
+    std::atomic<int32_t> mActiveFenceCount = 0;
+    std::atomic<int32_t> mLeakingFenceCount[MAX_FENCE_DISPLAY_SLOT] = {};
+    std::atomic<uint64_t> mFrameCount = 0;
     uint32_t mFenceLogSize = 0;
 };
 
@@ -50,6 +50,7 @@ enum {
     eDebugDisplayConfig = 0x00400000,
     eDebugTDM = 0x00800000,
     eDebugLoadBalancing = 0x01000000,
+    eDebugCapacityCheck = 0x02000000,
 };
 
 extern int hwcDebug;
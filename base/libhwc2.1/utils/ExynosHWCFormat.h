@@ -299,6 +299,8 @@ class ExynosFormat {
     inline const format_description_t &getFormatDesc() const {
         return exynos_format_desc[mDescIndex];
     };
+    /* Index of exynos_format_desc, it can be used as a table index */
+    inline uint32_t descIndex() const { return mDescIndex; };
 
   private:
     uint32_t mDescIndex;
@@ -97,6 +97,8 @@ enum {
     eExceedMaxLayerNum = 0x00040000,
     eFroceClientLayer = 0x00080000,
     eRemoveDynamicMetadata = 0x00100000,
+    ePlannedClientComposition = 0x00200000,
+    eFlattenedStaticLayer = 0x00400000,
     eResourceAssignFail = 0x20000000,
     eMPPUnsupported = 0x40000000,
     eUnknown = 0x80000000,
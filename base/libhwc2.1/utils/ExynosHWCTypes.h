@@ -82,6 +82,9 @@ enum {
     HWC_CTL_DO_FENCE_FILE_DUMP = 308,
     HWC_CTL_SYS_FENCE_LOGGING = 309,
     HWC_CTL_USE_PERF_FILE = 310,
+    HWC_CTL_COMPOSITION_PLANNER = 311,
+    HWC_CTL_PARALLEL_VALIDATE = 312,
+    HWC_CTL_PRESENT_SCHEDULER = 313,
 };
 
 enum {
@@ -247,6 +250,11 @@ typedef struct exynos_hwc_control {
     uint32_t fenceTracer;
     uint32_t sysFenceLogging;
     uint32_t usePerfFile;
+    /* Time budget (usec) of the composition planner, 0 disables it */
+    uint32_t compositionPlanner;
+    uint32_t parallelValidate;
+    /* Hold commits until the deadline of the expected present time */
+    uint32_t presentScheduler;
 } exynos_hwc_control_t;
 
 typedef struct restriction_size_element {
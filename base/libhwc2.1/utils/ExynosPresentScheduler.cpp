@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <algorithm>
+#include <chrono>
+#include "ExynosPresentScheduler.h"
+
+void ExynosCommitLatency::update(nsecs_t latency) {
+    mSamples[mHead] = latency;
+    mHead = (mHead + 1) % PRESENT_LATENCY_SAMPLES;
+    if (mCount < PRESENT_LATENCY_SAMPLES)
+        mCount++;
+}
+
+void ExynosCommitLatency::reset() {
+    mHead = 0;
+    mCount = 0;
+}
+
+nsecs_t ExynosCommitLatency::getEstimate() const {
+    if (mCount == 0)
+        return us2ns(PRESENT_DEFAULT_LATENCY_US);
+
+    nsecs_t sorted[PRESENT_LATENCY_SAMPLES];
+    std::copy(mSamples, mSamples + mCount, sorted);
+    uint32_t index = (mCount - 1) * PRESENT_LATENCY_PERCENTILE / 100;
+    std::nth_element(sorted, sorted + index, sorted + mCount);
+    return sorted[index];
+}
+
+nsecs_t ExynosCommitLatency::getMax() const {
+    return mCount ? *std::max_element(mSamples, mSamples + mCount) : 0;
+}
+
+void ExynosPresentScheduler::setExpectedPresentTime(nsecs_t expectedPresentTime) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mExpectedPresentTime = expectedPresentTime;
+}
+
+nsecs_t ExynosPresentScheduler::takeExpectedPresentTime() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    nsecs_t expectedPresentTime = mExpectedPresentTime;
+    mExpectedPresentTime = 0;
+    return expectedPresentTime;
+}
+
+nsecs_t ExynosPresentScheduler::getDeadlineLocked(nsecs_t targetVsync) const {
+    return targetVsync - mLatency.getEstimate() - us2ns(PRESENT_DEADLINE_MARGIN_US);
+}
+
+nsecs_t ExynosPresentScheduler::getDeadline(nsecs_t targetVsync) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return getDeadlineLocked(targetVsync);
+}
+
+void ExynosPresentScheduler::hold(nsecs_t targetVsync, nsecs_t now) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mTargetVsync = targetVsync;
+    mReleaseTime = now;
+    if (targetVsync == 0)
+        return;
+
+    mScheduledCount++;
+    nsecs_t deadline = getDeadlineLocked(targetVsync);
+    if (deadline <= now) {
+        mLateCount++;
+        return;
+    }
+    /* Expected present time is too far, it is not a frame of the next few vsyncs */
+    if (deadline - now > ms2ns(PRESENT_MAX_HOLD_MS))
+        return;
+
+    mHeldCount++;
+    auto until = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(deadline));
+    mCondition.wait_until(lock, until, [this] { return mCanceled; });
+    mCanceled = false;
+
+    mReleaseTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    mTotalHoldTime += mReleaseTime - now;
+}
+
+void ExynosPresentScheduler::cancel() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCanceled = true;
+    mCondition.notify_all();
+}
+
+void ExynosPresentScheduler::resume() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCanceled = false;
+}
+
+void ExynosPresentScheduler::onCommit(nsecs_t now) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCommitTime = now;
+}
+
+void ExynosPresentScheduler::onCommitDone(nsecs_t now) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mCommitTime == 0)
+        return;
+
+    mLatency.update(now - mCommitTime);
+    /* Commit that is returned after the target vsync is latched on a later vsync */
+    if ((mTargetVsync != 0) && (now > mTargetVsync))
+        mMissCount++;
+    mTargetVsync = 0;
+    mReleaseTime = 0;
+    mCommitTime = 0;
+}
+
+uint64_t ExynosPresentScheduler::getMissCount() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mMissCount;
+}
+
+void ExynosPresentScheduler::dump(android::String8 &result) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    result.appendFormat("Present scheduler: latency estimate(%" PRId64 " us), last(%" PRId64 " us), "
+                        "max(%" PRId64 " us)\n",
+                        ns2us(mLatency.getEstimate()), ns2us(mLatency.getLast()), ns2us(mLatency.getMax()));
+    result.appendFormat("\tscheduled(%" PRIu64 "), held(%" PRIu64 "), late(%" PRIu64 "), "
+                        "deadline miss(%" PRIu64 "), average hold(%" PRId64 " us)\n",
+                        mScheduledCount, mHeldCount, mLateCount, mMissCount,
+                        mHeldCount ? ns2us(mTotalHoldTime / (nsecs_t)mHeldCount) : 0);
+}
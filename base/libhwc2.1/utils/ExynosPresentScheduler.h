@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSPRESENTSCHEDULER_H
+#define _EXYNOSPRESENTSCHEDULER_H
+
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <condition_variable>
+#include <mutex>
+
+/* Number of commit latencies that the estimate is taken from */
+#ifndef PRESENT_LATENCY_SAMPLES
+#define PRESENT_LATENCY_SAMPLES 32
+#endif
+
+/* Percentile of the latencies that is used as the estimate */
+#ifndef PRESENT_LATENCY_PERCENTILE
+#define PRESENT_LATENCY_PERCENTILE 90
+#endif
+
+/* Estimate until the first latency is measured */
+#ifndef PRESENT_DEFAULT_LATENCY_US
+#define PRESENT_DEFAULT_LATENCY_US 4000
+#endif
+
+/* Commit is released this much earlier than the estimate requires */
+#ifndef PRESENT_DEADLINE_MARGIN_US
+#define PRESENT_DEADLINE_MARGIN_US 1000
+#endif
+
+/* Frame is not held if the deadline is farther than this */
+#ifndef PRESENT_MAX_HOLD_MS
+#define PRESENT_MAX_HOLD_MS 100
+#endif
+
+/* Latency from the atomic commit of a frame to its return */
+class ExynosCommitLatency {
+  public:
+    void update(nsecs_t latency);
+    void reset();
+    /* PRESENT_LATENCY_PERCENTILE of the samples, or the default without samples */
+    nsecs_t getEstimate() const;
+    nsecs_t getLast() const { return mCount ? mSamples[(mHead + PRESENT_LATENCY_SAMPLES - 1) % PRESENT_LATENCY_SAMPLES] : 0; };
+    nsecs_t getMax() const;
+
+  private:
+    nsecs_t mSamples[PRESENT_LATENCY_SAMPLES] = {0};
+    uint32_t mHead = 0;
+    uint32_t mCount = 0;
+};
+
+/*
+ * Holds a frame until the deadline of the vsync that it is expected to be presented on.
+ * The deadline is the target vsync minus the estimated commit latency and a margin,
+ * the margin covers the present path between the release and the atomic commit.
+ * hold() blocks the calling thread. presentDisplay() calls it without locks,
+ * so other displays can be validated and presented while it waits,
+ * but the next frame of the held display is not.
+ */
+class ExynosPresentScheduler {
+  public:
+    /* Expected present time of the next frame, 0 to commit it immediately */
+    void setExpectedPresentTime(nsecs_t expectedPresentTime);
+    /* Takes the expected present time that is set for the frame being presented */
+    nsecs_t takeExpectedPresentTime();
+
+    nsecs_t getDeadline(nsecs_t targetVsync);
+    /* Blocks until the deadline of targetVsync, 0 releases the frame immediately */
+    void hold(nsecs_t targetVsync, nsecs_t now);
+    /* Releases the held frame, or the next one if no frame is held */
+    void cancel();
+    /* Drops a cancel() that has not released any frame, called on power on */
+    void resume();
+    /* Called right before the atomic commit of the released frame */
+    void onCommit(nsecs_t now);
+    /* Called when the atomic commit is returned, the latency is measured from onCommit() */
+    void onCommitDone(nsecs_t now);
+
+    uint64_t getMissCount();
+    void dump(android::String8 &result);
+
+  private:
+    nsecs_t getDeadlineLocked(nsecs_t targetVsync) const;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mCanceled = false;
+
+    nsecs_t mExpectedPresentTime = 0;
+    /* Target vsync and release time of the frame in present */
+    nsecs_t mTargetVsync = 0;
+    nsecs_t mReleaseTime = 0;
+    nsecs_t mCommitTime = 0;
+    ExynosCommitLatency mLatency;
+
+    uint64_t mScheduledCount = 0;
+    uint64_t mHeldCount = 0;
+    uint64_t mLateCount = 0;
+    uint64_t mMissCount = 0;
+    nsecs_t mTotalHoldTime = 0;
+};
+
+#endif  // _EXYNOSPRESENTSCHEDULER_H
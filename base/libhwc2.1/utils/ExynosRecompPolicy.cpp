@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <algorithm>
+#include "ExynosRecompPolicy.h"
+
+void ExynosUpdateRate::update(nsecs_t now) {
+    mTimes[mHead] = now;
+    mHead = (mHead + 1) % DR_RATE_SAMPLES;
+    if (mCount < DR_RATE_SAMPLES)
+        mCount++;
+}
+
+void ExynosUpdateRate::reset() {
+    mHead = 0;
+    mCount = 0;
+}
+
+uint32_t ExynosUpdateRate::getRate(nsecs_t now) const {
+    nsecs_t windowStart = now - ms2ns(DR_RATE_WINDOW_MS);
+    uint32_t num = 0;
+
+    /* Timestamps are checked from the latest one */
+    for (uint32_t i = 1; i <= mCount; i++) {
+        if (mTimes[(mHead + DR_RATE_SAMPLES - i) % DR_RATE_SAMPLES] <= windowStart)
+            break;
+        num++;
+    }
+    return num * 1000 / DR_RATE_WINDOW_MS;
+}
+
+uint64_t ExynosRecompPolicy::getDeviceCost(const CostInfo &info) {
+    return info.layerBytes * info.refreshRate;
+}
+
+uint64_t ExynosRecompPolicy::getClientCost(const CostInfo &info, uint32_t updateRate) {
+    updateRate = std::min(updateRate, info.refreshRate);
+    return (info.targetBytes * info.refreshRate) +
+           ((info.layerBytes + info.targetBytes) * updateRate);
+}
+
+void ExynosRecompPolicy::setDecision(uint32_t updateRate, const CostInfo &info) {
+    mLastUpdateRate = updateRate;
+    mLastDeviceCost = getDeviceCost(info);
+    mLastClientCost = getClientCost(info, updateRate);
+}
+
+bool ExynosRecompPolicy::shouldFlatten(nsecs_t idleTime, uint32_t updateRate, const CostInfo &info) {
+    if ((mMode != MODE_DEVICE) || (idleTime < mIdleTimeout))
+        return false;
+
+    updateRate = std::min(updateRate, (uint32_t)(s2ns(1) / std::max(idleTime, (nsecs_t)1)));
+    setDecision(updateRate, info);
+
+    return (mLastClientCost * 100) <= (mLastDeviceCost * (100 - DR_COST_MARGIN_PERCENT));
+}
+
+uint32_t ExynosRecompPolicy::getRevertReason(uint32_t updateRate, const CostInfo &info) {
+    setDecision(updateRate, info);
+    if (mMode != MODE_CLIENT)
+        return REASON_NONE;
+
+    /* Thresholds are wider than the ones of shouldFlatten() not to oscillate */
+    if (updateRate >= DR_REVERT_UPDATE_RATE)
+        return REASON_UPDATE_RATE;
+    if (mLastClientCost > mLastDeviceCost)
+        return REASON_COST;
+    return REASON_NONE;
+}
+
+void ExynosRecompPolicy::setMode(uint32_t mode, uint32_t reason, nsecs_t now) {
+    if (mode == mMode)
+        return;
+
+    if (mode == MODE_CLIENT) {
+        mToClientCount++;
+    } else {
+        mToDeviceCount[std::min(reason, (uint32_t)REASON_MAX - 1)]++;
+        /* Wait longer before the next flattening if client composition didn't last */
+        if ((now - mSwitchTime) < ms2ns(DR_OSCILLATION_MS)) {
+            mOscillationCount++;
+            mIdleTimeout = std::min(mIdleTimeout * 2, ms2ns(DR_MAX_IDLE_TIMEOUT_MS));
+        } else {
+            mIdleTimeout = std::max(mIdleTimeout / 2, mMinIdleTimeout);
+        }
+    }
+    mMode = mode;
+    mLastReason = reason;
+    mSwitchTime = now;
+}
+
+void ExynosRecompPolicy::dump(android::String8 &result) {
+    static const char *reasonStr[REASON_MAX] = {"none", "static", "update rate", "cost", "geometry"};
+
+    result.appendFormat("Dynamic recomposition: mode(%s), idle timeout(%" PRId64 " ms), last reason(%s)\n",
+                        (mMode == MODE_CLIENT) ? "client" : "device", ns2ms(mIdleTimeout),
+                        reasonStr[std::min(mLastReason, (uint32_t)REASON_MAX - 1)]);
+    result.appendFormat("\tupdate rate(%u), device cost(%" PRIu64 " KB/s), client cost(%" PRIu64 " KB/s)\n",
+                        mLastUpdateRate, mLastDeviceCost / 1024, mLastClientCost / 1024);
+    result.appendFormat("\tto client(%" PRIu64 "), to device: update rate(%" PRIu64 "), cost(%" PRIu64 "), "
+                        "geometry(%" PRIu64 "), oscillation(%" PRIu64 ")\n",
+                        mToClientCount, mToDeviceCount[REASON_UPDATE_RATE], mToDeviceCount[REASON_COST],
+                        mToDeviceCount[REASON_GEOMETRY], mOscillationCount);
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _EXYNOSRECOMPPOLICY_H
+#define _EXYNOSRECOMPPOLICY_H
+
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+/* Update rate is the number of updates in this window */
+#ifndef DR_RATE_WINDOW_MS
+#define DR_RATE_WINDOW_MS 1000
+#endif
+
+/* Number of update timestamps that are kept, it limits the highest measurable rate */
+#ifndef DR_RATE_SAMPLES
+#define DR_RATE_SAMPLES 32
+#endif
+
+/* Client composition is reverted if content is updated this per second */
+#ifndef DR_REVERT_UPDATE_RATE
+#define DR_REVERT_UPDATE_RATE 8
+#endif
+
+/* Client composition should save this percent of bandwidth of device composition */
+#ifndef DR_COST_MARGIN_PERCENT
+#define DR_COST_MARGIN_PERCENT 20
+#endif
+
+/* Longest idle time before the display can be flattened to client composition */
+#ifndef DR_MAX_IDLE_TIMEOUT_MS
+#define DR_MAX_IDLE_TIMEOUT_MS 3200
+#endif
+
+/* Client composition reverted within this time is an oscillation */
+#ifndef DR_OSCILLATION_MS
+#define DR_OSCILLATION_MS 1000
+#endif
+
+/* Number of updates in the last DR_RATE_WINDOW_MS */
+class ExynosUpdateRate {
+  public:
+    void update(nsecs_t now);
+    void reset();
+    /* Updates per second */
+    uint32_t getRate(nsecs_t now) const;
+    nsecs_t getLastUpdateTime() const { return mCount ? mTimes[(mHead + DR_RATE_SAMPLES - 1) % DR_RATE_SAMPLES] : 0; };
+
+  private:
+    nsecs_t mTimes[DR_RATE_SAMPLES] = {0};
+    uint32_t mHead = 0;
+    uint32_t mCount = 0;
+};
+
+/*
+ * Decides the dynamic recomposition mode with the bandwidth of each mode.
+ * Device composition reads all layers on every refresh.
+ * Client composition reads only the client target on every refresh,
+ * but all layers are read and the target is written on every update.
+ * Idle timeout is doubled when client composition is reverted too soon.
+ */
+class ExynosRecompPolicy {
+  public:
+    enum {
+        MODE_DEVICE = 0,
+        MODE_CLIENT,
+    };
+
+    enum {
+        REASON_NONE = 0,
+        REASON_STATIC,
+        REASON_UPDATE_RATE,
+        REASON_COST,
+        REASON_GEOMETRY,
+        REASON_MAX,
+    };
+
+    /* idleTimeout is the default and the shortest idle time before flattening */
+    explicit ExynosRecompPolicy(nsecs_t idleTimeout)
+        : mMinIdleTimeout(idleTimeout), mIdleTimeout(idleTimeout){};
+
+    struct CostInfo {
+        /* Bytes that are read by DPU for a refresh in device composition */
+        uint64_t layerBytes = 0;
+        uint64_t targetBytes = 0;
+        uint32_t refreshRate = 60;
+    };
+
+    /* Bytes per second */
+    static uint64_t getDeviceCost(const CostInfo &info);
+    static uint64_t getClientCost(const CostInfo &info, uint32_t updateRate);
+
+    /*
+     * Called when content is not updated for idleTime.
+     * Update rate is expected to be lower than 1 / idleTime.
+     */
+    bool shouldFlatten(nsecs_t idleTime, uint32_t updateRate, const CostInfo &info);
+    /* Called for each frame of client composition, it returns REASON_NONE to keep it */
+    uint32_t getRevertReason(uint32_t updateRate, const CostInfo &info);
+    void setMode(uint32_t mode, uint32_t reason, nsecs_t now);
+    uint32_t getMode() const { return mMode; };
+    nsecs_t getIdleTimeout() const { return mIdleTimeout; };
+    void dump(android::String8 &result);
+
+  private:
+    void setDecision(uint32_t updateRate, const CostInfo &info);
+
+    uint32_t mMode = MODE_DEVICE;
+    nsecs_t mSwitchTime = 0;
+    const nsecs_t mMinIdleTimeout;
+    nsecs_t mIdleTimeout;
+
+    /* Inputs of the last decision */
+    uint32_t mLastUpdateRate = 0;
+    uint64_t mLastDeviceCost = 0;
+    uint64_t mLastClientCost = 0;
+    uint32_t mLastReason = REASON_NONE;
+
+    uint64_t mToClientCount = 0;
+    uint64_t mToDeviceCount[REASON_MAX] = {0};
+    uint64_t mOscillationCount = 0;
+};
+
+#endif  // _EXYNOSRECOMPPOLICY_H
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include "LatencyHistogram.h"
+
+using namespace android;
+
+static const char *latencyStageNames[LATENCY_STAGE_MAX] = {
+    "validate",
+    "preProcessing",
+    "assignResource",
+    "deliverPerformance",
+    "present",
+    "deliverWinConfig",
+    "setReleaseFences",
+    "getFBBuffer",
+};
+
+uint32_t LatencyHistogram::getBucketIndex(uint64_t usec) {
+    if (usec < LATENCY_SUB_BUCKET_NUM)
+        return (uint32_t)usec;
+
+    uint32_t msb = 63 - __builtin_clzll(usec);
+    uint32_t sub = (usec >> (msb - LATENCY_SUB_BUCKET_BITS)) & (LATENCY_SUB_BUCKET_NUM - 1);
+    uint32_t index = (msb - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKET_NUM + sub;
+
+    if (index >= LATENCY_BUCKET_NUM)
+        return LATENCY_BUCKET_NUM - 1;
+    return index;
+}
+
+uint64_t LatencyHistogram::getBucketUpperBound(uint32_t index) {
+    if (index < LATENCY_SUB_BUCKET_NUM)
+        return index + 1;
+
+    uint32_t msb = index / LATENCY_SUB_BUCKET_NUM - 1 + LATENCY_SUB_BUCKET_BITS;
+    uint64_t sub = index % LATENCY_SUB_BUCKET_NUM;
+    uint32_t shift = msb - LATENCY_SUB_BUCKET_BITS;
+    return (1ULL << msb) + ((sub + 1) << shift);
+}
+
+void LatencyHistogram::record(nsecs_t latency) {
+    uint64_t usec = (latency > 0) ? (uint64_t)ns2us(latency) : 0;
+
+    mBuckets[getBucketIndex(usec)].fetch_add(1, std::memory_order_relaxed);
+    mTotalUs.fetch_add(usec, std::memory_order_relaxed);
+
+    uint64_t maxUs = mMaxUs.load(std::memory_order_relaxed);
+    while ((usec > maxUs) &&
+           !mMaxUs.compare_exchange_weak(maxUs, usec, std::memory_order_relaxed))
+        ;
+}
+
+void LatencyHistogram::reset() {
+    for (auto &bucket : mBuckets)
+        bucket.store(0, std::memory_order_relaxed);
+    mTotalUs.store(0, std::memory_order_relaxed);
+    mMaxUs.store(0, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::dump(String8 &result, const char *name) const {
+    /* Snapshot can be torn by concurrent record(), which is fine for statistics */
+    uint64_t buckets[LATENCY_BUCKET_NUM];
+    uint64_t count = 0;
+    for (uint32_t i = 0; i < LATENCY_BUCKET_NUM; i++) {
+        buckets[i] = mBuckets[i].load(std::memory_order_relaxed);
+        count += buckets[i];
+    }
+
+    if (count == 0) {
+        result.appendFormat("\t%-20s count(0)\n", name);
+        return;
+    }
+
+    const uint32_t percents[] = {50, 95, 99};
+    uint64_t percentiles[3] = {0, 0, 0};
+    for (uint32_t p = 0; p < 3; p++) {
+        uint64_t target = (count * percents[p] + 99) / 100;
+        uint64_t accumulated = 0;
+        for (uint32_t i = 0; i < LATENCY_BUCKET_NUM; i++) {
+            accumulated += buckets[i];
+            if (accumulated >= target) {
+                percentiles[p] = getBucketUpperBound(i);
+                break;
+            }
+        }
+    }
+
+    result.appendFormat("\t%-20s count(%" PRIu64 "), avg(%" PRIu64 " us), "
+                        "p50(<%" PRIu64 " us), p95(<%" PRIu64 " us), p99(<%" PRIu64 " us), "
+                        "max(%" PRIu64 " us)\n",
+                        name, count, mTotalUs.load(std::memory_order_relaxed) / count,
+                        percentiles[0], percentiles[1], percentiles[2],
+                        mMaxUs.load(std::memory_order_relaxed));
+}
+
+void LatencyRecorder::reset() {
+    for (auto &histogram : mHistograms)
+        histogram.reset();
+}
+
+void LatencyRecorder::dump(String8 &result) const {
+    for (uint32_t i = 0; i < LATENCY_STAGE_MAX; i++)
+        mHistograms[i].dump(result, latencyStageNames[i]);
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LATENCYHISTOGRAM_H
+#define _LATENCYHISTOGRAM_H
+
+#include <atomic>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+/*
+ * Latencies are recorded in usec.
+ * Each power of two range is divided into LATENCY_SUB_BUCKET_NUM buckets,
+ * so a bucket is at most 25% wider than its lower bound.
+ */
+#define LATENCY_SUB_BUCKET_BITS 2
+#define LATENCY_SUB_BUCKET_NUM (1 << LATENCY_SUB_BUCKET_BITS)
+/* Latencies over about 4 sec are counted in the last bucket */
+#define LATENCY_RANGE_NUM 21
+#define LATENCY_BUCKET_NUM (LATENCY_RANGE_NUM * LATENCY_SUB_BUCKET_NUM)
+
+typedef enum latency_stage {
+    LATENCY_STAGE_VALIDATE = 0,
+    LATENCY_STAGE_PRE_PROCESSING,
+    LATENCY_STAGE_ASSIGN_RESOURCE,
+    LATENCY_STAGE_DELIVER_PERFORMANCE,
+    LATENCY_STAGE_PRESENT,
+    LATENCY_STAGE_DELIVER_WIN_CONFIG,
+    LATENCY_STAGE_SET_RELEASE_FENCES,
+    LATENCY_STAGE_GET_FB_BUFFER,
+    LATENCY_STAGE_MAX
+} latency_stage_t;
+
+/* It can be recorded by several threads without lock */
+class LatencyHistogram {
+  public:
+    void record(nsecs_t latency);
+    void reset();
+    void dump(android::String8 &result, const char *name) const;
+
+    static uint32_t getBucketIndex(uint64_t usec);
+    /* Exclusive upper bound of the bucket in usec */
+    static uint64_t getBucketUpperBound(uint32_t index);
+
+  private:
+    std::atomic<uint64_t> mBuckets[LATENCY_BUCKET_NUM] = {};
+    std::atomic<uint64_t> mTotalUs = 0;
+    std::atomic<uint64_t> mMaxUs = 0;
+};
+
+class LatencyRecorder {
+  public:
+    void record(latency_stage_t stage, nsecs_t latency) {
+        mHistograms[stage].record(latency);
+    };
+    void reset();
+    void dump(android::String8 &result) const;
+
+  private:
+    LatencyHistogram mHistograms[LATENCY_STAGE_MAX];
+};
+
+/* Records the time until the end of the scope */
+class ScopedLatency {
+  public:
+    ScopedLatency(LatencyRecorder *recorder, latency_stage_t stage)
+        : mRecorder(recorder), mStage(stage),
+          mStartTime(systemTime(SYSTEM_TIME_MONOTONIC)){};
+    ~ScopedLatency() {
+        if (mRecorder)
+            mRecorder->record(mStage, systemTime(SYSTEM_TIME_MONOTONIC) - mStartTime);
+    };
+
+  private:
+    LatencyRecorder *mRecorder;
+    latency_stage_t mStage;
+    nsecs_t mStartTime;
+};
+
+#endif  // _LATENCYHISTOGRAM_H
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "WorkerPool.h"
+#include <log/log.h>
+
+WorkerPool::WorkerPool(uint32_t threadNum)
+    : mThreadNum(threadNum) {}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopTriggered = true;
+    }
+    mTaskCondition.notify_all();
+    for (auto &thread : mThreads) {
+        if (thread.joinable())
+            thread.join();
+    }
+}
+
+bool WorkerPool::popTask(Task &task) {
+    if ((mTasks == nullptr) || (mNextTask >= mTasks->size()))
+        return false;
+    task = (*mTasks)[mNextTask++];
+    return true;
+}
+
+void WorkerPool::finishTask() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (--mPendingTaskNum == 0)
+        mDoneCondition.notify_all();
+}
+
+void WorkerPool::run(std::vector<Task> &tasks) {
+    if (tasks.empty())
+        return;
+
+    if ((tasks.size() > 1) && mThreads.empty()) {
+        for (uint32_t i = 0; i < mThreadNum; i++)
+            mThreads.emplace_back(&WorkerPool::loop, this);
+        ALOGI("WorkerPool:: %u threads are started", mThreadNum);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTasks = &tasks;
+        mNextTask = 0;
+        mPendingTaskNum = tasks.size();
+    }
+    mTaskCondition.notify_all();
+
+    Task task;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!popTask(task))
+                break;
+        }
+        task();
+        finishTask();
+    }
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDoneCondition.wait(lock, [this] { return mPendingTaskNum == 0; });
+    mTasks = nullptr;
+}
+
+void WorkerPool::loop() {
+    Task task;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mTaskCondition.wait(lock, [&] { return mStopTriggered || popTask(task); });
+            if (mStopTriggered)
+                return;
+        }
+        task();
+        finishTask();
+    }
+}
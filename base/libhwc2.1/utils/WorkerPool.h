@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _WORKERPOOL_H
+#define _WORKERPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool {
+  public:
+    using Task = std::function<void()>;
+
+    WorkerPool(uint32_t threadNum);
+    ~WorkerPool();
+
+    // Runs all tasks and returns when they are finished.
+    // The calling thread runs tasks too, so threads are started only
+    // when there are more tasks than one.
+    void run(std::vector<Task> &tasks);
+
+  private:
+    // Function that loops until the pool is destroyed.
+    void loop();
+    // Takes the next task of the current run. Called with mMutex held.
+    bool popTask(Task &task);
+    void finishTask();
+
+    const uint32_t mThreadNum;
+    std::vector<std::thread> mThreads;
+
+    std::mutex mMutex;
+    // Signaled when tasks are queued or the pool is stopped.
+    std::condition_variable mTaskCondition;
+    // Signaled when the last task of a run is finished.
+    std::condition_variable mDoneCondition;
+    std::vector<Task> *mTasks = nullptr;
+    size_t mNextTask = 0;
+    size_t mPendingTaskNum = 0;
+    bool mStopTriggered = false;
+};
+#endif  // _WORKERPOOL_H
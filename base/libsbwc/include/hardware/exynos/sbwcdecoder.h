@@ -5,6 +5,9 @@
 
 #define SBWCDECODER_ATTR_SECURE_BUFFER  (1 << 0)
 
+/* Number of buffers that can be queued at the same time */
+#define SBWCDECODER_DEFAULT_BUFFERS     3
+
 class SbwcImgInfo {
 public:
     unsigned int fmt;
@@ -13,9 +16,16 @@ public:
     unsigned int stride;
 };
 
+/*
+ * The V4L2 session is kept streaming between frames.
+ * It is renegotiated only when setImage() changes the format, size, crop,
+ * dataspace or protection. release() should be called when no frame is
+ * expected for a while, otherwise the session holds the driver buffers and
+ * the frame rate request until the decoder is destroyed.
+ */
 class SbwcDecoder {
 public:
-    SbwcDecoder();
+    SbwcDecoder(unsigned int numBuffers = SBWCDECODER_DEFAULT_BUFFERS);
     ~SbwcDecoder();
     bool setImage(unsigned int format, unsigned int width,
                   unsigned int height, unsigned int stride);
@@ -24,16 +34,39 @@ public:
                   unsigned int attr, unsigned int framerate = 0);
     bool setImage(SbwcImgInfo &src, SbwcImgInfo &dst, unsigned int dataspace,
                   unsigned int attr, unsigned int framerate = 0);
+    /* Decodes a frame synchronously, no frame should be queued */
     bool decode(int inBuf[], size_t inLen[], int outBuf[], size_t outLen[]);
+
+    /*
+     * Queues a frame without waiting for it. Frames are completed in queued order.
+     * outIndex is the buffer index that dequeue() returns for the frame.
+     * If the source is queued but the destination is not, the session is
+     * restarted and the frames in flight are dropped.
+     */
+    bool queue(int inBuf[], size_t inLen[], int outBuf[], size_t outLen[],
+               unsigned int *outIndex = nullptr);
+    /* Dequeues the oldest frame, waits up to timeoutMs or forever if it is negative */
+    bool dequeue(unsigned int *outIndex = nullptr, int timeoutMs = -1);
+    /*
+     * Stops streaming and frees the driver buffers and the frame rate request.
+     * Frames in flight are dropped. The next frame configures a new session.
+     */
+    void release();
+    /* Readable (POLLIN) when the oldest frame is completed */
+    int getCompletionFd() { return fd_dev; }
+    unsigned int getNumInflight() { return mNumInflight; }
 private:
+    bool configure();
+    void resetStream();
     bool setCtrl();
-    bool setFrameRate();
+    bool setFrameRate(uint32_t framerate);
     bool setFmt();
     bool setCrop();
     bool streamOn();
     bool streamOff();
-    bool queueBuf(int inBuf[], size_t inLen[], int outBuf[], size_t outLen[]);
-    bool dequeueBuf();
+    bool queueBuf(unsigned int index, int inBuf[], size_t inLen[],
+                  int outBuf[], size_t outLen[], bool *srcQueued);
+    bool dequeueBuf(unsigned int *index, bool *error);
     bool reqBufsWithCount(unsigned int count);
 
     int fd_dev;
@@ -45,6 +78,16 @@ private:
     bool mIsProtected = 0;
     uint32_t mFrameRate = 0;
     unsigned int mDataspace = 0;
+
+    unsigned int mNumBuffers;
+    /* Number of buffers allocated by the driver while streaming */
+    unsigned int mNumAllocated = 0;
+    unsigned int mNumInflight = 0;
+    unsigned int mNextIndex = 0;
+    bool mStreaming = false;
+    /* Image is changed by setImage() after the session is configured */
+    bool mNeedConfig = true;
+    bool mNeedFrameRate = false;
 };
 
 #endif
@@ -1,9 +1,11 @@
+#include <algorithm>
 #include <cstring>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <cstdio>
 #include <cerrno>
 #include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 
 #include <log/log.h>
@@ -72,7 +74,8 @@ enum {
     HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SPN_10B_SBWC_L80  = 0x172,
 };
 
-SbwcDecoder::SbwcDecoder()
+SbwcDecoder::SbwcDecoder(unsigned int numBuffers)
+    : mNumBuffers(numBuffers ? numBuffers : 1)
 {
     fd_dev = open(MSCLPATH, O_RDWR);
     if (fd_dev < 0) {
@@ -83,8 +86,10 @@ SbwcDecoder::SbwcDecoder()
 
 SbwcDecoder::~SbwcDecoder()
 {
-    if (fd_dev >= 0)
+    if (fd_dev >= 0) {
+        resetStream();
         close(fd_dev);
+    }
 }
 
 bool SbwcDecoder::reqBufsWithCount(unsigned int count)
@@ -92,7 +97,9 @@ bool SbwcDecoder::reqBufsWithCount(unsigned int count)
     ATRACE_CALL();
 
     v4l2_requestbuffers reqbufs;
+    unsigned int srcCount;
 
+    memset(&reqbufs, 0, sizeof(reqbufs));
     reqbufs.count = count;
     reqbufs.memory = V4L2_MEMORY_DMABUF;
 
@@ -103,6 +110,8 @@ bool SbwcDecoder::reqBufsWithCount(unsigned int count)
         return false;
     }
 
+    srcCount = reqbufs.count;
+    reqbufs.count = count;
     reqbufs.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
 
     if (ioctl(fd_dev, VIDIOC_REQBUFS, &reqbufs) < 0) {
@@ -110,6 +119,9 @@ bool SbwcDecoder::reqBufsWithCount(unsigned int count)
         return false;
     }
 
+    /* Driver could allocate less buffers than requested */
+    mNumAllocated = std::min({count, srcCount, reqbufs.count});
+
     return true;
 }
 
@@ -194,17 +206,17 @@ bool SbwcDecoder::setCtrl()
     return true;
 }
 
-bool SbwcDecoder::setFrameRate()
+bool SbwcDecoder::setFrameRate(uint32_t framerate)
 {
     ATRACE_CALL();
 
     v4l2_control ctrl;
 
     ctrl.id = SC_CID_FRAMERATE;
-    ctrl.value = mFrameRate;
+    ctrl.value = framerate;
 
     if (ioctl(fd_dev, VIDIOC_S_CTRL, &ctrl) < 0) {
-        ALOGERR("Failed to S_CTRL to set framerate %d", mFrameRate);
+        ALOGERR("Failed to S_CTRL to set framerate %d", framerate);
         return false;
     }
 
@@ -326,16 +338,18 @@ bool SbwcDecoder::streamOff()
 }
 
 //TODO : data_offset is not set, calculate byteused
-bool SbwcDecoder::queueBuf(int inBuf[], size_t inLen[],
-                           int outBuf[], size_t outLen[])
+bool SbwcDecoder::queueBuf(unsigned int index, int inBuf[], size_t inLen[],
+                           int outBuf[], size_t outLen[], bool *srcQueued)
 {
     ATRACE_CALL();
 
     v4l2_buffer buffer;
     v4l2_plane planes[4];
 
+    *srcQueued = false;
     memset(&buffer, 0, sizeof(buffer));
 
+    buffer.index = index;
     buffer.memory = V4L2_MEMORY_DMABUF;
 
     memset(planes, 0, sizeof(planes));
@@ -355,6 +369,7 @@ bool SbwcDecoder::queueBuf(int inBuf[], size_t inLen[],
         return false;
     }
 
+    *srcQueued = true;
     memset(planes, 0, sizeof(planes));
 
     buffer.length = mDstNumFd;
@@ -374,7 +389,8 @@ bool SbwcDecoder::queueBuf(int inBuf[], size_t inLen[],
     return true;
 }
 
-bool SbwcDecoder::dequeueBuf()
+/* Returns false if the buffers are not dequeued, error is set if the frame failed */
+bool SbwcDecoder::dequeueBuf(unsigned int *index, bool *error)
 {
     ATRACE_CALL();
 
@@ -383,6 +399,7 @@ bool SbwcDecoder::dequeueBuf()
 
     memset(&buffer, 0, sizeof(buffer));
 
+    *error = false;
     buffer.memory = V4L2_MEMORY_DMABUF;
 
     buffer.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
@@ -395,7 +412,7 @@ bool SbwcDecoder::dequeueBuf()
         return false;
     } else if (!!(buffer.flags & V4L2_BUF_FLAG_ERROR)) {
         ALOGERR("%s:Error during running(SRC)", __func__);
-        return false;
+        *error = true;
     }
 
     buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
@@ -406,39 +423,181 @@ bool SbwcDecoder::dequeueBuf()
     if (ioctl(fd_dev, VIDIOC_DQBUF, &buffer) < 0) {
         ALOGERR("Failed to DQBUF(DST)");
         return false;
-    } else if (!!(buffer.flags & V4L2_BUF_FLAG_ERROR)) {
+    }
+
+    *index = buffer.index;
+    if (!!(buffer.flags & V4L2_BUF_FLAG_ERROR)) {
         ALOGERR("%s:Error during running(DST)", __func__);
-        return false;
+        *error = true;
     }
 
     return true;
 }
 
-bool SbwcDecoder::decode(int inBuf[], size_t inLen[],
-                         int outBuf[], size_t outLen[])
+bool SbwcDecoder::configure()
 {
+    ATRACE_CALL();
+
     bool ret;
 
+    resetStream();
+
     ret = setCtrl();
     if (ret)
         ret = setFmt();
     if (ret)
         ret = setCrop();
     if (ret)
-        ret = setFrameRate();
+        ret = setFrameRate(mFrameRate);
     if (ret)
-        ret = reqBufsWithCount(1);
+        ret = reqBufsWithCount(mNumBuffers);
     if (ret)
         ret = streamOn();
-    if (ret)
-        ret = queueBuf(inBuf, inLen, outBuf, outLen);
-    if (ret)
-        ret = dequeueBuf();
 
+    if (!ret) {
+        streamOff();
+        reqBufsWithCount(0);
+        return false;
+    }
+
+    mStreaming = true;
+    mNeedConfig = false;
+    mNeedFrameRate = false;
+    mNextIndex = 0;
+
+    return true;
+}
+
+void SbwcDecoder::resetStream()
+{
+    if (!mStreaming)
+        return;
+
+    /* Buffers in flight are returned to the driver by STREAMOFF */
     streamOff();
     reqBufsWithCount(0);
 
-    return ret;
+    mStreaming = false;
+    mNumInflight = 0;
+}
+
+void SbwcDecoder::release()
+{
+    ATRACE_CALL();
+
+    if ((fd_dev < 0) || !mStreaming)
+        return;
+
+    resetStream();
+    mNeedConfig = true;
+
+    /* configure() requests the frame rate again for the next frame */
+    if (mFrameRate != 0)
+        setFrameRate(0);
+}
+
+bool SbwcDecoder::queue(int inBuf[], size_t inLen[],
+                        int outBuf[], size_t outLen[], unsigned int *outIndex)
+{
+    ATRACE_CALL();
+
+    unsigned int index;
+    bool srcQueued;
+
+    if ((mSrc.fmt == 0) || (mDst.fmt == 0)) {
+        ALOGE("Image is not set");
+        return false;
+    }
+
+    if (mNeedConfig) {
+        if (mNumInflight > 0) {
+            ALOGE("%u frames should be dequeued before the image is changed", mNumInflight);
+            return false;
+        }
+        if (!configure())
+            return false;
+    } else if (mNeedFrameRate) {
+        if (!setFrameRate(mFrameRate))
+            return false;
+        mNeedFrameRate = false;
+    }
+
+    if (mNumInflight >= mNumAllocated) {
+        ALOGE("All of %u buffers are in flight", mNumAllocated);
+        return false;
+    }
+
+    /* Frames are completed in order, so the buffers are used in a ring */
+    index = mNextIndex;
+    if (!queueBuf(index, inBuf, inLen, outBuf, outLen, &srcQueued)) {
+        /* SRC without DST breaks the ring, drop the frames in flight with the session */
+        if (srcQueued) {
+            resetStream();
+            mNeedConfig = true;
+        }
+        return false;
+    }
+
+    mNextIndex = (mNextIndex + 1) % mNumAllocated;
+    mNumInflight++;
+    if (outIndex)
+        *outIndex = index;
+
+    return true;
+}
+
+bool SbwcDecoder::dequeue(unsigned int *outIndex, int timeoutMs)
+{
+    ATRACE_CALL();
+
+    unsigned int index = 0;
+    bool error;
+
+    if (mNumInflight == 0) {
+        ALOGE("No frame is queued");
+        return false;
+    }
+
+    if (timeoutMs >= 0) {
+        pollfd pfd = {fd_dev, POLLIN, 0};
+        int err = poll(&pfd, 1, timeoutMs);
+        if (err == 0) {
+            errno = ETIMEDOUT;
+            return false;
+        } else if (err < 0) {
+            ALOGERR("Failed to poll");
+            return false;
+        }
+    }
+
+    if (!dequeueBuf(&index, &error)) {
+        /* Buffers in flight are unknown, start again from a new session */
+        resetStream();
+        mNeedConfig = true;
+        return false;
+    }
+
+    mNumInflight--;
+    if (outIndex)
+        *outIndex = index;
+
+    return !error;
+}
+
+bool SbwcDecoder::decode(int inBuf[], size_t inLen[],
+                         int outBuf[], size_t outLen[])
+{
+    ATRACE_CALL();
+
+    if (mNumInflight > 0) {
+        ALOGE("%u frames are queued, decode() can't be mixed with queue()", mNumInflight);
+        return false;
+    }
+
+    if (!queue(inBuf, inLen, outBuf, outLen))
+        return false;
+
+    return dequeue();
 }
 
 static struct {
@@ -522,62 +681,83 @@ bool SbwcDecoder::setImage(unsigned int format, unsigned int width,
     return setImage(src, dst, 0, attr, framerate);
 }
 
+static bool isSameImage(const SbwcImgInfo &a, const SbwcImgInfo &b)
+{
+    return (a.fmt == b.fmt) && (a.width == b.width) &&
+           (a.height == b.height) && (a.stride == b.stride);
+}
+
 bool SbwcDecoder::setImage(SbwcImgInfo &src, SbwcImgInfo &dst,
                            unsigned int dataspace, unsigned int attr, unsigned int framerate)
 {
     ATRACE_CALL();
 
-    mSrc.fmt = 0;
+    SbwcImgInfo newSrc{0, src.width, src.height, src.stride};
+    SbwcImgInfo newDst{0, dst.width, dst.height, dst.stride};
+    unsigned int srcNumFd = 0;
+    unsigned int dstNumFd = 0;
+    uint32_t lossyBlockSize = 0;
+    bool isProtected = !!(attr & SBWCDECODER_ATTR_SECURE_BUFFER);
+
     for (size_t i = 0; i < ARRSIZE(__halfmtSBWC_to_v4l2); i++) {
         if (src.fmt == __halfmtSBWC_to_v4l2[i].fmtHal) {
-            mSrc.fmt = __halfmtSBWC_to_v4l2[i].fmtV4L2;
-            mSrcNumFd = __halfmtSBWC_to_v4l2[i].numFd;
-            mLossyBlockSize = __halfmtSBWC_to_v4l2[i].blockSz;
+            newSrc.fmt = __halfmtSBWC_to_v4l2[i].fmtV4L2;
+            srcNumFd = __halfmtSBWC_to_v4l2[i].numFd;
+            lossyBlockSize = __halfmtSBWC_to_v4l2[i].blockSz;
 
             break;
         }
     }
-    if (mSrc.fmt == 0) {
+    if (newSrc.fmt == 0) {
         for (size_t i = 0; i < ARRSIZE(__halfmtNonSBWC_to_v4l2); i++) {
             if (src.fmt == __halfmtNonSBWC_to_v4l2[i].fmtHal) {
-                mSrc.fmt = __halfmtNonSBWC_to_v4l2[i].fmtV4L2;
-                mSrcNumFd = __halfmtNonSBWC_to_v4l2[i].numFd;
-                mLossyBlockSize = 0;
+                newSrc.fmt = __halfmtNonSBWC_to_v4l2[i].fmtV4L2;
+                srcNumFd = __halfmtNonSBWC_to_v4l2[i].numFd;
+                lossyBlockSize = 0;
 
                 break;
             }
         }
     }
-    if (mSrc.fmt == 0) {
-        ALOGE("fail to find the proper v4l2 format for HAL format(SRC) %#x", mSrc.fmt);
+    if (newSrc.fmt == 0) {
+        ALOGE("fail to find the proper v4l2 format for HAL format(SRC) %#x", src.fmt);
+        mSrc.fmt = 0;
+        mNeedConfig = true;
         return false;
     }
 
-    mDst.fmt = 0;
     for (size_t i = 0; i < ARRSIZE(__halfmtNonSBWC_to_v4l2); i++) {
         if (dst.fmt == __halfmtNonSBWC_to_v4l2[i].fmtHal) {
-            mDst.fmt = __halfmtNonSBWC_to_v4l2[i].fmtV4L2;
-            mDstNumFd = __halfmtNonSBWC_to_v4l2[i].numFd;
+            newDst.fmt = __halfmtNonSBWC_to_v4l2[i].fmtV4L2;
+            dstNumFd = __halfmtNonSBWC_to_v4l2[i].numFd;
 
             break;
         }
     }
-    if (mDst.fmt == 0) {
-        ALOGE("fail to find the proper v4l2 format for HAL format(DST) %#x", mDst.fmt);
+    if (newDst.fmt == 0) {
+        ALOGE("fail to find the proper v4l2 format for HAL format(DST) %#x", dst.fmt);
+        mDst.fmt = 0;
+        mNeedConfig = true;
         return false;
     }
 
-    mSrc.width = src.width;
-    mSrc.height = src.height;
-    mSrc.stride = src.stride;
+    /* Frame rate is the only one that can be changed while streaming */
+    if (!isSameImage(mSrc, newSrc) || !isSameImage(mDst, newDst) ||
+        (mLossyBlockSize != lossyBlockSize) || (mIsProtected != isProtected) ||
+        (isRGB(newDst.fmt) && (mDataspace != dataspace)))
+        mNeedConfig = true;
+    else if (mFrameRate != framerate)
+        mNeedFrameRate = true;
 
-    mDst.width = dst.width;
-    mDst.height = dst.height;
-    mDst.stride = dst.stride;
+    mSrc = newSrc;
+    mDst = newDst;
+    mSrcNumFd = srcNumFd;
+    mDstNumFd = dstNumFd;
+    mLossyBlockSize = lossyBlockSize;
 
     mDataspace = dataspace;
     mFrameRate = framerate;
-    mIsProtected = !!(attr & SBWCDECODER_ATTR_SECURE_BUFFER);
+    mIsProtected = isProtected;
 
     return true;
 }
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <hardware/exynos/ion.h>
+#include <hardware/exynos/sbwcdecoder.h>
+
+/*
+ * The frames are NV12M copies by the scaler of the decoder, so every frame
+ * completes without error whatever the contents of the buffers are.
+ */
+#define TEST_FORMAT_NV12M 0x105 /* HAL_PIXEL_FORMAT_EXYNOS_YCbCr_420_SP_M */
+#define TEST_WIDTH        256
+#define TEST_HEIGHT       128
+#define TEST_TIMEOUT_MS   1000
+
+class SbwcDecoderTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        mIonFd = exynos_ion_open();
+        ASSERT_GE(mIonFd, 0);
+
+        size_t len[2] = {TEST_WIDTH * TEST_HEIGHT, TEST_WIDTH * TEST_HEIGHT / 2};
+        for (int i = 0; i < 2; i++) {
+            mLen[i] = len[i];
+            mIn[i] = exynos_ion_alloc(mIonFd, len[i], EXYNOS_ION_HEAP_SYSTEM_MASK, 0);
+            mOut[i] = exynos_ion_alloc(mIonFd, len[i], EXYNOS_ION_HEAP_SYSTEM_MASK, 0);
+            ASSERT_GE(mIn[i], 0);
+            ASSERT_GE(mOut[i], 0);
+        }
+
+        mDecoder = new SbwcDecoder();
+        if (mDecoder->getCompletionFd() < 0)
+            GTEST_SKIP() << "SBWC decoder device is not available";
+
+        SbwcImgInfo img = {TEST_FORMAT_NV12M, TEST_WIDTH, TEST_HEIGHT, TEST_WIDTH};
+        ASSERT_TRUE(mDecoder->setImage(img, img, 0, 0));
+    }
+
+    virtual void TearDown() {
+        delete mDecoder;
+        for (int i = 0; i < 2; i++) {
+            if (mIn[i] >= 0)
+                close(mIn[i]);
+            if (mOut[i] >= 0)
+                close(mOut[i]);
+        }
+        if (mIonFd >= 0)
+            exynos_ion_close(mIonFd);
+    }
+
+    bool queue(unsigned int *index) {
+        return mDecoder->queue(mIn, mLen, mOut, mLen, index);
+    }
+
+    int mIonFd = -1;
+    int mIn[2] = {-1, -1};
+    int mOut[2] = {-1, -1};
+    size_t mLen[2];
+    SbwcDecoder *mDecoder = nullptr;
+};
+
+TEST_F(SbwcDecoderTest, Ring)
+{
+    unsigned int index;
+
+    ASSERT_TRUE(mDecoder->decode(mIn, mLen, mOut, mLen));
+
+    /* Buffers are used in a ring in queued order, from the one after decode() */
+    for (unsigned int i = 0; i < SBWCDECODER_DEFAULT_BUFFERS; i++) {
+        ASSERT_TRUE(queue(&index));
+        EXPECT_EQ(index, (i + 1) % SBWCDECODER_DEFAULT_BUFFERS);
+    }
+    EXPECT_EQ(mDecoder->getNumInflight(), SBWCDECODER_DEFAULT_BUFFERS);
+    EXPECT_FALSE(queue(&index));
+    EXPECT_FALSE(mDecoder->decode(mIn, mLen, mOut, mLen));
+
+    for (unsigned int i = 0; i < SBWCDECODER_DEFAULT_BUFFERS; i++) {
+        ASSERT_TRUE(mDecoder->dequeue(&index, TEST_TIMEOUT_MS));
+        EXPECT_EQ(index, (i + 1) % SBWCDECODER_DEFAULT_BUFFERS);
+    }
+    EXPECT_EQ(mDecoder->getNumInflight(), 0u);
+    EXPECT_FALSE(mDecoder->dequeue(&index, 0));
+
+    ASSERT_TRUE(queue(&index));
+    EXPECT_EQ(index, 1u);
+    ASSERT_TRUE(mDecoder->dequeue(&index, TEST_TIMEOUT_MS));
+}
+
+TEST_F(SbwcDecoderTest, QueueSrcWithoutDst)
+{
+    unsigned int index;
+    int badOut[2] = {-1, -1};
+
+    ASSERT_TRUE(queue(&index));
+    EXPECT_EQ(index, 0u);
+
+    /* SRC is queued but DST is not, the frame in flight is dropped with the session */
+    EXPECT_FALSE(mDecoder->queue(mIn, mLen, badOut, mLen, &index));
+    EXPECT_EQ(mDecoder->getNumInflight(), 0u);
+    EXPECT_FALSE(mDecoder->dequeue(&index, 0));
+
+    /* The next frame starts a new ring */
+    ASSERT_TRUE(queue(&index));
+    EXPECT_EQ(index, 0u);
+    ASSERT_TRUE(mDecoder->dequeue(&index, TEST_TIMEOUT_MS));
+    EXPECT_EQ(index, 0u);
+}
+
+TEST_F(SbwcDecoderTest, Release)
+{
+    unsigned int index;
+
+    ASSERT_TRUE(queue(&index));
+    mDecoder->release();
+    EXPECT_EQ(mDecoder->getNumInflight(), 0u);
+    mDecoder->release();
+
+    ASSERT_TRUE(queue(&index));
+    EXPECT_EQ(index, 0u);
+    ASSERT_TRUE(mDecoder->dequeue(&index, TEST_TIMEOUT_MS));
+    ASSERT_TRUE(mDecoder->decode(mIn, mLen, mOut, mLen));
+}